@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "incident_helper"
+
+#include "SectionParsers.h"
+
+#include "parsers/BatteryTypeParser.h"
+#include "parsers/CpuFreqParser.h"
+#include "parsers/CpuInfoParser.h"
+#include "parsers/EventLogTagsParser.h"
+#include "parsers/KernelWakesParser.h"
+#include "parsers/PageTypeInfoParser.h"
+#include "parsers/ProcrankParser.h"
+#include "parsers/PsParser.h"
+#include "parsers/SystemPropertiesParser.h"
+
+TextParserBase* selectSectionParser(int sectionId) {
+    switch (sectionId) {
+        // IDs larger than 1 are section ids reserved in incident.proto
+        case 1000:
+            return new SystemPropertiesParser();
+        case 1100:
+            return new EventLogTagsParser();
+        case 2000:
+            return new ProcrankParser();
+        case 2001:
+            return new PageTypeInfoParser();
+        case 2002:
+            return new KernelWakesParser();
+        case 2003:
+            return new CpuInfoParser();
+        case 2004:
+            return new CpuFreqParser();
+        case 2005:
+            return new PsParser();
+        case 2006:
+            return new BatteryTypeParser();
+        default:
+            return NULL;
+    }
+}
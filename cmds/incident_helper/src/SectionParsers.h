@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SECTION_PARSERS_H
+#define SECTION_PARSERS_H
+
+#include "TextParserBase.h"
+
+/**
+ * Returns a new parser of the given section of incident.proto, or NULL if the section has none.
+ * The parsers are also linked into incidentd, which runs them in process.
+ */
+TextParserBase* selectSectionParser(int sectionId);
+
+#endif // SECTION_PARSERS_H
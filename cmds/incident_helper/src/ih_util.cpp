@@ -236,7 +236,11 @@ double toDouble(const std::string& s) {
 // ==============================================================================
 Reader::Reader(const int fd)
 {
-    mFile = fdopen(fd, "r");
+    // Reads a dup of the fd, so that closing the reader leaves the fd to its owner, e.g. incidentd
+    // which runs the parsers in process.
+    int dupFd = dup(fd);
+    mFile = dupFd < 0 ? NULL : fdopen(dupFd, "r");
+    if (mFile == NULL && dupFd >= 0) close(dupFd);
     mStatus = mFile == NULL ? "Invalid fd " + std::to_string(fd) : "";
 }
 
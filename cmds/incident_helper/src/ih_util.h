@@ -104,7 +104,7 @@ double toDouble(const std::string& s);
 
 /**
  * Reader class reads data from given fd in streaming fashion.
- * The buffer size is controlled by capacity parameter.
+ * The buffer size is controlled by capacity parameter. The fd is left open.
  */
 class Reader
 {
@@ -16,15 +16,7 @@
 
 #define LOG_TAG "incident_helper"
 
-#include "parsers/BatteryTypeParser.h"
-#include "parsers/CpuFreqParser.h"
-#include "parsers/CpuInfoParser.h"
-#include "parsers/EventLogTagsParser.h"
-#include "parsers/KernelWakesParser.h"
-#include "parsers/PageTypeInfoParser.h"
-#include "parsers/ProcrankParser.h"
-#include "parsers/PsParser.h"
-#include "parsers/SystemPropertiesParser.h"
+#include "SectionParsers.h"
 
 #include <android-base/file.h>
 #include <getopt.h>
@@ -54,26 +46,8 @@ static TextParserBase* selectParser(int section) {
             return new ReverseParser();
 /* ========================================================================= */
         // IDs larger than 1 are section ids reserved in incident.proto
-        case 1000:
-            return new SystemPropertiesParser();
-        case 1100:
-            return new EventLogTagsParser();
-        case 2000:
-            return new ProcrankParser();
-        case 2001:
-            return new PageTypeInfoParser();
-        case 2002:
-            return new KernelWakesParser();
-        case 2003:
-            return new CpuInfoParser();
-        case 2004:
-            return new CpuFreqParser();
-        case 2005:
-            return new PsParser();
-        case 2006:
-            return new BatteryTypeParser();
         default:
-            return NULL;
+            return selectSectionParser(section);
     }
 }
 
@@ -18,6 +18,7 @@
 
 #include <android-base/file.h>
 #include <android-base/test_utils.h>
+#include <fcntl.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <string>
@@ -197,6 +198,20 @@ TEST(IhUtilTest, ReaderMultipleEmptyLines) {
     ASSERT_TRUE(r.ok(&line));
 }
 
+TEST(IhUtilTest, ReaderLeavesFdOpen) {
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    ASSERT_TRUE(WriteStringToFile("test string\n", tf.path));
+
+    {
+        Reader r(tf.fd);
+        string line;
+        ASSERT_TRUE(r.readLine(&line));
+        EXPECT_THAT(line, StrEq("test string"));
+    }
+    EXPECT_NE(-1, fcntl(tf.fd, F_GETFD));
+}
+
 TEST(IhUtilTest, ReaderFailedNegativeFd) {
     Reader r(-123);
     string line;
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "Section.h"
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <android/os/IncidentReportArgs.h>
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+
+namespace android {
+namespace os {
+namespace incidentd {
+
+// The battery type section, whose file is one short line like most of the sysfs files.
+static const int kBatteryTypeSection = 2006;
+
+// The overhead of a file section: the file is small, so the time is mostly starting the parser
+// and getting the data back from it.
+static void BM_FileSection(benchmark::State& state) {
+    const bool parseInProcess = state.range(0);
+    TemporaryFile tf;
+    android::base::WriteStringToFile("li-ion\n", tf.path);
+    FileSection section(kBatteryTypeSection, tf.path);
+
+    ReportRequestSet requests;
+    IncidentReportArgs args;
+    args.setAll(true);
+    args.setDest(android::os::DEST_LOCAL);
+    requests.add(new ReportRequest(args, NULL, open("/dev/null", O_WRONLY | O_CLOEXEC)));
+
+    FileSection::setParseInProcess(parseInProcess);
+    int errors = 0;
+    while (state.KeepRunning()) {
+        errors += section.Execute(&requests) != NO_ERROR;
+    }
+    FileSection::setParseInProcess(true);
+    state.SetLabel(parseInProcess ? "in process" : "incident_helper");
+    state.counters["errors"] = errors;
+}
+BENCHMARK(BM_FileSection)->Arg(true)->Arg(false)->Unit(benchmark::kMicrosecond);
+
+}  //  namespace incidentd
+}  //  namespace os
+}  //  namespace android
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <string>
+#include "FdBuffer.h"
+#include "Section.h"
+#include "benchmark/benchmark.h"
+#include "incidentd_util.h"
+
+namespace android {
+namespace os {
+namespace incidentd {
+
+static const char* GZIP[] = {"/system/bin/gzip", NULL};
+
+// About a last_kmsg: lines of kernel log, which compress well.
+static void WriteKernelLog(const char* path, size_t size) {
+    std::string content;
+    for (int i = 0; content.size() < size; i++) {
+        content += "[" + std::to_string(i / 1000) + "." + std::to_string(i % 1000) +
+                   "] healthd: battery l=" + std::to_string(i % 100) + " v=4100 t=30.0 h=2 st=3 " +
+                   "c=-" + std::to_string(i % 4000) + " chg=\n";
+    }
+    android::base::WriteStringToFile(content, path);
+}
+
+// The CPU time of incidentd and of its children, e.g. gzip.
+static int64_t CpuTimeUs() {
+    int64_t cpuTimeUs = 0;
+    for (int who : {RUSAGE_SELF, RUSAGE_CHILDREN}) {
+        struct rusage usage;
+        getrusage(who, &usage);
+        cpuTimeUs += (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL +
+                     usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    }
+    return cpuTimeUs;
+}
+
+// What GZipSection did before it compressed in process.
+static status_t GzipWithChildProcess(int fd, FdBuffer* buffer) {
+    Fpipe p2cPipe;
+    Fpipe c2pPipe;
+    if (!p2cPipe.init() || !c2pPipe.init()) {
+        return -errno;
+    }
+    pid_t pid = fork_execute_cmd((char* const*)GZIP, &p2cPipe, &c2pPipe);
+    if (pid == -1) {
+        return -errno;
+    }
+    status_t err = buffer->readProcessedDataInStream(fd, std::move(p2cPipe.writeFd()),
+                                                     std::move(c2pPipe.readFd()),
+                                                     REMOTE_CALL_TIMEOUT_MS);
+    status_t gzipStatus = wait_child(pid);
+    return err != NO_ERROR ? err : gzipStatus;
+}
+
+static void BM_Gzip(benchmark::State& state) {
+    const bool inProcess = state.range(0);
+    const size_t size = state.range(1) * 1024 * 1024;
+    TemporaryFile tf;
+    WriteKernelLog(tf.path, size);
+
+    int errors = 0;
+    size_t compressedSize = 0;
+    int64_t cpuTimeUs = 0;
+    while (state.KeepRunning()) {
+        lseek(tf.fd, 0, SEEK_SET);
+        FdBuffer buffer;
+        int64_t startCpuTimeUs = CpuTimeUs();
+        status_t err = inProcess
+                ? buffer.readAndGzip(tf.fd, GZIP_COMPRESSION_LEVEL, REMOTE_CALL_TIMEOUT_MS)
+                : GzipWithChildProcess(tf.fd, &buffer);
+        cpuTimeUs += CpuTimeUs() - startCpuTimeUs;
+        errors += err != NO_ERROR;
+        compressedSize = buffer.size();
+    }
+    state.SetLabel(inProcess ? "in process" : "gzip");
+    state.SetBytesProcessed(state.iterations() * size);
+    state.counters["cpu_ms"] = cpuTimeUs / 1000.0 / state.iterations();
+    state.counters["compressed_kb"] = compressedSize / 1024;
+    state.counters["errors"] = errors;
+}
+// Wall time, and the CPU time of gzip included in cpu_ms, for 1MB and 4MB files.
+BENCHMARK(BM_Gzip)
+        ->Args({true, 1})
+        ->Args({false, 1})
+        ->Args({true, 4})
+        ->Args({false, 4})
+        ->Unit(benchmark::kMillisecond);
+
+}  //  namespace incidentd
+}  //  namespace os
+}  //  namespace android
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <android/os/IncidentReportArgs.h>
+#include <android/util/ProtoOutputStream.h>
+#include <string>
+#include <vector>
+#include "PrivacyBuffer.h"
+#include "benchmark/benchmark.h"
+
+namespace android {
+namespace os {
+namespace incidentd {
+
+static const uint8_t kVarintType = 5;    // FIELD_TYPE_INT32
+static const uint8_t kStringType = 9;    // FIELD_TYPE_STRING
+static const uint8_t kMessageType = 11;  // FIELD_TYPE_MESSAGE
+
+// The policy of a section of text log entries, like the ones of LogSection: the metadata of the
+// entries is automatic, their tag explicit and their message local.
+static Privacy* makeField(uint32_t fieldId, uint8_t type, uint8_t dest, Privacy** children) {
+    return new Privacy{fieldId, type, children, dest, NULL};
+}
+
+static Privacy* kEntryFields[] = {
+        makeField(1, kVarintType, android::os::DEST_AUTOMATIC, NULL),  // sec
+        makeField(2, kVarintType, android::os::DEST_AUTOMATIC, NULL),  // nanosec
+        makeField(3, kVarintType, android::os::DEST_AUTOMATIC, NULL),  // priority
+        makeField(4, kVarintType, android::os::DEST_AUTOMATIC, NULL),  // uid
+        makeField(5, kVarintType, android::os::DEST_AUTOMATIC, NULL),  // pid
+        makeField(6, kVarintType, android::os::DEST_AUTOMATIC, NULL),  // tid
+        makeField(7, kStringType, android::os::DEST_EXPLICIT, NULL),   // tag
+        makeField(8, kStringType, android::os::DEST_LOCAL, NULL),      // log
+        NULL};
+static Privacy* kLogFields[] = {makeField(6, kMessageType, DEST_UNSET, kEntryFields), NULL};
+static Privacy* kLogPolicy = makeField(1000, kMessageType, DEST_UNSET, kLogFields);
+
+static void writeTextLogs(size_t bytes, ProtoOutputStream* proto) {
+    for (int i = 0; proto->bytesWritten() < bytes; i++) {
+        uint64_t token = proto->start(FIELD_TYPE_MESSAGE | 6);
+        proto->write(FIELD_TYPE_INT32 | 1, 1536000000 + i / 100);
+        proto->write(FIELD_TYPE_INT32 | 2, i * 7919 % 1000000000);
+        proto->write(FIELD_TYPE_INT32 | 3, 4);
+        proto->write(FIELD_TYPE_INT32 | 4, 1000 + i % 50);
+        proto->write(FIELD_TYPE_INT32 | 5, 1234 + i % 50);
+        proto->write(FIELD_TYPE_INT32 | 6, 1300 + i % 200);
+        proto->write(FIELD_TYPE_STRING | 7, std::string("ActivityManager"));
+        proto->write(FIELD_TYPE_STRING | 8,
+                     "Start proc " + std::to_string(i) + ":com.example.app/u0a42 for service");
+        proto->end(token);
+    }
+}
+
+// Strips a section of text logs for the three destinations, either in a single pass, or once per
+// destination as the requests used to be.
+static void BM_StripThreeDests(benchmark::State& state) {
+    const bool singlePass = state.range(0);
+    ProtoOutputStream proto;
+    writeTextLogs(state.range(1) * 1024 * 1024, &proto);
+    EncodedBuffer::iterator data = proto.data();
+    const std::vector<PrivacySpec> specs = {PrivacySpec::new_spec(android::os::DEST_AUTOMATIC),
+                                            PrivacySpec::new_spec(android::os::DEST_EXPLICIT),
+                                            PrivacySpec::new_spec(android::os::DEST_LOCAL)};
+
+    PrivacyBuffer privacyBuffer(kLogPolicy, data);
+    size_t strippedBytes = 0;
+    int errors = 0;
+    while (state.KeepRunning()) {
+        strippedBytes = 0;
+        if (singlePass) {
+            errors += privacyBuffer.strip(specs) != NO_ERROR;
+            for (const PrivacySpec& spec : specs) {
+                strippedBytes += privacyBuffer.size(spec);
+            }
+        } else {
+            for (const PrivacySpec& spec : specs) {
+                errors += privacyBuffer.strip(spec) != NO_ERROR;
+                strippedBytes += privacyBuffer.size();
+                privacyBuffer.clear();
+            }
+        }
+    }
+    state.SetLabel(singlePass ? "single pass" : "per dest");
+    state.SetBytesProcessed(state.iterations() * data.size());
+    state.counters["stripped_kb"] = strippedBytes / 1024;
+    state.counters["errors"] = errors;
+}
+BENCHMARK(BM_StripThreeDests)
+        ->Args({true, 1})
+        ->Args({false, 1})
+        ->Args({true, 4})
+        ->Args({false, 4})
+        ->Unit(benchmark::kMillisecond);
+
+}  //  namespace incidentd
+}  //  namespace os
+}  //  namespace android
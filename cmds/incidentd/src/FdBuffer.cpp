@@ -25,6 +25,9 @@
 #include <poll.h>
 #include <unistd.h>
 #include <wait.h>
+#include <zlib.h>
+
+#include <memory>
 
 namespace android {
 namespace os {
@@ -32,6 +35,7 @@ namespace incidentd {
 
 const ssize_t BUFFER_SIZE = 16 * 1024;  // 16 KB
 const ssize_t MAX_BUFFER_COUNT = 256;   // 4 MB max
+const ssize_t GZIP_READ_SIZE = 256 * 1024;  // 256 KB
 
 FdBuffer::FdBuffer()
     : mBuffer(BUFFER_SIZE), mStartTime(-1), mFinishTime(-1), mTimedOut(false), mTruncated(false) {}
@@ -253,6 +257,61 @@ status_t FdBuffer::readProcessedDataInStream(int fd, unique_fd toFd, unique_fd f
     return NO_ERROR;
 }
 
+status_t FdBuffer::readAndGzip(int fd, int compressionLevel, int64_t timeoutMs) {
+    mStartTime = uptimeMillis();
+
+    z_stream stream = {};
+    // 16 + MAX_WBITS writes the gzip header and trailer around the deflate data, like gzip.
+    if (deflateInit2(&stream, compressionLevel, Z_DEFLATED, 16 + MAX_WBITS, 8 /* memLevel */,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        VLOG("Fail to init deflate: %s", stream.msg != NULL ? stream.msg : "");
+        return BAD_VALUE;
+    }
+    std::unique_ptr<z_stream, decltype(&deflateEnd)> streamEnd(&stream, deflateEnd);
+
+    // Files aren't mmaped: one that shrinks while it's compressed would crash incidentd.
+    std::unique_ptr<uint8_t[]> in(new uint8_t[GZIP_READ_SIZE]);
+    int flush = Z_NO_FLUSH;
+    while (flush != Z_FINISH) {
+        if (uptimeMillis() - mStartTime >= timeoutMs) {
+            VLOG("timed out due to long read");
+            mTimedOut = true;
+            break;
+        }
+        ssize_t amt = TEMP_FAILURE_RETRY(::read(fd, in.get(), GZIP_READ_SIZE));
+        if (amt < 0) {
+            VLOG("Fail to read %d: %s", fd, strerror(errno));
+            return -errno;
+        }
+        stream.next_in = in.get();
+        stream.avail_in = amt;
+        flush = amt == 0 ? Z_FINISH : Z_NO_FLUSH;
+
+        // Deflate into the chunks of the buffer, until the input is consumed.
+        do {
+            if (mBuffer.size() >= MAX_BUFFER_COUNT * BUFFER_SIZE) {
+                VLOG("Truncating data");
+                mTruncated = true;
+                mFinishTime = uptimeMillis();
+                return NO_ERROR;
+            }
+            uint8_t* out = mBuffer.writeBuffer();
+            if (out == NULL) return NO_MEMORY;
+            size_t toWrite = mBuffer.currentToWrite();
+            stream.next_out = out;
+            stream.avail_out = toWrite;
+            if (deflate(&stream, flush) == Z_STREAM_ERROR) {
+                VLOG("Fail to deflate %d", fd);
+                return UNKNOWN_ERROR;
+            }
+            mBuffer.wp()->move(toWrite - stream.avail_out);
+        } while (stream.avail_out == 0);
+    }
+
+    mFinishTime = uptimeMillis();
+    return NO_ERROR;
+}
+
 size_t FdBuffer::size() const { return mBuffer.size(); }
 
 EncodedBuffer::iterator FdBuffer::data() const { return mBuffer.begin(); }
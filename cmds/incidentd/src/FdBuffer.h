@@ -63,6 +63,13 @@ public:
     status_t readProcessedDataInStream(int fd, unique_fd toFd, unique_fd fromFd, int64_t timeoutMs,
                                        const bool isSysfs = false);
 
+    /**
+     * Read the data of fd until eof and compress it in the gzip format, straight into the buffer.
+     * The reads are large, as the compression costs more than the reads. Returns NO_ERROR if
+     * there were no errors or if we timed out.
+     */
+    status_t readAndGzip(int fd, int compressionLevel, int64_t timeoutMs);
+
     /**
      * Whether we timed out.
      */
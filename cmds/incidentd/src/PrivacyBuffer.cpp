@@ -23,118 +23,216 @@
 #include <android/util/protobuf.h>
 #include <cutils/log.h>
 
+#include <algorithm>
+
 namespace android {
 namespace os {
 namespace incidentd {
 
+// Field ids up to this are looked up in a table, the others in the children of the policy.
+static const uint32_t MAX_POLICY_TABLE_FIELD_ID = 1024;
+
+const PrivacyBuffer::PolicyTable& PrivacyBuffer::getPolicyTable(const Privacy* policy) {
+    auto it = mPolicyTables.find(policy);
+    if (it != mPolicyTables.end()) return it->second;
+
+    PolicyTable& table = mPolicyTables[policy];
+    uint32_t maxFieldId = 0;
+    for (int i = 0; policy->children[i] != NULL; i++) {  // NULL-terminated.
+        if (policy->children[i]->field_id > maxFieldId) maxFieldId = policy->children[i]->field_id;
+    }
+    if (maxFieldId > MAX_POLICY_TABLE_FIELD_ID) return table;
+    table.resize(maxFieldId + 1, NULL);
+    for (int i = 0; policy->children[i] != NULL; i++) {
+        const Privacy* child = policy->children[i];
+        if (table[child->field_id] == NULL) table[child->field_id] = child;
+    }
+    return table;
+}
+
+const Privacy* PrivacyBuffer::lookupChild(const Privacy* parentPolicy, const PolicyTable& table,
+                                          uint32_t fieldId) const {
+    if (table.empty()) return lookup(parentPolicy, fieldId);
+    return fieldId < table.size() ? table[fieldId] : NULL;
+}
+
+PrivacyBuffer::Output* PrivacyBuffer::findOutput(const PrivacySpec& spec) const {
+    for (auto it = mOutputs.begin(); it != mOutputs.end(); it++) {
+        if ((*it)->spec.dest == spec.dest) return it->get();
+    }
+    return NULL;
+}
+
 /**
- * Write the field to buf based on the wire type, iterator will point to next field.
- * If skip is set to true, no data will be written to buf. Return number of bytes written.
+ * Write the field to the outputs that don't skip it based on the wire type, iterator will point
+ * to next field. The field is read once whatever the number of outputs.
  */
-void PrivacyBuffer::writeFieldOrSkip(uint32_t fieldTag, bool skip) {
+void PrivacyBuffer::writeField(uint32_t fieldTag) {
     uint8_t wireType = read_wire_type(fieldTag);
     size_t bytesToWrite = 0;
     uint64_t varint = 0;
+    bool written = false;
 
     switch (wireType) {
         case WIRE_TYPE_VARINT:
             varint = mData.readRawVarint();
-            if (!skip) {
-                mProto.writeRawVarint(fieldTag);
-                mProto.writeRawVarint(varint);
+            for (Output* output : mStripping) {
+                if (output->skip) continue;
+                output->proto.writeRawVarint(fieldTag);
+                output->proto.writeRawVarint(varint);
             }
             return;
         case WIRE_TYPE_FIXED64:
-            if (!skip) mProto.writeRawVarint(fieldTag);
             bytesToWrite = 8;
+            for (Output* output : mStripping) {
+                if (!output->skip) output->proto.writeRawVarint(fieldTag);
+            }
             break;
         case WIRE_TYPE_LENGTH_DELIMITED:
             bytesToWrite = mData.readRawVarint();
-            if (!skip) mProto.writeLengthDelimitedHeader(read_field_id(fieldTag), bytesToWrite);
+            for (Output* output : mStripping) {
+                if (!output->skip) {
+                    output->proto.writeLengthDelimitedHeader(read_field_id(fieldTag), bytesToWrite);
+                }
+            }
             break;
         case WIRE_TYPE_FIXED32:
-            if (!skip) mProto.writeRawVarint(fieldTag);
             bytesToWrite = 4;
+            for (Output* output : mStripping) {
+                if (!output->skip) output->proto.writeRawVarint(fieldTag);
+            }
             break;
     }
-    if (skip) {
+    for (Output* output : mStripping) {
+        written |= !output->skip;
+    }
+    if (!written) {
         mData.rp()->move(bytesToWrite);
-    } else {
-        for (size_t i = 0; i < bytesToWrite; i++) {
-            mProto.writeRawByte(mData.next());
+        return;
+    }
+    // Copy the field a contiguous span of the data at a time.
+    while (bytesToWrite > 0 && mData.readBuffer() != NULL) {
+        const uint8_t* span = mData.readBuffer();
+        size_t spanSize = std::min(bytesToWrite, mData.currentToRead());
+        for (Output* output : mStripping) {
+            if (output->skip) continue;
+            for (size_t i = 0; i < spanSize; i++) {
+                output->proto.writeRawByte(span[i]);
+            }
         }
+        mData.rp()->move(spanSize);
+        bytesToWrite -= spanSize;
     }
+    // The field is truncated, move past the end so that the strip fails.
+    mData.rp()->move(bytesToWrite);
 }
 
 /**
- * Strip next field based on its private policy and request spec, then stores data in buf.
- * Return NO_ERROR if succeeds, otherwise BAD_VALUE is returned to indicate bad data in FdBuffer.
+ * Strip next field based on its private policy and the specs being stripped, then stores data in
+ * their outputs. Return NO_ERROR if succeeds, otherwise BAD_VALUE is returned to indicate bad data
+ * in FdBuffer.
  *
  * The iterator must point to the head of a protobuf formatted field for successful operation.
  * After exit with NO_ERROR, iterator points to the next protobuf field's head.
  */
-status_t PrivacyBuffer::stripField(const Privacy* parentPolicy, const PrivacySpec& spec,
+status_t PrivacyBuffer::stripField(const Privacy* parentPolicy, const PolicyTable& table,
                                    int depth /* use as a counter for this recusive method. */) {
     if (!mData.hasNext() || parentPolicy == NULL) return BAD_VALUE;
     uint32_t fieldTag = mData.readRawVarint();
     uint32_t fieldId = read_field_id(fieldTag);
-    const Privacy* policy = lookup(parentPolicy, fieldId);
+    const Privacy* policy = lookupChild(parentPolicy, table, fieldId);
 
     VLOG("[Depth %2d]Try to strip id %d, wiretype %d", depth, fieldId, read_wire_type(fieldTag));
     if (policy == NULL || policy->children == NULL) {
-        bool skip = !spec.CheckPremission(policy, parentPolicy->dest);
+        for (Output* output : mStripping) {
+            output->skip = !output->spec.CheckPremission(policy, parentPolicy->dest);
+        }
         // iterator will point to head of next field
         size_t currentAt = mData.rp()->pos();
-        writeFieldOrSkip(fieldTag, skip);
-        VLOG("[Depth %2d]Field %d %ss %d bytes", depth, fieldId, skip ? "skip" : "write",
+        writeField(fieldTag);
+        VLOG("[Depth %2d]Field %d has %d bytes", depth, fieldId,
              (int)(get_varint_size(fieldTag) + mData.rp()->pos() - currentAt));
         return NO_ERROR;
     }
     // current field is message type and its sub-fields have extra privacy policies
     uint32_t msgSize = mData.readRawVarint();
     size_t start = mData.rp()->pos();
-    uint64_t token = mProto.start(encode_field_id(policy));
+    const PolicyTable& childTable = getPolicyTable(policy);
+    for (Output* output : mStripping) {
+        mTokens.push_back(output->proto.start(encode_field_id(policy)));
+    }
     while (mData.rp()->pos() - start != msgSize) {
-        status_t err = stripField(policy, spec, depth + 1);
+        status_t err = stripField(policy, childTable, depth + 1);
         if (err != NO_ERROR) return err;
     }
-    mProto.end(token);
+    for (size_t i = mStripping.size(); i > 0; i--) {
+        mStripping[i - 1]->proto.end(mTokens.back());
+        mTokens.pop_back();
+    }
     return NO_ERROR;
 }
 
 // ================================================================================
 PrivacyBuffer::PrivacyBuffer(const Privacy* policy, EncodedBuffer::iterator data)
-    : mPolicy(policy), mData(data), mProto(), mSize(0) {}
+    : mPolicy(policy), mData(data) {}
 
 PrivacyBuffer::~PrivacyBuffer() {}
 
 status_t PrivacyBuffer::strip(const PrivacySpec& spec) {
-    VLOG("Strip with spec %d", spec.dest);
-    // optimization when no strip happens
-    if (mPolicy == NULL || mPolicy->children == NULL || spec.RequireAll()) {
-        if (spec.CheckPremission(mPolicy)) mSize = mData.size();
-        return NO_ERROR;
+    return strip(std::vector<PrivacySpec>(1, spec));
+}
+
+status_t PrivacyBuffer::strip(const std::vector<PrivacySpec>& specs) {
+    clear();
+    for (const PrivacySpec& spec : specs) {
+        if (findOutput(spec) != NULL) continue;
+        VLOG("Strip with spec %d", spec.dest);
+        Output* output = new Output(spec);
+        mOutputs.emplace_back(output);
+        // optimization when no strip happens
+        if (mPolicy == NULL || mPolicy->children == NULL || spec.RequireAll()) {
+            if (spec.CheckPremission(mPolicy)) output->size = mData.size();
+        } else {
+            mStripping.push_back(output);
+        }
     }
+    if (mStripping.empty()) return NO_ERROR;
+
+    const PolicyTable& table = getPolicyTable(mPolicy);
     while (mData.hasNext()) {
-        status_t err = stripField(mPolicy, spec, 0);
+        status_t err = stripField(mPolicy, table, 0);
         if (err != NO_ERROR) return err;
     }
     if (mData.bytesRead() != mData.size()) return BAD_VALUE;
-    mSize = mProto.size();
+    for (Output* output : mStripping) {
+        output->size = output->proto.size();
+    }
     mData.rp()->rewind();  // rewind the read pointer back to beginning after the strip.
     return NO_ERROR;
 }
 
 void PrivacyBuffer::clear() {
-    mSize = 0;
-    mProto.clear();
+    mOutputs.clear();
+    mStripping.clear();
+    mTokens.clear();
 }
 
-size_t PrivacyBuffer::size() const { return mSize; }
+size_t PrivacyBuffer::size() const { return mOutputs.empty() ? 0 : mOutputs[0]->size; }
+
+size_t PrivacyBuffer::size(const PrivacySpec& spec) const {
+    const Output* output = findOutput(spec);
+    return output != NULL ? output->size : 0;
+}
 
 status_t PrivacyBuffer::flush(int fd) {
+    return mOutputs.empty() ? NO_ERROR : flush(fd, mOutputs[0]->spec);
+}
+
+status_t PrivacyBuffer::flush(int fd, const PrivacySpec& spec) {
+    Output* output = findOutput(spec);
+    if (output == NULL || output->size == 0) return NO_ERROR;
     status_t err = NO_ERROR;
-    EncodedBuffer::iterator iter = size() == mData.size() ? mData : mProto.data();
+    EncodedBuffer::iterator iter = output->size == mData.size() ? mData : output->proto.data();
     while (iter.readBuffer() != NULL) {
         err = WriteFully(fd, iter.readBuffer(), iter.currentToRead()) ? NO_ERROR : -errno;
         iter.rp()->move(iter.currentToRead());
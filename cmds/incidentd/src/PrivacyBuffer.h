@@ -25,6 +25,10 @@
 #include <stdint.h>
 #include <utils/Errors.h>
 
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 namespace android {
 namespace os {
 namespace incidentd {
@@ -34,6 +38,9 @@ using namespace android::util;
 /**
  * PrivacyBuffer holds the original protobuf data and strips PII-sensitive fields
  * based on the request and holds stripped data in its own buffer for output.
+ *
+ * The data can be stripped for several specs at once, in which case it is parsed once and each
+ * field is written to the buffers of the specs that allow it.
  */
 class PrivacyBuffer {
 public:
@@ -46,30 +53,70 @@ public:
      */
     status_t strip(const PrivacySpec& spec);
 
+    /**
+     * Strip for each of the specs in a single pass over the data, and hold the data of each
+     * of them in its own buffer. Return NO_ERROR if strip succeeds.
+     */
+    status_t strip(const std::vector<PrivacySpec>& specs);
+
     /**
      * Clear encoded buffer so it can be reused by another request.
      */
     void clear();
 
     /**
-     * Return the size of the stripped data.
+     * Return the size of the stripped data, of the first spec if there are several.
      */
     size_t size() const;
 
+    /**
+     * Return the size of the data stripped for the given spec, 0 if it wasn't stripped for it.
+     */
+    size_t size(const PrivacySpec& spec) const;
+
     /**
      * Flush buffer to the given fd. NO_ERROR is returned if the flush succeeds.
      */
     status_t flush(int fd);
 
+    /**
+     * Flush the data stripped for the given spec to the given fd. NO_ERROR is returned if the
+     * flush succeeds.
+     */
+    status_t flush(int fd, const PrivacySpec& spec);
+
 private:
+    // The stripped data of a spec.
+    struct Output {
+        explicit Output(const PrivacySpec& spec) : spec(spec), size(0), skip(false) {}
+
+        const PrivacySpec spec;
+        ProtoOutputStream proto;
+        size_t size;
+        // Whether the current field is stripped.
+        bool skip;
+    };
+
+    // The children of a message policy, indexed by field id, so that a field's policy isn't
+    // searched for in the children. Left empty when the field ids are too sparse for it.
+    typedef std::vector<const Privacy*> PolicyTable;
+
     const Privacy* mPolicy;
     EncodedBuffer::iterator mData;
 
-    ProtoOutputStream mProto;
-    size_t mSize;
+    std::vector<std::unique_ptr<Output>> mOutputs;
+    // The outputs the fields are written to while stripping.
+    std::vector<Output*> mStripping;
+    // The tokens of the messages being written, mStripping.size() per nesting level.
+    std::vector<uint64_t> mTokens;
+    std::unordered_map<const Privacy*, PolicyTable> mPolicyTables;
 
-    status_t stripField(const Privacy* parentPolicy, const PrivacySpec& spec, int depth);
-    void writeFieldOrSkip(uint32_t fieldTag, bool skip);
+    const PolicyTable& getPolicyTable(const Privacy* policy);
+    const Privacy* lookupChild(const Privacy* parentPolicy, const PolicyTable& table,
+                               uint32_t fieldId) const;
+    Output* findOutput(const PrivacySpec& spec) const;
+    status_t stripField(const Privacy* parentPolicy, const PolicyTable& table, int depth);
+    void writeField(uint32_t fieldTag);
 };
 
 }  // namespace incidentd
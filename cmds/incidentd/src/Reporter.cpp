@@ -19,20 +19,23 @@
 #include "Reporter.h"
 
 #include "Privacy.h"
+#include "SectionScheduler.h"
 #include "report_directory.h"
 #include "section_list.h"
 
 #include <android-base/properties.h>
 #include <android/os/DropBoxManager.h>
 #include <private/android_filesystem_config.h>
-#include <utils/SystemClock.h>
 
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <algorithm>
 #include <string>
+#include <utility>
 
 /**
  * The directory where the incident reports are stored.
@@ -43,6 +46,8 @@ namespace android {
 namespace os {
 namespace incidentd {
 
+using android::util::EncodedBuffer;
+
 // ================================================================================
 ReportRequest::ReportRequest(const IncidentReportArgs& a,
                              const sp<IIncidentReportStatusListener>& l, int f)
@@ -59,7 +64,14 @@ bool ReportRequest::ok() { return fd >= 0 && err == NO_ERROR; }
 
 // ================================================================================
 ReportRequestSet::ReportRequestSet()
-    : mRequests(), mSections(), mMainFd(-1), mMainDest(-1), mMetadata(), mSectionStats() {}
+    : mRequests(),
+      mSections(),
+      mMainFd(-1),
+      mMainDest(-1),
+      mDeferWrites(false),
+      mDeferredData(),
+      mMetadata(),
+      mSectionStats() {}
 
 ReportRequestSet::~ReportRequestSet() {}
 
@@ -102,6 +114,10 @@ IncidentMetadata::SectionStats* ReportRequestSet::sectionStats(int id) {
     return &mSectionStats[id];
 }
 
+void ReportRequestSet::setDeferredData(EncodedBuffer* data) {
+    mDeferredData.reset(new EncodedBuffer(std::move(*data)));
+}
+
 // ================================================================================
 Reporter::Reporter() : Reporter(INCIDENT_DIRECTORY) { isTest = false; };
 
@@ -131,6 +147,8 @@ Reporter::run_report_status_t Reporter::runReport(size_t* reportByteSize) {
     int mainDest = -1;
     HeaderSection headers;
     MetadataSection metadataSection;
+    SectionScheduler scheduler;
+    vector<const Section*> sections;
     std::string buildType = android::base::GetProperty("ro.build.type", "");
     const bool isUserdebugOrEng = buildType == "userdebug" || buildType == "eng";
 
@@ -185,39 +203,13 @@ Reporter::run_report_status_t Reporter::runReport(size_t* reportByteSize) {
             continue;
         }
         if (this->batch.containsSection(id)) {
-            ALOGD("Taking incident report section %d '%s'", id, (*section)->name.string());
-            for (ReportRequestSet::iterator it = batch.begin(); it != batch.end(); it++) {
-                if ((*it)->listener != NULL && (*it)->args.containsSection(id)) {
-                    (*it)->listener->onReportSectionStatus(
-                            id, IIncidentReportStatusListener::STATUS_STARTING);
-                }
-            }
-
-            // Execute - go get the data and write it into the file descriptors.
-            IncidentMetadata::SectionStats* stats = batch.sectionStats(id);
-            int64_t startTime = uptimeMillis();
-            err = (*section)->Execute(&batch);
-            int64_t endTime = uptimeMillis();
-            stats->set_success(err == NO_ERROR);
-            stats->set_exec_duration_ms(endTime - startTime);
-            if (err != NO_ERROR) {
-                ALOGW("Incident section %s (%d) failed: %s. Stopping report.",
-                      (*section)->name.string(), id, strerror(-err));
-                goto DONE;
-            }
-            (*reportByteSize) += stats->report_size_bytes();
-
-            // Notify listener of starting
-            for (ReportRequestSet::iterator it = batch.begin(); it != batch.end(); it++) {
-                if ((*it)->listener != NULL && (*it)->args.containsSection(id)) {
-                    (*it)->listener->onReportSectionStatus(
-                            id, IIncidentReportStatusListener::STATUS_FINISHED);
-                }
-            }
-            ALOGD("Finish incident report section %d '%s'", id, (*section)->name.string());
+            sections.push_back(*section);
         }
     }
 
+    // Execute - go get the data and write it into the file descriptors.
+    err = scheduler.run(sections, &batch, reportByteSize);
+
 DONE:
     // Reports the metdadata when taking the incident report.
     if (!isTest) metadataSection.Execute(&batch);
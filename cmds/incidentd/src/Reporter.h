@@ -22,11 +22,14 @@
 #include <android/os/IncidentReportArgs.h>
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <time.h>
 
+#include <android/util/EncodedBuffer.h>
+
 #include "Throttler.h"
 #include "frameworks/base/libs/incident/proto/android/os/metadata.pb.h"
 
@@ -71,11 +74,24 @@ public:
     bool containsSection(int id);
     IncidentMetadata::SectionStats* sectionStats(int id);
 
+    /**
+     * A set that defers the writes keeps the data of the section executed with it instead of
+     * writing it to the file descriptors, so that the section can run alongside others. The data
+     * is written to the requests later, see write_deferred_report_requests().
+     */
+    void setDeferWrites(bool deferWrites) { mDeferWrites = deferWrites; }
+    bool deferWrites() const { return mDeferWrites; }
+    // Takes the data of the buffer, which is left empty.
+    void setDeferredData(android::util::EncodedBuffer* data);
+    const android::util::EncodedBuffer* deferredData() const { return mDeferredData.get(); }
+
 private:
     vector<sp<ReportRequest>> mRequests;
     IncidentReportArgs mSections;
     int mMainFd;
     int mMainDest;
+    bool mDeferWrites;
+    std::unique_ptr<android::util::EncodedBuffer> mDeferredData;
 
     IncidentMetadata mMetadata;
     map<int, IncidentMetadata::SectionStats> mSectionStats;
@@ -21,6 +21,8 @@
 #include <dirent.h>
 #include <errno.h>
 
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <set>
 
@@ -38,6 +40,7 @@
 #include "FdBuffer.h"
 #include "Privacy.h"
 #include "PrivacyBuffer.h"
+#include "SectionParsers.h"
 #include "frameworks/base/core/proto/android/os/backtrace.proto.h"
 #include "frameworks/base/core/proto/android/os/data.proto.h"
 #include "frameworks/base/core/proto/android/util/log.proto.h"
@@ -56,7 +59,6 @@ const int FIELD_ID_INCIDENT_METADATA = 2;
 
 // incident section parameters
 const char INCIDENT_HELPER[] = "/system/bin/incident_helper";
-const char* GZIP[] = {"/system/bin/gzip", NULL};
 
 static pid_t fork_execute_incident_helper(const int id, Fpipe* p2cPipe, Fpipe* c2pPipe) {
     const char* ihArgs[]{INCIDENT_HELPER, "-s", String8::format("%d", id).string(), NULL};
@@ -77,11 +79,10 @@ static void write_section_stats(IncidentMetadata::SectionStats* stats, const FdB
     stats->set_is_truncated(buffer.truncated());
 }
 
-// Reads data from FdBuffer and writes it to the requests file descriptor.
-static status_t write_report_requests(const int id, const FdBuffer& buffer,
+// Writes the data of the section to the requests file descriptor.
+static status_t write_report_requests(const int id, EncodedBuffer::iterator data,
                                       ReportRequestSet* requests) {
     status_t err = -EBADF;
-    EncodedBuffer::iterator data = buffer.data();
     PrivacyBuffer privacyBuffer(get_privacy_of_section(id), data);
     int writeable = 0;
 
@@ -96,53 +97,62 @@ static status_t write_report_requests(const int id, const FdBuffer& buffer,
         requestsBySpec[spec].push_back(request);
     }
 
+    // Strip the data once for all the specs, the dropbox file's included.
+    vector<PrivacySpec> specs;
+    for (auto mit = requestsBySpec.begin(); mit != requestsBySpec.end(); mit++) {
+        specs.push_back(mit->first);
+    }
+    if (requests->mainFd() >= 0) {
+        specs.push_back(PrivacySpec::new_spec(requests->mainDest()));
+    }
+    if (specs.empty()) return err;
+    err = privacyBuffer.strip(specs);
+    if (err != NO_ERROR) return err;  // it means the privacyBuffer data is corrupted.
+
     for (auto mit = requestsBySpec.begin(); mit != requestsBySpec.end(); mit++) {
         PrivacySpec spec = mit->first;
-        err = privacyBuffer.strip(spec);
-        if (err != NO_ERROR) return err;  // it means the privacyBuffer data is corrupted.
-        if (privacyBuffer.size() == 0) continue;
+        size_t size = privacyBuffer.size(spec);
+        if (size == 0) continue;
 
         for (auto it = mit->second.begin(); it != mit->second.end(); it++) {
             sp<ReportRequest> request = *it;
-            err = write_section_header(request->fd, id, privacyBuffer.size());
+            err = write_section_header(request->fd, id, size);
             if (err != NO_ERROR) {
                 request->err = err;
                 continue;
             }
-            err = privacyBuffer.flush(request->fd);
+            err = privacyBuffer.flush(request->fd, spec);
             if (err != NO_ERROR) {
                 request->err = err;
                 continue;
             }
             writeable++;
-            VLOG("Section %d flushed %zu bytes to fd %d with spec %d", id, privacyBuffer.size(),
-                 request->fd, spec.dest);
+            VLOG("Section %d flushed %zu bytes to fd %d with spec %d", id, size, request->fd,
+                 spec.dest);
         }
-        privacyBuffer.clear();
     }
 
     // The dropbox file
     if (requests->mainFd() >= 0) {
         PrivacySpec spec = PrivacySpec::new_spec(requests->mainDest());
-        err = privacyBuffer.strip(spec);
-        if (err != NO_ERROR) return err;  // the buffer data is corrupted.
-        if (privacyBuffer.size() == 0) goto DONE;
+        size_t size = privacyBuffer.size(spec);
+        if (size == 0) goto DONE;
 
-        err = write_section_header(requests->mainFd(), id, privacyBuffer.size());
+        err = write_section_header(requests->mainFd(), id, size);
         if (err != NO_ERROR) {
             requests->setMainFd(-1);
             goto DONE;
         }
-        err = privacyBuffer.flush(requests->mainFd());
+        err = privacyBuffer.flush(requests->mainFd(), spec);
         if (err != NO_ERROR) {
             requests->setMainFd(-1);
             goto DONE;
         }
         writeable++;
-        VLOG("Section %d flushed %zu bytes to dropbox %d with spec %d", id, privacyBuffer.size(),
+        VLOG("Section %d flushed %zu bytes to dropbox %d with spec %d", id, size,
              requests->mainFd(), spec.dest);
         // Reports bytes of the section uploaded via dropbox after filtering.
-        requests->sectionStats(id)->set_report_size_bytes(privacyBuffer.size());
+        requests->sectionStats(id)->set_report_size_bytes(size);
     }
 
 DONE:
@@ -150,6 +160,23 @@ DONE:
     return writeable > 0 ? NO_ERROR : err;
 }
 
+// Reads data from FdBuffer and writes it to the requests file descriptor, or moves it to the
+// requests if they defer the writes.
+status_t write_report_requests(const int id, FdBuffer& buffer, ReportRequestSet* requests) {
+    if (requests->deferWrites()) {
+        requests->setDeferredData(buffer.getInternalBuffer());
+        return NO_ERROR;
+    }
+    return write_report_requests(id, buffer.data(), requests);
+}
+
+status_t write_deferred_report_requests(const int id, const ReportRequestSet& deferred,
+                                        ReportRequestSet* requests) {
+    // The section didn't write anything, e.g. it timed out.
+    if (deferred.deferredData() == NULL) return NO_ERROR;
+    return write_report_requests(id, deferred.deferredData()->begin(), requests);
+}
+
 // ================================================================================
 Section::Section(int i, int64_t timeoutMs, bool userdebugAndEngOnly, bool deviceSpecific)
     : id(i),
@@ -249,6 +276,10 @@ FileSection::FileSection(int id, const char* filename, const bool deviceSpecific
 
 FileSection::~FileSection() {}
 
+atomic<bool> FileSection::gParseInProcess(true);
+
+void FileSection::setParseInProcess(bool parseInProcess) { gParseInProcess = parseInProcess; }
+
 status_t FileSection::Execute(ReportRequestSet* requests) const {
     // read from mFilename first, make sure the file is available
     // add O_CLOEXEC to make sure it is closed when exec incident helper
@@ -258,6 +289,47 @@ status_t FileSection::Execute(ReportRequestSet* requests) const {
         return this->deviceSpecific ? NO_ERROR : -errno;
     }
 
+    shared_ptr<TextParserBase> parser(gParseInProcess ? selectSectionParser(this->id) : NULL);
+    if (parser != NULL) {
+        return ExecuteInProcess(parser, std::move(fd), requests);
+    }
+    return ExecuteWithIncidentHelper(std::move(fd), requests);
+}
+
+status_t FileSection::ExecuteInProcess(const shared_ptr<TextParserBase>& parser, unique_fd fd,
+                                       ReportRequestSet* requests) const {
+    FdBuffer buffer;
+    bool timedOut = false;
+    // The parser reads the file directly. It might still be running if it times out, so it
+    // shares the file with this thread.
+    shared_ptr<unique_fd> file = make_shared<unique_fd>(std::move(fd));
+    status_t err = read_from_worker_thread(
+            this->name.string(),
+            [parser, file](int pipeWriteFd) { return parser->Parse(file->get(), pipeWriteFd); },
+            this->timeoutMs, &buffer, &timedOut);
+    write_section_stats(requests->sectionStats(this->id), buffer);
+    if (timedOut || buffer.timedOut()) {
+        ALOGW("FileSection '%s' timed out in parser %s", this->name.string(),
+              parser->name.string());
+        return NO_ERROR;
+    }
+    if (err != NO_ERROR) {
+        ALOGW("FileSection '%s' failed to parse: %s", this->name.string(), strerror(-err));
+        return err;
+    }
+
+    VLOG("FileSection '%s' wrote %zd bytes in %d ms", this->name.string(), buffer.size(),
+         (int)buffer.durationMs());
+    err = write_report_requests(this->id, buffer, requests);
+    if (err != NO_ERROR) {
+        ALOGW("FileSection '%s' failed writing: %s", this->name.string(), strerror(-err));
+        return err;
+    }
+
+    return NO_ERROR;
+}
+
+status_t FileSection::ExecuteWithIncidentHelper(unique_fd fd, ReportRequestSet* requests) const {
     FdBuffer buffer;
     Fpipe p2cPipe;
     Fpipe c2pPipe;
@@ -303,7 +375,21 @@ status_t FileSection::Execute(ReportRequestSet* requests) const {
     return NO_ERROR;
 }
 // ================================================================================
-GZipSection::GZipSection(int id, const char* filename, ...) : Section(id) {
+GZipSection::GZipSection(int id, int compressionLevel, const char* filename, ...)
+    : Section(id), mCompressionLevel(compressionLevel) {
+    va_list args;
+    va_start(args, filename);
+    mFilenames = varargs(filename, args);
+    va_end(args);
+    name = "gzip";
+    for (int i = 0; mFilenames[i] != NULL; i++) {
+        name += " ";
+        name += mFilenames[i];
+    }
+}
+
+GZipSection::GZipSection(int id, const char* filename, ...)
+    : Section(id), mCompressionLevel(GZIP_COMPRESSION_LEVEL) {
     va_list args;
     va_start(args, filename);
     mFilenames = varargs(filename, args);
@@ -335,20 +421,6 @@ status_t GZipSection::Execute(ReportRequestSet* requests) const {
         return NO_ERROR;  // e.g. LAST_KMSG will reach here in user build.
     }
     FdBuffer buffer;
-    Fpipe p2cPipe;
-    Fpipe c2pPipe;
-    // initiate pipes to pass data to/from gzip
-    if (!p2cPipe.init() || !c2pPipe.init()) {
-        ALOGW("GZipSection '%s' failed to setup pipes", this->name.string());
-        return -errno;
-    }
-
-    pid_t pid = fork_execute_cmd((char* const*)GZIP, &p2cPipe, &c2pPipe);
-    if (pid == -1) {
-        ALOGW("GZipSection '%s' failed to fork", this->name.string());
-        return -errno;
-    }
-    // parent process
 
     // construct Fdbuffer to output GZippedfileProto, the reason to do this instead of using
     // ProtoOutputStream is to avoid allocation of another buffer inside ProtoOutputStream.
@@ -367,23 +439,14 @@ status_t GZipSection::Execute(ReportRequestSet* requests) const {
     VLOG("GZipSection '%s' editPos=%zd, dataBeginAt=%zd", this->name.string(), editPos,
          dataBeginAt);
 
-    status_t readStatus = buffer.readProcessedDataInStream(
-            fd.get(), std::move(p2cPipe.writeFd()), std::move(c2pPipe.readFd()), this->timeoutMs,
-            isSysfs(mFilenames[index]));
+    status_t readStatus = buffer.readAndGzip(fd.get(), mCompressionLevel, this->timeoutMs);
     write_section_stats(requests->sectionStats(this->id), buffer);
     if (readStatus != NO_ERROR || buffer.timedOut()) {
-        ALOGW("GZipSection '%s' failed to read data from gzip: %s, timedout: %s",
-              this->name.string(), strerror(-readStatus), buffer.timedOut() ? "true" : "false");
-        kill_child(pid);
+        ALOGW("GZipSection '%s' failed to compress data: %s, timedout: %s", this->name.string(),
+              strerror(-readStatus), buffer.timedOut() ? "true" : "false");
         return readStatus;
     }
 
-    status_t gzipStatus = wait_child(pid);
-    if (gzipStatus != NO_ERROR) {
-        ALOGW("GZipSection '%s' abnormal child process: %s", this->name.string(),
-              strerror(-gzipStatus));
-        return gzipStatus;
-    }
     // Revisit the actual size from gzip result and edit the internal buffer accordingly.
     size_t dataSize = buffer.size() - dataBeginAt;
     internalBuffer->wp()->rewind()->move(editPos);
@@ -402,7 +465,7 @@ status_t GZipSection::Execute(ReportRequestSet* requests) const {
 
 // ================================================================================
 struct WorkerThreadData : public virtual RefBase {
-    const WorkerThreadSection* section;
+    const function<status_t(int)> call;
     Fpipe pipe;
 
     // Lock protects these fields
@@ -410,24 +473,18 @@ struct WorkerThreadData : public virtual RefBase {
     bool workerDone;
     status_t workerError;
 
-    WorkerThreadData(const WorkerThreadSection* section);
+    WorkerThreadData(const function<status_t(int)>& call);
     virtual ~WorkerThreadData();
 };
 
-WorkerThreadData::WorkerThreadData(const WorkerThreadSection* sec)
-    : section(sec), workerDone(false), workerError(NO_ERROR) {}
+WorkerThreadData::WorkerThreadData(const function<status_t(int)>& c)
+    : call(c), workerDone(false), workerError(NO_ERROR) {}
 
 WorkerThreadData::~WorkerThreadData() {}
 
-// ================================================================================
-WorkerThreadSection::WorkerThreadSection(int id, const int64_t timeoutMs, bool userdebugAndEngOnly)
-    : Section(id, timeoutMs, userdebugAndEngOnly) {}
-
-WorkerThreadSection::~WorkerThreadSection() {}
-
 static void* worker_thread_func(void* cookie) {
     WorkerThreadData* data = (WorkerThreadData*)cookie;
-    status_t err = data->section->BlockingCall(data->pipe.writeFd().get());
+    status_t err = data->call(data->pipe.writeFd().get());
 
     {
         unique_lock<mutex> lock(data->lock);
@@ -436,20 +493,23 @@ static void* worker_thread_func(void* cookie) {
     }
 
     data->pipe.writeFd().reset();
-    data->decStrong(data->section);
+    data->decStrong(data);
     // data might be gone now. don't use it after this point in this thread.
     return NULL;
 }
 
-status_t WorkerThreadSection::Execute(ReportRequestSet* requests) const {
+// Runs the blocking call on a worker thread, which writes to the fd it's given, and reads the data
+// into the buffer until the call is done or the timeout. The call is left running if it times out.
+static status_t read_from_worker_thread(const char* name, const function<status_t(int)>& call,
+                                        const int64_t timeoutMs, FdBuffer* buffer,
+                                        bool* timedOut) {
     status_t err = NO_ERROR;
     pthread_t thread;
     pthread_attr_t attr;
-    bool timedOut = false;
-    FdBuffer buffer;
+    *timedOut = false;
 
     // Data shared between this thread and the worker thread.
-    sp<WorkerThreadData> data = new WorkerThreadData(this);
+    sp<WorkerThreadData> data = new WorkerThreadData(call);
 
     // Create the pipe
     if (!data->pipe.init()) {
@@ -458,7 +518,7 @@ status_t WorkerThreadSection::Execute(ReportRequestSet* requests) const {
 
     // The worker thread needs a reference and we can't let the count go to zero
     // if that thread is slow to start.
-    data->incStrong(this);
+    data->incStrong(data.get());
 
     // Create the thread
     err = pthread_attr_init(&attr);
@@ -479,11 +539,10 @@ status_t WorkerThreadSection::Execute(ReportRequestSet* requests) const {
     pthread_attr_destroy(&attr);
 
     // Loop reading until either the timeout or the worker side is done (i.e. eof).
-    err = buffer.read(data->pipe.readFd().get(), this->timeoutMs);
+    err = buffer->read(data->pipe.readFd().get(), timeoutMs);
     if (err != NO_ERROR) {
         // TODO: Log this error into the incident report.
-        ALOGW("WorkerThreadSection '%s' reader failed with error '%s'", this->name.string(),
-              strerror(-err));
+        ALOGW("Section '%s' reader failed with error '%s'", name, strerror(-err));
     }
 
     // Done with the read fd. The worker thread closes the write one so
@@ -496,16 +555,31 @@ status_t WorkerThreadSection::Execute(ReportRequestSet* requests) const {
         unique_lock<mutex> lock(data->lock);
         if (!data->workerDone) {
             // We timed out
-            timedOut = true;
+            *timedOut = true;
         } else {
             if (data->workerError != NO_ERROR) {
                 err = data->workerError;
                 // TODO: Log this error into the incident report.
-                ALOGW("WorkerThreadSection '%s' worker failed with error '%s'", this->name.string(),
-                      strerror(-err));
+                ALOGW("Section '%s' worker failed with error '%s'", name, strerror(-err));
             }
         }
     }
+    return err;
+}
+
+// ================================================================================
+WorkerThreadSection::WorkerThreadSection(int id, const int64_t timeoutMs, bool userdebugAndEngOnly)
+    : Section(id, timeoutMs, userdebugAndEngOnly) {}
+
+WorkerThreadSection::~WorkerThreadSection() {}
+
+status_t WorkerThreadSection::Execute(ReportRequestSet* requests) const {
+    bool timedOut = false;
+    FdBuffer buffer;
+
+    status_t err = read_from_worker_thread(
+            this->name.string(), [this](int pipeWriteFd) { return BlockingCall(pipeWriteFd); },
+            this->timeoutMs, &buffer, &timedOut);
     write_section_stats(requests->sectionStats(this->id), buffer);
     if (timedOut || buffer.timedOut()) {
         ALOGW("WorkerThreadSection '%s' timed out", this->name.string());
@@ -662,6 +736,7 @@ status_t DumpsysSection::BlockingCall(int pipeWriteFd) const {
 // ================================================================================
 // initialization only once in Section.cpp.
 map<log_id_t, log_time> LogSection::gLastLogsRetrieved;
+mutex LogSection::gLastLogsRetrievedLock;
 
 LogSection::LogSection(int id, log_id_t logID) : WorkerThreadSection(id), mLogID(logID) {
     name += "logcat ";
@@ -696,12 +771,22 @@ static inline int32_t get4LE(uint8_t const* src) {
 }
 
 status_t LogSection::BlockingCall(int pipeWriteFd) const {
+    // The log sections can run at the same time, each one with its own log buffer.
+    bool retrievedBefore;
+    log_time lastRetrieved(0);
+    {
+        lock_guard<mutex> lock(gLastLogsRetrievedLock);
+        auto it = gLastLogsRetrieved.find(mLogID);
+        retrievedBefore = it != gLastLogsRetrieved.end();
+        if (retrievedBefore) lastRetrieved = it->second;
+    }
+
     // Open log buffer and getting logs since last retrieved time if any.
     unique_ptr<logger_list, void (*)(logger_list*)> loggers(
-            gLastLogsRetrieved.find(mLogID) == gLastLogsRetrieved.end()
+            !retrievedBefore
                     ? android_logger_list_alloc(ANDROID_LOG_RDONLY | ANDROID_LOG_NONBLOCK, 0, 0)
                     : android_logger_list_alloc_time(ANDROID_LOG_RDONLY | ANDROID_LOG_NONBLOCK,
-                                                     gLastLogsRetrieved[mLogID], 0),
+                                                     lastRetrieved, 0),
             android_logger_list_free);
 
     if (android_logger_open(loggers.get(), mLogID) == NULL) {
@@ -812,7 +897,10 @@ status_t LogSection::BlockingCall(int pipeWriteFd) const {
             proto.end(token);
         }
     }
-    gLastLogsRetrieved[mLogID] = lastTimestamp;
+    {
+        lock_guard<mutex> lock(gLastLogsRetrievedLock);
+        gLastLogsRetrieved[mLogID] = lastTimestamp;
+    }
     proto.flush(pipeWriteFd);
     return NO_ERROR;
 }
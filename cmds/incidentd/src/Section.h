@@ -21,18 +21,38 @@
 #include "Reporter.h"
 
 #include <stdarg.h>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
 
+#include <android-base/unique_fd.h>
 #include <utils/String16.h>
 #include <utils/String8.h>
 #include <utils/Vector.h>
 
+class TextParserBase;
+
 namespace android {
 namespace os {
 namespace incidentd {
 
 const int64_t REMOTE_CALL_TIMEOUT_MS = 30 * 1000;  // 30 seconds
 
+class FdBuffer;
+
+/**
+ * Writes the data read by a section to the requests. If the requests defer the writes, the data
+ * is moved to them instead, see ReportRequestSet::deferWrites().
+ */
+status_t write_report_requests(const int id, FdBuffer& buffer, ReportRequestSet* requests);
+
+/**
+ * Writes the data a section kept in a set that defers the writes to the requests.
+ */
+status_t write_deferred_report_requests(const int id, const ReportRequestSet& deferred,
+                                        ReportRequestSet* requests);
+
 /**
  * Base class for sections
  */
@@ -75,6 +95,10 @@ public:
 
 /**
  * Section that reads in a file.
+ *
+ * The file is parsed by the incident_helper parser of the section, which runs in incidentd on a
+ * worker thread. The parsers run in an incident_helper child process instead, like the sections
+ * without one, if they aren't parsed in process.
  */
 class FileSection : public Section {
 public:
@@ -84,17 +108,34 @@ public:
 
     virtual status_t Execute(ReportRequestSet* requests) const;
 
+    /**
+     * Whether the parsers run in incidentd, the default, or in incident_helper to sandbox them.
+     */
+    static void setParseInProcess(bool parseInProcess);
+
 private:
+    static atomic<bool> gParseInProcess;
+
     const char* mFilename;
     bool mIsSysfs;  // sysfs files are pollable but return POLLERR by default, handle it separately
+
+    status_t ExecuteInProcess(const shared_ptr<TextParserBase>& parser,
+                              android::base::unique_fd fd, ReportRequestSet* requests) const;
+    status_t ExecuteWithIncidentHelper(android::base::unique_fd fd,
+                                       ReportRequestSet* requests) const;
 };
 
+const int GZIP_COMPRESSION_LEVEL = 6;  // the default of gzip
+
 /**
- * Section that reads in a file and gzips the content.
+ * Section that reads in a file and gzips the content, in process.
  */
 class GZipSection : public Section {
 public:
+    GZipSection(int id, int compressionLevel, const char* filename, ...);
+
     GZipSection(int id, const char* filename, ...);
+
     virtual ~GZipSection();
 
     virtual status_t Execute(ReportRequestSet* requests) const;
@@ -102,6 +143,7 @@ public:
 private:
     // It looks up the content from multiple files and stops when the first one is available.
     const char** mFilenames;
+    const int mCompressionLevel;
 };
 
 /**
@@ -156,6 +198,7 @@ private:
 class LogSection : public WorkerThreadSection {
     // global last log retrieved timestamp for each log_id_t.
     static map<log_id_t, log_time> gLastLogsRetrieved;
+    static mutex gLastLogsRetrievedLock;
 
 public:
     LogSection(int id, log_id_t logID);
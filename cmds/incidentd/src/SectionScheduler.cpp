@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define DEBUG false
+#include "Log.h"
+
+#include "SectionScheduler.h"
+
+#include <utils/SystemClock.h>
+
+#include <string.h>
+#include <thread>
+
+namespace android {
+namespace os {
+namespace incidentd {
+
+static void notify_section_status(ReportRequestSet* requests, int id, int status) {
+    for (ReportRequestSet::iterator it = requests->begin(); it != requests->end(); it++) {
+        if ((*it)->listener != NULL && (*it)->args.containsSection(id)) {
+            (*it)->listener->onReportSectionStatus(id, status);
+        }
+    }
+}
+
+SectionScheduler::SectionScheduler(size_t maxConcurrentSections, int64_t reportTimeoutMs)
+    : mMaxConcurrentSections(maxConcurrentSections),
+      mReportTimeoutMs(reportTimeoutMs) {}
+
+SectionScheduler::~SectionScheduler() {}
+
+void SectionScheduler::execute(Task* task) {
+    task->startTime = uptimeMillis();
+    status_t err = task->section->Execute(&task->requests);
+    int64_t endTime = uptimeMillis();
+
+    unique_lock<mutex> lock(mLock);
+    task->err = err;
+    task->endTime = endTime;
+    task->done = true;
+    mTaskDone.notify_all();
+}
+
+status_t SectionScheduler::run(const vector<const Section*>& sections, ReportRequestSet* requests,
+                               size_t* reportByteSize) {
+    const int64_t deadline = uptimeMillis() + mReportTimeoutMs;
+    vector<unique_ptr<Task>> tasks;
+    for (const Section* section : sections) {
+        unique_ptr<Task> task(new Task());
+        task->section = section;
+        for (ReportRequestSet::iterator it = requests->begin(); it != requests->end(); it++) {
+            task->requests.add(*it);
+        }
+        if (requests->mainFd() >= 0) {
+            task->requests.setMainFd(requests->mainFd());
+            task->requests.setMainDest(requests->mainDest());
+        }
+        task->requests.setDeferWrites(true);
+        task->err = NO_ERROR;
+        task->startTime = 0;
+        task->endTime = 0;
+        task->done = false;
+        tasks.push_back(std::move(task));
+    }
+
+    status_t err = NO_ERROR;
+    size_t nextToStart = 0;
+    for (size_t nextToWrite = 0; nextToWrite < tasks.size();) {
+        // Start the sections while there is room, in order. A section takes room until it's
+        // written, as its data is held until then.
+        while (nextToStart < tasks.size() && nextToStart - nextToWrite < mMaxConcurrentSections &&
+               uptimeMillis() < deadline) {
+            Task* task = tasks[nextToStart++].get();
+            ALOGD("Taking incident report section %d '%s'", task->section->id,
+                  task->section->name.string());
+            notify_section_status(requests, task->section->id,
+                                  IIncidentReportStatusListener::STATUS_STARTING);
+            task->worker = thread(&SectionScheduler::execute, this, task);
+        }
+
+        Task* task = tasks[nextToWrite].get();
+        const int id = task->section->id;
+        if (nextToWrite == nextToStart) {
+            // The report timed out before the section could start.
+            ALOGW("Incident section %s (%d) skipped, the report timed out",
+                  task->section->name.string(), id);
+            IncidentMetadata::SectionStats* stats = requests->sectionStats(id);
+            stats->set_success(false);
+            stats->set_timed_out(true);
+            nextToStart++;
+            nextToWrite++;
+            continue;
+        }
+        {
+            // Wait for the next section to write.
+            unique_lock<mutex> lock(mLock);
+            mTaskDone.wait(lock, [task] { return task->done; });
+        }
+        task->worker.join();
+
+        // Write the section to the requests, now that the ones before it are written.
+        IncidentMetadata::SectionStats* stats = requests->sectionStats(id);
+        *stats = *task->requests.sectionStats(id);
+        err = task->err;
+        if (err == NO_ERROR) {
+            err = write_deferred_report_requests(id, task->requests, requests);
+        }
+        stats->set_success(err == NO_ERROR);
+        stats->set_exec_duration_ms(task->endTime - task->startTime);
+        if (err != NO_ERROR) {
+            ALOGW("Incident section %s (%d) failed: %s. Stopping report.",
+                  task->section->name.string(), id, strerror(-err));
+            break;
+        }
+        (*reportByteSize) += stats->report_size_bytes();
+        notify_section_status(requests, id, IIncidentReportStatusListener::STATUS_FINISHED);
+        ALOGD("Finish incident report section %d '%s'", id, task->section->name.string());
+        tasks[nextToWrite++].reset();
+    }
+
+    // The sections still running after a failure are bounded by their timeouts, and their data
+    // is dropped.
+    for (const unique_ptr<Task>& task : tasks) {
+        if (task != nullptr && task->worker.joinable()) {
+            task->worker.join();
+        }
+    }
+    return err;
+}
+
+}  // namespace incidentd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef SECTION_SCHEDULER_H
+#define SECTION_SCHEDULER_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Reporter.h"
+#include "Section.h"
+
+namespace android {
+namespace os {
+namespace incidentd {
+
+const size_t MAX_CONCURRENT_SECTIONS = 4;
+const int64_t REPORT_TIMEOUT_MS = 3 * 60 * 1000;  // 3 minutes
+
+/**
+ * Executes the sections of a report, several at a time.
+ *
+ * Each section runs on its own thread with a set of the same requests that defers the writes, so
+ * the data is only written once the sections before it are, and the report is the same as if the
+ * sections ran one after the other. The sections running and the ones done but not written yet
+ * are bounded together, which bounds the data held in memory. The sections are bounded by their
+ * own timeouts, and the ones that haven't started when the report times out are skipped.
+ */
+class SectionScheduler {
+public:
+    SectionScheduler(size_t maxConcurrentSections = MAX_CONCURRENT_SECTIONS,
+                     int64_t reportTimeoutMs = REPORT_TIMEOUT_MS);
+    ~SectionScheduler();
+
+    /**
+     * Executes the sections and writes them to the requests in order, telling the listeners of
+     * each request. Stops at the first section that fails, and returns its error.
+     */
+    status_t run(const vector<const Section*>& sections, ReportRequestSet* requests,
+                 size_t* reportByteSize);
+
+private:
+    struct Task {
+        const Section* section;
+        ReportRequestSet requests;
+        status_t err;
+        int64_t startTime;
+        int64_t endTime;
+        bool done;
+        thread worker;
+    };
+
+    const size_t mMaxConcurrentSections;
+    const int64_t mReportTimeoutMs;
+
+    // Protects the done flag of the tasks.
+    mutex mLock;
+    condition_variable mTaskDone;
+
+    void execute(Task* task);
+};
+
+}  // namespace incidentd
+}  // namespace os
+}  // namespace android
+
+#endif  // SECTION_SCHEDULER_H
@@ -16,7 +16,9 @@
 #include "Log.h"
 
 #include "IncidentService.h"
+#include "Section.h"
 
+#include <android-base/properties.h>
 #include <binder/IInterface.h>
 #include <binder/IPCThreadState.h>
 #include <binder/IServiceManager.h>
@@ -33,6 +35,11 @@ using namespace android::os::incidentd;
 
 // ================================================================================
 int main(int /*argc*/, char** /*argv*/) {
+    // The parsers of the file sections run in incident_helper instead, e.g. to sandbox them, if
+    // the property is false.
+    FileSection::setParseInProcess(
+            android::base::GetBoolProperty("persist.incidentd.parsers_in_process", true));
+
     // Set up the looper
     sp<Looper> looper(Looper::prepare(0 /* opts */));
 
@@ -23,6 +23,7 @@
 #include <gtest/gtest.h>
 #include <signal.h>
 #include <string.h>
+#include <zlib.h>
 
 using namespace android;
 using namespace android::base;
@@ -57,6 +58,35 @@ public:
         EXPECT_EQ(expected[i], '\0');
     }
 
+    std::string ReadBuffer() {
+        std::string content;
+        EncodedBuffer::iterator it = buffer.data();
+        while (it.readBuffer() != NULL) {
+            content.append((const char*)it.readBuffer(), it.currentToRead());
+            it.rp()->move(it.currentToRead());
+        }
+        return content;
+    }
+
+    // Decompresses as much as it can of the gzip data.
+    static std::string Gunzip(const std::string& data) {
+        z_stream stream = {};
+        EXPECT_EQ(Z_OK, inflateInit2(&stream, 16 + MAX_WBITS));
+        stream.next_in = (Bytef*)data.data();
+        stream.avail_in = data.size();
+        std::string content;
+        char out[BUFFER_SIZE];
+        int ret;
+        do {
+            stream.next_out = (Bytef*)out;
+            stream.avail_out = sizeof(out);
+            ret = inflate(&stream, Z_NO_FLUSH);
+            content.append(out, sizeof(out) - stream.avail_out);
+        } while (ret == Z_OK);
+        inflateEnd(&stream);
+        return content;
+    }
+
     bool DoDataStream(const unique_fd& rFd, const unique_fd& wFd) {
         char buf[BUFFER_SIZE];
         ssize_t nRead;
@@ -263,6 +293,43 @@ TEST_F(FdBufferTest, ReadInStreamMoreThan4MB) {
     }
 }
 
+TEST_F(FdBufferTest, ReadAndGzip) {
+    std::string testdata;
+    for (int i = 0; i < 100000; i++) {
+        testdata += "line " + std::to_string(i % 100) + "\n";
+    }
+    ASSERT_TRUE(WriteStringToFile(testdata, tf.path));
+    ASSERT_EQ(NO_ERROR, buffer.readAndGzip(tf.fd, 6, READ_TIMEOUT));
+    EXPECT_FALSE(buffer.timedOut());
+    EXPECT_FALSE(buffer.truncated());
+    EXPECT_LT(buffer.size(), testdata.size() / 10);
+    EXPECT_EQ(testdata, Gunzip(ReadBuffer()));
+}
+
+TEST_F(FdBufferTest, ReadAndGzipEmpty) {
+    ASSERT_EQ(NO_ERROR, buffer.readAndGzip(tf.fd, 6, READ_TIMEOUT));
+    EXPECT_GT(buffer.size(), 0u);  // the gzip header and trailer.
+    EXPECT_EQ("", Gunzip(ReadBuffer()));
+}
+
+TEST_F(FdBufferTest, ReadAndGzipMoreThan4MB) {
+    // Data that doesn't compress.
+    std::string testdata;
+    uint32_t seed = 1;
+    for (int i = 0; i < 5 * 1024 * 1024; i++) {
+        seed = seed * 1103515245 + 12345;
+        testdata += (char)(seed >> 24);
+    }
+    ASSERT_TRUE(WriteStringToFile(testdata, tf.path));
+    ASSERT_EQ(NO_ERROR, buffer.readAndGzip(tf.fd, 6, READ_TIMEOUT));
+    EXPECT_EQ(buffer.size(), (size_t)4 * 1024 * 1024);
+    EXPECT_TRUE(buffer.truncated());
+    // What was compressed is still readable.
+    std::string content = Gunzip(ReadBuffer());
+    EXPECT_GT(content.size(), (size_t)3 * 1024 * 1024);
+    EXPECT_EQ(testdata.substr(0, content.size()), content);
+}
+
 TEST_F(FdBufferTest, ReadInStreamTimeOut) {
     std::string testdata = "timeout test";
     ASSERT_TRUE(WriteStringToFile(testdata, tf.path));
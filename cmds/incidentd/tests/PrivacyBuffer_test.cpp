@@ -286,3 +286,35 @@ TEST_F(PrivacyBufferTest, AutoMessage) {
     std::string expected = "\x2a\xd" + STRING_FIELD_2;
     assertStripByFields(DEST_AUTOMATIC, expected, 1, autoMsg);
 }
+
+TEST_F(PrivacyBufferTest, StripForSeveralSpecs) {
+    writeToFdBuffer(STRING_FIELD_0 + VARINT_FIELD_1 + STRING_FIELD_2 + MESSAGE_FIELD_5);
+    Privacy* list[] = {create_privacy(1, OTHER_TYPE, DEST_LOCAL), NULL};
+    Privacy* fields[] = {create_privacy(0, STRING_TYPE, DEST_AUTOMATIC),
+                         create_privacy(2, STRING_TYPE, DEST_EXPLICIT),
+                         create_message_privacy(5, list), NULL};
+    EncodedBuffer::iterator bufData = buffer.data();
+    PrivacyBuffer privacyBuf(create_message_privacy(300, fields), bufData);
+    PrivacySpec automatic = PrivacySpec::new_spec(DEST_AUTOMATIC);
+    PrivacySpec explicitSpec = PrivacySpec::new_spec(DEST_EXPLICIT);
+    PrivacySpec local = PrivacySpec::new_spec(DEST_LOCAL);
+
+    ASSERT_EQ(privacyBuf.strip({automatic, explicitSpec, local, automatic}), NO_ERROR);
+    std::string expected[] = {STRING_FIELD_0,
+                              STRING_FIELD_0 + VARINT_FIELD_1 + STRING_FIELD_2 + "\x2a\xd" +
+                                      STRING_FIELD_2,
+                              STRING_FIELD_0 + VARINT_FIELD_1 + STRING_FIELD_2 + MESSAGE_FIELD_5};
+    PrivacySpec specs[] = {automatic, explicitSpec, local};
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(privacyBuf.size(specs[i]), expected[i].size());
+        CaptureStdout();
+        ASSERT_EQ(privacyBuf.flush(STDOUT_FILENO, specs[i]), NO_ERROR);
+        ASSERT_THAT(GetCapturedStdout(), StrEq(expected[i]));
+    }
+
+    // The same as stripping for each spec on its own.
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(privacyBuf.strip(specs[i]), NO_ERROR);
+        assertBuffer(privacyBuf, expected[i]);
+    }
+}
@@ -0,0 +1,192 @@
+// Copyright (C) 2018 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#define DEBUG false
+#include "Log.h"
+
+#include "FdBuffer.h"
+#include "SectionScheduler.h"
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <android/os/IncidentReportArgs.h>
+#include <android/util/protobuf.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <utils/SystemClock.h>
+
+#include <chrono>
+#include <thread>
+
+using namespace android;
+using namespace android::base;
+using namespace android::binder;
+using namespace android::os;
+using namespace android::os::incidentd;
+using namespace android::util;
+using ::testing::StrEq;
+using ::testing::Test;
+
+// A section that takes its time, then writes a varint field of its id.
+class SlowSection : public Section {
+public:
+    SlowSection(int id, int64_t durationMs, status_t err = NO_ERROR)
+        : Section(id), mDurationMs(durationMs), mErr(err) {
+        name = "slow";
+    }
+    virtual ~SlowSection() {}
+
+    virtual status_t Execute(ReportRequestSet* requests) const {
+        std::this_thread::sleep_for(std::chrono::milliseconds(mDurationMs));
+        if (mErr != NO_ERROR) return mErr;
+        FdBuffer buffer;
+        EncodedBuffer* data = buffer.getInternalBuffer();
+        data->writeHeader(1, WIRE_TYPE_VARINT);
+        data->writeRawVarint32(id);
+        return write_report_requests(id, buffer, requests);
+    }
+
+private:
+    const int64_t mDurationMs;
+    const status_t mErr;
+};
+
+class SectionListener : public IIncidentReportStatusListener {
+public:
+    vector<int> startSections;
+    vector<int> finishSections;
+
+    SectionListener(){};
+    virtual ~SectionListener(){};
+
+    virtual Status onReportStarted() { return Status::ok(); };
+    virtual Status onReportSectionStatus(int section, int status) {
+        switch (status) {
+            case IIncidentReportStatusListener::STATUS_STARTING:
+                startSections.push_back(section);
+                break;
+            case IIncidentReportStatusListener::STATUS_FINISHED:
+                finishSections.push_back(section);
+                break;
+        }
+        return Status::ok();
+    };
+    virtual Status onReportFinished() { return Status::ok(); };
+    virtual Status onReportFailed() { return Status::ok(); };
+
+protected:
+    virtual IBinder* onAsBinder() override { return nullptr; };
+};
+
+class SectionSchedulerTest : public Test {
+public:
+    virtual void SetUp() override {
+        ASSERT_NE(tf.fd, -1);
+        l = new SectionListener();
+        IncidentReportArgs args;
+        args.setAll(true);
+        args.setDest(android::os::DEST_LOCAL);
+        requests.add(new ReportRequest(args, l, dup(tf.fd)));
+    }
+
+    // What SlowSection writes to the report.
+    static std::string sectionData(int id) {
+        uint8_t buf[20];
+        uint8_t* p = write_length_delimited_tag_header(buf, id, 2);
+        return std::string((char*)buf, p - buf) + "\x08" + (char)id;
+    }
+
+    std::string readReport() {
+        std::string content;
+        ReadFileToString(tf.path, &content);
+        return content;
+    }
+
+    // Runs the sections, returns how long it took in milliseconds.
+    int64_t run(SectionScheduler* scheduler, const vector<const Section*>& sections,
+                status_t expectedErr = NO_ERROR) {
+        size_t size = 0;
+        int64_t startTime = uptimeMillis();
+        EXPECT_EQ(expectedErr, scheduler->run(sections, &requests, &size));
+        return uptimeMillis() - startTime;
+    }
+
+protected:
+    TemporaryFile tf;
+    ReportRequestSet requests;
+    sp<SectionListener> l;
+};
+
+TEST_F(SectionSchedulerTest, WallTimeTracksSlowestSection) {
+    SlowSection s1(11, 300), s2(12, 100), s3(13, 400), s4(14, 200);
+    SectionScheduler scheduler(4, REPORT_TIMEOUT_MS);
+
+    int64_t durationMs = run(&scheduler, {&s1, &s2, &s3, &s4});
+    EXPECT_GE(durationMs, 400);
+    EXPECT_LT(durationMs, 700);  // the sum is 1000ms.
+
+    // The sections are written in order, whatever order they finished in.
+    EXPECT_THAT(readReport(),
+                StrEq(sectionData(11) + sectionData(12) + sectionData(13) + sectionData(14)));
+    EXPECT_EQ(vector<int>({11, 12, 13, 14}), l->startSections);
+    EXPECT_EQ(vector<int>({11, 12, 13, 14}), l->finishSections);
+    EXPECT_TRUE(requests.sectionStats(13)->success());
+    EXPECT_GE(requests.sectionStats(13)->exec_duration_ms(), 400);
+}
+
+TEST_F(SectionSchedulerTest, BoundedConcurrentSections) {
+    SlowSection s1(11, 200), s2(12, 200), s3(13, 200), s4(14, 200);
+    SectionScheduler scheduler(2, REPORT_TIMEOUT_MS);
+
+    int64_t durationMs = run(&scheduler, {&s1, &s2, &s3, &s4});
+    EXPECT_GE(durationMs, 400);
+    EXPECT_LT(durationMs, 700);
+    EXPECT_THAT(readReport(),
+                StrEq(sectionData(11) + sectionData(12) + sectionData(13) + sectionData(14)));
+}
+
+TEST_F(SectionSchedulerTest, BoundedUnwrittenSections) {
+    SlowSection s1(11, 400), s2(12, 50), s3(13, 50), s4(14, 50);
+    SectionScheduler scheduler(2, REPORT_TIMEOUT_MS);
+
+    // s2 is done long before s1, but it's held until s1 is written, so s3 and s4 wait for s1.
+    int64_t durationMs = run(&scheduler, {&s1, &s2, &s3, &s4});
+    EXPECT_GE(durationMs, 450);
+    EXPECT_THAT(readReport(),
+                StrEq(sectionData(11) + sectionData(12) + sectionData(13) + sectionData(14)));
+}
+
+TEST_F(SectionSchedulerTest, ReportTimeout) {
+    SlowSection s1(11, 300), s2(12, 100), s3(13, 100);
+    SectionScheduler scheduler(1, 200);
+
+    // The running section finishes, the others don't start.
+    run(&scheduler, {&s1, &s2, &s3});
+    EXPECT_THAT(readReport(), StrEq(sectionData(11)));
+    EXPECT_EQ(vector<int>({11}), l->startSections);
+    EXPECT_EQ(vector<int>({11}), l->finishSections);
+    EXPECT_TRUE(requests.sectionStats(11)->success());
+    EXPECT_FALSE(requests.sectionStats(12)->success());
+    EXPECT_TRUE(requests.sectionStats(12)->timed_out());
+    EXPECT_TRUE(requests.sectionStats(13)->timed_out());
+}
+
+TEST_F(SectionSchedulerTest, StopsAtFailedSection) {
+    SlowSection s1(11, 100), s2(12, 200, -EINVAL), s3(13, 100), s4(14, 300);
+    SectionScheduler scheduler(4, REPORT_TIMEOUT_MS);
+
+    run(&scheduler, {&s1, &s2, &s3, &s4}, -EINVAL);
+    EXPECT_THAT(readReport(), StrEq(sectionData(11)));
+    EXPECT_EQ(vector<int>({11}), l->finishSections);
+    EXPECT_FALSE(requests.sectionStats(12)->success());
+}
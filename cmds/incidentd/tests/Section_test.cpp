@@ -19,11 +19,13 @@
 #include <android-base/file.h>
 #include <android-base/test_utils.h>
 #include <android/os/IncidentReportArgs.h>
+#include <android/util/ProtoReader.h>
 #include <android/util/protobuf.h>
 #include <frameworks/base/libs/incident/proto/android/os/header.pb.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <string.h>
+#include <zlib.h>
 
 using namespace android;
 using namespace android::base;
@@ -51,6 +53,25 @@ class SectionTest : public Test {
 public:
     virtual void SetUp() override { ASSERT_NE(tf.fd, -1); }
 
+    static std::string gunzip(const std::string& data) {
+        z_stream stream = {};
+        EXPECT_EQ(Z_OK, inflateInit2(&stream, 16 + MAX_WBITS));
+        stream.next_in = (Bytef*)data.data();
+        stream.avail_in = data.size();
+        std::string content;
+        char out[4096];
+        int ret;
+        do {
+            stream.next_out = (Bytef*)out;
+            stream.avail_out = sizeof(out);
+            ret = inflate(&stream, Z_NO_FLUSH);
+            content.append(out, sizeof(out) - stream.avail_out);
+        } while (ret == Z_OK);
+        EXPECT_EQ(Z_STREAM_END, ret);
+        inflateEnd(&stream);
+        return content;
+    }
+
     void printDebugString(std::string s) {
         fprintf(stderr, "size: %zu\n", s.length());
         for (size_t i = 0; i < s.length(); i++) {
@@ -143,6 +164,28 @@ TEST_F(SectionTest, FileSection) {
     EXPECT_THAT(GetCapturedStdout(), StrEq("\xa\vatadtsetmai"));
 }
 
+TEST_F(SectionTest, FileSectionInProcessParser) {
+    const int batteryTypeSection = 2006;
+    FileSection fs(batteryTypeSection, tf.path);
+
+    ASSERT_TRUE(WriteStringToFile("li-ion\n", tf.path));
+
+    requests.setMainFd(STDOUT_FILENO);
+
+    CaptureStdout();
+    ASSERT_EQ(NO_ERROR, fs.Execute(&requests));
+    // Section 2006 is "\xb2\x7d", and the parser writes BatteryTypeProto with type "li-ion".
+    std::string expected("\xb2\x7d\x08\x0a\x06li-ion");
+    EXPECT_THAT(GetCapturedStdout(), StrEq(expected));
+
+    // The same as in incident_helper.
+    FileSection::setParseInProcess(false);
+    CaptureStdout();
+    ASSERT_EQ(NO_ERROR, fs.Execute(&requests));
+    FileSection::setParseInProcess(true);
+    EXPECT_THAT(GetCapturedStdout(), StrEq(expected));
+}
+
 TEST_F(SectionTest, FileSectionNotExist) {
     FileSection fs1(NOOP_PARSER, "notexist", false, QUICK_TIMEOUT_MS);
     ASSERT_EQ(NAME_NOT_FOUND, fs1.Execute(&requests));
@@ -159,27 +202,49 @@ TEST_F(SectionTest, FileSectionTimeout) {
 
 TEST_F(SectionTest, GZipSection) {
     const std::string testFile = kTestDataPath + "kmsg.txt";
-    const std::string testGzFile = testFile + ".gz";
     GZipSection gs(NOOP_PARSER, "/tmp/nonexist", testFile.c_str(), NULL);
 
     requests.setMainFd(tf.fd);
     requests.setMainDest(android::os::DEST_LOCAL);
 
     ASSERT_EQ(NO_ERROR, gs.Execute(&requests));
-    std::string expected, gzFile, actual;
-    ASSERT_TRUE(ReadFileToString(testGzFile, &gzFile));
+    std::string content, actual;
+    ASSERT_TRUE(ReadFileToString(testFile, &content));
     ASSERT_TRUE(ReadFileToString(tf.path, &actual));
-    // generates the expected protobuf result.
-    size_t fileLen = testFile.size();
-    size_t totalLen = 1 + get_varint_size(fileLen) + fileLen + 3 + gzFile.size();
-    uint8_t header[20];
-    header[0] = '\x2';  // header 0 << 3 + 2
-    uint8_t* ptr = write_raw_varint(header + 1, totalLen);
-    *ptr = '\n';  // header 1 << 3 + 2
-    ptr = write_raw_varint(++ptr, fileLen);
-    expected.assign((const char*)header, ptr - header);
-    expected += testFile + "\x12\x9F\x6" + gzFile;
-    EXPECT_THAT(actual, StrEq(expected));
+    // parses the section header and the GZippedFileProto.
+    ProtoReader reader((const uint8_t*)actual.data(), actual.size());
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ((uint32_t)NOOP_PARSER, reader.fieldId());
+    uint64_t token = reader.start();
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(1u, reader.fieldId());
+    EXPECT_THAT(reader.readString(), StrEq(testFile));
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(2u, reader.fieldId());
+    // gzip'ed in process, so compare what it decompresses to.
+    EXPECT_THAT(gunzip(reader.readString()), StrEq(content));
+    EXPECT_FALSE(reader.next());
+    reader.end(token);
+    EXPECT_FALSE(reader.hasError());
+    EXPECT_EQ(actual.size(), reader.bytesRead());
+}
+
+TEST_F(SectionTest, GZipSectionCompressionLevel) {
+    const std::string testFile = kTestDataPath + "kmsg.txt";
+    GZipSection fast(NOOP_PARSER, 1, testFile.c_str(), NULL);
+    GZipSection best(NOOP_PARSER, 9, testFile.c_str(), NULL);
+    TemporaryFile fastOutput, bestOutput;
+
+    requests.setMainFd(fastOutput.fd);
+    requests.setMainDest(android::os::DEST_LOCAL);
+    ASSERT_EQ(NO_ERROR, fast.Execute(&requests));
+    requests.setMainFd(bestOutput.fd);
+    ASSERT_EQ(NO_ERROR, best.Execute(&requests));
+
+    std::string fastContent, bestContent;
+    ASSERT_TRUE(ReadFileToString(fastOutput.path, &fastContent));
+    ASSERT_TRUE(ReadFileToString(bestOutput.path, &bestContent));
+    EXPECT_GE(fastContent.size(), bestContent.size());
 }
 
 TEST_F(SectionTest, GZipSectionNoFileFound) {
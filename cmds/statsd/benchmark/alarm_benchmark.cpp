@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <random>
+#include <vector>
+#include "anomaly/AlarmMonitor.h"
+#include "anomaly/AlarmTimerWheel.h"
+#include "anomaly/indexed_priority_queue.h"
+#include "benchmark/benchmark.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::vector;
+
+static const int kAlarmCount = 1000000;
+
+static const uint32_t kNowSec = 1500000000;
+
+// The alarms are within a day of the current time, like the anomaly and periodic alarms.
+static vector<uint32_t> createAlarmTimes() {
+    std::mt19937 random(1);
+    vector<uint32_t> times(kAlarmCount);
+    for (auto& time : times) {
+        time = kNowSec + random() % (24 * 60 * 60);
+    }
+    return times;
+}
+
+static void BM_AlarmTimerWheelArmAndCancel(benchmark::State& state) {
+    const vector<uint32_t> times = createAlarmTimes();
+    vector<AlarmTimerWheelNode> alarms(kAlarmCount);
+    vector<const AlarmTimerWheelNode*> expired;
+    AlarmTimerWheel wheel;
+    wheel.popSoonerThan(kNowSec, &expired);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < kAlarmCount; i++) {
+            wheel.arm(&alarms[i], times[i]);
+        }
+        for (int i = 0; i < kAlarmCount; i++) {
+            wheel.cancel(&alarms[i]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kAlarmCount);
+}
+BENCHMARK(BM_AlarmTimerWheelArmAndCancel)->Unit(benchmark::kMillisecond);
+
+static void BM_IndexedPriorityQueueArmAndCancel(benchmark::State& state) {
+    const vector<uint32_t> times = createAlarmTimes();
+    vector<sp<const InternalAlarm>> alarms;
+    alarms.reserve(kAlarmCount);
+    for (uint32_t time : times) {
+        alarms.push_back(new InternalAlarm{time});
+    }
+    indexed_priority_queue<InternalAlarm, InternalAlarm::SmallerTimestamp> pq;
+    while (state.KeepRunning()) {
+        for (const auto& alarm : alarms) {
+            pq.push(alarm);
+        }
+        for (const auto& alarm : alarms) {
+            pq.remove(alarm);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kAlarmCount);
+}
+BENCHMARK(BM_IndexedPriorityQueueArmAndCancel)->Unit(benchmark::kMillisecond);
+
+// Arms the alarms, and pops them a minute at a time, the way the alarms fire.
+static void BM_AlarmTimerWheelArmAndPop(benchmark::State& state) {
+    const vector<uint32_t> times = createAlarmTimes();
+    vector<AlarmTimerWheelNode> alarms(kAlarmCount);
+    vector<const AlarmTimerWheelNode*> expired;
+    uint32_t offsetSec = 0;
+    AlarmTimerWheel wheel;
+    wheel.popSoonerThan(kNowSec, &expired);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < kAlarmCount; i++) {
+            wheel.arm(&alarms[i], times[i] + offsetSec);
+        }
+        offsetSec += 24 * 60 * 60;
+        while (!wheel.empty()) {
+            expired.clear();
+            wheel.popSoonerThan(wheel.getSoonestAlarmTimeSec() + 60, &expired);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kAlarmCount);
+}
+BENCHMARK(BM_AlarmTimerWheelArmAndPop)->Unit(benchmark::kMillisecond);
+
+static void BM_IndexedPriorityQueueArmAndPop(benchmark::State& state) {
+    const vector<uint32_t> times = createAlarmTimes();
+    vector<sp<const InternalAlarm>> alarms;
+    alarms.reserve(kAlarmCount);
+    for (uint32_t time : times) {
+        alarms.push_back(new InternalAlarm{time});
+    }
+    indexed_priority_queue<InternalAlarm, InternalAlarm::SmallerTimestamp> pq;
+    while (state.KeepRunning()) {
+        for (const auto& alarm : alarms) {
+            pq.push(alarm);
+        }
+        while (!pq.empty()) {
+            const uint32_t timeSec = pq.top()->timestampSec + 60;
+            while (!pq.empty() && pq.top()->timestampSec <= timeSec) {
+                pq.pop();
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kAlarmCount);
+}
+BENCHMARK(BM_IndexedPriorityQueueArmAndPop)->Unit(benchmark::kMillisecond);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
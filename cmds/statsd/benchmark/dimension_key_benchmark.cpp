@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "FieldValue.h"
+#include "HashableDimensionKey.h"
+#include "logd/LogEvent.h"
+#include "stats_log_util.h"
+#include "stats_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+
+// The number of distinct dimensions, like a per-uid, per-tag wakelock metric would see.
+static const int kDimensionCount = 50000;
+
+// Creates one event per dimension, sliced by the uid and tag of the first attribution node.
+static void createEventsAndMatchers(vector<unique_ptr<LogEvent>>* events,
+                                    vector<Matcher>* matchers) {
+    for (int i = 0; i < kDimensionCount; i++) {
+        AttributionNodeInternal node;
+        node.set_uid(10000 + i % 1000);
+        node.set_tag("com.android.wakelock.tag" + std::to_string(i / 1000));
+
+        unique_ptr<LogEvent> event = std::make_unique<LogEvent>(10, 100000);
+        event->write(vector<AttributionNodeInternal>{node});
+        event->write("wakelock_name");
+        event->init();
+        events->push_back(std::move(event));
+    }
+
+    FieldMatcher fieldMatcher;
+    fieldMatcher.set_field(10);
+    auto child = fieldMatcher.add_child();
+    child->set_field(1);
+    child->set_position(FIRST);
+    child->add_child()->set_field(1);
+    child->add_child()->set_field(2);
+    translateFieldMatcher(fieldMatcher, matchers);
+}
+
+// The per-event cost of a sliced metric: filter the dimension out of the event, then update the
+// current bucket and the anomaly sums of the dimension.
+static void BM_DimensionKeyFromEvent(benchmark::State& state) {
+    vector<unique_ptr<LogEvent>> events;
+    vector<Matcher> matchers;
+    createEventsAndMatchers(&events, &matchers);
+
+    unordered_map<MetricDimensionKey, int64_t> currentBucket;
+    unordered_map<MetricDimensionKey, int64_t> anomalySums;
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        HashableDimensionKey dimensionInWhat;
+        filterValues(matchers, events[i]->getValues(), &dimensionInWhat);
+        MetricDimensionKey key(dimensionInWhat, DEFAULT_DIMENSION_KEY);
+        currentBucket[key]++;
+        anomalySums[key]++;
+        i = (i + 1) % events.size();
+    }
+    state.counters["dimensions"] = currentBucket.size();
+}
+BENCHMARK(BM_DimensionKeyFromEvent);
+
+// The cost of moving every dimension of a bucket into the past buckets, as done by a bucket flush.
+static void BM_DimensionKeyBucketFlush(benchmark::State& state) {
+    vector<unique_ptr<LogEvent>> events;
+    vector<Matcher> matchers;
+    createEventsAndMatchers(&events, &matchers);
+
+    unordered_map<MetricDimensionKey, int64_t> currentBucket;
+    for (const auto& event : events) {
+        HashableDimensionKey dimensionInWhat;
+        filterValues(matchers, event->getValues(), &dimensionInWhat);
+        currentBucket[MetricDimensionKey(dimensionInWhat, DEFAULT_DIMENSION_KEY)]++;
+    }
+
+    unordered_map<MetricDimensionKey, vector<int64_t>> pastBuckets;
+    while (state.KeepRunning()) {
+        for (const auto& counter : currentBucket) {
+            pastBuckets[counter.first].push_back(counter.second);
+        }
+        state.PauseTiming();
+        pastBuckets.clear();
+        state.ResumeTiming();
+    }
+    state.counters["dimensions"] = currentBucket.size();
+}
+BENCHMARK(BM_DimensionKeyBucketFlush);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "logd/LogEvent.h"
+#include "metric_util.h"
+#include "stats_log_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::unique_ptr;
+using std::vector;
+
+// The dimensions of the metric, under the dimension guardrail.
+static const int kDimensionCount = 500;
+
+// The buckets of each dimension waiting for a report.
+static const int kBucketCount = 40;
+
+static const int64_t kBucketSizeNs = 5 * 60 * NS_PER_SEC;
+
+// A wakelock count sliced by the uid and tag of the first attribution node.
+static StatsdConfig CreateWakelockCountConfig() {
+    StatsdConfig config;
+    config.add_allowed_log_source("AID_ROOT");  // LogEvent defaults to UID of root.
+    auto wakelockAcquireMatcher = CreateAcquireWakelockAtomMatcher();
+    *config.add_atom_matcher() = wakelockAcquireMatcher;
+
+    auto metric = config.add_count_metric();
+    metric->set_id(StringToId("WakelockCount"));
+    metric->set_what(wakelockAcquireMatcher.id());
+    metric->set_bucket(FIVE_MINUTES);
+    *metric->mutable_dimensions_in_what() = CreateAttributionUidAndTagDimensions(
+            android::util::WAKELOCK_STATE_CHANGED, {Position::FIRST});
+    return config;
+}
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+// Runs a report on another thread while this thread keeps logging events, the way the socket
+// listener does. The stall is the longest time an event waited for the processor, which is how
+// long the report held its lock.
+static void BM_DumpReportIngestionStall(benchmark::State& state) {
+    const int64_t timeBaseSec = 1000;
+    const StatsdConfig config = CreateWakelockCountConfig();
+    const ConfigKey key(0, 12345);
+    sp<StatsLogProcessor> processor = CreateStatsLogProcessor(timeBaseSec, config, key);
+
+    vector<unique_ptr<LogEvent>> events;
+    for (int i = 0; i < kDimensionCount; i++) {
+        events.push_back(CreateAcquireWakelockEvent(
+                {CreateAttribution(10000 + i, "job" + std::to_string(i))}, "wl", 0));
+    }
+
+    int64_t timeNs = timeBaseSec * NS_PER_SEC + 1;
+    int64_t maxStallNs = 0;
+    int64_t dumpCount = 0;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        for (int bucket = 0; bucket < kBucketCount; bucket++) {
+            for (auto& event : events) {
+                event->setElapsedTimestampNs(timeNs++);
+                processor->OnLogEvent(event.get());
+            }
+            timeNs += kBucketSizeNs;
+        }
+        state.ResumeTiming();
+
+        std::atomic<bool> dumpDone(false);
+        const int64_t dumpTimeNs = timeNs;
+        std::thread dumpThread([&processor, &key, &dumpDone, dumpTimeNs] {
+            vector<uint8_t> output;
+            processor->onDumpReport(key, dumpTimeNs, true /* include_current_bucket */,
+                                    ADB_DUMP, &output);
+            dumpDone = true;
+        });
+        size_t i = 0;
+        while (!dumpDone) {
+            LogEvent* event = events[i].get();
+            event->setElapsedTimestampNs(++timeNs);
+            const int64_t startNs = nowNs();
+            processor->OnLogEvent(event);
+            maxStallNs = std::max(maxStallNs, nowNs() - startNs);
+            i = (i + 1) % events.size();
+        }
+        dumpThread.join();
+        dumpCount++;
+    }
+    state.counters["max_stall_us"] = maxStallNs / 1000;
+    state.counters["dumps"] = dumpCount;
+}
+BENCHMARK(BM_DumpReportIngestionStall);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
@@ -14,9 +14,28 @@
  * limitations under the License.
  */
 #include <vector>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
 #include "benchmark/benchmark.h"
 #include "logd/LogEvent.h"
 
+// Counts the allocations made by the benchmarks, so that they can report allocations per event.
+static std::atomic<int64_t> gAllocationCount(0);
+
+void* operator new(size_t size) {
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        abort();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
 namespace android {
 namespace os {
 namespace statsd {
@@ -60,15 +79,73 @@ static void getSimpleLogMsgData(log_msg* msg) {
     std::copy(buffer.begin(), buffer.end(), msg->buf + kLogMsgHeaderSize);
 }
 
+// An atom with a timestamp, an int, and a string too long to be stored inline in std::string.
+static void getStringLogMsgData(log_msg* msg) {
+    static const char kTag[] = "com.android.statsd.benchmark.wakelock";
+    vector<char> buffer;
+    // stats_log tag id
+    write4Bytes(1937006964, &buffer);
+    buffer.push_back(EVENT_TYPE_LIST);
+    buffer.push_back(4);  // field counts;
+    buffer.push_back(EVENT_TYPE_LONG);
+    write4Bytes(1000 /* elapsed timestamp */, &buffer);
+    write4Bytes(0, &buffer);
+    buffer.push_back(EVENT_TYPE_INT);
+    write4Bytes(10 /* atom id */, &buffer);
+    buffer.push_back(EVENT_TYPE_INT);
+    write4Bytes(99 /* a value to log*/, &buffer);
+    buffer.push_back(EVENT_TYPE_STRING);
+    write4Bytes(sizeof(kTag) - 1, &buffer);
+    buffer.insert(buffer.end(), kTag, kTag + sizeof(kTag) - 1);
+
+    msg->entry_v1.len = buffer.size();
+    msg->entry.hdr_size = kLogMsgHeaderSize;
+    msg->entry_v1.sec = time(nullptr);
+    std::copy(buffer.begin(), buffer.end(), msg->buf + kLogMsgHeaderSize);
+}
+
+static void reportAllocationsPerEvent(benchmark::State& state, int64_t allocationCount) {
+    state.counters["allocs_per_event"] =
+            state.iterations() == 0 ? 0 : (double)allocationCount / state.iterations();
+}
+
 static void BM_LogEventCreation(benchmark::State& state) {
     log_msg msg;
     getSimpleLogMsgData(&msg);
+    const int64_t allocationCount = gAllocationCount.load();
     while (state.KeepRunning()) {
         benchmark::DoNotOptimize(LogEvent(msg));
     }
+    reportAllocationsPerEvent(state, gAllocationCount.load() - allocationCount);
 }
 BENCHMARK(BM_LogEventCreation);
 
+static void BM_LogEventCreationWithString(benchmark::State& state) {
+    log_msg msg;
+    getStringLogMsgData(&msg);
+    const int64_t allocationCount = gAllocationCount.load();
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(LogEvent(msg));
+    }
+    reportAllocationsPerEvent(state, gAllocationCount.load() - allocationCount);
+}
+BENCHMARK(BM_LogEventCreationWithString);
+
+// The steady state of the socket thread, which recycles processed events: no allocation is
+// expected per event.
+static void BM_LogEventReset(benchmark::State& state) {
+    log_msg msg;
+    getStringLogMsgData(&msg);
+    LogEvent event(msg);
+    const int64_t allocationCount = gAllocationCount.load();
+    while (state.KeepRunning()) {
+        event.reset(msg);
+        benchmark::DoNotOptimize(event.getValues().data());
+    }
+    reportAllocationsPerEvent(state, gAllocationCount.load() - allocationCount);
+}
+BENCHMARK(BM_LogEventReset);
+
 }  //  namespace statsd
 }  //  namespace os
 }  //  namespace android
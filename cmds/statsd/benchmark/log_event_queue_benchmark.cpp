@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "logd/LogEvent.h"
+#include "metric_util.h"
+#include "socket/LogEventQueue.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::unique_ptr;
+using std::vector;
+using std::chrono::steady_clock;
+
+// Atoms are replayed at 100k atoms/s, for one second.
+static const int64_t kAtomsPerSecond = 100000;
+static const int kReplayedAtoms = 100000;
+
+static StatsdConfig CreateScreenOnCountConfig() {
+    StatsdConfig config;
+    config.add_allowed_log_source("AID_ROOT");  // LogEvent defaults to UID of root.
+
+    auto screenOnMatcher = CreateScreenTurnedOnAtomMatcher();
+    *config.add_atom_matcher() = screenOnMatcher;
+    auto metric = config.add_count_metric();
+    metric->set_id(StringToId("ScreenOnCount"));
+    metric->set_what(screenOnMatcher.id());
+    metric->set_bucket(FIVE_MINUTES);
+    return config;
+}
+
+// Replays atoms at a fixed rate into a queue of range(0) events, drained by a processing thread
+// that stalls for range(1) microseconds every 1000 events, like a slow metric would. Reports the
+// fraction of atoms dropped, and the 99th percentile of the time the socket thread spends
+// enqueuing an atom.
+static void BM_LogEventQueueReplay(benchmark::State& state) {
+    const size_t capacity = state.range(0);
+    const int64_t stallMicros = state.range(1);
+    const long timeBaseSec = 1;
+
+    auto processor = CreateStatsLogProcessor(timeBaseSec, CreateScreenOnCountConfig(),
+                                             ConfigKey(0, 0));
+    LogEventQueue queue(capacity);
+    std::thread consumer([&] {
+        vector<unique_ptr<LogEvent>> events;
+        int processed = 0;
+        while (queue.popBatch(&events, 256)) {
+            for (const auto& event : events) {
+                processor->OnLogEvent(event.get());
+                if (stallMicros > 0 && ++processed % 1000 == 0) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(stallMicros));
+                }
+            }
+            events.clear();
+        }
+    });
+
+    vector<int64_t> latenciesNs;
+    latenciesNs.reserve(kReplayedAtoms);
+    int64_t replayed = 0;
+    int64_t dropped = 0;
+    const auto interval = std::chrono::nanoseconds(NS_PER_SEC / kAtomsPerSecond);
+    auto nextAtomTime = steady_clock::now();
+    while (state.KeepRunning()) {
+        unique_ptr<LogEvent> event = CreateScreenStateChangedEvent(
+                android::view::DisplayStateEnum::DISPLAY_STATE_ON,
+                timeBaseSec * NS_PER_SEC + replayed + 1);
+
+        // Wait for the atom's turn.
+        while (steady_clock::now() < nextAtomTime) {
+        }
+        nextAtomTime += interval;
+
+        const auto start = steady_clock::now();
+        if (!queue.push(std::move(event))) {
+            dropped++;
+        }
+        latenciesNs.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock::now() - start)
+                        .count());
+        replayed++;
+    }
+    queue.stop();
+    consumer.join();
+
+    std::sort(latenciesNs.begin(), latenciesNs.end());
+    state.counters["drop_rate"] = replayed == 0 ? 0 : (double)dropped / replayed;
+    state.counters["p99_enqueue_ns"] =
+            latenciesNs.empty() ? 0 : latenciesNs[latenciesNs.size() * 99 / 100];
+}
+BENCHMARK(BM_LogEventQueueReplay)
+        ->Args({2000, 0})
+        ->Args({2000, 5000})
+        ->Args({2000, 50000})
+        ->Args({200, 50000})
+        ->Iterations(kReplayedAtoms)
+        ->UseRealTime();
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
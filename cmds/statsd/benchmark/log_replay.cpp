@@ -0,0 +1,172 @@
+// Copyright (C) 2018 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "log_replay.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <chrono>
+#include "src/StatsLogProcessor.h"
+#include "src/anomaly/AlarmMonitor.h"
+#include "src/packages/UidMap.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+bool ReadRecordedLogEvents(const string& path, vector<unique_ptr<LogEvent>>* events) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    log_msg msg;
+    const size_t lengthsSize = 2 * sizeof(uint16_t);
+    bool success = true;
+    // Each entry is its logger_entry header, of the size in hdr_size, followed by the payload.
+    while (fread(msg.buf, lengthsSize, 1, file) == 1) {
+        const size_t headerSize = msg.entry.hdr_size ? msg.entry.hdr_size : sizeof(msg.entry_v1);
+        const size_t payloadSize = msg.entry.len;
+        if (headerSize < sizeof(msg.entry_v1) || headerSize > sizeof(msg.entry_v4) ||
+            payloadSize > LOGGER_ENTRY_MAX_PAYLOAD) {
+            success = false;
+            break;
+        }
+        // The uid is only in the latest header.
+        memset(msg.buf + lengthsSize, 0, sizeof(msg.entry_v4) - lengthsSize);
+        if (fread(msg.buf + lengthsSize, headerSize - lengthsSize, 1, file) != 1 ||
+            (payloadSize > 0 && fread(msg.buf + headerSize, payloadSize, 1, file) != 1)) {
+            success = false;
+            break;
+        }
+        msg.buf[headerSize + payloadSize] = 0;
+        events->push_back(std::make_unique<LogEvent>(msg));
+    }
+    fclose(file);
+    return success;
+}
+
+bool ReadStatsdConfig(const string& path, StatsdConfig* config) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    string data;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.append(buffer, n);
+    }
+    fclose(file);
+    return config->ParseFromString(data);
+}
+
+static int64_t getThreadCpuTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static int64_t getSteadyTimeNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+static sp<AlarmMonitor> createAlarmMonitor() {
+    // The alarms are popped by the replay, rather than registered with StatsCompanionService.
+    return new AlarmMonitor(1, [](const sp<IStatsCompanionService>&, int64_t) {},
+                            [](const sp<IStatsCompanionService>&) {});
+}
+
+ReplayResult ReplayLogEvents(const vector<StatsdConfig>& configs,
+                             const vector<unique_ptr<LogEvent>>& events, bool measureStages) {
+    ReplayResult result;
+    if (events.empty()) {
+        return result;
+    }
+    const int64_t startTimeNs = events.front()->GetElapsedTimestampNs();
+
+    sp<AlarmMonitor> anomalyAlarmMonitor = createAlarmMonitor();
+    sp<AlarmMonitor> periodicAlarmMonitor = createAlarmMonitor();
+    sp<StatsLogProcessor> processor =
+            new StatsLogProcessor(new UidMap(), anomalyAlarmMonitor, periodicAlarmMonitor,
+                                  startTimeNs, [](const ConfigKey&) { return true; });
+    vector<ConfigKey> keys;
+    for (size_t i = 0; i < configs.size(); i++) {
+        // A uid per config, so that configs with the same id don't replace each other.
+        keys.emplace_back(i, configs[i].id());
+        processor->OnConfigUpdated(startTimeNs, keys.back(), configs[i]);
+    }
+
+    if (measureStages) {
+        ProcessingStageTimes::enable();
+    }
+    const int64_t cpuStartNs = getThreadCpuTimeNs();
+    const int64_t startNs = getSteadyTimeNs();
+    int64_t alarmCheckTimeSec = startTimeNs / NS_PER_SEC;
+    for (const auto& event : events) {
+        // The alarms fire, like StatsService does when they are reported, as the simulated clock
+        // reaches them.
+        const int64_t eventTimeSec = event->GetElapsedTimestampNs() / NS_PER_SEC;
+        if (eventTimeSec > alarmCheckTimeSec) {
+            alarmCheckTimeSec = eventTimeSec;
+            auto anomalyAlarms = anomalyAlarmMonitor->popSoonerThan(eventTimeSec);
+            if (!anomalyAlarms.empty()) {
+                processor->onAnomalyAlarmFired(eventTimeSec * NS_PER_SEC, anomalyAlarms);
+            }
+            auto periodicAlarms = periodicAlarmMonitor->popSoonerThan(eventTimeSec);
+            if (!periodicAlarms.empty()) {
+                processor->onPeriodicAlarmFired(eventTimeSec * NS_PER_SEC, periodicAlarms);
+            }
+        }
+        processor->OnLogEvent(event.get());
+    }
+    result.processingTimeNs = getSteadyTimeNs() - startNs;
+    result.processingCpuTimeNs = getThreadCpuTimeNs() - cpuStartNs;
+    result.eventCount = events.size();
+    if (measureStages) {
+        ProcessingStageTimes::disable();
+        for (int i = 0; i < PROCESSING_STAGE_COUNT; i++) {
+            result.stageCpuTimeNs[i] = ProcessingStageTimes::getCpuTimeNs((ProcessingStage)i);
+        }
+    }
+
+    const int64_t dumpTimeNs = events.back()->GetElapsedTimestampNs() + 1;
+    for (const ConfigKey& key : keys) {
+        result.metricsBytes += processor->GetMetricsSize(key);
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        result.peakRssKb = usage.ru_maxrss;
+    }
+    const int64_t dumpStartNs = getSteadyTimeNs();
+    for (const ConfigKey& key : keys) {
+        vector<uint8_t> output;
+        processor->onDumpReport(key, dumpTimeNs, true /* include_current_partial_bucket */,
+                                ADB_DUMP, &output);
+        result.dumpBytes += output.size();
+    }
+    result.dumpTimeNs = getSteadyTimeNs() - dumpStartNs;
+    return result;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,62 @@
+// Copyright (C) 2018 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
+#include "src/guardrail/ProcessingStageTimer.h"
+#include "src/logd/LogEvent.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Reads atoms recorded in the binary format of logcat, e.g. with
+// `adb logcat -b stats -B -d > atoms.bin`. Returns false if the file can't be read or is corrupt.
+bool ReadRecordedLogEvents(const std::string& path,
+                           std::vector<std::unique_ptr<LogEvent>>* events);
+
+// Reads a binary StatsdConfig, as given to `adb shell cmd stats config update`.
+bool ReadStatsdConfig(const std::string& path, StatsdConfig* config);
+
+struct ReplayResult {
+    int64_t eventCount = 0;
+    // Wall time of processing the events, alarms included.
+    int64_t processingTimeNs = 0;
+    // Only measured if the replay was asked to, as the timers slow down the processing.
+    int64_t stageCpuTimeNs[PROCESSING_STAGE_COUNT] = {};
+    int64_t processingCpuTimeNs = 0;
+    // Size of the metrics of all the configs after the last event.
+    size_t metricsBytes = 0;
+    // Peak resident memory of the process so far, which includes the recorded events.
+    int64_t peakRssKb = 0;
+    // Dumping the reports of all the configs after the last event.
+    int64_t dumpTimeNs = 0;
+    size_t dumpBytes = 0;
+};
+
+// Replays [events] through a new StatsLogProcessor running [configs]. The configs are added at
+// the time of the first event, and the events drive a simulated clock: the anomaly and periodic
+// alarms fire as the events reach their time. The pull alarm isn't simulated, so that the replay
+// only depends on its input.
+ReplayResult ReplayLogEvents(const std::vector<StatsdConfig>& configs,
+                             const std::vector<std::unique_ptr<LogEvent>>& events,
+                             bool measureStages);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "logd/LogEvent.h"
+#include "metric_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::vector;
+
+// Atom ids that are never logged in these benchmarks.
+static const int kFirstUnusedAtomId = 100000;
+
+// Creates a config that counts screen on events, plus one count metric for each of
+// `matcherCount` other atoms.
+static StatsdConfig CreateManyMatchersConfig(int configIndex, int matcherCount) {
+    StatsdConfig config;
+    config.set_id(configIndex);
+    config.add_allowed_log_source("AID_ROOT");  // LogEvent defaults to UID of root.
+
+    auto screenOnMatcher = CreateScreenTurnedOnAtomMatcher();
+    *config.add_atom_matcher() = screenOnMatcher;
+    auto screenOnMetric = config.add_count_metric();
+    screenOnMetric->set_id(StringToId("ScreenOnCount"));
+    screenOnMetric->set_what(screenOnMatcher.id());
+    screenOnMetric->set_bucket(FIVE_MINUTES);
+
+    for (int i = 0; i < matcherCount; i++) {
+        const std::string name = "Unused" + std::to_string(i);
+        auto matcher = CreateSimpleAtomMatcher(name, kFirstUnusedAtomId + i);
+        *config.add_atom_matcher() = matcher;
+
+        auto metric = config.add_count_metric();
+        metric->set_id(StringToId(name + "Count"));
+        metric->set_what(matcher.id());
+        metric->set_bucket(FIVE_MINUTES);
+    }
+    return config;
+}
+
+// Measures the cost of processing one event with range(0) configs of range(1) matchers each, of
+// which only one per config matches the event.
+static void BM_ManyMatchers(benchmark::State& state) {
+    const int configCount = state.range(0);
+    const int matcherCount = state.range(1);
+    const long timeBaseSec = 1;
+
+    auto processor = CreateStatsLogProcessor(
+            timeBaseSec, CreateManyMatchersConfig(0, matcherCount), ConfigKey(0, 0));
+    for (int i = 1; i < configCount; i++) {
+        processor->OnConfigUpdated(timeBaseSec * NS_PER_SEC, ConfigKey(0, i),
+                                   CreateManyMatchersConfig(i, matcherCount));
+    }
+
+    // Stay within the first bucket, so that the benchmark doesn't measure bucket flushes.
+    std::unique_ptr<LogEvent> event = CreateScreenStateChangedEvent(
+            android::view::DisplayStateEnum::DISPLAY_STATE_ON, timeBaseSec * NS_PER_SEC + 1);
+    while (state.KeepRunning()) {
+        processor->OnLogEvent(event.get());
+    }
+}
+BENCHMARK(BM_ManyMatchers)->RangeMultiplier(4)->Ranges({{1, 4}, {1, 256}});
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "log_replay.h"
+#include "metric_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+// Replays a recording instead of the synthetic events when set, e.g.
+//   STATSD_REPLAY_EVENTS=/data/local/tmp/atoms.bin
+//   STATSD_REPLAY_CONFIGS=/data/local/tmp/config1.pb,/data/local/tmp/config2.pb
+static const char* kEventsPathEnv = "STATSD_REPLAY_EVENTS";
+static const char* kConfigPathsEnv = "STATSD_REPLAY_CONFIGS";
+
+static const int kSyntheticUidCount = 50;
+static const int kSyntheticEventCount = 200000;
+
+// Wakelock counts and durations sliced by uid while the screen is off, with an alert on each, so
+// that all the stages have some work.
+static StatsdConfig CreateSyntheticConfig() {
+    StatsdConfig config;
+    config.set_id(StringToId("ReplayConfig"));
+    config.add_allowed_log_source("AID_ROOT");  // LogEvent defaults to UID of root.
+    auto acquireWakelockMatcher = CreateAcquireWakelockAtomMatcher();
+    *config.add_atom_matcher() = acquireWakelockMatcher;
+    *config.add_atom_matcher() = CreateReleaseWakelockAtomMatcher();
+    *config.add_atom_matcher() = CreateScreenTurnedOnAtomMatcher();
+    *config.add_atom_matcher() = CreateScreenTurnedOffAtomMatcher();
+
+    auto screenIsOffPredicate = CreateScreenIsOffPredicate();
+    *config.add_predicate() = screenIsOffPredicate;
+    auto holdingWakelockPredicate = CreateHoldingWakelockPredicate();
+    *holdingWakelockPredicate.mutable_simple_predicate()->mutable_dimensions() =
+            CreateAttributionUidDimensions(android::util::WAKELOCK_STATE_CHANGED,
+                                           {Position::FIRST});
+    *config.add_predicate() = holdingWakelockPredicate;
+
+    auto countMetric = config.add_count_metric();
+    countMetric->set_id(StringToId("WakelockCount"));
+    countMetric->set_what(acquireWakelockMatcher.id());
+    countMetric->set_condition(screenIsOffPredicate.id());
+    *countMetric->mutable_dimensions_in_what() = CreateAttributionUidDimensions(
+            android::util::WAKELOCK_STATE_CHANGED, {Position::FIRST});
+    countMetric->set_bucket(FIVE_MINUTES);
+
+    auto durationMetric = config.add_duration_metric();
+    durationMetric->set_id(StringToId("WakelockDuration"));
+    durationMetric->set_what(holdingWakelockPredicate.id());
+    durationMetric->set_condition(screenIsOffPredicate.id());
+    durationMetric->set_aggregation_type(DurationMetric::SUM);
+    *durationMetric->mutable_dimensions_in_what() = CreateAttributionUidDimensions(
+            android::util::WAKELOCK_STATE_CHANGED, {Position::FIRST});
+    durationMetric->set_bucket(FIVE_MINUTES);
+
+    auto countAlert = config.add_alert();
+    countAlert->set_id(StringToId("WakelockCountAlert"));
+    countAlert->set_metric_id(countMetric->id());
+    countAlert->set_num_buckets(3);
+    countAlert->set_refractory_period_secs(60);
+    countAlert->set_trigger_if_sum_gt(200);
+
+    auto durationAlert = config.add_alert();
+    durationAlert->set_id(StringToId("WakelockDurationAlert"));
+    durationAlert->set_metric_id(durationMetric->id());
+    durationAlert->set_num_buckets(2);
+    durationAlert->set_refractory_period_secs(60);
+    durationAlert->set_trigger_if_sum_gt(60 * NS_PER_SEC);
+    return config;
+}
+
+// About an event every 100ms, so a few hours of device time: each uid acquires and releases its
+// wakelock in turn, and the screen toggles every thousand events.
+static vector<unique_ptr<LogEvent>> CreateSyntheticEvents() {
+    vector<AttributionNodeInternal> attributions;
+    for (int i = 0; i < kSyntheticUidCount; i++) {
+        attributions.push_back(CreateAttribution(10000 + i, "app" + std::to_string(i)));
+    }
+    vector<unique_ptr<LogEvent>> events;
+    events.reserve(kSyntheticEventCount);
+    uint64_t timestampNs = 1000 * NS_PER_SEC;
+    for (int i = 0; i < kSyntheticEventCount; i++) {
+        timestampNs += NS_PER_SEC / 10;
+        if (i % 1000 == 0) {
+            events.push_back(CreateScreenStateChangedEvent(
+                    (i / 1000) % 2 == 0 ? android::view::DisplayStateEnum::DISPLAY_STATE_OFF
+                                        : android::view::DisplayStateEnum::DISPLAY_STATE_ON,
+                    timestampNs));
+            continue;
+        }
+        const int uid = i % kSyntheticUidCount;
+        if ((i / kSyntheticUidCount) % 2 == 0) {
+            events.push_back(CreateAcquireWakelockEvent({attributions[uid]}, "wl", timestampNs));
+        } else {
+            events.push_back(CreateReleaseWakelockEvent({attributions[uid]}, "wl", timestampNs));
+        }
+    }
+    return events;
+}
+
+struct ReplayInput {
+    vector<StatsdConfig> configs;
+    vector<unique_ptr<LogEvent>> events;
+    bool valid = true;
+};
+
+static const ReplayInput& GetReplayInput() {
+    static ReplayInput* input = [] {
+        ReplayInput* input = new ReplayInput();
+        const char* eventsPath = getenv(kEventsPathEnv);
+        const char* configPaths = getenv(kConfigPathsEnv);
+        if (eventsPath == nullptr || configPaths == nullptr) {
+            input->configs.push_back(CreateSyntheticConfig());
+            input->events = CreateSyntheticEvents();
+            return input;
+        }
+        input->valid = ReadRecordedLogEvents(eventsPath, &input->events);
+        std::istringstream paths(configPaths);
+        string path;
+        while (input->valid && std::getline(paths, path, ',')) {
+            StatsdConfig config;
+            input->valid = ReadStatsdConfig(path, &config);
+            input->configs.push_back(config);
+        }
+        return input;
+    }();
+    return *input;
+}
+
+static void BM_Replay(benchmark::State& state) {
+    const ReplayInput& input = GetReplayInput();
+    if (!input.valid || input.events.empty()) {
+        state.SkipWithError("Can't read the recorded events or configs");
+        return;
+    }
+    ReplayResult result;
+    while (state.KeepRunning()) {
+        result = ReplayLogEvents(input.configs, input.events, false /* measureStages */);
+        state.SetIterationTime(result.processingTimeNs / (double)NS_PER_SEC);
+    }
+    state.SetItemsProcessed(state.iterations() * result.eventCount);
+    state.counters["metrics_bytes"] = result.metricsBytes;
+    state.counters["peak_rss_kb"] = result.peakRssKb;
+    state.counters["dump_us"] = result.dumpTimeNs / 1000;
+    state.counters["dump_bytes"] = result.dumpBytes;
+}
+// Only the processing of the events is timed, not creating the processor or dumping the reports.
+BENCHMARK(BM_Replay)->UseManualTime()->Unit(benchmark::kMillisecond);
+
+// The CPU time of each stage of the processing, in a separate run as the stage timers add their
+// own overhead. "other_ms" is the rest of the processing, e.g. the socket-facing checks and the
+// alarms that aren't part of a stage.
+static void BM_ReplayStages(benchmark::State& state) {
+    const ReplayInput& input = GetReplayInput();
+    if (!input.valid || input.events.empty()) {
+        state.SkipWithError("Can't read the recorded events or configs");
+        return;
+    }
+    ReplayResult result;
+    while (state.KeepRunning()) {
+        result = ReplayLogEvents(input.configs, input.events, true /* measureStages */);
+    }
+    int64_t stagesCpuTimeNs = 0;
+    for (int64_t stageCpuTimeNs : result.stageCpuTimeNs) {
+        stagesCpuTimeNs += stageCpuTimeNs;
+    }
+    state.counters["matching_ms"] = result.stageCpuTimeNs[PROCESSING_STAGE_MATCHING] / 1000000;
+    state.counters["condition_ms"] = result.stageCpuTimeNs[PROCESSING_STAGE_CONDITION] / 1000000;
+    state.counters["metrics_ms"] = result.stageCpuTimeNs[PROCESSING_STAGE_METRICS] / 1000000;
+    state.counters["anomaly_ms"] = result.stageCpuTimeNs[PROCESSING_STAGE_ANOMALY] / 1000000;
+    state.counters["other_ms"] = (result.processingCpuTimeNs - stagesCpuTimeNs) / 1000000;
+}
+BENCHMARK(BM_ReplayStages)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
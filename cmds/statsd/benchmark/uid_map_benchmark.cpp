@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "logd/LogEvent.h"
+#include "matchers/matcher_util.h"
+#include "metric_util.h"
+#include "packages/UidMap.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::string;
+using std::vector;
+
+// About the number of packages of a device, with some uids sharing packages.
+static const int kPackageCount = 400;
+static const int kUidCount = 300;
+
+static void CreateUidMap(UidMap* uidMap) {
+    vector<int32_t> uids;
+    vector<int64_t> versions;
+    vector<String16> apps;
+    for (int i = 0; i < kPackageCount; i++) {
+        uids.push_back(10000 + i % kUidCount);
+        versions.push_back(1);
+        apps.push_back(String16(("com.Example.App" + std::to_string(i)).c_str()));
+    }
+    uidMap->updateMap(1, uids, versions, apps);
+}
+
+// Matches the wakelocks of a package, by the uid of their first attribution node.
+static SimpleAtomMatcher CreatePackageWakelockMatcher(const string& packageName) {
+    SimpleAtomMatcher matcher;
+    matcher.set_atom_id(android::util::WAKELOCK_STATE_CHANGED);
+    auto attributionMatcher = matcher.add_field_value_matcher();
+    attributionMatcher->set_field(1);  // The attribution chain.
+    attributionMatcher->set_position(Position::FIRST);
+    auto uidMatcher = attributionMatcher->mutable_matches_tuple()->add_field_value_matcher();
+    uidMatcher->set_field(1);  // The uid of the attribution node.
+    uidMatcher->set_eq_string(packageName);
+    return matcher;
+}
+
+static void BM_MatchUidToPackage(benchmark::State& state) {
+    UidMap uidMap;
+    CreateUidMap(&uidMap);
+    const SimpleAtomMatcher matcher = CreatePackageWakelockMatcher("com.example.app42");
+    vector<std::unique_ptr<LogEvent>> events;
+    for (int i = 0; i < kUidCount; i++) {
+        events.push_back(
+                CreateAcquireWakelockEvent({CreateAttribution(10000 + i, "tag")}, "wl", i));
+    }
+    int matched = 0;
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        matched += matchesSimple(uidMap, matcher, *events[i]);
+        i = (i + 1) % events.size();
+    }
+    state.counters["matched"] = matched;
+}
+BENCHMARK(BM_MatchUidToPackage);
+
+// The lookup that the matchers used to do, for comparison.
+static void BM_GetAppNamesFromUid(benchmark::State& state) {
+    UidMap uidMap;
+    CreateUidMap(&uidMap);
+    const string packageName = "com.example.app42";
+    int matched = 0;
+    int uid = 0;
+    while (state.KeepRunning()) {
+        std::set<string> packageNames =
+                uidMap.getAppNamesFromUid(10000 + uid, true /* returnNormalized */);
+        matched += packageNames.find(packageName) != packageNames.end();
+        uid = (uid + 1) % kUidCount;
+    }
+    state.counters["matched"] = matched;
+}
+BENCHMARK(BM_GetAppNamesFromUid);
+
+static void BM_HasNormalizedApp(benchmark::State& state) {
+    UidMap uidMap;
+    CreateUidMap(&uidMap);
+    const string packageName = "com.example.app42";
+    int matched = 0;
+    int uid = 0;
+    while (state.KeepRunning()) {
+        matched += uidMap.hasNormalizedApp(10000 + uid, packageName);
+        uid = (uid + 1) % kUidCount;
+    }
+    state.counters["matched"] = matched;
+}
+BENCHMARK(BM_HasNormalizedApp);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
@@ -28,35 +28,42 @@ namespace statsd {
 using std::string;
 using std::vector;
 
-android::hash_t hashDimension(const HashableDimensionKey& value) {
-    android::hash_t hash = 0;
-    for (const auto& fieldValue : value.getValues()) {
-        hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getField()));
-        hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getTag()));
-        hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mValue.getType()));
-        switch (fieldValue.mValue.getType()) {
-            case INT:
-                hash = android::JenkinsHashMix(hash,
-                                               android::hash_type(fieldValue.mValue.int_value));
-                break;
-            case LONG:
-                hash = android::JenkinsHashMix(hash,
-                                               android::hash_type(fieldValue.mValue.long_value));
-                break;
-            case STRING:
-                hash = android::JenkinsHashMix(hash, static_cast<uint32_t>(std::hash<std::string>()(
-                                                             fieldValue.mValue.str_value)));
-                break;
-            case FLOAT: {
-                hash = android::JenkinsHashMix(hash,
-                                               android::hash_type(fieldValue.mValue.float_value));
-                break;
-            }
-            default:
-                break;
+static android::hash_t mixFieldValue(android::hash_t hash, const FieldValue& fieldValue) {
+    hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getField()));
+    hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getTag()));
+    hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mValue.getType()));
+    switch (fieldValue.mValue.getType()) {
+        case INT:
+            hash = android::JenkinsHashMix(hash, android::hash_type(fieldValue.mValue.int_value));
+            break;
+        case LONG:
+            hash = android::JenkinsHashMix(hash, android::hash_type(fieldValue.mValue.long_value));
+            break;
+        case STRING:
+            hash = android::JenkinsHashMix(hash, static_cast<uint32_t>(std::hash<std::string>()(
+                                                         fieldValue.mValue.str_value)));
+            break;
+        case FLOAT: {
+            hash = android::JenkinsHashMix(hash,
+                                           android::hash_type(fieldValue.mValue.float_value));
+            break;
         }
+        default:
+            break;
+    }
+    return hash;
+}
+
+static android::hash_t mixFieldValues(const vector<FieldValue>& values) {
+    android::hash_t hash = 0;
+    for (const auto& fieldValue : values) {
+        hash = mixFieldValue(hash, fieldValue);
     }
-    return JenkinsHashWhiten(hash);
+    return hash;
+}
+
+android::hash_t hashDimension(const HashableDimensionKey& value) {
+    return JenkinsHashWhiten(mixFieldValues(value.getValues()));
 }
 
 bool filterValues(const vector<Matcher>& matcherFields, const vector<FieldValue>& values,
@@ -68,10 +75,9 @@ bool filterValues(const vector<Matcher>& matcherFields, const vector<FieldValue>
             // TODO: potential optimization here to break early because all fields are naturally
             // sorted.
             if (value.mField.matches(matcher)) {
-                output->addValue(value);
-                output->mutableValue(num_matches)->mField.setTag(value.mField.getTag());
-                output->mutableValue(num_matches)->mField.setField(
-                    value.mField.getField() & matcher.mMask);
+                FieldValue match = value;
+                match.mField.setField(value.mField.getField() & matcher.mMask);
+                output->addValue(match);
                 num_matches++;
             }
         }
@@ -102,12 +108,13 @@ void getDimensionForCondition(const std::vector<FieldValue>& eventValues,
         return;
     }
 
+    // The values are replaced all at once, so that the key is hashed once.
+    vector<FieldValue> values = conditionDimension->getValues();
     for (size_t i = 0; i < count; i++) {
-        conditionDimension->mutableValue(i)->mField.setField(
-            links.conditionFields[i].mMatcher.getField());
-        conditionDimension->mutableValue(i)->mField.setTag(
-            links.conditionFields[i].mMatcher.getTag());
+        values[i].mField.setField(links.conditionFields[i].mMatcher.getField());
+        values[i].mField.setTag(links.conditionFields[i].mMatcher.getTag());
     }
+    *conditionDimension = HashableDimensionKey(values);
 }
 
 bool LessThan(const vector<FieldValue>& s1, const vector<FieldValue>& s2) {
@@ -124,10 +131,30 @@ bool LessThan(const vector<FieldValue>& s1, const vector<FieldValue>& s2) {
     return false;
 }
 
+HashableDimensionKey::HashableDimensionKey(const vector<FieldValue>& values)
+    : mValues(values), mMixedHash(mixFieldValues(values)) {
+}
+
+void HashableDimensionKey::addValue(const FieldValue& value) {
+    mValues.push_back(value);
+    mMixedHash = mixFieldValue(mMixedHash, value);
+}
+
+void HashableDimensionKey::setValue(size_t i, const FieldValue& value) {
+    if (i < mValues.size()) {
+        mValues[i] = value;
+        mMixedHash = mixFieldValues(mValues);
+    }
+}
+
 bool HashableDimensionKey::operator==(const HashableDimensionKey& that) const {
     if (mValues.size() != that.getValues().size()) {
         return false;
     }
+    // Most keys that hash maps compare are different, which the hashes tell without the values.
+    if (mMixedHash != that.mMixedHash) {
+        return false;
+    }
     size_t count = mValues.size();
     for (size_t i = 0; i < count; i++) {
         if (mValues[i] != (that.getValues())[i]) {
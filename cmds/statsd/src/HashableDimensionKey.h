@@ -34,33 +34,38 @@ struct Metric2Condition {
     std::vector<Matcher> conditionFields;
 };
 
+class HashableDimensionKey;
+
+android::hash_t hashDimension(const HashableDimensionKey& key);
+
+/**
+ * The values of a dimension. The hash of the values is kept with them and updated as they are set,
+ * so that a key is hashed once no matter how many maps it is looked up in, and keys with different
+ * hashes are told apart without comparing their values. The values only change through the
+ * methods below, and the const ones write nothing, so a key can be read by several threads.
+ */
 class HashableDimensionKey {
 public:
-    explicit HashableDimensionKey(const std::vector<FieldValue>& values) {
-        mValues = values;
-    }
+    explicit HashableDimensionKey(const std::vector<FieldValue>& values);
 
     HashableDimensionKey() {};
 
-    HashableDimensionKey(const HashableDimensionKey& that) : mValues(that.getValues()){};
+    HashableDimensionKey(const HashableDimensionKey& that)
+        : mValues(that.getValues()), mMixedHash(that.mMixedHash){};
 
-    inline void addValue(const FieldValue& value) {
-        mValues.push_back(value);
-    }
+    HashableDimensionKey& operator=(const HashableDimensionKey& from) = default;
+
+    void addValue(const FieldValue& value);
+
+    // Replaces the i-th value, if there is one.
+    void setValue(size_t i, const FieldValue& value);
 
     inline const std::vector<FieldValue>& getValues() const {
         return mValues;
     }
 
-    inline std::vector<FieldValue>* mutableValues() {
-        return &mValues;
-    }
-
-    inline FieldValue* mutableValue(size_t i) {
-        if (i >= 0 && i < mValues.size()) {
-            return &(mValues[i]);
-        }
-        return nullptr;
+    inline android::hash_t getHash() const {
+        return android::JenkinsHashWhiten(mMixedHash);
     }
 
     std::string toString() const;
@@ -73,6 +78,9 @@ public:
 
 private:
     std::vector<FieldValue> mValues;
+
+    // The hash of mValues before whitening, so that addValue() only mixes in the new value.
+    android::hash_t mMixedHash = 0;
 };
 
 class MetricDimensionKey {
@@ -117,8 +125,6 @@ class MetricDimensionKey {
       HashableDimensionKey mDimensionKeyInCondition;
 };
 
-android::hash_t hashDimension(const HashableDimensionKey& key);
-
 /**
  * Creating HashableDimensionKeys from FieldValues using matcher.
  *
@@ -157,15 +163,15 @@ using android::os::statsd::MetricDimensionKey;
 template <>
 struct hash<HashableDimensionKey> {
     std::size_t operator()(const HashableDimensionKey& key) const {
-        return hashDimension(key);
+        return key.getHash();
     }
 };
 
 template <>
 struct hash<MetricDimensionKey> {
     std::size_t operator()(const MetricDimensionKey& key) const {
-        android::hash_t hash = hashDimension(key.getDimensionKeyInWhat());
-        hash = android::JenkinsHashMix(hash, hashDimension(key.getDimensionKeyInCondition()));
+        android::hash_t hash = key.getDimensionKeyInWhat().getHash();
+        hash = android::JenkinsHashMix(hash, key.getDimensionKeyInCondition().getHash());
         return android::JenkinsHashWhiten(hash);
     }
 };
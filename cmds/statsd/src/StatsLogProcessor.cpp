@@ -33,6 +33,10 @@
 #include <utils/Errors.h>
 #include <utils/SystemClock.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 using namespace android;
 using android::base::StringPrintf;
 using android::util::FIELD_COUNT_REPEATED;
@@ -69,11 +73,12 @@ const int FIELD_ID_STRINGS = 9;
 
 #define NS_PER_HOUR 3600 * NS_PER_SEC
 
-#define STATS_DATA_DIR "/data/misc/stats-data"
-
 // Cool down period for writing data to disk to avoid overwriting files.
 #define WRITE_DATA_COOL_DOWN_SEC 5
 
+// The maximum number of threads encoding the reports written to disk.
+#define MAX_REPORT_THREADS 4
+
 StatsLogProcessor::StatsLogProcessor(const sp<UidMap>& uidMap,
                                      const sp<AlarmMonitor>& anomalyAlarmMonitor,
                                      const sp<AlarmMonitor>& periodicAlarmMonitor,
@@ -180,8 +185,15 @@ void StatsLogProcessor::resetConfigsLocked(const int64_t timestampNs) {
 }
 
 void StatsLogProcessor::OnLogEvent(LogEvent* event, bool reconnected) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        OnLogEventLocked(event, reconnected);
+    }
+    // The configs reset while processing the event had their data queued for disk.
+    writeQueuedReportsToDisk();
+}
 
+void StatsLogProcessor::OnLogEventLocked(LogEvent* event, bool reconnected) {
 #ifdef VERY_VERBOSE_PRINTING
     if (mPrintAllLogs) {
         ALOGI("%s", event->ToString().c_str());
@@ -260,9 +272,12 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, bool reconnected) {
 
 void StatsLogProcessor::OnConfigUpdated(const int64_t timestampNs, const ConfigKey& key,
                                         const StatsdConfig& config) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
-    WriteDataToDiskLocked(key, timestampNs, CONFIG_UPDATED);
-    OnConfigUpdatedLocked(timestampNs, key, config);
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        WriteDataToDiskLocked(key, timestampNs, CONFIG_UPDATED);
+        OnConfigUpdatedLocked(timestampNs, key, config);
+    }
+    writeQueuedReportsToDisk();
 }
 
 void StatsLogProcessor::OnConfigUpdatedLocked(
@@ -312,8 +327,6 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
                                      const bool include_current_partial_bucket,
                                      const DumpReportReason dumpReportReason,
                                      vector<uint8_t>* outData) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
-
     ProtoOutputStream proto;
 
     // Start of ConfigKey.
@@ -323,25 +336,49 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
     proto.end(configKeyToken);
     // End of ConfigKey.
 
-    // Then, check stats-data directory to see there's any file containing
-    // ConfigMetricsReport from previous shutdowns to concatenate to reports.
-    StorageManager::appendConfigMetricsReport(key, &proto);
-
-    auto it = mMetricsManagers.find(key);
-    if (it != mMetricsManagers.end()) {
-        // This allows another broadcast to be sent within the rate-limit period if we get close to
-        // filling the buffer again soon.
-        mLastBroadcastTimes.erase(key);
+    // Only moving the data out of the metrics holds the lock. It's encoded once the lock is
+    // released, so that the events aren't held up by the report.
+    PreparedConfigReport report;
+    bool hasReport = false;
+    {
+        std::unique_lock<std::mutex> lock(mMetricsMutex);
+        // The reports moved out of the metrics but not on disk yet would be missing from the
+        // dump. Waiting for them releases mMetricsMutex, so the events keep being processed.
+        mDiskWritesDone.wait(lock, [this] {
+            return mQueuedDiskReports.empty() && mDiskWritesInProgress == 0;
+        });
+
+        // Then, check stats-data directory to see there's any file containing
+        // ConfigMetricsReport from previous shutdowns to concatenate to reports.
+        {
+            // No write is in progress, so this doesn't wait.
+            std::lock_guard<std::mutex> storageLock(mStorageMutex);
+            StorageManager::appendConfigMetricsReport(key, &proto);
+        }
+        // Some of the reports may have been unreadable.
+        resetUidMapOfLostReports();
+
+        auto it = mMetricsManagers.find(key);
+        if (it != mMetricsManagers.end()) {
+            // This allows another broadcast to be sent within the rate-limit period if we get
+            // close to filling the buffer again soon.
+            mLastBroadcastTimes.erase(key);
+
+            prepareConfigMetricsReportLocked(key, dumpTimeStampNs, include_current_partial_bucket,
+                                             dumpReportReason, &report);
+            hasReport = true;
+        } else {
+            ALOGW("Config source %s does not exist", key.ToString().c_str());
+        }
+    }
 
+    if (hasReport) {
         // Start of ConfigMetricsReport (reports).
         uint64_t reportsToken =
                 proto.start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS);
-        onConfigMetricsReportLocked(key, dumpTimeStampNs, include_current_partial_bucket,
-                                    dumpReportReason, &proto);
+        writeConfigMetricsReport(report, &proto);
         proto.end(reportsToken);
         // End of ConfigMetricsReport (reports).
-    } else {
-        ALOGW("Config source %s does not exist", key.ToString().c_str());
     }
 
     if (outData != nullptr) {
@@ -361,52 +398,61 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
 }
 
 /*
- * onConfigMetricsReportLocked dumps serialized ConfigMetricsReport into outData.
+ * prepareConfigMetricsReportLocked moves the data of a ConfigMetricsReport out of the metrics.
  */
-void StatsLogProcessor::onConfigMetricsReportLocked(const ConfigKey& key,
-                                                    const int64_t dumpTimeStampNs,
-                                                    const bool include_current_partial_bucket,
-                                                    const DumpReportReason dumpReportReason,
-                                                    ProtoOutputStream* proto) {
-    // We already checked whether key exists in mMetricsManagers in
-    // WriteDataToDisk.
-    auto it = mMetricsManagers.find(key);
-    if (it == mMetricsManagers.end()) {
-        return;
-    }
-    int64_t lastReportTimeNs = it->second->getLastReportTimeNs();
-    int64_t lastReportWallClockNs = it->second->getLastReportWallClockNs();
+void StatsLogProcessor::prepareConfigMetricsReportLocked(const ConfigKey& key,
+                                                         const int64_t dumpTimeStampNs,
+                                                         const bool include_current_partial_bucket,
+                                                         const DumpReportReason dumpReportReason,
+                                                         PreparedConfigReport* report) {
+    // The callers already checked whether key exists in mMetricsManagers.
+    const sp<MetricsManager>& metricsManager = mMetricsManagers.find(key)->second;
+    report->key = key;
+    report->metricsManager = metricsManager;
+    report->dumpTimeStampNs = dumpTimeStampNs;
+    report->lastReportTimeNs = metricsManager->getLastReportTimeNs();
+    report->lastReportWallClockNs = metricsManager->getLastReportWallClockNs();
+    report->dumpReportReason = dumpReportReason;
+    report->metricReports =
+            metricsManager->prepareDumpReport(dumpTimeStampNs, include_current_partial_bucket);
+}
+
+/*
+ * writeConfigMetricsReport dumps serialized ConfigMetricsReport into proto.
+ */
+void StatsLogProcessor::writeConfigMetricsReport(const PreparedConfigReport& report,
+                                                 ProtoOutputStream* proto) {
+    const sp<MetricsManager>& metricsManager = report.metricsManager;
 
     std::set<string> str_set;
 
-    // First, fill in ConfigMetricsReport using current data on memory, which
+    // First, fill in ConfigMetricsReport using the data moved out of the metrics, which
     // starts from filling in StatsLogReport's.
-    it->second->onDumpReport(dumpTimeStampNs, include_current_partial_bucket,
-                             &str_set, proto);
+    metricsManager->writeDumpReport(report.metricReports, &str_set, proto);
 
     // Fill in UidMap if there is at least one metric to report.
     // This skips the uid map if it's an empty config.
-    if (it->second->getNumMetrics() > 0) {
+    if (metricsManager->getNumMetrics() > 0) {
         uint64_t uidMapToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP);
-        if (it->second->hashStringInReport()) {
-            mUidMap->appendUidMap(dumpTimeStampNs, key, &str_set, proto);
+        if (metricsManager->hashStringInReport()) {
+            mUidMap->appendUidMap(report.dumpTimeStampNs, report.key, &str_set, proto);
         } else {
-            mUidMap->appendUidMap(dumpTimeStampNs, key, nullptr, proto);
+            mUidMap->appendUidMap(report.dumpTimeStampNs, report.key, nullptr, proto);
         }
         proto->end(uidMapToken);
     }
 
     // Fill in the timestamps.
     proto->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
-                (long long)lastReportTimeNs);
+                (long long)report.lastReportTimeNs);
     proto->write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
-                (long long)dumpTimeStampNs);
+                (long long)report.dumpTimeStampNs);
     proto->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
-                (long long)lastReportWallClockNs);
+                (long long)report.lastReportWallClockNs);
     proto->write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
                 (long long)getWallClockNs());
     // Dump report reason
-    proto->write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
+    proto->write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, report.dumpReportReason);
 
     for (const auto& str : str_set) {
         proto->write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
@@ -444,7 +490,14 @@ void StatsLogProcessor::resetIfConfigTtlExpiredLocked(const int64_t timestampNs)
 }
 
 void StatsLogProcessor::OnConfigRemoved(const ConfigKey& key) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        OnConfigRemovedLocked(key);
+    }
+    writeQueuedReportsToDisk();
+}
+
+void StatsLogProcessor::OnConfigRemovedLocked(const ConfigKey& key) {
     auto it = mMetricsManagers.find(key);
     if (it != mMetricsManagers.end()) {
         WriteDataToDiskLocked(key, getElapsedRealtimeNs(), CONFIG_REMOVED);
@@ -476,6 +529,7 @@ void StatsLogProcessor::flushIfNecessaryLocked(
     if (totalBytes >
         StatsdStats::kMaxMetricsBytesPerConfig) {  // Too late. We need to start clearing data.
         metricsManager.dropData(timestampNs);
+        mUidMap->OnConfigDataLost(key);
         StatsdStats::getInstance().noteDataDropped(key);
         VLOG("StatsD had to toss out metrics for %s", key.ToString().c_str());
     } else if ((totalBytes > StatsdStats::kBytesPerConfigTriggerGetData) ||
@@ -504,6 +558,60 @@ void StatsLogProcessor::flushIfNecessaryLocked(
     }
 }
 
+vector<ConfigKey> StatsLogProcessor::writeReportsToDisk(
+        const vector<PreparedConfigReport>& reports) {
+    // The reports trimmed since the last write mustn't be the base of the uid maps encoded here.
+    resetUidMapOfLostReports();
+
+    // Each report is encoded into its own buffer, by a few threads taking the next report to
+    // encode until there is none left.
+    vector<unique_ptr<ProtoOutputStream>> protos(reports.size());
+    std::atomic<size_t> nextReport(0);
+    auto encodeReports = [this, &reports, &protos, &nextReport] {
+        for (size_t i = nextReport++; i < reports.size(); i = nextReport++) {
+            protos[i] = make_unique<ProtoOutputStream>();
+            writeConfigMetricsReport(reports[i], protos[i].get());
+        }
+    };
+    const size_t threadCount = std::min(reports.size(), (size_t)MAX_REPORT_THREADS);
+    vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(encodeReports);
+    }
+    encodeReports();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // All the reports go to disk in one segment, synced once.
+    vector<ConfigKey> writtenKeys;
+    vector<std::pair<ConfigKey, ProtoOutputStream*>> segment;
+    for (size_t i = 0; i < reports.size(); i++) {
+        segment.emplace_back(reports[i].key, protos[i].get());
+    }
+    {
+        std::lock_guard<std::mutex> storageLock(mStorageMutex);
+        if (StorageManager::writeConfigMetricsReports(segment)) {
+            for (const auto& report : reports) {
+                writtenKeys.push_back(report.key);
+            }
+        } else {
+            for (const auto& report : reports) {
+                mUidMap->OnConfigDataLost(report.key);
+            }
+        }
+    }
+    // Writing the segment may have trimmed older ones.
+    resetUidMapOfLostReports();
+    return writtenKeys;
+}
+
+void StatsLogProcessor::resetUidMapOfLostReports() {
+    for (const ConfigKey& key : StorageManager::takeConfigsWithLostReports()) {
+        mUidMap->OnConfigDataLost(key);
+    }
+}
+
 void StatsLogProcessor::WriteDataToDiskLocked(const ConfigKey& key,
                                               const int64_t timestampNs,
                                               const DumpReportReason dumpReportReason) {
@@ -511,23 +619,13 @@ void StatsLogProcessor::WriteDataToDiskLocked(const ConfigKey& key,
         !mMetricsManagers.find(key)->second->shouldWriteToDisk()) {
         return;
     }
-    ProtoOutputStream proto;
-    onConfigMetricsReportLocked(key, timestampNs, true /* include_current_partial_bucket*/,
-                                dumpReportReason, &proto);
-    string file_name = StringPrintf("%s/%ld_%d_%lld", STATS_DATA_DIR,
-         (long)getWallClockSec(), key.GetUid(), (long long)key.GetId());
-    android::base::unique_fd fd(open(file_name.c_str(),
-                                O_WRONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR));
-    if (fd == -1) {
-        ALOGE("Attempt to write %s but failed", file_name.c_str());
-        return;
-    }
-    proto.flush(fd.get());
-    // We were able to write the ConfigMetricsReport to disk, so we should trigger collection ASAP.
-    mOnDiskDataConfigs.insert(key);
+    mQueuedDiskReports.emplace_back();
+    prepareConfigMetricsReportLocked(key, timestampNs, true /* include_current_partial_bucket*/,
+                                     dumpReportReason, &mQueuedDiskReports.back());
 }
 
-void StatsLogProcessor::WriteDataToDiskLocked(const DumpReportReason dumpReportReason) {
+void StatsLogProcessor::prepareDataToDiskLocked(const DumpReportReason dumpReportReason,
+                                                vector<PreparedConfigReport>* reports) {
     const int64_t timeNs = getElapsedRealtimeNs();
     // Do not write to disk if we already have in the last few seconds.
     // This is to avoid overwriting files that would have the same name if we
@@ -540,13 +638,49 @@ void StatsLogProcessor::WriteDataToDiskLocked(const DumpReportReason dumpReportR
     }
     mLastWriteTimeNs = timeNs;
     for (auto& pair : mMetricsManagers) {
-        WriteDataToDiskLocked(pair.first, timeNs, dumpReportReason);
+        if (!pair.second->shouldWriteToDisk()) {
+            continue;
+        }
+        reports->emplace_back();
+        prepareConfigMetricsReportLocked(pair.first, timeNs,
+                                         true /* include_current_partial_bucket*/,
+                                         dumpReportReason, &reports->back());
     }
 }
 
+void StatsLogProcessor::WriteDataToDiskLocked(const DumpReportReason dumpReportReason) {
+    prepareDataToDiskLocked(dumpReportReason, &mQueuedDiskReports);
+}
+
 void StatsLogProcessor::WriteDataToDisk(const DumpReportReason dumpReportReason) {
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        WriteDataToDiskLocked(dumpReportReason);
+    }
+    writeQueuedReportsToDisk();
+}
+
+void StatsLogProcessor::writeQueuedReportsToDisk() {
+    // The reports are encoded and written without holding mMetricsMutex, so that the events keep
+    // being processed meanwhile.
+    vector<PreparedConfigReport> reports;
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        if (mQueuedDiskReports.empty()) {
+            return;
+        }
+        reports.swap(mQueuedDiskReports);
+        mDiskWritesInProgress++;
+    }
+    const vector<ConfigKey> writtenKeys = writeReportsToDisk(reports);
+
     std::lock_guard<std::mutex> lock(mMetricsMutex);
-    WriteDataToDiskLocked(dumpReportReason);
+    // If we were able to write the ConfigMetricsReport to disk, we should trigger collection ASAP.
+    for (const ConfigKey& key : writtenKeys) {
+        mOnDiskDataConfigs.insert(key);
+    }
+    mDiskWritesInProgress--;
+    mDiskWritesDone.notify_all();
 }
 
 void StatsLogProcessor::informPullAlarmFired(const int64_t timestampNs) {
@@ -26,7 +26,11 @@
 #include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
 
 #include <stdio.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 namespace os {
@@ -115,6 +119,11 @@ private:
 
     mutable mutex mMetricsMutex;
 
+    // Guards the reports in the stats-data directory, so that a report isn't read while it's
+    // written. It's never waited on while holding mMetricsMutex: a dump only takes it once no
+    // write is queued or in progress.
+    mutable mutex mStorageMutex;
+
     std::unordered_map<ConfigKey, sp<MetricsManager>> mMetricsManagers;
 
     std::unordered_map<ConfigKey, long> mLastBroadcastTimes;
@@ -135,17 +144,65 @@ private:
 
     void resetIfConfigTtlExpiredLocked(const int64_t timestampNs);
 
+    void OnLogEventLocked(LogEvent* event, bool reconnectionStarts);
+
+    void OnConfigRemovedLocked(const ConfigKey& key);
+
     void OnConfigUpdatedLocked(
         const int64_t currentTimestampNs, const ConfigKey& key, const StatsdConfig& config);
 
+    // Queues the reports to write to disk, see writeQueuedReportsToDisk().
     void WriteDataToDiskLocked(const DumpReportReason dumpReportReason);
     void WriteDataToDiskLocked(const ConfigKey& key, const int64_t timestampNs,
                                const DumpReportReason dumpReportReason);
 
-    void onConfigMetricsReportLocked(const ConfigKey& key, const int64_t dumpTimeStampNs,
-                                     const bool include_current_partial_bucket,
-                                     const DumpReportReason dumpReportReason,
-                                     util::ProtoOutputStream* proto);
+    // Encodes and writes the queued reports to disk. Must be called without mMetricsMutex, after
+    // anything that may have queued reports.
+    void writeQueuedReportsToDisk();
+
+    // The data of a ConfigMetricsReport, moved out of its MetricsManager under mMetricsMutex, so
+    // that it can be encoded once the lock is released.
+    struct PreparedConfigReport {
+        ConfigKey key;
+        sp<MetricsManager> metricsManager;
+        std::vector<std::unique_ptr<PreparedDumpReport>> metricReports;
+        int64_t dumpTimeStampNs;
+        int64_t lastReportTimeNs;
+        int64_t lastReportWallClockNs;
+        DumpReportReason dumpReportReason;
+    };
+
+    void prepareConfigMetricsReportLocked(const ConfigKey& key, const int64_t dumpTimeStampNs,
+                                          const bool include_current_partial_bucket,
+                                          const DumpReportReason dumpReportReason,
+                                          PreparedConfigReport* report);
+
+    // The reports prepared under mMetricsMutex, to be encoded and written to disk once it's
+    // released, by writeQueuedReportsToDisk(). Guarded by mMetricsMutex, as are the two below.
+    std::vector<PreparedConfigReport> mQueuedDiskReports;
+
+    // The number of writeQueuedReportsToDisk() calls encoding or writing reports.
+    int mDiskWritesInProgress = 0;
+
+    // Notified, with mMetricsMutex, when a write is done.
+    std::condition_variable mDiskWritesDone;
+
+    // Writes a prepared report to [proto] as a ConfigMetricsReport. Doesn't need mMetricsMutex.
+    void writeConfigMetricsReport(const PreparedConfigReport& report,
+                                  util::ProtoOutputStream* proto);
+
+    // Prepares the reports of the configs that write to disk, unless data was written to disk in
+    // the cool down period.
+    void prepareDataToDiskLocked(const DumpReportReason dumpReportReason,
+                                 std::vector<PreparedConfigReport>* reports);
+
+    // Encodes the reports in parallel and writes them to disk. Doesn't need mMetricsMutex.
+    // Returns the configs whose report was written.
+    std::vector<ConfigKey> writeReportsToDisk(const std::vector<PreparedConfigReport>& reports);
+
+    // Makes the next report of the configs whose reports were lost on disk carry a full uid map
+    // snapshot, as the snapshot they were missing may be among the lost ones.
+    void resetUidMapOfLostReports();
 
     /* Check if we should send a broadcast if approaching memory limits and if we're over, we
      * actually delete the data. */
@@ -195,6 +252,7 @@ private:
     FRIEND_TEST(StatsLogProcessorTest, TestRateLimitByteSize);
     FRIEND_TEST(StatsLogProcessorTest, TestRateLimitBroadcast);
     FRIEND_TEST(StatsLogProcessorTest, TestDropWhenByteSizeTooLarge);
+    FRIEND_TEST(StatsLogProcessorTest, TestDumpReportWaitsForDiskWriteWithoutBlockingEvents);
     FRIEND_TEST(WakelockDurationE2eTest, TestAggregatedPredicateDimensionsForSumDuration1);
     FRIEND_TEST(WakelockDurationE2eTest, TestAggregatedPredicateDimensionsForSumDuration2);
     FRIEND_TEST(WakelockDurationE2eTest, TestAggregatedPredicateDimensionsForSumDuration3);
@@ -32,7 +32,15 @@ AlarmMonitor::AlarmMonitor(
       mUpdateAlarm(updateAlarm),
       mCancelAlarm(cancelAlarm) {}
 
-AlarmMonitor::~AlarmMonitor() {}
+AlarmMonitor::~AlarmMonitor() {
+    // Releases the references held by the wheel. mExpiredAlarms may still hold the alarms of the
+    // last popSoonerThan(), which were already released.
+    std::vector<const AlarmTimerWheelNode*> alarms;
+    mAlarms.popSoonerThan(UINT32_MAX, &alarms);
+    for (const AlarmTimerWheelNode* node : alarms) {
+        static_cast<const InternalAlarm*>(node)->decStrong(this);
+    }
+}
 
 void AlarmMonitor::setStatsCompanionService(sp<IStatsCompanionService> statsCompanionService) {
     std::lock_guard<std::mutex> lock(mLock);
@@ -43,9 +51,8 @@ void AlarmMonitor::setStatsCompanionService(sp<IStatsCompanionService> statsComp
         return;
     }
     VLOG("Creating link to statsCompanionService");
-    const sp<const InternalAlarm> top = mPq.top();
-    if (top != nullptr) {
-        updateRegisteredAlarmTime_l(top->timestampSec);
+    if (!mAlarms.empty()) {
+        updateRegisteredAlarmTime_l(mAlarms.getSoonestAlarmTimeSec());
     }
 }
 
@@ -62,7 +69,10 @@ void AlarmMonitor::add(sp<const InternalAlarm> alarm) {
     }
     // TODO: Ensure that refractory period is respected.
     VLOG("Adding alarm with time %u", alarm->timestampSec);
-    mPq.push(alarm);
+    if (!mAlarms.arm(alarm.get(), alarm->timestampSec)) {
+        return;
+    }
+    alarm->incStrong(this);
     if (mRegisteredAlarmTimeSec < 1 ||
         alarm->timestampSec + mMinUpdateTimeSec < mRegisteredAlarmTimeSec) {
         updateRegisteredAlarmTime_l(alarm->timestampSec);
@@ -76,21 +86,22 @@ void AlarmMonitor::remove(sp<const InternalAlarm> alarm) {
         return;
     }
     VLOG("Removing alarm with time %u", alarm->timestampSec);
-    bool wasPresent = mPq.remove(alarm);
+    bool wasPresent = mAlarms.cancel(alarm.get());
     if (!wasPresent) return;
-    if (mPq.empty()) {
+    alarm->decStrong(this);
+    if (mAlarms.empty()) {
         VLOG("Queue is empty. Cancel any alarm.");
         cancelRegisteredAlarmTime_l();
         return;
     }
-    uint32_t soonestAlarmTimeSec = mPq.top()->timestampSec;
+    uint32_t soonestAlarmTimeSec = mAlarms.getSoonestAlarmTimeSec();
     VLOG("Soonest alarm is %u", soonestAlarmTimeSec);
     if (soonestAlarmTimeSec > mRegisteredAlarmTimeSec + mMinUpdateTimeSec) {
         updateRegisteredAlarmTime_l(soonestAlarmTimeSec);
     }
 }
 
-// More efficient than repeatedly calling remove(mPq.top()) since it batches the
+// More efficient than repeatedly calling remove() on the soonest alarm since it batches the
 // updates to the registered alarm.
 unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>> AlarmMonitor::popSoonerThan(
         uint32_t timestampSec) {
@@ -98,19 +109,21 @@ unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>> AlarmMonitor::popS
     unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>> oldAlarms;
     std::lock_guard<std::mutex> lock(mLock);
 
-    for (sp<const InternalAlarm> t = mPq.top(); t != nullptr && t->timestampSec <= timestampSec;
-        t = mPq.top()) {
-        oldAlarms.insert(t);
-        mPq.pop();  // remove t
+    mExpiredAlarms.clear();
+    mAlarms.popSoonerThan(timestampSec, &mExpiredAlarms);
+    for (const AlarmTimerWheelNode* node : mExpiredAlarms) {
+        const InternalAlarm* alarm = static_cast<const InternalAlarm*>(node);
+        oldAlarms.insert(alarm);
+        alarm->decStrong(this);  // The reference of the wheel, now held by oldAlarms.
     }
     // Always update registered alarm time (if anything has changed).
     if (!oldAlarms.empty()) {
-        if (mPq.empty()) {
+        if (mAlarms.empty()) {
             VLOG("Queue is empty. Cancel any alarm.");
             cancelRegisteredAlarmTime_l();
         } else {
             // Always update the registered alarm in this case (unlike remove()).
-            updateRegisteredAlarmTime_l(mPq.top()->timestampSec);
+            updateRegisteredAlarmTime_l(mAlarms.getSoonestAlarmTimeSec());
         }
     }
     return oldAlarms;
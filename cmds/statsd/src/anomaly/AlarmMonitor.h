@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "anomaly/AlarmTimerWheel.h"
 #include "anomaly/indexed_priority_queue.h"
 
 #include <android/os/IStatsCompanionService.h>
@@ -40,8 +41,9 @@ namespace statsd {
  * projected time at which the metric is expected to exceed its anomaly
  * threshold.
  * Timestamps are in seconds since epoch in a uint32, so will fail in year 2106.
+ * The alarm carries its own links in the AlarmMonitor, so adding and removing it doesn't allocate.
  */
-struct InternalAlarm : public RefBase {
+struct InternalAlarm : public RefBase, public AlarmTimerWheelNode {
     InternalAlarm(uint32_t timestampSec) : timestampSec(timestampSec) {
     }
 
@@ -112,15 +114,19 @@ private:
     /**
      * Timestamp (seconds since epoch) of the alarm registered with
      * StatsCompanionService. This, in general, may not be equal to the soonest
-     * alarm stored in mPq, but should be within minUpdateTimeSec of it.
+     * alarm stored in mAlarms, but should be within minUpdateTimeSec of it.
      * A value of 0 indicates that no alarm is currently registered.
      */
     uint32_t mRegisteredAlarmTimeSec;
 
     /**
-     * Priority queue of alarms, prioritized by soonest alarm.timestampSec.
+     * Timer wheel of the alarms, by alarm.timestampSec. It holds a strong reference to each of its
+     * alarms.
      */
-    indexed_priority_queue<InternalAlarm, InternalAlarm::SmallerTimestamp> mPq;
+    AlarmTimerWheel mAlarms;
+
+    // The alarms popped from mAlarms, kept to reuse its allocation.
+    std::vector<const AlarmTimerWheelNode*> mExpiredAlarms;
 
     /**
      * Binder interface for communicating with StatsCompanionService.
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "anomaly/AlarmTimerWheel.h"
+
+#include <string.h>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::vector;
+
+AlarmTimerWheel::AlarmTimerWheel() {
+    memset(mSlots, 0, sizeof(mSlots));
+    memset(mOccupiedSlots, 0, sizeof(mOccupiedSlots));
+    memset(mSlotSoonestTimeSec, 0, sizeof(mSlotSoonestTimeSec));
+    memset(mValidSlotSoonestTimes, 0, sizeof(mValidSlotSoonestTimes));
+}
+
+bool AlarmTimerWheel::arm(const AlarmTimerWheelNode* alarm, uint32_t timeSec) {
+    if (alarm->wheel != nullptr) {
+        return false;
+    }
+    alarm->wheel = this;
+    alarm->timeSec = timeSec;
+    link(alarm);
+    mSize++;
+    if (mSoonestAlarmTimeValid && (mSize == 1 || timeSec < mSoonestAlarmTimeSec)) {
+        mSoonestAlarmTimeSec = timeSec;
+    }
+    return true;
+}
+
+bool AlarmTimerWheel::cancel(const AlarmTimerWheelNode* alarm) {
+    if (alarm->wheel != this) {
+        return false;
+    }
+    unlink(alarm);
+    alarm->wheel = nullptr;
+    mSize--;
+    if (mSize == 0) {
+        mSoonestAlarmTimeSec = 0;
+        mSoonestAlarmTimeValid = true;
+    } else if (alarm->timeSec == mSoonestAlarmTimeSec) {
+        mSoonestAlarmTimeValid = false;
+    }
+    return true;
+}
+
+void AlarmTimerWheel::popSoonerThan(uint32_t timeSec, vector<const AlarmTimerWheelNode*>* expired) {
+    const size_t expiredCount = expired->size();
+
+    // The alarms armed in the past expire whether or not the wheel moves.
+    for (const AlarmTimerWheelNode* alarm = mDueAlarms; alarm != nullptr;) {
+        const AlarmTimerWheelNode* next = alarm->next;
+        if (alarm->timeSec <= timeSec) {
+            unlink(alarm);
+            alarm->wheel = nullptr;
+            mSize--;
+            expired->push_back(alarm);
+        }
+        alarm = next;
+    }
+
+    if (timeSec > mNowSec) {
+        const uint32_t previousNowSec = mNowSec;
+        mNowSec = timeSec;
+        // From the highest level, so that the alarms moved to a lower level are handled there.
+        for (int level = kLevelCount - 1; level >= 0; level--) {
+            if (mOccupiedSlots[level] == 0) {
+                continue;
+            }
+            const int shift = level * kSlotBits;
+            const int higherLevelsShift = shift + kSlotBits;
+            uint64_t slots;
+            if (higherLevelsShift < 32 &&
+                (previousNowSec >> higherLevelsShift) != (timeSec >> higherLevelsShift)) {
+                // The wheel moved past all the slots of this level.
+                slots = mOccupiedSlots[level];
+            } else {
+                // The wheel moved up to the slot of its new time in this level.
+                const int nowSlot = (timeSec >> shift) & (kSlotCount - 1);
+                slots = mOccupiedSlots[level] & (~0ULL >> (kSlotCount - 1 - nowSlot));
+            }
+            while (slots != 0) {
+                const int slot = __builtin_ctzll(slots);
+                slots &= slots - 1;
+                cascade(level, slot, expired);
+            }
+        }
+    }
+
+    if (mSize == 0) {
+        mSoonestAlarmTimeSec = 0;
+        mSoonestAlarmTimeValid = true;
+    } else if (expired->size() > expiredCount) {
+        mSoonestAlarmTimeValid = false;
+    }
+}
+
+uint32_t AlarmTimerWheel::getSoonestAlarmTimeSec() {
+    if (mSoonestAlarmTimeValid) {
+        return mSoonestAlarmTimeSec;
+    }
+    uint32_t soonestAlarmTimeSec = 0;
+    if (mDueAlarms != nullptr) {
+        soonestAlarmTimeSec = mDueAlarms->timeSec;
+        for (const AlarmTimerWheelNode* alarm = mDueAlarms->next; alarm != nullptr;
+             alarm = alarm->next) {
+            if (alarm->timeSec < soonestAlarmTimeSec) {
+                soonestAlarmTimeSec = alarm->timeSec;
+            }
+        }
+    } else {
+        // The alarms of a lower level, and then of a lower slot, are sooner: they share more of
+        // their higher digits with the time of the wheel.
+        for (int level = 0; level < kLevelCount; level++) {
+            if (mOccupiedSlots[level] != 0) {
+                soonestAlarmTimeSec =
+                        getSlotSoonestAlarmTimeSec(level, __builtin_ctzll(mOccupiedSlots[level]));
+                break;
+            }
+        }
+    }
+    mSoonestAlarmTimeSec = soonestAlarmTimeSec;
+    mSoonestAlarmTimeValid = true;
+    return soonestAlarmTimeSec;
+}
+
+uint32_t AlarmTimerWheel::getSlotSoonestAlarmTimeSec(int level, int slot) {
+    const uint64_t slotBit = 1ULL << slot;
+    if ((mValidSlotSoonestTimes[level] & slotBit) == 0) {
+        const AlarmTimerWheelNode* alarm = mSlots[level][slot];
+        uint32_t soonestAlarmTimeSec = alarm->timeSec;
+        for (alarm = alarm->next; alarm != nullptr; alarm = alarm->next) {
+            if (alarm->timeSec < soonestAlarmTimeSec) {
+                soonestAlarmTimeSec = alarm->timeSec;
+            }
+        }
+        mSlotSoonestTimeSec[level][slot] = soonestAlarmTimeSec;
+        mValidSlotSoonestTimes[level] |= slotBit;
+    }
+    return mSlotSoonestTimeSec[level][slot];
+}
+
+void AlarmTimerWheel::link(const AlarmTimerWheelNode* alarm) {
+    const AlarmTimerWheelNode** head;
+    if (alarm->timeSec <= mNowSec) {
+        alarm->level = kDueLevel;
+        alarm->slot = 0;
+        head = &mDueAlarms;
+    } else {
+        // The highest bit in which the time of the alarm differs from the time of the wheel.
+        const int highestBit = 31 - __builtin_clz(alarm->timeSec ^ mNowSec);
+        alarm->level = highestBit / kSlotBits;
+        alarm->slot = (alarm->timeSec >> (alarm->level * kSlotBits)) & (kSlotCount - 1);
+        head = &mSlots[alarm->level][alarm->slot];
+        const uint64_t slotBit = 1ULL << alarm->slot;
+        uint32_t& slotSoonestTimeSec = mSlotSoonestTimeSec[alarm->level][alarm->slot];
+        if (*head == nullptr) {
+            mOccupiedSlots[alarm->level] |= slotBit;
+            mValidSlotSoonestTimes[alarm->level] |= slotBit;
+            slotSoonestTimeSec = alarm->timeSec;
+        } else if (alarm->timeSec < slotSoonestTimeSec) {
+            slotSoonestTimeSec = alarm->timeSec;
+        }
+    }
+    alarm->prev = nullptr;
+    alarm->next = *head;
+    if (*head != nullptr) {
+        (*head)->prev = alarm;
+    }
+    *head = alarm;
+}
+
+void AlarmTimerWheel::unlink(const AlarmTimerWheelNode* alarm) {
+    const AlarmTimerWheelNode** head =
+            alarm->level == kDueLevel ? &mDueAlarms : &mSlots[alarm->level][alarm->slot];
+    if (alarm->prev != nullptr) {
+        alarm->prev->next = alarm->next;
+    } else {
+        *head = alarm->next;
+    }
+    if (alarm->next != nullptr) {
+        alarm->next->prev = alarm->prev;
+    }
+    alarm->prev = nullptr;
+    alarm->next = nullptr;
+    if (alarm->level != kDueLevel) {
+        const uint64_t slotBit = 1ULL << alarm->slot;
+        if (*head == nullptr) {
+            mOccupiedSlots[alarm->level] &= ~slotBit;
+        } else if (alarm->timeSec == mSlotSoonestTimeSec[alarm->level][alarm->slot]) {
+            mValidSlotSoonestTimes[alarm->level] &= ~slotBit;
+        }
+    }
+}
+
+void AlarmTimerWheel::cascade(int level, int slot, vector<const AlarmTimerWheelNode*>* expired) {
+    const AlarmTimerWheelNode* alarm = mSlots[level][slot];
+    mSlots[level][slot] = nullptr;
+    mOccupiedSlots[level] &= ~(1ULL << slot);
+    while (alarm != nullptr) {
+        const AlarmTimerWheelNode* next = alarm->next;
+        if (alarm->timeSec <= mNowSec) {
+            alarm->wheel = nullptr;
+            alarm->prev = nullptr;
+            alarm->next = nullptr;
+            mSize--;
+            expired->push_back(alarm);
+        } else {
+            link(alarm);
+        }
+        alarm = next;
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+class AlarmTimerWheel;
+
+/**
+ * The links of an alarm in an AlarmTimerWheel, meant to be a base of the alarm, so that arming and
+ * cancelling an alarm doesn't allocate. The links are mutable, as they belong to the wheel rather
+ * than to the alarm. An alarm can only be in one wheel at a time.
+ */
+struct AlarmTimerWheelNode {
+    mutable const AlarmTimerWheel* wheel = nullptr;
+    mutable const AlarmTimerWheelNode* prev = nullptr;
+    mutable const AlarmTimerWheelNode* next = nullptr;
+    mutable uint32_t timeSec = 0;
+    mutable uint8_t level = 0;
+    mutable uint8_t slot = 0;
+};
+
+/**
+ * Hierarchical timing wheel of alarms, with timestamps in seconds.
+ *
+ * Each level has 64 slots, a slot of a level spanning the 64 slots of the level below it, and 6
+ * levels cover the 32 bits of the timestamps. An alarm is linked in the slot of the highest
+ * 6-bit digit in which its time differs from the time of the wheel, so arming and cancelling an
+ * alarm is O(1). When the wheel moves forward, the alarms of the slots that the time of the wheel
+ * reaches are either expired or moved to a lower level, so each alarm moves at most 5 times.
+ *
+ * Alarms sooner than or at the time of the wheel are kept on their own list, and expire at the
+ * next popSoonerThan() reaching them.
+ *
+ * Not thread safe.
+ */
+class AlarmTimerWheel {
+public:
+    AlarmTimerWheel();
+
+    /**
+     * Arms the alarm at timeSec. Returns false, and does nothing, if the alarm is already armed.
+     */
+    bool arm(const AlarmTimerWheelNode* alarm, uint32_t timeSec);
+
+    /**
+     * Cancels the alarm. Returns false, and does nothing, if the alarm isn't armed in this wheel.
+     */
+    bool cancel(const AlarmTimerWheelNode* alarm);
+
+    /**
+     * Moves the wheel forward to timeSec, and removes the alarms whose time <= timeSec into
+     * [expired]. The wheel never moves back, but the alarms armed in the past still only expire
+     * when timeSec reaches them.
+     */
+    void popSoonerThan(uint32_t timeSec, std::vector<const AlarmTimerWheelNode*>* expired);
+
+    /**
+     * Returns the time of the soonest alarm, or 0 if there is none. It is O(1) unless the soonest
+     * alarm was cancelled since the last call, or was armed in the past.
+     */
+    uint32_t getSoonestAlarmTimeSec();
+
+    size_t size() const {
+        return mSize;
+    }
+
+    bool empty() const {
+        return mSize == 0;
+    }
+
+private:
+    static const int kSlotBits = 6;
+    static const int kSlotCount = 1 << kSlotBits;
+    static const int kLevelCount = 6;
+    // The level of the alarms that are due.
+    static const int kDueLevel = kLevelCount;
+
+    // Links the alarm in the slot for its time, relatively to mNowSec.
+    void link(const AlarmTimerWheelNode* alarm);
+    void unlink(const AlarmTimerWheelNode* alarm);
+
+    // Unlinks the alarms of a slot, expiring the ones whose time <= mNowSec and linking the others
+    // again.
+    void cascade(int level, int slot, std::vector<const AlarmTimerWheelNode*>* expired);
+
+    uint32_t getSlotSoonestAlarmTimeSec(int level, int slot);
+
+    // The time the wheel has moved forward to.
+    uint32_t mNowSec = 0;
+
+    // The alarms of each slot, and which slots of each level have alarms.
+    const AlarmTimerWheelNode* mSlots[kLevelCount][kSlotCount];
+    uint64_t mOccupiedSlots[kLevelCount];
+
+    // The time of the soonest alarm of each slot, for the slots whose bit is set in
+    // mValidSlotSoonestTimes. It is invalidated when that alarm is cancelled.
+    uint32_t mSlotSoonestTimeSec[kLevelCount][kSlotCount];
+    uint64_t mValidSlotSoonestTimes[kLevelCount];
+
+    // The alarms whose time was <= mNowSec when they were armed.
+    const AlarmTimerWheelNode* mDueAlarms = nullptr;
+
+    size_t mSize = 0;
+
+    // The time of the soonest alarm, if mSoonestAlarmTimeValid.
+    uint32_t mSoonestAlarmTimeSec = 0;
+    bool mSoonestAlarmTimeValid = true;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
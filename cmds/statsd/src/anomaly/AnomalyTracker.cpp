@@ -20,6 +20,7 @@
 #include "AnomalyTracker.h"
 #include "subscriber_util.h"
 #include "external/Perfetto.h"
+#include "guardrail/ProcessingStageTimer.h"
 #include "guardrail/StatsdStats.h"
 #include "subscriber/IncidentdReporter.h"
 #include "subscriber/SubscriberReporter.h"
@@ -93,6 +94,7 @@ void AnomalyTracker::advanceMostRecentBucketTo(const int64_t& bucketNum) {
 void AnomalyTracker::addPastBucket(const MetricDimensionKey& key,
                                    const int64_t& bucketValue,
                                    const int64_t& bucketNum) {
+    ScopedProcessingStageTimer timer(PROCESSING_STAGE_ANOMALY);
     VLOG("addPastBucket(bucketValue) called.");
     if (mNumOfPastBuckets == 0 ||
         bucketNum < 0 || bucketNum <= mMostRecentBucketNum - mNumOfPastBuckets) {
@@ -122,6 +124,7 @@ void AnomalyTracker::addPastBucket(const MetricDimensionKey& key,
 
 void AnomalyTracker::addPastBucket(std::shared_ptr<DimToValMap> bucket,
                                    const int64_t& bucketNum) {
+    ScopedProcessingStageTimer timer(PROCESSING_STAGE_ANOMALY);
     VLOG("addPastBucket(bucket) called.");
     if (mNumOfPastBuckets == 0 ||
             bucketNum < 0 || bucketNum <= mMostRecentBucketNum - mNumOfPastBuckets) {
@@ -239,6 +242,7 @@ void AnomalyTracker::detectAndDeclareAnomaly(const int64_t& timestampNs,
                                              const int64_t& currBucketNum,
                                              const MetricDimensionKey& key,
                                              const int64_t& currentBucketValue) {
+    ScopedProcessingStageTimer timer(PROCESSING_STAGE_ANOMALY);
     if (detectAnomaly(currBucketNum, key, currentBucketValue)) {
         declareAnomaly(timestampNs, key);
     }
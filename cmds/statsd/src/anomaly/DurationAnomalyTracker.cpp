@@ -18,6 +18,7 @@
 #include "Log.h"
 
 #include "DurationAnomalyTracker.h"
+#include "guardrail/ProcessingStageTimer.h"
 #include "guardrail/StatsdStats.h"
 
 namespace android {
@@ -37,6 +38,7 @@ DurationAnomalyTracker::~DurationAnomalyTracker() {
 
 void DurationAnomalyTracker::startAlarm(const MetricDimensionKey& dimensionKey,
                                         const int64_t& timestampNs) {
+    ScopedProcessingStageTimer timer(PROCESSING_STAGE_ANOMALY);
     // Alarms are stored in secs. Must round up, since if it fires early, it is ignored completely.
     uint32_t timestampSec = static_cast<uint32_t>((timestampNs -1) / NS_PER_SEC) + 1; // round up
     if (isInRefractoryPeriod(timestampNs, dimensionKey)) {
@@ -58,6 +60,7 @@ void DurationAnomalyTracker::startAlarm(const MetricDimensionKey& dimensionKey,
 
 void DurationAnomalyTracker::stopAlarm(const MetricDimensionKey& dimensionKey,
                                        const int64_t& timestampNs) {
+    ScopedProcessingStageTimer timer(PROCESSING_STAGE_ANOMALY);
     const auto itr = mAlarms.find(dimensionKey);
     if (itr == mAlarms.end()) {
         return;
@@ -23,6 +23,8 @@
 #include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
 #include "stats_util.h"
 
+#include <unordered_map>
+
 namespace android {
 namespace os {
 namespace statsd {
@@ -123,7 +125,9 @@ private:
 
     int mDimensionTag;
 
-    std::map<HashableDimensionKey, int> mSlicedConditionState;
+    // Hashed rather than ordered: the keys are looked up for every event, and never iterated in
+    // order.
+    std::unordered_map<HashableDimensionKey, int> mSlicedConditionState;
 
     void handleStopAll(std::vector<ConditionState>& conditionCache,
                        std::vector<bool>& changedCache);
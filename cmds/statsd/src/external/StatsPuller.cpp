@@ -55,7 +55,9 @@ bool StatsPuller::Pull(const int64_t elapsedTimeNs, std::vector<std::shared_ptr<
     }
     mCachedData.clear();
     mLastPullTimeNs = elapsedTimeNs;
+    const int64_t pullStartNs = getElapsedRealtimeNs();
     bool ret = PullInternal(&mCachedData);
+    StatsdStats::getInstance().notePullLatency(mTagId, getElapsedRealtimeNs() - pullStartNs);
     for (const shared_ptr<LogEvent>& data : mCachedData) {
         data->setElapsedTimestampNs(elapsedTimeNs);
         data->setLogdWallClockTimestampNs(wallClockTimeNs);
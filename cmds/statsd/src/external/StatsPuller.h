@@ -69,7 +69,7 @@ private:
     // cached data will be returned.
     std::vector<std::shared_ptr<LogEvent>> mCachedData;
 
-    int64_t mLastPullTimeNs;
+    int64_t mLastPullTimeNs = 0;
 
     int clearCache();
 
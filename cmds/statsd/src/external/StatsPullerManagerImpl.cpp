@@ -22,6 +22,7 @@
 #include <math.h>
 #include <stdint.h>
 #include <algorithm>
+#include <thread>
 #include "../StatsService.h"
 #include "../logd/LogEvent.h"
 #include "../stats_log_util.h"
@@ -41,6 +42,7 @@ using std::shared_ptr;
 using std::string;
 using std::vector;
 using std::list;
+using std::chrono::steady_clock;
 
 namespace android {
 namespace os {
@@ -173,15 +175,36 @@ const std::map<int, PullAtomInfo> StatsPullerManagerImpl::kAllPullAtomInfo = {
         // temperature
         {android::util::TEMPERATURE, {{}, {}, 1, new ResourceThermalManagerPuller()}}};
 
-StatsPullerManagerImpl::StatsPullerManagerImpl() : mNextPullTimeNs(NO_ALARM_UPDATE) {
+StatsPullerManagerImpl::StatsPullerManagerImpl()
+    : StatsPullerManagerImpl(kAllPullAtomInfo) {
+}
+
+StatsPullerManagerImpl::StatsPullerManagerImpl(const std::map<int, PullAtomInfo>& pullAtomInfo)
+    : mPullAtomInfo(pullAtomInfo),
+      mNextPullTimeNs(NO_ALARM_UPDATE),
+      mSoonestPullTimeNs(NO_ALARM_UPDATE) {
+    for (int i = 0; i < kPullThreadCount; i++) {
+        mPullThreads.emplace_back(&StatsPullerManagerImpl::pullLoop, this);
+    }
+}
+
+StatsPullerManagerImpl::~StatsPullerManagerImpl() {
+    {
+        std::lock_guard<std::mutex> lock(mPullLock);
+        mStopPulling = true;
+    }
+    mPullCondition.notify_all();
+    for (auto& thread : mPullThreads) {
+        thread.join();
+    }
 }
 
 bool StatsPullerManagerImpl::Pull(const int tagId, const int64_t timeNs,
                                   vector<shared_ptr<LogEvent>>* data) {
     VLOG("Initiating pulling %d", tagId);
 
-    if (kAllPullAtomInfo.find(tagId) != kAllPullAtomInfo.end()) {
-        bool ret = kAllPullAtomInfo.find(tagId)->second.puller->Pull(timeNs, data);
+    if (mPullAtomInfo.find(tagId) != mPullAtomInfo.end()) {
+        bool ret = mPullAtomInfo.find(tagId)->second.puller->Pull(timeNs, data);
         VLOG("pulled %d items", (int)data->size());
         return ret;
     } else {
@@ -196,7 +219,7 @@ StatsPullerManagerImpl& StatsPullerManagerImpl::GetInstance() {
 }
 
 bool StatsPullerManagerImpl::PullerForMatcherExists(int tagId) const {
-    return kAllPullAtomInfo.find(tagId) != kAllPullAtomInfo.end();
+    return mPullAtomInfo.find(tagId) != mPullAtomInfo.end();
 }
 
 void StatsPullerManagerImpl::updateAlarmLocked() {
@@ -219,7 +242,7 @@ void StatsPullerManagerImpl::SetStatsCompanionService(
     AutoMutex _l(mLock);
     sp<IStatsCompanionService> tmpForLock = mStatsCompanionService;
     mStatsCompanionService = statsCompanionService;
-    for (const auto& pulledAtom : kAllPullAtomInfo) {
+    for (const auto& pulledAtom : mPullAtomInfo) {
         pulledAtom.second.puller->SetStatsCompanionService(statsCompanionService);
     }
     if (mStatsCompanionService != nullptr) {
@@ -253,10 +276,15 @@ void StatsPullerManagerImpl::RegisterReceiver(int tagId, wp<PullDataReceiver> re
     receiverInfo.nextPullTimeNs = nextPullTimeNs;
     receivers.push_back(receiverInfo);
 
-    // There is only one alarm for all pulled events. So only set it to the smallest denom.
-    if (nextPullTimeNs < mNextPullTimeNs) {
-        VLOG("Updating next pull time %lld", (long long)mNextPullTimeNs);
-        mNextPullTimeNs = nextPullTimeNs;
+    // There is only one alarm for all pulled events. So only set it to the smallest denom, and the
+    // receivers coalesced with it.
+    if (nextPullTimeNs < mSoonestPullTimeNs) {
+        mSoonestPullTimeNs = nextPullTimeNs;
+    }
+    const int64_t coalescedPullTimeNs = getCoalescedPullTimeLocked(mSoonestPullTimeNs);
+    if (coalescedPullTimeNs != mNextPullTimeNs) {
+        VLOG("Updating next pull time %lld", (long long)coalescedPullTimeNs);
+        mNextPullTimeNs = coalescedPullTimeNs;
         updateAlarmLocked();
     }
     VLOG("Puller for tagId %d registered of %d", tagId, (int)receivers.size());
@@ -279,61 +307,174 @@ void StatsPullerManagerImpl::UnRegisterReceiver(int tagId, wp<PullDataReceiver>
 }
 
 void StatsPullerManagerImpl::OnAlarmFired(const int64_t currentTimeNs) {
-    AutoMutex _l(mLock);
-
-    int64_t minNextPullTimeNs = NO_ALARM_UPDATE;
-
-    vector<pair<int, vector<ReceiverInfo*>>> needToPull =
-            vector<pair<int, vector<ReceiverInfo*>>>();
-    for (auto& pair : mReceivers) {
-        vector<ReceiverInfo*> receivers = vector<ReceiverInfo*>();
-        if (pair.second.size() != 0) {
-            for (ReceiverInfo& receiverInfo : pair.second) {
+    // The receivers that are due, by atom. They're looked up again once the pulls are done, as
+    // mLock isn't held while waiting for them.
+    vector<pair<int, vector<wp<PullDataReceiver>>>> needToPull;
+    vector<shared_ptr<PullTask>> pullTasks;
+    {
+        AutoMutex _l(mLock);
+        for (const auto& pair : mReceivers) {
+            vector<wp<PullDataReceiver>> receivers;
+            for (const ReceiverInfo& receiverInfo : pair.second) {
                 if (receiverInfo.nextPullTimeNs <= currentTimeNs) {
-                    receivers.push_back(&receiverInfo);
-                } else {
-                    if (receiverInfo.nextPullTimeNs < minNextPullTimeNs) {
-                        minNextPullTimeNs = receiverInfo.nextPullTimeNs;
-                    }
+                    receivers.push_back(receiverInfo.receiver);
                 }
             }
             if (receivers.size() > 0) {
                 needToPull.push_back(make_pair(pair.first, receivers));
             }
         }
+
+        // All the receivers of an atom share one pull, and the atoms are pulled concurrently so
+        // that a slow puller doesn't hold back the others.
+        for (const auto& pullInfo : needToPull) {
+            pullTasks.push_back(startPull(pullInfo.first, currentTimeNs));
+        }
     }
 
-    for (const auto& pullInfo : needToPull) {
-        vector<shared_ptr<LogEvent>> data;
-        if (Pull(pullInfo.first, currentTimeNs, &data)) {
-            for (const auto& receiverInfo : pullInfo.second) {
-                sp<PullDataReceiver> receiverPtr = receiverInfo->receiver.promote();
-                if (receiverPtr != nullptr) {
-                    receiverPtr->onDataPulled(data);
-                    // we may have just come out of a coma, compute next pull time
-                    receiverInfo->nextPullTimeNs =
-                            (currentTimeNs - receiverInfo->nextPullTimeNs) /
-                                receiverInfo->intervalNs * receiverInfo->intervalNs +
-                            receiverInfo->intervalNs + receiverInfo->nextPullTimeNs;
-                    if (receiverInfo->nextPullTimeNs < minNextPullTimeNs) {
-                        minNextPullTimeNs = receiverInfo->nextPullTimeNs;
-                    }
-                } else {
-                    VLOG("receiver already gone.");
-                }
+    vector<vector<shared_ptr<LogEvent>>> pulledData(needToPull.size());
+    vector<bool> pulled(needToPull.size());
+    for (size_t i = 0; i < needToPull.size(); i++) {
+        pulled[i] = waitForPull(pullTasks[i], &pulledData[i]);
+    }
+
+    AutoMutex _l(mLock);
+    for (size_t i = 0; i < needToPull.size(); i++) {
+        if (!pulled[i]) {
+            continue;
+        }
+        auto& receivers = mReceivers[needToPull[i].first];
+        for (const auto& receiver : needToPull[i].second) {
+            auto receiverInfo = std::find_if(
+                    receivers.begin(), receivers.end(),
+                    [&receiver](const ReceiverInfo& info) { return info.receiver == receiver; });
+            if (receiverInfo == receivers.end()) {
+                VLOG("receiver unregistered during the pull.");
+                continue;
+            }
+            sp<PullDataReceiver> receiverPtr = receiver.promote();
+            if (receiverPtr != nullptr) {
+                receiverPtr->onDataPulled(pulledData[i]);
+                // we may have just come out of a coma, compute next pull time
+                receiverInfo->nextPullTimeNs =
+                        (currentTimeNs - receiverInfo->nextPullTimeNs) /
+                            receiverInfo->intervalNs * receiverInfo->intervalNs +
+                        receiverInfo->intervalNs + receiverInfo->nextPullTimeNs;
+            } else {
+                VLOG("receiver already gone.");
+            }
+        }
+    }
+
+    // The receivers that are still due, as their pull timed out, was still in flight or failed,
+    // are retried once the coalescing window passed, instead of setting the alarm in the past.
+    int64_t minNextPullTimeNs = NO_ALARM_UPDATE;
+    for (const auto& pair : mReceivers) {
+        for (const ReceiverInfo& receiverInfo : pair.second) {
+            const int64_t nextPullTimeNs = receiverInfo.nextPullTimeNs > currentTimeNs
+                                                   ? receiverInfo.nextPullTimeNs
+                                                   : currentTimeNs + kPullCoalesceWindowNs;
+            if (nextPullTimeNs < minNextPullTimeNs) {
+                minNextPullTimeNs = nextPullTimeNs;
             }
         }
     }
 
+    const int64_t coalescedPullTimeNs = getCoalescedPullTimeLocked(minNextPullTimeNs);
     VLOG("mNextPullTimeNs: %lld updated to %lld", (long long)mNextPullTimeNs,
-         (long long)minNextPullTimeNs);
-    mNextPullTimeNs = minNextPullTimeNs;
+         (long long)coalescedPullTimeNs);
+    mSoonestPullTimeNs = minNextPullTimeNs;
+    mNextPullTimeNs = coalescedPullTimeNs;
     updateAlarmLocked();
 }
 
+shared_ptr<StatsPullerManagerImpl::PullTask> StatsPullerManagerImpl::startPull(int tagId,
+                                                                               int64_t timeNs) {
+    shared_ptr<PullTask> task = make_shared<PullTask>();
+    task->tagId = tagId;
+    task->timeNs = timeNs;
+    const auto it = mPullAtomInfo.find(tagId);
+    if (it == mPullAtomInfo.end()) {
+        VLOG("Unknown tagId %d", tagId);
+        task->done = true;
+        return task;
+    }
+    task->deadline = steady_clock::now() + std::chrono::nanoseconds(it->second.pullTimeoutNs);
+    // The task holds a reference to the puller, so that a pull that times out can finish after
+    // the alarm stopped waiting for it.
+    task->puller = it->second.puller;
+
+    std::lock_guard<std::mutex> lock(mPullLock);
+    if (!mPullsInFlight.insert(tagId).second) {
+        ALOGW("Pull of atom %d still in progress, skipping it", tagId);
+        task->done = true;
+        return task;
+    }
+    mPullQueue.push_back(task);
+    mPullCondition.notify_one();
+    return task;
+}
+
+void StatsPullerManagerImpl::pullLoop() {
+    std::unique_lock<std::mutex> pullLock(mPullLock);
+    while (true) {
+        mPullCondition.wait(pullLock, [this] { return mStopPulling || !mPullQueue.empty(); });
+        if (mStopPulling) {
+            return;
+        }
+        shared_ptr<PullTask> task = mPullQueue.front();
+        mPullQueue.pop_front();
+        pullLock.unlock();
+
+        vector<shared_ptr<LogEvent>> data;
+        const bool success = task->puller->Pull(task->timeNs, &data);
+        {
+            std::lock_guard<std::mutex> lock(task->lock);
+            task->success = success;
+            task->data.swap(data);
+            task->done = true;
+            task->doneCondition.notify_all();
+        }
+
+        pullLock.lock();
+        mPullsInFlight.erase(task->tagId);
+    }
+}
+
+bool StatsPullerManagerImpl::waitForPull(const shared_ptr<PullTask>& task,
+                                         vector<shared_ptr<LogEvent>>* data) {
+    std::unique_lock<std::mutex> lock(task->lock);
+    if (!task->doneCondition.wait_until(lock, task->deadline, [&task] { return task->done; })) {
+        ALOGW("Pull of atom %d timed out", task->tagId);
+        StatsdStats::getInstance().notePullTimeout(task->tagId);
+        return false;
+    }
+    VLOG("pulled %d items", (int)task->data.size());
+    data->swap(task->data);
+    return task->success;
+}
+
+int64_t StatsPullerManagerImpl::getCoalescedPullTimeLocked(int64_t soonestPullTimeNs) const {
+    if (soonestPullTimeNs == NO_ALARM_UPDATE) {
+        return NO_ALARM_UPDATE;
+    }
+    // Pulling a receiver a little after its bucket ends is fine, as for a late alarm, but pulling
+    // it before would miss the end of the bucket. So the alarm is for the latest of the pull times.
+    int64_t pullTimeNs = soonestPullTimeNs;
+    for (const auto& pair : mReceivers) {
+        for (const ReceiverInfo& receiverInfo : pair.second) {
+            if (receiverInfo.nextPullTimeNs > pullTimeNs &&
+                receiverInfo.nextPullTimeNs <= soonestPullTimeNs + kPullCoalesceWindowNs) {
+                pullTimeNs = receiverInfo.nextPullTimeNs;
+            }
+        }
+    }
+    return pullTimeNs;
+}
+
 int StatsPullerManagerImpl::ForceClearPullerCache() {
     int totalCleared = 0;
-    for (const auto& pulledAtom : kAllPullAtomInfo) {
+    for (const auto& pulledAtom : mPullAtomInfo) {
         totalCleared += pulledAtom.second.puller->ForceClearCache();
     }
     return totalCleared;
@@ -341,7 +482,7 @@ int StatsPullerManagerImpl::ForceClearPullerCache() {
 
 int StatsPullerManagerImpl::ClearPullerCacheIfNecessary(int64_t timestampNs) {
     int totalCleared = 0;
-    for (const auto& pulledAtom : kAllPullAtomInfo) {
+    for (const auto& pulledAtom : mPullAtomInfo) {
         totalCleared += pulledAtom.second.puller->ClearCacheIfNecessary(timestampNs);
     }
     return totalCleared;
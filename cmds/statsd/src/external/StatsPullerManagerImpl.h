@@ -20,7 +20,13 @@
 #include <binder/IServiceManager.h>
 #include <utils/RefBase.h>
 #include <utils/threads.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 #include <list>
@@ -44,6 +50,9 @@ typedef struct {
   int64_t coolDownNs = 1 * NS_PER_SEC;
   // The actual puller
   sp<StatsPuller> puller;
+  // How long the pull alarm waits for a scheduled pull of this atom. A pull that takes longer is
+  // left to finish on its own, and its receivers are pulled again at the next alarm.
+  int64_t pullTimeoutNs = 10 * NS_PER_SEC;
 } PullAtomInfo;
 
 class StatsPullerManagerImpl : public virtual RefBase {
@@ -70,9 +79,51 @@ public:
 
     const static std::map<int, PullAtomInfo> kAllPullAtomInfo;
 
+    // Receivers whose next pull times are within this window of the soonest one are pulled
+    // together, at the latest of their pull times.
+    static const int64_t kPullCoalesceWindowNs = 5 * NS_PER_SEC;
+
+    // The number of threads the scheduled pulls run on.
+    static const int kPullThreadCount = 4;
+
+    ~StatsPullerManagerImpl();
+
    private:
     StatsPullerManagerImpl();
 
+    // Pulls with the given pullers instead of kAllPullAtomInfo, for tests.
+    StatsPullerManagerImpl(const std::map<int, PullAtomInfo>& pullAtomInfo);
+
+    // A pull running on one of mPullThreads. The alarm waits for it until its deadline.
+    struct PullTask {
+        std::mutex lock;
+        std::condition_variable doneCondition;
+        bool done = false;
+        bool success = false;
+        std::vector<std::shared_ptr<LogEvent>> data;
+        int tagId;
+        int64_t timeNs;
+        sp<StatsPuller> puller;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    // Queues the pull of the atom. The returned task is already done, and failed, if the atom is
+    // unknown or if its previous pull is still running.
+    std::shared_ptr<PullTask> startPull(int tagId, int64_t timeNs);
+
+    // Runs the queued pulls until the manager is destroyed.
+    void pullLoop();
+
+    // Returns false if the pull failed or didn't finish before its deadline.
+    bool waitForPull(const std::shared_ptr<PullTask>& task,
+                     vector<std::shared_ptr<LogEvent>>* data);
+
+    // Returns the latest next pull time of the receivers within kPullCoalesceWindowNs of
+    // soonestPullTimeNs.
+    int64_t getCoalescedPullTimeLocked(int64_t soonestPullTimeNs) const;
+
+    const std::map<int, PullAtomInfo> mPullAtomInfo;
+
     sp<IStatsCompanionService> mStatsCompanionService = nullptr;
 
     typedef struct {
@@ -89,12 +140,31 @@ public:
 
     void updateAlarmLocked();
 
+    // The time the pull alarm is set for.
     int64_t mNextPullTimeNs;
 
+    // The soonest next pull time of the receivers, which mNextPullTimeNs is coalesced from.
+    int64_t mSoonestPullTimeNs;
+
+    // Guards the pull queue, and the atoms being pulled. Never held while pulling.
+    std::mutex mPullLock;
+    std::condition_variable mPullCondition;
+    std::deque<std::shared_ptr<PullTask>> mPullQueue;
+    // The atoms whose pull is queued or running, including pulls the alarm stopped waiting for.
+    std::set<int> mPullsInFlight;
+    bool mStopPulling = false;
+    std::vector<std::thread> mPullThreads;
+
     FRIEND_TEST(GaugeMetricE2eTest, TestRandomSamplePulledEvents);
     FRIEND_TEST(GaugeMetricE2eTest, TestRandomSamplePulledEvent_LateAlarm);
     FRIEND_TEST(ValueMetricE2eTest, TestPulledEvents);
     FRIEND_TEST(ValueMetricE2eTest, TestPulledEvents_LateAlarm);
+    FRIEND_TEST(StatsPullerManagerImplTest, TestSharedPull);
+    FRIEND_TEST(StatsPullerManagerImplTest, TestCoalescedPullTime);
+    FRIEND_TEST(StatsPullerManagerImplTest, TestConcurrentPulls);
+    FRIEND_TEST(StatsPullerManagerImplTest, TestPullTimeout);
+    FRIEND_TEST(StatsPullerManagerImplTest, TestPullInFlightIsSkipped);
+    FRIEND_TEST(StatsPullerManagerImplTest, TestNotLockedWhileWaitingForPulls);
 };
 
 }  // namespace statsd
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "guardrail/ProcessingStageTimer.h"
+
+#include <string.h>
+#include <time.h>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+bool ProcessingStageTimes::sEnabled = false;
+ProcessingStage ProcessingStageTimes::sCurrentStage = PROCESSING_STAGE_COUNT;
+int64_t ProcessingStageTimes::sCurrentStageStartNs = 0;
+int64_t ProcessingStageTimes::sCpuTimeNs[PROCESSING_STAGE_COUNT];
+
+static int64_t getThreadCpuTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void ProcessingStageTimes::enable() {
+    memset(sCpuTimeNs, 0, sizeof(sCpuTimeNs));
+    sCurrentStage = PROCESSING_STAGE_COUNT;
+    sEnabled = true;
+}
+
+void ProcessingStageTimes::disable() {
+    sEnabled = false;
+}
+
+ProcessingStage ProcessingStageTimes::enter(ProcessingStage stage) {
+    const int64_t nowNs = getThreadCpuTimeNs();
+    if (sCurrentStage != PROCESSING_STAGE_COUNT) {
+        sCpuTimeNs[sCurrentStage] += nowNs - sCurrentStageStartNs;
+    }
+    const ProcessingStage outerStage = sCurrentStage;
+    sCurrentStage = stage;
+    sCurrentStageStartNs = nowNs;
+    return outerStage;
+}
+
+void ProcessingStageTimes::exit(ProcessingStage outerStage) {
+    const int64_t nowNs = getThreadCpuTimeNs();
+    if (sCurrentStage != PROCESSING_STAGE_COUNT) {
+        sCpuTimeNs[sCurrentStage] += nowNs - sCurrentStageStartNs;
+    }
+    sCurrentStage = outerStage;
+    sCurrentStageStartNs = nowNs;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
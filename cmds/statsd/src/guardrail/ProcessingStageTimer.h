@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+enum ProcessingStage {
+    PROCESSING_STAGE_MATCHING = 0,
+    PROCESSING_STAGE_CONDITION,
+    PROCESSING_STAGE_METRICS,
+    PROCESSING_STAGE_ANOMALY,
+    PROCESSING_STAGE_COUNT,
+};
+
+/**
+ * The CPU time spent in each stage of processing the events, for the replay benchmark.
+ *
+ * The times are exclusive: the time of a stage nested in another, like the anomaly detection done
+ * by a metric, isn't counted in the outer stage. Disabled by default, when a timer only checks a
+ * flag. Not thread safe: only enable it while a single thread processes the events.
+ */
+class ProcessingStageTimes {
+public:
+    // Clears the times and starts measuring.
+    static void enable();
+
+    static void disable();
+
+    static int64_t getCpuTimeNs(ProcessingStage stage) {
+        return sCpuTimeNs[stage];
+    }
+
+private:
+    // Starts measuring [stage], and returns the stage it was nested in.
+    static ProcessingStage enter(ProcessingStage stage);
+
+    // Stops measuring the current stage, and goes back to [outerStage].
+    static void exit(ProcessingStage outerStage);
+
+    static bool sEnabled;
+
+    // PROCESSING_STAGE_COUNT when outside of all the stages.
+    static ProcessingStage sCurrentStage;
+    static int64_t sCurrentStageStartNs;
+
+    static int64_t sCpuTimeNs[PROCESSING_STAGE_COUNT];
+
+    friend class ScopedProcessingStageTimer;
+};
+
+/**
+ * Counts the CPU time of its scope in a stage of ProcessingStageTimes.
+ */
+class ScopedProcessingStageTimer {
+public:
+    explicit ScopedProcessingStageTimer(ProcessingStage stage) {
+        if (ProcessingStageTimes::sEnabled) {
+            mOuterStage = ProcessingStageTimes::enter(stage);
+            mActive = true;
+        }
+    }
+
+    ~ScopedProcessingStageTimer() {
+        if (mActive) {
+            ProcessingStageTimes::exit(mOuterStage);
+        }
+    }
+
+private:
+    bool mActive = false;
+    ProcessingStage mOuterStage = PROCESSING_STAGE_COUNT;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
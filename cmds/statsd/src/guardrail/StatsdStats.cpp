@@ -18,6 +18,7 @@
 
 #include "StatsdStats.h"
 
+#include <algorithm>
 #include <android/util/ProtoOutputStream.h>
 #include "../stats_log_util.h"
 #include "statslog.h"
@@ -52,6 +53,7 @@ const int FIELD_ID_LOGGER_ERROR_STATS = 11;
 const int FIELD_ID_PERIODIC_ALARM_STATS = 12;
 const int FIELD_ID_LOG_LOSS_STATS = 14;
 const int FIELD_ID_SYSTEM_SERVER_RESTART = 15;
+const int FIELD_ID_EVENT_QUEUE_STATS = 16;
 
 const int FIELD_ID_ATOM_STATS_TAG = 1;
 const int FIELD_ID_ATOM_STATS_COUNT = 2;
@@ -59,6 +61,10 @@ const int FIELD_ID_ATOM_STATS_COUNT = 2;
 const int FIELD_ID_ANOMALY_ALARMS_REGISTERED = 1;
 const int FIELD_ID_PERIODIC_ALARMS_REGISTERED = 1;
 
+const int FIELD_ID_EVENT_QUEUE_MAX_DEPTH = 1;
+const int FIELD_ID_EVENT_QUEUE_OVERFLOW_COUNT = 2;
+const int FIELD_ID_EVENT_QUEUE_DROPPED_EVENTS = 3;
+
 const int FIELD_ID_LOGGER_STATS_TIME = 1;
 const int FIELD_ID_LOGGER_STATS_ERROR_CODE = 2;
 
@@ -188,6 +194,15 @@ void StatsdStats::noteLogLost(int64_t timestampNs) {
     mLogLossTimestampNs.push_back(timestampNs);
 }
 
+void StatsdStats::noteEventQueueBatch(int queueDepth, int droppedEvents) {
+    lock_guard<std::mutex> lock(mLock);
+    mEventQueueMaxDepth = std::max(mEventQueueMaxDepth, queueDepth);
+    if (droppedEvents > 0) {
+        mEventQueueOverflowCount++;
+        mEventQueueDroppedEvents += droppedEvents;
+    }
+}
+
 void StatsdStats::noteBroadcastSent(const ConfigKey& key) {
     noteBroadcastSent(key, getWallClockSec());
 }
@@ -345,6 +360,21 @@ void StatsdStats::notePullFromCache(int pullAtomId) {
     mPulledAtomStats[pullAtomId].totalPullFromCache++;
 }
 
+void StatsdStats::notePullLatency(int pullAtomId, int64_t latencyNs) {
+    int bucket = 0;
+    for (int64_t latencyMs = latencyNs / 1000000; latencyMs > 0; latencyMs >>= 1) {
+        bucket++;
+    }
+    bucket = std::min(bucket, kPullLatencyBucketCount - 1);
+    lock_guard<std::mutex> lock(mLock);
+    mPulledAtomStats[pullAtomId].pullLatencyHistogram[bucket]++;
+}
+
+void StatsdStats::notePullTimeout(int pullAtomId) {
+    lock_guard<std::mutex> lock(mLock);
+    mPulledAtomStats[pullAtomId].pullTimeout++;
+}
+
 void StatsdStats::noteAtomLogged(int atomId, int32_t timeSec) {
     lock_guard<std::mutex> lock(mLock);
 
@@ -389,6 +419,9 @@ void StatsdStats::resetInternalLocked() {
     mLoggerErrors.clear();
     mSystemServerRestartSec.clear();
     mLogLossTimestampNs.clear();
+    mEventQueueMaxDepth = 0;
+    mEventQueueOverflowCount = 0;
+    mEventQueueDroppedEvents = 0;
     for (auto& config : mConfigStats) {
         config.second->broadcast_sent_time_sec.clear();
         config.second->data_drop_time_sec.clear();
@@ -497,8 +530,14 @@ void StatsdStats::dumpStats(FILE* out) const {
 
     fprintf(out, "********Pulled Atom stats***********\n");
     for (const auto& pair : mPulledAtomStats) {
-        fprintf(out, "Atom %d->%ld, %ld, %ld\n", (int)pair.first, (long)pair.second.totalPull,
-                (long)pair.second.totalPullFromCache, (long)pair.second.minPullIntervalSec);
+        fprintf(out, "Atom %d->%ld, %ld, %ld, %ld\n", (int)pair.first, (long)pair.second.totalPull,
+                (long)pair.second.totalPullFromCache, (long)pair.second.minPullIntervalSec,
+                (long)pair.second.pullTimeout);
+        fprintf(out, "  Pull latency histogram (ms, log2 buckets):");
+        for (int i = 0; i < kPullLatencyBucketCount; i++) {
+            fprintf(out, " %ld", (long)pair.second.pullLatencyHistogram[i]);
+        }
+        fprintf(out, "\n");
     }
 
     if (mAnomalyAlarmRegisteredStats > 0) {
@@ -531,6 +570,9 @@ void StatsdStats::dumpStats(FILE* out) const {
     for (const auto& loss : mLogLossTimestampNs) {
         fprintf(out, "Log loss detected at %lld (elapsedRealtimeNs)\n", (long long)loss);
     }
+
+    fprintf(out, "Event queue stats: max depth=%d, overflows=%d, dropped events=%lld\n",
+            mEventQueueMaxDepth, mEventQueueOverflowCount, (long long)mEventQueueDroppedEvents);
 }
 
 void addConfigStatsToProto(const ConfigStats& configStats, ProtoOutputStream* proto) {
@@ -695,6 +737,13 @@ void StatsdStats::dumpStats(std::vector<uint8_t>* output, bool reset) {
                     restart);
     }
 
+    uint64_t eventQueueToken = proto.start(FIELD_TYPE_MESSAGE | FIELD_ID_EVENT_QUEUE_STATS);
+    proto.write(FIELD_TYPE_INT32 | FIELD_ID_EVENT_QUEUE_MAX_DEPTH, mEventQueueMaxDepth);
+    proto.write(FIELD_TYPE_INT32 | FIELD_ID_EVENT_QUEUE_OVERFLOW_COUNT, mEventQueueOverflowCount);
+    proto.write(FIELD_TYPE_INT64 | FIELD_ID_EVENT_QUEUE_DROPPED_EVENTS,
+                (long long)mEventQueueDroppedEvents);
+    proto.end(eventQueueToken);
+
     output->clear();
     size_t bufferSize = proto.size();
     output->resize(bufferSize);
@@ -143,6 +143,10 @@ public:
     // How long to try to clear puller cache from last time
     static const long kPullerCacheClearIntervalSec = 1;
 
+    // The buckets of the pull latency histogram. Bucket 0 counts the pulls faster than 1ms, bucket
+    // i the pulls in [2^(i-1), 2^i) ms, and the last bucket the pulls slower than that.
+    static const int kPullLatencyBucketCount = 14;
+
     /**
      * Report a new config has been received and report the static stats about the config.
      *
@@ -272,6 +276,12 @@ public:
     // Notify pull request for an atom served from cached data
     void notePullFromCache(int pullAtomId);
 
+    // Notify how long an actual pull of an atom took
+    void notePullLatency(int pullAtomId, int64_t latencyNs);
+
+    // Notify a scheduled pull of an atom that was not waited for, as it took too long
+    void notePullTimeout(int pullAtomId);
+
     /**
      * Records statsd met an error while reading from logd.
      */
@@ -287,6 +297,15 @@ public:
      */
     void noteLogLost(int64_t timestamp);
 
+    /**
+     * Records a batch of events read from the statsd socket and added to the event queue.
+     *
+     * [queueDepth]: The number of events in the queue after the batch was added.
+     * [droppedEvents]: The number of events of the batch that were dropped because the queue was
+     *                  full.
+     */
+    void noteEventQueueBatch(int queueDepth, int droppedEvents);
+
     /**
      * Reset the historical stats. Including all stats in icebox, and the tracked stats about
      * metrics, matchers, and atoms. The active configs will be kept and StatsdStats will continue
@@ -310,6 +329,8 @@ public:
         long totalPull;
         long totalPullFromCache;
         long minPullIntervalSec;
+        long pullTimeout;
+        long pullLatencyHistogram[kPullLatencyBucketCount];
     } PulledAtomStats;
 
 private:
@@ -347,6 +368,15 @@ private:
 
     std::list<int32_t> mSystemServerRestartSec;
 
+    // The largest number of events seen in the event queue.
+    int mEventQueueMaxDepth = 0;
+
+    // The number of batches that didn't fit in the event queue.
+    int mEventQueueOverflowCount = 0;
+
+    // The number of events dropped because the event queue was full.
+    int64_t mEventQueueDroppedEvents = 0;
+
     // Stores the number of times statsd modified the anomaly alarm registered with
     // StatsCompanionService.
     int mAnomalyAlarmRegisteredStats = 0;
@@ -376,6 +406,7 @@ private:
     FRIEND_TEST(StatsdStatsTest, TestTimestampThreshold);
     FRIEND_TEST(StatsdStatsTest, TestAnomalyMonitor);
     FRIEND_TEST(StatsdStatsTest, TestSystemServerCrash);
+    FRIEND_TEST(StatsdStatsTest, TestEventQueue);
 };
 
 }  // namespace statsd
@@ -19,6 +19,8 @@
 
 #include "stats_log_util.h"
 
+#include <string.h>
+
 namespace android {
 namespace os {
 namespace statsd {
@@ -29,15 +31,24 @@ using std::string;
 using std::vector;
 
 LogEvent::LogEvent(log_msg& msg) {
-    mContext =
-            create_android_log_parser(msg.msg() + sizeof(uint32_t), msg.len() - sizeof(uint32_t));
-    mLogdTimestampNs = msg.entry_v1.sec * NS_PER_SEC + msg.entry_v1.nsec;
-    mLogUid = msg.entry_v4.uid;
-    init(mContext);
+    reset(msg);
+}
+
+void LogEvent::reset(log_msg& msg) {
     if (mContext) {
-        // android_log_destroy will set mContext to NULL
         android_log_destroy(&mContext);
     }
+    mLogdTimestampNs = msg.entry_v1.sec * NS_PER_SEC + msg.entry_v1.nsec;
+    mElapsedTimestampNs = 0;
+    mTagId = 0;
+    mLogUid = msg.entry_v4.uid;
+    // The payload starts with the event tag shared by all stats logs, which is skipped.
+    const size_t len = msg.entry.len;
+    if (len < sizeof(uint32_t)) {
+        init(nullptr, 0);
+        return;
+    }
+    init(msg.msg() + sizeof(uint32_t), len - sizeof(uint32_t));
 }
 
 LogEvent::LogEvent(int32_t tagId, int64_t wallClockTimestampNs, int64_t elapsedTimestampNs) {
@@ -65,15 +76,12 @@ LogEvent::LogEvent(int32_t tagId, int64_t timestampNs) {
 void LogEvent::init() {
     if (mContext) {
         const char* buffer;
-        size_t len = android_log_write_list_buffer(mContext, &buffer);
-        // turns to reader mode
-        android_log_context contextForRead = create_android_log_parser(buffer, len);
-        if (contextForRead) {
-            init(contextForRead);
-            // destroy the context to save memory.
-            // android_log_destroy will set mContext to NULL
-            android_log_destroy(&contextForRead);
+        int len = android_log_write_list_buffer(mContext, &buffer);
+        if (len > 0) {
+            init(buffer, len);
         }
+        // destroy the context to save memory.
+        // android_log_destroy will set mContext to NULL
         android_log_destroy(&mContext);
     }
 }
@@ -165,111 +173,212 @@ bool LogEvent::write(const AttributionNodeInternal& node) {
     return false;
 }
 
+namespace {
+
+/**
+ * Reads the elements of a buffer in the binary event format, where each element is a type byte
+ * followed by its payload in little endian, and each list has the count of its elements.
+ */
+class LogBufferReader {
+public:
+    LogBufferReader(const char* buffer, size_t len) : mBuffer(buffer), mLen(len), mOffset(0) {
+    }
+
+    bool readByte(uint8_t* out) {
+        return read(out, sizeof(*out));
+    }
+
+    bool readInt32(int32_t* out) {
+        return read(out, sizeof(*out));
+    }
+
+    bool readInt64(int64_t* out) {
+        return read(out, sizeof(*out));
+    }
+
+    bool readFloat(float* out) {
+        return read(out, sizeof(*out));
+    }
+
+    // Points [out] at the string in the buffer, which is not null terminated.
+    bool readString(const char** out, uint32_t* len) {
+        if (!read(len, sizeof(*len)) || mLen - mOffset < *len) {
+            return false;
+        }
+        *out = mBuffer + mOffset;
+        mOffset += *len;
+        return true;
+    }
+
+private:
+    bool read(void* out, size_t size) {
+        if (mLen - mOffset < size) {
+            return false;
+        }
+        // All the devices statsd runs on are little endian.
+        memcpy(out, mBuffer + mOffset, size);
+        mOffset += size;
+        return true;
+    }
+
+    const char* const mBuffer;
+    const size_t mLen;
+    size_t mOffset;
+};
+
+}  // namespace
+
+void LogEvent::init(const char* buffer, size_t len) {
+    // Values left over from a previous event are only dropped once the new ones are decoded, so
+    // that their storage is reused.
+    mValues.resize(parseValues(buffer, len));
+}
+
+FieldValue& LogEvent::valueAt(size_t index, int32_t pos[], int32_t depth) {
+    if (index == mValues.size()) {
+        mValues.emplace_back();
+    }
+    FieldValue& value = mValues[index];
+    value.mField = Field(mTagId, pos, depth);
+    // Keeps the capacity of the string for when the value is reused for a string again.
+    value.mValue.str_value.clear();
+    return value;
+}
+
 /**
- * The elements of each log event are stored as a vector of android_log_list_elements.
  * The goal is to do as little preprocessing as possible, because we read a tiny fraction
  * of the elements that are written to the log.
  *
  * The idea here is to read through the log items once, we get as much information we need for
  * matching as possible. Because this log will be matched against lots of matchers.
+ *
+ * The buffer is decoded directly, instead of through a log parser, so that no copy of the buffer
+ * is made and the only allocations are the values that don't fit in mValues yet.
  */
-void LogEvent::init(android_log_context context) {
-    android_log_list_element elem;
+size_t LogEvent::parseValues(const char* buffer, size_t len) {
+    LogBufferReader reader(buffer, len);
+    size_t count = 0;
     int i = 0;
     int depth = -1;
-    int pos[] = {1, 1, 1};
-    do {
-        elem = android_log_read_next(context);
-        switch ((int)elem.type) {
-            case EVENT_TYPE_INT:
+    int32_t pos[] = {1, 1, 1};
+    // The number of elements left to read in each of the open lists.
+    int remaining[] = {0, 0, 0};
+    uint8_t type;
+    while (reader.readByte(&type)) {
+        if (depth >= 0) {
+            remaining[depth]--;
+        }
+        switch (type) {
+            case EVENT_TYPE_INT: {
+                int32_t value;
+                if (!reader.readInt32(&value)) {
+                    return count;
+                }
                 // elem at [0] is EVENT_TYPE_LIST, [1] is the timestamp, [2] is tag id.
                 if (i == 2) {
-                    mTagId = elem.data.int32;
+                    mTagId = value;
                 } else {
                     if (depth < 0 || depth > 2) {
-                        return;
+                        return count;
                     }
 
-                    mValues.push_back(
-                            FieldValue(Field(mTagId, pos, depth), Value((int32_t)elem.data.int32)));
+                    valueAt(count++, pos, depth).mValue.setInt(value);
 
                     pos[depth]++;
                 }
-                break;
+            } break;
             case EVENT_TYPE_FLOAT: {
+                float value;
+                if (!reader.readFloat(&value)) {
+                    return count;
+                }
                 if (depth < 0 || depth > 2) {
                     ALOGE("Depth > 2. Not supported!");
-                    return;
+                    return count;
                 }
 
-                mValues.push_back(FieldValue(Field(mTagId, pos, depth), Value(elem.data.float32)));
+                valueAt(count++, pos, depth).mValue.setFloat(value);
 
                 pos[depth]++;
 
             } break;
             case EVENT_TYPE_STRING: {
+                const char* value;
+                uint32_t valueLen;
+                if (!reader.readString(&value, &valueLen)) {
+                    return count;
+                }
                 if (depth < 0 || depth > 2) {
                     ALOGE("Depth > 2. Not supported!");
-                    return;
+                    return count;
                 }
 
-                mValues.push_back(FieldValue(Field(mTagId, pos, depth),
-                                             Value(string(elem.data.string, elem.len))));
+                valueAt(count++, pos, depth).mValue.setString(value, valueLen);
 
                 pos[depth]++;
 
             } break;
             case EVENT_TYPE_LONG: {
+                int64_t value;
+                if (!reader.readInt64(&value)) {
+                    return count;
+                }
                 if (i == 1) {
-                    mElapsedTimestampNs = elem.data.int64;
+                    mElapsedTimestampNs = value;
                 } else {
                     if (depth < 0 || depth > 2) {
                         ALOGE("Depth > 2. Not supported!");
-                        return;
+                        return count;
                     }
-                    mValues.push_back(
-                            FieldValue(Field(mTagId, pos, depth), Value((int64_t)elem.data.int64)));
+
+                    valueAt(count++, pos, depth).mValue.setLong(value);
 
                     pos[depth]++;
                 }
             } break;
-            case EVENT_TYPE_LIST:
+            case EVENT_TYPE_LIST: {
+                uint8_t listCount;
+                if (!reader.readByte(&listCount)) {
+                    return count;
+                }
                 depth++;
                 if (depth > 2) {
                     ALOGE("Depth > 2. Not supported!");
-                    return;
+                    return count;
                 }
                 pos[depth] = 1;
+                remaining[depth] = listCount;
+            } break;
+            default:
+                // Includes EVENT_TYPE_LIST_STOP, which only follows the outermost list.
+                return count;
+        }
+        i++;
 
-                break;
-            case EVENT_TYPE_LIST_STOP: {
-                int prevDepth = depth;
-                depth--;
-                if (depth >= 0 && depth < 2) {
-                    // Now go back to decorate the previous items that are last at prevDepth.
-                    // So that we can later easily match them with Position=Last matchers.
-                    pos[prevDepth]--;
-                    int path = getEncodedField(pos, prevDepth, false);
-                    for (auto it = mValues.rbegin(); it != mValues.rend(); ++it) {
-                        if (it->mField.getDepth() >= prevDepth &&
-                            it->mField.getPath(prevDepth) == path) {
-                            it->mField.decorateLastPos(prevDepth);
-                        } else {
-                            // Safe to break, because the items are in DFS order.
-                            break;
-                        }
-                    }
-                    pos[depth]++;
+        // Close the lists that have all their elements.
+        while (depth >= 0 && remaining[depth] <= 0) {
+            int prevDepth = depth;
+            depth--;
+            if (depth < 0) {
+                return count;
+            }
+            // Now go back to decorate the previous items that are last at prevDepth.
+            // So that we can later easily match them with Position=Last matchers.
+            pos[prevDepth]--;
+            int path = getEncodedField(pos, prevDepth, false);
+            for (size_t j = count; j > 0; j--) {
+                Field& field = mValues[j - 1].mField;
+                if (field.getDepth() >= prevDepth && field.getPath(prevDepth) == path) {
+                    field.decorateLastPos(prevDepth);
+                } else {
+                    // Safe to break, because the items are in DFS order.
+                    break;
                 }
-                break;
             }
-            case EVENT_TYPE_UNKNOWN:
-                break;
-            default:
-                break;
+            pos[depth]++;
         }
-        i++;
-    } while ((elem.type != EVENT_TYPE_UNKNOWN) && !elem.complete);
+    }
+    return count;
 }
 
 int64_t LogEvent::GetLong(size_t key, status_t* err) const {
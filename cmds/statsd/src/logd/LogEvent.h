@@ -61,6 +61,13 @@ public:
      */
     explicit LogEvent(log_msg& msg);
 
+    /**
+     * Replaces the contents of this LogEvent with the event read from a log_msg. The storage of the
+     * previous values is reused, so recycling LogEvents doesn't allocate once their values have
+     * grown to the size of the atoms read.
+     */
+    void reset(log_msg& msg);
+
     /**
      * Constructs a LogEvent with synthetic data for testing. Must call init() before reading.
      */
@@ -161,12 +168,23 @@ private:
     explicit LogEvent(const LogEvent&);
 
     /**
-     * Parses a log_msg into a LogEvent object.
+     * Decodes a buffer in the binary event format into the values of this LogEvent, replacing the
+     * previous values.
+     */
+    void init(const char* buffer, size_t len);
+
+    /**
+     * Decodes the values of a buffer into mValues, and returns how many values were decoded.
+     */
+    size_t parseValues(const char* buffer, size_t len);
+
+    /**
+     * Returns the value at [index] of mValues with its field set, adding it if needed.
      */
-    void init(android_log_context context);
+    FieldValue& valueAt(size_t index, int32_t pos[], int32_t depth);
 
     // The items are naturally sorted in DFS order as we read them. this allows us to do fast
-    // matching.
+    // matching. When the LogEvent is reset, the items are overwritten in place.
     std::vector<FieldValue> mValues;
 
     // This field is used when statsD wants to create log event object and write fields to it. After
@@ -40,6 +40,10 @@ using namespace android::os::statsd;
 const bool kUseLogd = false;
 const bool kUseStatsdSocket = true;
 
+// The number of events that can wait between the statsd socket and the log processor, so that a
+// slow metric doesn't keep the socket from being read. 0 processes events on the socket thread.
+const size_t kSocketEventQueueCapacity = 2000;
+
 /**
  * Thread function data.
  */
@@ -141,7 +145,8 @@ int main(int /*argc*/, char** /*argv*/) {
 
     gStatsService->Startup();
 
-    sp<StatsSocketListener> socketListener = new StatsSocketListener(gStatsService);
+    sp<StatsSocketListener> socketListener =
+            new StatsSocketListener(gStatsService, kSocketEventQueueCapacity);
 
     if (kUseLogd) {
         ALOGI("using logd");
@@ -69,6 +69,13 @@ public:
         return mAtomIds;
     }
 
+    // Get the indices of the matchers this matcher is combined from. Their results are computed
+    // as part of this matcher's onLogEvent.
+    virtual const std::vector<int>& getChildren() const {
+        static const std::vector<int> kNoChildren;
+        return kNoChildren;
+    }
+
     const int64_t& getId() const {
         return mId;
     }
@@ -90,8 +90,7 @@ bool tryMatchString(const UidMap& uidMap, const Field& field, const Value& value
         if (aidIt != UidMap::sAidToUidMapping.end()) {
             return ((int)aidIt->second) == uid;
         }
-        std::set<string> packageNames = uidMap.getAppNamesFromUid(uid, true /* normalize*/);
-        return packageNames.find(str_match) != packageNames.end();
+        return uidMap.hasNormalizedApp(uid, str_match);
     } else if (value.getType() == STRING) {
         return value.str_value == str_match;
     }
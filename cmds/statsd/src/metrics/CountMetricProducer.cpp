@@ -25,6 +25,8 @@
 #include <limits.h>
 #include <stdlib.h>
 
+#include <algorithm>
+
 using android::util::FIELD_COUNT_REPEATED;
 using android::util::FIELD_TYPE_BOOL;
 using android::util::FIELD_TYPE_FLOAT;
@@ -138,16 +140,23 @@ void CountMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mPastBuckets.clear();
 }
 
-void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
-                                             const bool include_current_partial_bucket,
-                                             std::set<string> *str_set,
-                                             ProtoOutputStream* protoOutput) {
+std::unique_ptr<PreparedDumpReport> CountMetricProducer::prepareDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket) {
     if (include_current_partial_bucket) {
         flushLocked(dumpTimeNs);
     } else {
         flushIfNeededLocked(dumpTimeNs);
     }
-    if (mPastBuckets.empty()) {
+    PreparedReport* report = new PreparedReport();
+    std::swap(report->pastBuckets, mPastBuckets);
+    return std::unique_ptr<PreparedDumpReport>(report);
+}
+
+void CountMetricProducer::writeDumpReport(PreparedDumpReport* report,
+                                          std::set<string> *str_set,
+                                          ProtoOutputStream* protoOutput) const {
+    const PastBucketStore& pastBuckets = static_cast<PreparedReport*>(report)->pastBuckets;
+    if (pastBuckets.empty()) {
         return;
     }
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
@@ -173,7 +182,8 @@ void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
 
     uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_COUNT_METRICS);
 
-    for (const auto& counter : mPastBuckets) {
+    vector<PastBucket> buckets;
+    for (const auto& counter : pastBuckets) {
         const MetricDimensionKey& dimensionKey = counter.first;
         VLOG("  dimension key %s", dimensionKey.toString().c_str());
 
@@ -204,7 +214,9 @@ void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
             }
         }
         // Then fill bucket_info (CountBucketInfo).
-        for (const auto& bucket : counter.second) {
+        buckets.clear();
+        pastBuckets.decode(counter.second, &buckets);
+        for (const auto& bucket : buckets) {
             uint64_t bucketInfoToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
             // Partial bucket.
@@ -217,17 +229,15 @@ void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                 protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
                                    (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
             }
-            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_COUNT, (long long)bucket.mCount);
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_COUNT, (long long)bucket.mValue);
             protoOutput->end(bucketInfoToken);
             VLOG("\t bucket [%lld - %lld] count: %lld", (long long)bucket.mBucketStartNs,
-                 (long long)bucket.mBucketEndNs, (long long)bucket.mCount);
+                 (long long)bucket.mBucketEndNs, (long long)bucket.mValue);
         }
         protoOutput->end(wrapperToken);
     }
 
     protoOutput->end(protoToken);
-
-    mPastBuckets.clear();
 }
 
 void CountMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
@@ -318,17 +328,9 @@ void CountMetricProducer::flushIfNeededLocked(const int64_t& eventTimeNs) {
 
 void CountMetricProducer::flushCurrentBucketLocked(const int64_t& eventTimeNs) {
     int64_t fullBucketEndTimeNs = getCurrentBucketEndTimeNs();
-    CountBucket info;
-    info.mBucketStartNs = mCurrentBucketStartTimeNs;
-    if (eventTimeNs < fullBucketEndTimeNs) {
-        info.mBucketEndNs = eventTimeNs;
-    } else {
-        info.mBucketEndNs = fullBucketEndTimeNs;
-    }
+    const int64_t bucketEndNs = std::min(eventTimeNs, fullBucketEndTimeNs);
     for (const auto& counter : *mCurrentSlicedCounter) {
-        info.mCount = counter.second;
-        auto& bucketList = mPastBuckets[counter.first];
-        bucketList.push_back(info);
+        mPastBuckets.add(counter.first, mCurrentBucketStartTimeNs, bucketEndNs, counter.second);
         VLOG("metric %lld, dump key value: %s -> %lld", (long long)mMetricId,
              counter.first.toString().c_str(),
              (long long)counter.second);
@@ -363,15 +365,9 @@ void CountMetricProducer::flushCurrentBucketLocked(const int64_t& eventTimeNs) {
     mCurrentSlicedCounter = std::make_shared<DimToValMap>();
 }
 
-// Rough estimate of CountMetricProducer buffer stored. This number will be
-// greater than actual data size as it contains each dimension of
-// CountMetricData is  duplicated.
+// Rough estimate of CountMetricProducer buffer stored, from the size of the encoded past buckets.
 size_t CountMetricProducer::byteSizeLocked() const {
-    size_t totalSize = 0;
-    for (const auto& pair : mPastBuckets) {
-        totalSize += pair.second.size() * kBucketSize;
-    }
-    return totalSize;
+    return mPastBuckets.byteSize();
 }
 
 }  // namespace statsd
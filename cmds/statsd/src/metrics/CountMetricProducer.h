@@ -25,6 +25,7 @@
 #include "../condition/ConditionTracker.h"
 #include "../matchers/matcher_util.h"
 #include "MetricProducer.h"
+#include "PastBucketStore.h"
 #include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
 #include "stats_util.h"
 
@@ -32,12 +33,6 @@ namespace android {
 namespace os {
 namespace statsd {
 
-struct CountBucket {
-    int64_t mBucketStartNs;
-    int64_t mBucketEndNs;
-    int64_t mCount;
-};
-
 class CountMetricProducer : public MetricProducer {
 public:
     // TODO: Pass in the start time from MetricsManager, it should be consistent for all metrics.
@@ -47,6 +42,9 @@ public:
 
     virtual ~CountMetricProducer();
 
+    void writeDumpReport(PreparedDumpReport* report, std::set<string> *str_set,
+                         android::util::ProtoOutputStream* protoOutput) const override;
+
 protected:
     void onMatchedLogEventInternalLocked(
             const size_t matcherIndex, const MetricDimensionKey& eventKey,
@@ -55,10 +53,13 @@ protected:
 
 private:
 
-    void onDumpReportLocked(const int64_t dumpTimeNs,
-                            const bool include_current_partial_bucket,
-                            std::set<string> *str_set,
-                            android::util::ProtoOutputStream* protoOutput) override;
+    // The past buckets of a report.
+    struct PreparedReport : public PreparedDumpReport {
+        PastBucketStore pastBuckets;
+    };
+
+    std::unique_ptr<PreparedDumpReport> prepareDumpReportLocked(
+            const int64_t dumpTimeNs, const bool include_current_partial_bucket) override;
 
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
@@ -81,7 +82,7 @@ private:
     void flushCurrentBucketLocked(const int64_t& eventTimeNs) override;
 
     // TODO: Add a lock to mPastBuckets.
-    std::unordered_map<MetricDimensionKey, std::vector<CountBucket>> mPastBuckets;
+    PastBucketStore mPastBuckets;
 
     // The current bucket (may be a partial bucket).
     std::shared_ptr<DimToValMap> mCurrentSlicedCounter = std::make_shared<DimToValMap>();
@@ -90,8 +91,6 @@ private:
     // partial bucket). This is only updated while flushing the current bucket.
     std::shared_ptr<DimToValMap> mCurrentFullCounters = std::make_shared<DimToValMap>();
 
-    static const size_t kBucketSize = sizeof(CountBucket{});
-
     bool hitGuardRailLocked(const MetricDimensionKey& newKey);
 
     FRIEND_TEST(CountMetricProducerTest, TestNonDimensionalEvents);
@@ -453,16 +453,23 @@ void DurationMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mPastBuckets.clear();
 }
 
-void DurationMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
-                                                const bool include_current_partial_bucket,
-                                                std::set<string> *str_set,
-                                                ProtoOutputStream* protoOutput) {
+std::unique_ptr<PreparedDumpReport> DurationMetricProducer::prepareDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket) {
     if (include_current_partial_bucket) {
         flushLocked(dumpTimeNs);
     } else {
         flushIfNeededLocked(dumpTimeNs);
     }
-    if (mPastBuckets.empty()) {
+    PreparedReport* report = new PreparedReport();
+    std::swap(report->pastBuckets, mPastBuckets);
+    return std::unique_ptr<PreparedDumpReport>(report);
+}
+
+void DurationMetricProducer::writeDumpReport(PreparedDumpReport* report,
+                                             std::set<string> *str_set,
+                                             ProtoOutputStream* protoOutput) const {
+    const auto& pastBuckets = static_cast<PreparedReport*>(report)->pastBuckets;
+    if (pastBuckets.empty()) {
         VLOG(" Duration metric, empty return");
         return;
     }
@@ -490,7 +497,7 @@ void DurationMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
 
     VLOG("Duration metric %lld dump report now...", (long long)mMetricId);
 
-    for (const auto& pair : mPastBuckets) {
+    for (const auto& pair : pastBuckets) {
         const MetricDimensionKey& dimensionKey = pair.first;
         VLOG("  dimension key %s", dimensionKey.toString().c_str());
 
@@ -543,7 +550,6 @@ void DurationMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
     }
 
     protoOutput->end(protoToken);
-    mPastBuckets.clear();
 }
 
 void DurationMetricProducer::flushIfNeededLocked(const int64_t& eventTimeNs) {
@@ -49,6 +49,9 @@ public:
     sp<AnomalyTracker> addAnomalyTracker(const Alert &alert,
                                          const sp<AlarmMonitor>& anomalyAlarmMonitor) override;
 
+    void writeDumpReport(PreparedDumpReport* report, std::set<string> *str_set,
+                         android::util::ProtoOutputStream* protoOutput) const override;
+
 protected:
     void onMatchedLogEventLocked(const size_t matcherIndex, const LogEvent& event) override;
 
@@ -61,10 +64,13 @@ private:
     void handleStartEvent(const MetricDimensionKey& eventKey, const ConditionKey& conditionKeys,
                           bool condition, const LogEvent& event);
 
-    void onDumpReportLocked(const int64_t dumpTimeNs,
-                            const bool include_current_partial_bucket,
-                            std::set<string> *str_set,
-                            android::util::ProtoOutputStream* protoOutput) override;
+    // The past buckets of a report.
+    struct PreparedReport : public PreparedDumpReport {
+        std::unordered_map<MetricDimensionKey, std::vector<DurationBucket>> pastBuckets;
+    };
+
+    std::unique_ptr<PreparedDumpReport> prepareDumpReportLocked(
+            const int64_t dumpTimeNs, const bool include_current_partial_bucket) override;
 
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
@@ -104,24 +104,30 @@ void EventMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mProto->clear();
 }
 
-void EventMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
-                                             const bool include_current_partial_bucket,
-                                             std::set<string> *str_set,
-                                             ProtoOutputStream* protoOutput) {
-    if (mProto->size() <= 0) {
+std::unique_ptr<PreparedDumpReport> EventMetricProducer::prepareDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket) {
+    PreparedReport* report = new PreparedReport();
+    report->proto = std::move(mProto);
+    mProto = std::make_unique<ProtoOutputStream>();
+    return std::unique_ptr<PreparedDumpReport>(report);
+}
+
+void EventMetricProducer::writeDumpReport(PreparedDumpReport* report,
+                                          std::set<string> *str_set,
+                                          ProtoOutputStream* protoOutput) const {
+    ProtoOutputStream& proto = *static_cast<PreparedReport*>(report)->proto;
+    if (proto.size() <= 0) {
         return;
     }
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
 
-    size_t bufferSize = mProto->size();
+    size_t bufferSize = proto.size();
     VLOG("metric %lld dump report now... proto size: %zu ",
         (long long)mMetricId, bufferSize);
-    std::unique_ptr<std::vector<uint8_t>> buffer = serializeProtoLocked(*mProto);
+    std::unique_ptr<std::vector<uint8_t>> buffer = serializeProtoLocked(proto);
 
     protoOutput->write(FIELD_TYPE_MESSAGE | FIELD_ID_EVENT_METRICS,
                        reinterpret_cast<char*>(buffer.get()->data()), buffer.get()->size());
-
-    mProto->clear();
 }
 
 void EventMetricProducer::onConditionChangedLocked(const bool conditionMet,
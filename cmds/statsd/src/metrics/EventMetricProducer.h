@@ -40,16 +40,22 @@ public:
 
     virtual ~EventMetricProducer();
 
+    void writeDumpReport(PreparedDumpReport* report, std::set<string> *str_set,
+                         android::util::ProtoOutputStream* protoOutput) const override;
+
 private:
     void onMatchedLogEventInternalLocked(
             const size_t matcherIndex, const MetricDimensionKey& eventKey,
             const ConditionKey& conditionKey, bool condition,
             const LogEvent& event) override;
 
-    void onDumpReportLocked(const int64_t dumpTimeNs,
-                            const bool include_current_partial_bucket,
-                            std::set<string> *str_set,
-                            android::util::ProtoOutputStream* protoOutput) override;
+    // The events of a report.
+    struct PreparedReport : public PreparedDumpReport {
+        std::unique_ptr<android::util::ProtoOutputStream> proto;
+    };
+
+    std::unique_ptr<PreparedDumpReport> prepareDumpReportLocked(
+            const int64_t dumpTimeNs, const bool include_current_partial_bucket) override;
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
     // Internal interface to handle condition change.
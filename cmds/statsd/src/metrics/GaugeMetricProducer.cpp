@@ -176,18 +176,30 @@ void GaugeMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mSkippedBuckets.clear();
 }
 
-void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
-                                             const bool include_current_partial_bucket,
-                                             std::set<string> *str_set,
-                                             ProtoOutputStream* protoOutput) {
-    VLOG("Gauge metric %lld report now...", (long long)mMetricId);
+std::unique_ptr<PreparedDumpReport> GaugeMetricProducer::prepareDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket) {
     if (include_current_partial_bucket) {
         flushLocked(dumpTimeNs);
     } else {
         flushIfNeededLocked(dumpTimeNs);
     }
+    PreparedReport* report = new PreparedReport();
+    report->tagId = mTagId;
+    std::swap(report->pastBuckets, mPastBuckets);
+    // The skipped buckets are only reported along with some data, so they are kept until then.
+    if (!report->pastBuckets.empty()) {
+        std::swap(report->skippedBuckets, mSkippedBuckets);
+    }
+    // TODO: Clear mDimensionKeyMap once the report is dumped.
+    return std::unique_ptr<PreparedDumpReport>(report);
+}
 
-    if (mPastBuckets.empty()) {
+void GaugeMetricProducer::writeDumpReport(PreparedDumpReport* report,
+                                          std::set<string> *str_set,
+                                          ProtoOutputStream* protoOutput) const {
+    VLOG("Gauge metric %lld report now...", (long long)mMetricId);
+    const PreparedReport* gaugeReport = static_cast<PreparedReport*>(report);
+    if (gaugeReport->pastBuckets.empty()) {
         return;
     }
 
@@ -213,7 +225,7 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
 
     uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_GAUGE_METRICS);
 
-    for (const auto& pair : mSkippedBuckets) {
+    for (const auto& pair : gaugeReport->skippedBuckets) {
         uint64_t wrapperToken =
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SKIPPED);
         protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKIPPED_START_MILLIS,
@@ -222,9 +234,8 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                            (long long)(NanoToMillis(pair.second)));
         protoOutput->end(wrapperToken);
     }
-    mSkippedBuckets.clear();
 
-    for (const auto& pair : mPastBuckets) {
+    for (const auto& pair : gaugeReport->pastBuckets) {
         const MetricDimensionKey& dimensionKey = pair.first;
 
         VLOG("Gauge dimension key %s", dimensionKey.toString().c_str());
@@ -275,12 +286,13 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                     uint64_t atomsToken =
                         protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
                                            FIELD_ID_ATOM);
-                    writeFieldValueTreeToStream(mTagId, *(atom.mFields), protoOutput);
+                    writeFieldValueTreeToStream(gaugeReport->tagId, *(atom.mFields),
+                                                protoOutput);
                     protoOutput->end(atomsToken);
                 }
                 const bool truncateTimestamp =
                         android::util::AtomsInfo::kNotTruncatingTimestampAtomWhiteList.find(
-                                mTagId) ==
+                                gaugeReport->tagId) ==
                         android::util::AtomsInfo::kNotTruncatingTimestampAtomWhiteList.end();
                 for (const auto& atom : bucket.mGaugeAtoms) {
                     const int64_t elapsedTimestampNs =  truncateTimestamp ?
@@ -306,9 +318,6 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
         protoOutput->end(wrapperToken);
     }
     protoOutput->end(protoToken);
-
-    mPastBuckets.clear();
-    // TODO: Clear mDimensionKeyMap once the report is dumped.
 }
 
 void GaugeMetricProducer::pullLocked(const int64_t timestampNs) {
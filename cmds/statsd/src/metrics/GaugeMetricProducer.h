@@ -81,6 +81,9 @@ public:
         }
     };
 
+    void writeDumpReport(PreparedDumpReport* report, std::set<string> *str_set,
+                         android::util::ProtoOutputStream* protoOutput) const override;
+
 protected:
     void onMatchedLogEventInternalLocked(
             const size_t matcherIndex, const MetricDimensionKey& eventKey,
@@ -88,10 +91,15 @@ protected:
             const LogEvent& event) override;
 
 private:
-    void onDumpReportLocked(const int64_t dumpTimeNs,
-                            const bool include_current_partial_bucket,
-                            std::set<string> *str_set,
-                            android::util::ProtoOutputStream* protoOutput) override;
+    // The past and skipped buckets of a report, and the atom they hold.
+    struct PreparedReport : public PreparedDumpReport {
+        int tagId;
+        std::unordered_map<MetricDimensionKey, std::vector<GaugeBucket>> pastBuckets;
+        std::list<std::pair<int64_t, int64_t>> skippedBuckets;
+    };
+
+    std::unique_ptr<PreparedDumpReport> prepareDumpReportLocked(
+            const int64_t dumpTimeNs, const bool include_current_partial_bucket) override;
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
     // for testing
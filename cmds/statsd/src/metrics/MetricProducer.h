@@ -28,12 +28,20 @@
 
 #include <log/logprint.h>
 #include <utils/RefBase.h>
+#include <memory>
 #include <unordered_map>
 
 namespace android {
 namespace os {
 namespace statsd {
 
+// The data of a metric report, moved out of a MetricProducer by prepareDumpReport() so that it can
+// be encoded by writeDumpReport() while the producer keeps processing events. Each producer
+// extends it with the buckets it keeps.
+struct PreparedDumpReport {
+    virtual ~PreparedDumpReport(){};
+};
+
 // A MetricProducer is responsible for compute one single metrics, creating stats log report, and
 // writing the report to dropbox. MetricProducers should respond to package changes as required in
 // PackageInfoListener, but if none of the metrics are slicing by package name, then the update can
@@ -117,10 +125,25 @@ public:
                       const bool include_current_partial_bucket,
                       std::set<string> *str_set,
                       android::util::ProtoOutputStream* protoOutput) {
+        std::unique_ptr<PreparedDumpReport> report =
+                prepareDumpReport(dumpTimeNs, include_current_partial_bucket);
+        writeDumpReport(report.get(), str_set, protoOutput);
+    }
+
+    // The first half of onDumpReport(): flushes the buckets and moves the past buckets out of the
+    // producer. This is the only part of a report that holds the lock.
+    std::unique_ptr<PreparedDumpReport> prepareDumpReport(
+            const int64_t dumpTimeNs, const bool include_current_partial_bucket) {
         std::lock_guard<std::mutex> lock(mMutex);
-        return onDumpReportLocked(dumpTimeNs, include_current_partial_bucket, str_set, protoOutput);
+        return prepareDumpReportLocked(dumpTimeNs, include_current_partial_bucket);
     }
 
+    // The second half of onDumpReport(): writes a report returned by prepareDumpReport() to
+    // [protoOutput]. It doesn't lock, as it only reads the report and the configuration of the
+    // metric, which doesn't change once the producer is created.
+    virtual void writeDumpReport(PreparedDumpReport* report, std::set<string> *str_set,
+                                 android::util::ProtoOutputStream* protoOutput) const = 0;
+
     void clearPastBuckets(const int64_t dumpTimeNs) {
         std::lock_guard<std::mutex> lock(mMutex);
         return clearPastBucketsLocked(dumpTimeNs);
@@ -181,10 +204,8 @@ protected:
     virtual void onConditionChangedLocked(const bool condition, const int64_t eventTime) = 0;
     virtual void onSlicedConditionMayChangeLocked(bool overallCondition,
                                                   const int64_t eventTime) = 0;
-    virtual void onDumpReportLocked(const int64_t dumpTimeNs,
-                                    const bool include_current_partial_bucket,
-                                    std::set<string> *str_set,
-                                    android::util::ProtoOutputStream* protoOutput) = 0;
+    virtual std::unique_ptr<PreparedDumpReport> prepareDumpReportLocked(
+            const int64_t dumpTimeNs, const bool include_current_partial_bucket) = 0;
     virtual void clearPastBucketsLocked(const int64_t dumpTimeNs) = 0;
     virtual size_t byteSizeLocked() const = 0;
     virtual void dumpStatesLocked(FILE* out, bool verbose) const = 0;
@@ -221,7 +242,7 @@ protected:
         return mTimeBaseNs + (mCurrentBucketNum + 1) * mBucketSizeNs;
     }
 
-    int64_t getBucketNumFromEndTimeNs(const int64_t endNs) {
+    int64_t getBucketNumFromEndTimeNs(const int64_t endNs) const {
         return (endNs - mTimeBaseNs) / mBucketSizeNs - 1;
     }
 
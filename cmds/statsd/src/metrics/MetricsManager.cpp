@@ -21,6 +21,7 @@
 #include "CountMetricProducer.h"
 #include "condition/CombinationConditionTracker.h"
 #include "condition/SimpleConditionTracker.h"
+#include "guardrail/ProcessingStageTimer.h"
 #include "guardrail/StatsdStats.h"
 #include "matchers/CombinationLogMatchingTracker.h"
 #include "matchers/SimpleLogMatchingTracker.h"
@@ -28,6 +29,7 @@
 #include "stats_util.h"
 #include "stats_log_util.h"
 
+#include <algorithm>
 #include <log/logprint.h>
 #include <private/android_filesystem_config.h>
 #include <utils/SystemClock.h>
@@ -42,6 +44,7 @@ using android::util::ProtoOutputStream;
 using std::make_unique;
 using std::set;
 using std::string;
+using std::unique_ptr;
 using std::unordered_map;
 using std::vector;
 
@@ -76,6 +79,10 @@ MetricsManager::MetricsManager(const ConfigKey& key, const StatsdConfig& config,
 
     mHashStringsInReport = config.hash_strings_in_metric_report();
 
+    if (mConfigValid) {
+        initTagIdToMatcherIndices();
+    }
+
     if (config.allowed_log_source_size() == 0) {
         mConfigValid = false;
         ALOGE("Log source whitelist is empty! This config won't get any data. Suggest adding at "
@@ -124,6 +131,34 @@ MetricsManager::~MetricsManager() {
     VLOG("~MetricsManager()");
 }
 
+void MetricsManager::initTagIdToMatcherIndices() {
+    std::unordered_map<int, set<int>> tagIdToMatchers;
+    for (size_t i = 0; i < mAllAtomMatchers.size(); i++) {
+        // Evaluating a combination matcher also evaluates its children, even the ones that are
+        // about other atoms.
+        set<int> dependencies;
+        vector<int> stack = {(int)i};
+        while (!stack.empty()) {
+            const int index = stack.back();
+            stack.pop_back();
+            if (dependencies.insert(index).second) {
+                const vector<int>& children = mAllAtomMatchers[index]->getChildren();
+                stack.insert(stack.end(), children.begin(), children.end());
+            }
+        }
+
+        for (const int tagId : mAllAtomMatchers[i]->getAtomIds()) {
+            tagIdToMatchers[tagId].insert(dependencies.begin(), dependencies.end());
+        }
+    }
+
+    mTagIdToMatcherIndices.clear();
+    for (const auto& pair : tagIdToMatchers) {
+        mTagIdToMatcherIndices[pair.first].assign(pair.second.begin(), pair.second.end());
+    }
+    mMatcherCache.assign(mAllAtomMatchers.size(), MatchingState::kNotComputed);
+}
+
 void MetricsManager::initLogSourceWhiteList() {
     std::lock_guard<std::mutex> lock(mAllowedLogSourcesMutex);
     mAllowedLogSources.clear();
@@ -197,24 +232,44 @@ void MetricsManager::onDumpReport(const int64_t dumpTimeStampNs,
                                   const bool include_current_partial_bucket,
                                   std::set<string> *str_set,
                                   ProtoOutputStream* protoOutput) {
-    VLOG("=========================Metric Reports Start==========================");
-    // one StatsLogReport per MetricProduer
+    writeDumpReport(prepareDumpReport(dumpTimeStampNs, include_current_partial_bucket), str_set,
+                    protoOutput);
+}
+
+vector<unique_ptr<PreparedDumpReport>> MetricsManager::prepareDumpReport(
+        const int64_t dumpTimeStampNs, const bool include_current_partial_bucket) {
+    vector<unique_ptr<PreparedDumpReport>> reports;
+    reports.reserve(mAllMetricProducers.size());
     for (const auto& producer : mAllMetricProducers) {
         if (mNoReportMetricIds.find(producer->getMetricId()) == mNoReportMetricIds.end()) {
-            uint64_t token = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_METRICS);
-            if (mHashStringsInReport) {
-                producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, str_set,
-                                       protoOutput);
-            } else {
-                producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, nullptr,
-                                       protoOutput);
-            }
-            protoOutput->end(token);
+            reports.push_back(
+                    producer->prepareDumpReport(dumpTimeStampNs, include_current_partial_bucket));
         } else {
             producer->clearPastBuckets(dumpTimeStampNs);
         }
     }
+
+    mLastReportTimeNs = dumpTimeStampNs;
+    mLastReportWallClockNs = getWallClockNs();
+    return reports;
+}
+
+void MetricsManager::writeDumpReport(const vector<unique_ptr<PreparedDumpReport>>& reports,
+                                     std::set<string> *str_set,
+                                     ProtoOutputStream* protoOutput) const {
+    VLOG("=========================Metric Reports Start==========================");
+    // one StatsLogReport per MetricProduer
+    size_t reportIndex = 0;
+    for (const auto& producer : mAllMetricProducers) {
+        if (mNoReportMetricIds.find(producer->getMetricId()) != mNoReportMetricIds.end()) {
+            continue;
+        }
+        uint64_t token = protoOutput->start(
+                FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_METRICS);
+        producer->writeDumpReport(reports[reportIndex++].get(),
+                                  mHashStringsInReport ? str_set : nullptr, protoOutput);
+        protoOutput->end(token);
+    }
     for (const auto& annotation : mAnnotations) {
         uint64_t token = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
                                             FIELD_ID_ANNOTATIONS);
@@ -223,9 +278,6 @@ void MetricsManager::onDumpReport(const int64_t dumpTimeStampNs,
         protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_ANNOTATIONS_INT32, annotation.second);
         protoOutput->end(token);
     }
-
-    mLastReportTimeNs = dumpTimeStampNs;
-    mLastReportWallClockNs = getWallClockNs();
     VLOG("=========================Metric Reports End==========================");
 }
 
@@ -304,81 +356,104 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
         return;
     }
 
-    vector<MatchingState> matcherCache(mAllAtomMatchers.size(), MatchingState::kNotComputed);
-
-    for (auto& matcher : mAllAtomMatchers) {
-        matcher->onLogEvent(event, mAllAtomMatchers, matcherCache);
+    auto matchersIt = mTagIdToMatcherIndices.find(tagId);
+    if (matchersIt == mTagIdToMatcherIndices.end()) {
+        return;
     }
+    const vector<int>& matcherIndices = matchersIt->second;
 
-    // A bitmap to see which ConditionTracker needs to be re-evaluated.
-    vector<bool> conditionToBeEvaluated(mAllConditionTrackers.size(), false);
-
-    for (const auto& pair : mTrackerToConditionMap) {
-        if (matcherCache[pair.first] == MatchingState::kMatched) {
-            const auto& conditionList = pair.second;
-            for (const int conditionIndex : conditionList) {
-                conditionToBeEvaluated[conditionIndex] = true;
-            }
+    // Matchers that are not in the list can't match this atom, so their results stay
+    // kNotComputed.
+    {
+        ScopedProcessingStageTimer timer(PROCESSING_STAGE_MATCHING);
+        for (const int i : matcherIndices) {
+            mAllAtomMatchers[i]->onLogEvent(event, mAllAtomMatchers, mMatcherCache);
         }
     }
 
-    vector<ConditionState> conditionCache(mAllConditionTrackers.size(),
-                                          ConditionState::kNotEvaluated);
-    // A bitmap to track if a condition has changed value.
-    vector<bool> changedCache(mAllConditionTrackers.size(), false);
-    for (size_t i = 0; i < mAllConditionTrackers.size(); i++) {
-        if (conditionToBeEvaluated[i] == false) {
+    vector<int> matchedIndices;
+    // The ConditionTrackers that need to be re-evaluated. Only these can change value.
+    vector<int> conditionsToBeEvaluated;
+    for (const int i : matcherIndices) {
+        if (mMatcherCache[i] != MatchingState::kMatched) {
             continue;
         }
-        sp<ConditionTracker>& condition = mAllConditionTrackers[i];
-        condition->evaluateCondition(event, matcherCache, mAllConditionTrackers, conditionCache,
-                                     changedCache);
+        matchedIndices.push_back(i);
+        auto pair = mTrackerToConditionMap.find(i);
+        if (pair != mTrackerToConditionMap.end()) {
+            conditionsToBeEvaluated.insert(conditionsToBeEvaluated.end(), pair->second.begin(),
+                                           pair->second.end());
+        }
     }
 
-    for (size_t i = 0; i < mAllConditionTrackers.size(); i++) {
-        if (changedCache[i] == false) {
-            continue;
+    if (!conditionsToBeEvaluated.empty()) {
+        std::sort(conditionsToBeEvaluated.begin(), conditionsToBeEvaluated.end());
+        conditionsToBeEvaluated.erase(
+                std::unique(conditionsToBeEvaluated.begin(), conditionsToBeEvaluated.end()),
+                conditionsToBeEvaluated.end());
+
+        vector<ConditionState> conditionCache(mAllConditionTrackers.size(),
+                                              ConditionState::kNotEvaluated);
+        // A bitmap to track if a condition has changed value.
+        vector<bool> changedCache(mAllConditionTrackers.size(), false);
+        {
+            ScopedProcessingStageTimer timer(PROCESSING_STAGE_CONDITION);
+            for (const int i : conditionsToBeEvaluated) {
+                sp<ConditionTracker>& condition = mAllConditionTrackers[i];
+                condition->evaluateCondition(event, mMatcherCache, mAllConditionTrackers,
+                                             conditionCache, changedCache);
+            }
         }
-        auto pair = mConditionToMetricMap.find(i);
-        if (pair != mConditionToMetricMap.end()) {
-            auto& metricList = pair->second;
-            for (auto metricIndex : metricList) {
-                // metric cares about non sliced condition, and it's changed.
-                // Push the new condition to it directly.
-                if (!mAllMetricProducers[metricIndex]->isConditionSliced()) {
-                    mAllMetricProducers[metricIndex]->onConditionChanged(conditionCache[i],
-                                                                         eventTime);
-                    // metric cares about sliced conditions, and it may have changed. Send
-                    // notification, and the metric can query the sliced conditions that are
-                    // interesting to it.
-                } else {
-                    mAllMetricProducers[metricIndex]->onSlicedConditionMayChange(conditionCache[i],
-                                                                                 eventTime);
+
+        ScopedProcessingStageTimer metricsTimer(PROCESSING_STAGE_METRICS);
+        for (const int i : conditionsToBeEvaluated) {
+            if (changedCache[i] == false) {
+                continue;
+            }
+            auto pair = mConditionToMetricMap.find(i);
+            if (pair != mConditionToMetricMap.end()) {
+                auto& metricList = pair->second;
+                for (auto metricIndex : metricList) {
+                    // metric cares about non sliced condition, and it's changed.
+                    // Push the new condition to it directly.
+                    if (!mAllMetricProducers[metricIndex]->isConditionSliced()) {
+                        mAllMetricProducers[metricIndex]->onConditionChanged(conditionCache[i],
+                                                                             eventTime);
+                        // metric cares about sliced conditions, and it may have changed. Send
+                        // notification, and the metric can query the sliced conditions that are
+                        // interesting to it.
+                    } else {
+                        mAllMetricProducers[metricIndex]->onSlicedConditionMayChange(
+                                conditionCache[i], eventTime);
+                    }
                 }
             }
         }
     }
 
     // For matched AtomMatchers, tell relevant metrics that a matched event has come.
-    for (size_t i = 0; i < mAllAtomMatchers.size(); i++) {
-        if (matcherCache[i] == MatchingState::kMatched) {
-            StatsdStats::getInstance().noteMatcherMatched(mConfigKey,
-                                                          mAllAtomMatchers[i]->getId());
-            auto pair = mTrackerToMetricMap.find(i);
-            if (pair != mTrackerToMetricMap.end()) {
-                auto& metricList = pair->second;
-                for (const int metricIndex : metricList) {
-                    // pushed metrics are never scheduled pulls
-                    mAllMetricProducers[metricIndex]->onMatchedLogEvent(i, event);
-                }
+    ScopedProcessingStageTimer timer(PROCESSING_STAGE_METRICS);
+    for (const int i : matchedIndices) {
+        StatsdStats::getInstance().noteMatcherMatched(mConfigKey, mAllAtomMatchers[i]->getId());
+        auto pair = mTrackerToMetricMap.find(i);
+        if (pair != mTrackerToMetricMap.end()) {
+            auto& metricList = pair->second;
+            for (const int metricIndex : metricList) {
+                // pushed metrics are never scheduled pulls
+                mAllMetricProducers[metricIndex]->onMatchedLogEvent(i, event);
             }
         }
     }
+
+    for (const int i : matcherIndices) {
+        mMatcherCache[i] = MatchingState::kNotComputed;
+    }
 }
 
 void MetricsManager::onAnomalyAlarmFired(
         const int64_t& timestampNs,
         unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>>& alarmSet) {
+    ScopedProcessingStageTimer timer(PROCESSING_STAGE_ANOMALY);
     for (const auto& itr : mAllAnomalyTrackers) {
         itr->informAlarmsFired(timestampNs, alarmSet);
     }
@@ -108,6 +108,17 @@ public:
                               std::set<string> *str_set,
                               android::util::ProtoOutputStream* protoOutput);
 
+    // The two halves of onDumpReport(). prepareDumpReport() moves the data to report out of the
+    // metric producers and starts a new report period. writeDumpReport() then encodes it without
+    // locking the producers, so that events keep being processed meanwhile. The reports are in
+    // the order of the producers, with no report for the metrics that are not reported.
+    std::vector<std::unique_ptr<PreparedDumpReport>> prepareDumpReport(
+            const int64_t dumpTimeNs, const bool include_current_partial_bucket);
+
+    void writeDumpReport(const std::vector<std::unique_ptr<PreparedDumpReport>>& reports,
+                         std::set<string> *str_set,
+                         android::util::ProtoOutputStream* protoOutput) const;
+
     // Computes the total byte size of all metrics managed by a single config source.
     // Does not change the state.
     virtual size_t byteSize();
@@ -193,8 +204,20 @@ private:
     // maps from ConditionTracker to MetricProducer
     std::unordered_map<int, std::vector<int>> mConditionToMetricMap;
 
+    // maps from an atom tag id to the indices, in increasing order, of the LogMatchingTrackers
+    // that can match it, and of the matchers they are combined from. Only these matchers are
+    // evaluated for an event, so that the cost of an event doesn't grow with the number of
+    // matchers for other atoms.
+    std::unordered_map<int, std::vector<int>> mTagIdToMatcherIndices;
+
+    // The matching results of the current event, indexed like mAllAtomMatchers. Only the entries
+    // of the event's matchers are used, and they are reset to kNotComputed after each event.
+    std::vector<MatchingState> mMatcherCache;
+
     void initLogSourceWhiteList();
 
+    void initTagIdToMatcherIndices();
+
     // The metrics that don't need to be uploaded or even reported.
     std::set<int64_t> mNoReportMetricIds;
 
@@ -226,6 +249,8 @@ private:
     FRIEND_TEST(AnomalyDetectionE2eTest, TestDurationMetric_SUM_multiple_buckets);
     FRIEND_TEST(AnomalyDetectionE2eTest, TestDurationMetric_SUM_long_refractory_period);
 
+    FRIEND_TEST(MetricsManagerTest, TestTagIdToMatcherIndices);
+
     FRIEND_TEST(AlarmE2eTest, TestMultipleAlarms);
     FRIEND_TEST(ConfigTtlE2eTest, TestCountMetric);
 };
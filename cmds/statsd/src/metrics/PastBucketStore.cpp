@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PastBucketStore.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::vector;
+
+constexpr size_t PastBucketStore::kColumnOverheadBytes;
+
+static void writeVarint(uint64_t value, vector<uint8_t>* out) {
+    while (value >= 0x80) {
+        out->push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<uint8_t>(value));
+}
+
+static uint64_t readVarint(const vector<uint8_t>& data, size_t* pos) {
+    uint64_t value = 0;
+    for (int shift = 0; *pos < data.size(); shift += 7) {
+        const uint8_t byte = data[(*pos)++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    return value;
+}
+
+// Zigzag encoding, so that small negative differences take as few bytes as small positive ones.
+static uint64_t encodeZigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t decodeZigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void PastBucketStore::add(const MetricDimensionKey& key, int64_t bucketStartNs,
+                          int64_t bucketEndNs, int64_t value) {
+    // All the dimensions of a bucket are added one after the other, so only the last boundaries
+    // can be shared.
+    if (mBoundaries.empty() || mBoundaries.back().first != bucketStartNs ||
+        mBoundaries.back().second != bucketEndNs) {
+        mBoundaries.emplace_back(bucketStartNs, bucketEndNs);
+    }
+    const size_t boundaryIndex = mBoundaries.size() - 1;
+
+    Column& column = mColumns[key];
+    writeVarint(boundaryIndex - column.lastBoundaryIndex, &column.data);
+    // The difference is computed in uint64_t, as it may overflow int64_t.
+    writeVarint(encodeZigzag(static_cast<int64_t>(static_cast<uint64_t>(value) -
+                                                  static_cast<uint64_t>(column.lastValue))),
+                &column.data);
+    column.bucketCount++;
+    column.lastBoundaryIndex = boundaryIndex;
+    column.lastValue = value;
+}
+
+vector<PastBucket> PastBucketStore::getBuckets(const MetricDimensionKey& key) const {
+    vector<PastBucket> buckets;
+    const auto it = mColumns.find(key);
+    if (it != mColumns.end()) {
+        decode(it->second, &buckets);
+    }
+    return buckets;
+}
+
+void PastBucketStore::decode(const Column& column, vector<PastBucket>* buckets) const {
+    buckets->reserve(buckets->size() + column.bucketCount);
+    size_t pos = 0;
+    size_t boundaryIndex = 0;
+    int64_t value = 0;
+    for (size_t i = 0; i < column.bucketCount; i++) {
+        boundaryIndex += readVarint(column.data, &pos);
+        value = static_cast<int64_t>(static_cast<uint64_t>(value) +
+                                     static_cast<uint64_t>(decodeZigzag(
+                                             readVarint(column.data, &pos))));
+        const auto& boundaries = mBoundaries[boundaryIndex];
+        buckets->push_back({boundaries.first, boundaries.second, value});
+    }
+}
+
+size_t PastBucketStore::byteSize() const {
+    size_t totalSize = mBoundaries.capacity() * sizeof(mBoundaries[0]);
+    for (const auto& pair : mColumns) {
+        totalSize += pair.second.data.capacity() + kColumnOverheadBytes;
+    }
+    return totalSize;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
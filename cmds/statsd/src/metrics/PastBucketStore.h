@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "HashableDimensionKey.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+struct PastBucket {
+    int64_t mBucketStartNs;
+    int64_t mBucketEndNs;
+    int64_t mValue;
+};
+
+/**
+ * Compact storage for the past buckets of a metric whose buckets hold one int64 per dimension.
+ *
+ * All the dimensions flushed together share their bucket boundaries, so the boundaries are kept
+ * once in a table. Each dimension keeps a column of varints: for each of its buckets, the distance
+ * from its previous bucket in the boundary table, then the zigzag-encoded difference from its
+ * previous value. A bucket that takes 24 bytes as a PastBucket usually takes 2 to 3 bytes here.
+ * The buckets are only decoded when a report is written.
+ */
+class PastBucketStore {
+public:
+    struct Column {
+        std::vector<uint8_t> data;
+
+        // The number of buckets in data.
+        size_t bucketCount = 0;
+
+        // The last bucket written to data, which the next one is encoded relative to.
+        size_t lastBoundaryIndex = 0;
+        int64_t lastValue = 0;
+    };
+
+    // What a column takes besides its data: its map node, with the key, the Column and the links
+    // of the hash table.
+    static constexpr size_t kColumnOverheadBytes =
+            sizeof(std::pair<const MetricDimensionKey, Column>) + 2 * sizeof(void*);
+
+    typedef std::unordered_map<MetricDimensionKey, Column>::const_iterator const_iterator;
+
+    /**
+     * Adds the value of [key] in the bucket [bucketStartNs, bucketEndNs). Buckets must be added in
+     * time order.
+     */
+    void add(const MetricDimensionKey& key, int64_t bucketStartNs, int64_t bucketEndNs,
+             int64_t value);
+
+    /**
+     * Returns the buckets of [key] in the order they were added, or no bucket if [key] has none.
+     */
+    std::vector<PastBucket> getBuckets(const MetricDimensionKey& key) const;
+
+    /**
+     * Decodes the buckets of a column, in the order they were added, to the end of [buckets].
+     */
+    void decode(const Column& column, std::vector<PastBucket>* buckets) const;
+
+    /**
+     * Estimates the memory used by the buckets: the allocated boundary table and columns, and the
+     * fixed overhead of each column. Guardrails depend on it, so it counts the memory allocated
+     * rather than the bytes used.
+     */
+    size_t byteSize() const;
+
+    void clear() {
+        // Releases the boundary table, which would otherwise keep its capacity.
+        std::vector<std::pair<int64_t, int64_t>>().swap(mBoundaries);
+        mColumns.clear();
+    }
+
+    // The number of dimensions with buckets.
+    size_t size() const {
+        return mColumns.size();
+    }
+
+    bool empty() const {
+        return mColumns.empty();
+    }
+
+    const_iterator find(const MetricDimensionKey& key) const {
+        return mColumns.find(key);
+    }
+
+    const_iterator begin() const {
+        return mColumns.begin();
+    }
+
+    const_iterator end() const {
+        return mColumns.end();
+    }
+
+private:
+    // The start and end of the buckets, in time order.
+    std::vector<std::pair<int64_t, int64_t>> mBoundaries;
+
+    std::unordered_map<MetricDimensionKey, Column> mColumns;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
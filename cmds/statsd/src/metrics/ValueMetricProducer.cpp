@@ -25,6 +25,8 @@
 #include <limits.h>
 #include <stdlib.h>
 
+#include <algorithm>
+
 using android::util::FIELD_COUNT_REPEATED;
 using android::util::FIELD_TYPE_BOOL;
 using android::util::FIELD_TYPE_FLOAT;
@@ -167,17 +169,26 @@ void ValueMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mSkippedBuckets.clear();
 }
 
-void ValueMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
-                                             const bool include_current_partial_bucket,
-                                             std::set<string> *str_set,
-                                             ProtoOutputStream* protoOutput) {
-    VLOG("metric %lld dump report now...", (long long)mMetricId);
+std::unique_ptr<PreparedDumpReport> ValueMetricProducer::prepareDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket) {
     if (include_current_partial_bucket) {
         flushLocked(dumpTimeNs);
     } else {
         flushIfNeededLocked(dumpTimeNs);
     }
-    if (mPastBuckets.empty() && mSkippedBuckets.empty()) {
+    PreparedReport* report = new PreparedReport();
+    std::swap(report->pastBuckets, mPastBuckets);
+    std::swap(report->skippedBuckets, mSkippedBuckets);
+    return std::unique_ptr<PreparedDumpReport>(report);
+}
+
+void ValueMetricProducer::writeDumpReport(PreparedDumpReport* report,
+                                          std::set<string> *str_set,
+                                          ProtoOutputStream* protoOutput) const {
+    VLOG("metric %lld dump report now...", (long long)mMetricId);
+    const PreparedReport* valueReport = static_cast<PreparedReport*>(report);
+    const PastBucketStore& pastBuckets = valueReport->pastBuckets;
+    if (pastBuckets.empty() && valueReport->skippedBuckets.empty()) {
         return;
     }
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
@@ -201,7 +212,7 @@ void ValueMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
 
     uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_VALUE_METRICS);
 
-    for (const auto& pair : mSkippedBuckets) {
+    for (const auto& pair : valueReport->skippedBuckets) {
         uint64_t wrapperToken =
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SKIPPED);
         protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKIPPED_START_MILLIS,
@@ -210,9 +221,9 @@ void ValueMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                            (long long)(NanoToMillis(pair.second)));
         protoOutput->end(wrapperToken);
     }
-    mSkippedBuckets.clear();
 
-    for (const auto& pair : mPastBuckets) {
+    std::vector<PastBucket> buckets;
+    for (const auto& pair : pastBuckets) {
         const MetricDimensionKey& dimensionKey = pair.first;
         VLOG("  dimension key %s", dimensionKey.toString().c_str());
         uint64_t wrapperToken =
@@ -242,7 +253,9 @@ void ValueMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
         }
 
         // Then fill bucket_info (ValueBucketInfo).
-        for (const auto& bucket : pair.second) {
+        buckets.clear();
+        pastBuckets.decode(pair.second, &buckets);
+        for (const auto& bucket : buckets) {
             uint64_t bucketInfoToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
 
@@ -266,7 +279,6 @@ void ValueMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
     protoOutput->end(protoToken);
 
     VLOG("metric %lld dump report now...", (long long)mMetricId);
-    mPastBuckets.clear();
 }
 
 void ValueMetricProducer::onConditionChangedLocked(const bool condition,
@@ -458,30 +470,22 @@ void ValueMetricProducer::flushCurrentBucketLocked(const int64_t& eventTimeNs) {
          (int)mCurrentSlicedBucket.size());
     int64_t fullBucketEndTimeNs = getCurrentBucketEndTimeNs();
 
-    ValueBucket info;
-    info.mBucketStartNs = mCurrentBucketStartTimeNs;
-    if (eventTimeNs < fullBucketEndTimeNs) {
-        info.mBucketEndNs = eventTimeNs;
-    } else {
-        info.mBucketEndNs = fullBucketEndTimeNs;
-    }
+    const int64_t bucketEndNs = std::min(eventTimeNs, fullBucketEndTimeNs);
 
-    if (info.mBucketEndNs - mCurrentBucketStartTimeNs >= mMinBucketSizeNs) {
+    if (bucketEndNs - mCurrentBucketStartTimeNs >= mMinBucketSizeNs) {
         // The current bucket is large enough to keep.
         int tainted = 0;
         for (const auto& slice : mCurrentSlicedBucket) {
             tainted += slice.second.tainted;
             tainted += slice.second.startUpdated;
             if (slice.second.hasValue) {
-                info.mValue = slice.second.sum;
-                // it will auto create new vector of ValuebucketInfo if the key is not found.
-                auto& bucketList = mPastBuckets[slice.first];
-                bucketList.push_back(info);
+                mPastBuckets.add(slice.first, mCurrentBucketStartTimeNs, bucketEndNs,
+                                 slice.second.sum);
             }
         }
         VLOG("%d tainted pairs in the bucket", tainted);
     } else {
-        mSkippedBuckets.emplace_back(info.mBucketStartNs, info.mBucketEndNs);
+        mSkippedBuckets.emplace_back(mCurrentBucketStartTimeNs, bucketEndNs);
     }
 
     if (eventTimeNs > fullBucketEndTimeNs) {  // If full bucket, send to anomaly tracker.
@@ -520,11 +524,7 @@ void ValueMetricProducer::flushCurrentBucketLocked(const int64_t& eventTimeNs) {
 }
 
 size_t ValueMetricProducer::byteSizeLocked() const {
-    size_t totalSize = 0;
-    for (const auto& pair : mPastBuckets) {
-        totalSize += pair.second.size() * kBucketSize;
-    }
-    return totalSize;
+    return mPastBuckets.byteSize();
 }
 
 }  // namespace statsd
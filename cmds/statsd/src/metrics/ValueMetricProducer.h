@@ -24,18 +24,13 @@
 #include "../external/PullDataReceiver.h"
 #include "../external/StatsPullerManager.h"
 #include "MetricProducer.h"
+#include "PastBucketStore.h"
 #include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
 
 namespace android {
 namespace os {
 namespace statsd {
 
-struct ValueBucket {
-    int64_t mBucketStartNs;
-    int64_t mBucketEndNs;
-    int64_t mValue;
-};
-
 class ValueMetricProducer : public virtual MetricProducer, public virtual PullDataReceiver {
 public:
     ValueMetricProducer(const ConfigKey& key, const ValueMetric& valueMetric,
@@ -81,6 +76,9 @@ public:
         }
     };
 
+    void writeDumpReport(PreparedDumpReport* report, std::set<string> *str_set,
+                         android::util::ProtoOutputStream* protoOutput) const override;
+
 protected:
     void onMatchedLogEventInternalLocked(
             const size_t matcherIndex, const MetricDimensionKey& eventKey,
@@ -88,10 +86,15 @@ protected:
             const LogEvent& event) override;
 
 private:
-    void onDumpReportLocked(const int64_t dumpTimeNs,
-                            const bool include_current_partial_bucket,
-                            std::set<string> *str_set,
-                            android::util::ProtoOutputStream* protoOutput) override;
+    // The past and skipped buckets of a report.
+    struct PreparedReport : public PreparedDumpReport {
+        PastBucketStore pastBuckets;
+        std::list<std::pair<int64_t, int64_t>> skippedBuckets;
+    };
+
+    std::unique_ptr<PreparedDumpReport> prepareDumpReportLocked(
+            const int64_t dumpTimeNs, const bool include_current_partial_bucket) override;
+
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
     // Internal interface to handle condition change.
@@ -150,7 +153,7 @@ private:
 
     // Save the past buckets and we can clear when the StatsLogReport is dumped.
     // TODO: Add a lock to mPastBuckets.
-    std::unordered_map<MetricDimensionKey, std::vector<ValueBucket>> mPastBuckets;
+    PastBucketStore mPastBuckets;
 
     // Pairs of (elapsed start, elapsed end) denoting buckets that were skipped.
     std::list<std::pair<int64_t, int64_t>> mSkippedBuckets;
@@ -160,8 +163,6 @@ private:
     // Util function to check whether the specified dimension hits the guardrail.
     bool hitGuardRailLocked(const MetricDimensionKey& newKey);
 
-    static const size_t kBucketSize = sizeof(ValueBucket{});
-
     const size_t mDimensionSoftLimit;
 
     const size_t mDimensionHardLimit;
@@ -51,6 +51,7 @@ const int FIELD_ID_SNAPSHOT_PACKAGE_DELETED = 4;
 const int FIELD_ID_SNAPSHOT_PACKAGE_NAME_HASH = 5;
 const int FIELD_ID_SNAPSHOT_TIMESTAMP = 1;
 const int FIELD_ID_SNAPSHOT_PACKAGE_INFO = 2;
+const int FIELD_ID_SNAPSHOT_IS_DELTA = 3;
 const int FIELD_ID_SNAPSHOTS = 1;
 const int FIELD_ID_CHANGES = 2;
 const int FIELD_ID_CHANGE_DELETION = 1;
@@ -68,8 +69,94 @@ UidMap::~UidMap() {}
 bool UidMap::hasApp(int uid, const string& packageName) const {
     lock_guard<mutex> lock(mMutex);
 
-    auto it = mMap.find(std::make_pair(uid, packageName));
-    return it != mMap.end() && !it->second.deleted;
+    const UidApp* app = findAppLocked(uid, packageName);
+    return app != nullptr && !app->data.deleted;
+}
+
+bool UidMap::hasNormalizedApp(int uid, const string& normalizedPackageName) const {
+    lock_guard<mutex> lock(mMutex);
+
+    const int normalizedPackageId = getPackageIdLocked(normalizedPackageName);
+    if (normalizedPackageId < 0) {
+        return false;
+    }
+    auto it = mUidApps.find(uid);
+    if (it == mUidApps.end()) {
+        return false;
+    }
+    for (const UidApp& app : it->second) {
+        if (app.normalizedPackageId == normalizedPackageId && !app.data.deleted) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int UidMap::getPackageIdLocked(const string& name) const {
+    auto it = mPackageIds.find(name);
+    return it == mPackageIds.end() ? -1 : it->second;
+}
+
+int UidMap::internPackageNameLocked(const string& name) {
+    auto it = mPackageIds.find(name);
+    if (it != mPackageIds.end()) {
+        return it->second;
+    }
+    const int id = mPackageNames.size();
+    mPackageNames.push_back(name);
+    mPackageIds[name] = id;
+    return id;
+}
+
+const UidMap::UidApp* UidMap::findAppLocked(int uid, const string& packageName) const {
+    const int packageId = getPackageIdLocked(packageName);
+    if (packageId < 0) {
+        return nullptr;
+    }
+    auto it = mUidApps.find(uid);
+    if (it == mUidApps.end()) {
+        return nullptr;
+    }
+    for (const UidApp& app : it->second) {
+        if (app.packageId == packageId) {
+            return &app;
+        }
+    }
+    return nullptr;
+}
+
+UidMap::UidApp* UidMap::findAppLocked(int uid, const string& packageName) {
+    return const_cast<UidApp*>(static_cast<const UidMap*>(this)->findAppLocked(uid, packageName));
+}
+
+void UidMap::setAppLocked(int uid, const string& packageName, const AppData& data) {
+    UidApp* app = findAppLocked(uid, packageName);
+    if (app != nullptr) {
+        app->data = data;
+        return;
+    }
+    const int packageId = internPackageNameLocked(packageName);
+    const int normalizedPackageId = internPackageNameLocked(normalizeAppName(packageName));
+    mUidApps[uid].push_back({packageId, normalizedPackageId, data});
+}
+
+void UidMap::eraseAppLocked(int uid, const string& packageName) {
+    const int packageId = getPackageIdLocked(packageName);
+    auto it = mUidApps.find(uid);
+    if (packageId < 0 || it == mUidApps.end()) {
+        return;
+    }
+    vector<UidApp>& apps = it->second;
+    for (size_t i = 0; i < apps.size(); i++) {
+        if (apps[i].packageId == packageId) {
+            apps[i] = apps.back();
+            apps.pop_back();
+            break;
+        }
+    }
+    if (apps.empty()) {
+        mUidApps.erase(it);
+    }
 }
 
 string UidMap::normalizeAppName(const string& appName) const {
@@ -85,9 +172,13 @@ std::set<string> UidMap::getAppNamesFromUid(const int32_t& uid, bool returnNorma
 
 std::set<string> UidMap::getAppNamesFromUidLocked(const int32_t& uid, bool returnNormalized) const {
     std::set<string> names;
-    for (const auto& kv : mMap) {
-        if (kv.first.first == uid && !kv.second.deleted) {
-            names.insert(returnNormalized ? normalizeAppName(kv.first.second) : kv.first.second);
+    auto it = mUidApps.find(uid);
+    if (it == mUidApps.end()) {
+        return names;
+    }
+    for (const UidApp& app : it->second) {
+        if (!app.data.deleted) {
+            names.insert(mPackageNames[returnNormalized ? app.normalizedPackageId : app.packageId]);
         }
     }
     return names;
@@ -96,11 +187,11 @@ std::set<string> UidMap::getAppNamesFromUidLocked(const int32_t& uid, bool retur
 int64_t UidMap::getAppVersion(int uid, const string& packageName) const {
     lock_guard<mutex> lock(mMutex);
 
-    auto it = mMap.find(std::make_pair(uid, packageName));
-    if (it == mMap.end() || it->second.deleted) {
+    const UidApp* app = findAppLocked(uid, packageName);
+    if (app == nullptr || app->data.deleted) {
         return 0;
     }
-    return it->second.versionCode;
+    return app->data.versionCode;
 }
 
 void UidMap::updateMap(const int64_t& timestamp, const vector<int32_t>& uid,
@@ -109,29 +200,38 @@ void UidMap::updateMap(const int64_t& timestamp, const vector<int32_t>& uid,
     {
         lock_guard<mutex> lock(mMutex);  // Exclusively lock for updates.
 
-        std::unordered_map<std::pair<int, string>, AppData, PairHash> deletedApps;
+        vector<std::pair<std::pair<int, string>, AppData>> deletedApps;
 
         // Copy all the deleted apps.
-        for (const auto& kv : mMap) {
-            if (kv.second.deleted) {
-                deletedApps[kv.first] = kv.second;
+        for (const auto& kv : mUidApps) {
+            for (const UidApp& app : kv.second) {
+                if (app.data.deleted) {
+                    deletedApps.push_back(
+                            std::make_pair(std::make_pair(kv.first, mPackageNames[app.packageId]),
+                                           app.data));
+                }
             }
         }
 
-        mMap.clear();
+        mUidApps.clear();
+        mPackageNames.clear();
+        mPackageIds.clear();
         for (size_t j = 0; j < uid.size(); j++) {
             string package = string(String8(packageName[j]).string());
-            mMap[std::make_pair(uid[j], package)] = AppData(versionCode[j]);
+            setAppLocked(uid[j], package, AppData(versionCode[j], timestamp));
         }
 
         for (const auto& kv : deletedApps) {
-            auto mMapIt = mMap.find(kv.first);
-            if (mMapIt != mMap.end()) {
+            UidApp* app = findAppLocked(kv.first.first, kv.first.second);
+            if (app != nullptr) {
                 // Insert this deleted app back into the current map.
-                mMap[kv.first] = kv.second;
+                app->data = kv.second;
             }
         }
 
+        // The apps missing from the new map are only gone from the full snapshots.
+        mConfigKeysWithFullSnapshot.clear();
+
         ensureBytesUsedBelowLimit();
         StatsdStats::getInstance().setCurrentUidMapMemory(mBytesUsed);
         getListenerListCopyLocked(&broadcastList);
@@ -157,16 +257,17 @@ void UidMap::updateApp(const int64_t& timestamp, const String16& app_16, const i
         lock_guard<mutex> lock(mMutex);
         int32_t prevVersion = 0;
         bool found = false;
-        auto it = mMap.find(std::make_pair(uid, appName));
-        if (it != mMap.end()) {
+        UidApp* app = findAppLocked(uid, appName);
+        if (app != nullptr) {
             found = true;
-            prevVersion = it->second.versionCode;
-            it->second.versionCode = versionCode;
-            it->second.deleted = false;
+            prevVersion = app->data.versionCode;
+            app->data.versionCode = versionCode;
+            app->data.deleted = false;
+            app->data.lastUpdateNs = timestamp;
         }
         if (!found) {
             // Otherwise, we need to add an app at this uid.
-            mMap[std::make_pair(uid, appName)] = AppData(versionCode);
+            setAppLocked(uid, appName, AppData(versionCode, timestamp));
         } else {
             // Only notify the listeners if this is an app upgrade. If this app is being installed
             // for the first time, then we don't notify the listeners.
@@ -226,18 +327,18 @@ void UidMap::removeApp(const int64_t& timestamp, const String16& app_16, const i
         lock_guard<mutex> lock(mMutex);
 
         int64_t prevVersion = 0;
-        auto key = std::make_pair(uid, app);
-        auto it = mMap.find(key);
-        if (it != mMap.end() && !it->second.deleted) {
-            prevVersion = it->second.versionCode;
-            it->second.deleted = true;
-            mDeletedApps.push_back(key);
+        UidApp* uidApp = findAppLocked(uid, app);
+        if (uidApp != nullptr && !uidApp->data.deleted) {
+            prevVersion = uidApp->data.versionCode;
+            uidApp->data.deleted = true;
+            uidApp->data.lastUpdateNs = timestamp;
+            mDeletedApps.push_back(std::make_pair(uid, app));
         }
         if (mDeletedApps.size() > StatsdStats::kMaxDeletedAppsInUidMap) {
             // Delete the oldest one.
             auto oldest = mDeletedApps.front();
             mDeletedApps.pop_front();
-            mMap.erase(oldest);
+            eraseAppLocked(oldest.first, oldest.second);
             StatsdStats::getInstance().noteUidMapAppDeletionDropped();
         }
         mChanges.emplace_back(true, timestamp, app, uid, 0, prevVersion);
@@ -293,6 +394,7 @@ int UidMap::getHostUidOrSelf(int uid) const {
 
 void UidMap::clearOutput() {
     mChanges.clear();
+    mConfigKeysWithFullSnapshot.clear();
     // Also update the guardrail trackers.
     StatsdStats::getInstance().setUidMapChanges(0);
     mBytesUsed = 0;
@@ -342,29 +444,42 @@ void UidMap::appendUidMap(const int64_t& timestamp, const ConfigKey& key,
         }
     }
 
-    // Write snapshot from current uid map state.
+    // Write snapshot from current uid map state. Once the config has all the apps, only the apps
+    // updated since its last update are written.
+    const bool isDelta = mConfigKeysWithFullSnapshot.find(key) != mConfigKeysWithFullSnapshot.end();
+    const int64_t lastUpdateNs = mLastUpdatePerConfigKey[key];
     uint64_t snapshotsToken =
             proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SNAPSHOTS);
     proto->write(FIELD_TYPE_INT64 | FIELD_ID_SNAPSHOT_TIMESTAMP, (long long)timestamp);
-    for (const auto& kv : mMap) {
-        uint64_t token = proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
-                                      FIELD_ID_SNAPSHOT_PACKAGE_INFO);
-
-        if (str_set != nullptr) {
-            str_set->insert(kv.first.second);
-            proto->write(FIELD_TYPE_UINT64 | FIELD_ID_SNAPSHOT_PACKAGE_NAME_HASH,
-                         (long long)Hash64(kv.first.second));
-        } else {
-            proto->write(FIELD_TYPE_STRING | FIELD_ID_SNAPSHOT_PACKAGE_NAME, kv.first.second);
-        }
+    if (isDelta) {
+        proto->write(FIELD_TYPE_BOOL | FIELD_ID_SNAPSHOT_IS_DELTA, true);
+    }
+    for (const auto& kv : mUidApps) {
+        for (const UidApp& app : kv.second) {
+            if (isDelta && app.data.lastUpdateNs <= lastUpdateNs) {
+                continue;
+            }
+            const string& packageName = mPackageNames[app.packageId];
+            uint64_t token = proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
+                                          FIELD_ID_SNAPSHOT_PACKAGE_INFO);
+
+            if (str_set != nullptr) {
+                str_set->insert(packageName);
+                proto->write(FIELD_TYPE_UINT64 | FIELD_ID_SNAPSHOT_PACKAGE_NAME_HASH,
+                             (long long)Hash64(packageName));
+            } else {
+                proto->write(FIELD_TYPE_STRING | FIELD_ID_SNAPSHOT_PACKAGE_NAME, packageName);
+            }
 
-        proto->write(FIELD_TYPE_INT64 | FIELD_ID_SNAPSHOT_PACKAGE_VERSION,
-                     (long long)kv.second.versionCode);
-        proto->write(FIELD_TYPE_INT32 | FIELD_ID_SNAPSHOT_PACKAGE_UID, kv.first.first);
-        proto->write(FIELD_TYPE_BOOL | FIELD_ID_SNAPSHOT_PACKAGE_DELETED, kv.second.deleted);
-        proto->end(token);
+            proto->write(FIELD_TYPE_INT64 | FIELD_ID_SNAPSHOT_PACKAGE_VERSION,
+                         (long long)app.data.versionCode);
+            proto->write(FIELD_TYPE_INT32 | FIELD_ID_SNAPSHOT_PACKAGE_UID, kv.first);
+            proto->write(FIELD_TYPE_BOOL | FIELD_ID_SNAPSHOT_PACKAGE_DELETED, app.data.deleted);
+            proto->end(token);
+        }
     }
     proto->end(snapshotsToken);
+    mConfigKeysWithFullSnapshot.insert(key);
 
     int64_t prevMin = getMinimumTimestampNs();
     mLastUpdatePerConfigKey[key] = timestamp;
@@ -389,29 +504,44 @@ void UidMap::appendUidMap(const int64_t& timestamp, const ConfigKey& key,
 void UidMap::printUidMap(FILE* out) const {
     lock_guard<mutex> lock(mMutex);
 
-    for (const auto& kv : mMap) {
-        if (!kv.second.deleted) {
-            fprintf(out, "%s, v%" PRId64 " (%i)\n", kv.first.second.c_str(), kv.second.versionCode,
-                    kv.first.first);
+    for (const auto& kv : mUidApps) {
+        for (const UidApp& app : kv.second) {
+            if (!app.data.deleted) {
+                fprintf(out, "%s, v%" PRId64 " (%i)\n", mPackageNames[app.packageId].c_str(),
+                        app.data.versionCode, kv.first);
+            }
         }
     }
 }
 
 void UidMap::OnConfigUpdated(const ConfigKey& key) {
     mLastUpdatePerConfigKey[key] = -1;
+    mConfigKeysWithFullSnapshot.erase(key);
 }
 
 void UidMap::OnConfigRemoved(const ConfigKey& key) {
     mLastUpdatePerConfigKey.erase(key);
+    mConfigKeysWithFullSnapshot.erase(key);
+}
+
+void UidMap::OnConfigDataLost(const ConfigKey& key) {
+    lock_guard<mutex> lock(mMutex);
+    mConfigKeysWithFullSnapshot.erase(key);
 }
 
 set<int32_t> UidMap::getAppUid(const string& package) const {
     lock_guard<mutex> lock(mMutex);
 
     set<int32_t> results;
-    for (const auto& kv : mMap) {
-        if (kv.first.second == package && !kv.second.deleted) {
-            results.insert(kv.first.first);
+    const int packageId = getPackageIdLocked(package);
+    if (packageId < 0) {
+        return results;
+    }
+    for (const auto& kv : mUidApps) {
+        for (const UidApp& app : kv.second) {
+            if (app.packageId == packageId && !app.data.deleted) {
+                results.insert(kv.first);
+            }
         }
     }
     return results;
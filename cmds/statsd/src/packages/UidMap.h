@@ -32,6 +32,8 @@
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 using namespace android;
 using namespace std;
@@ -45,11 +47,13 @@ namespace statsd {
 struct AppData {
     int64_t versionCode;
     bool deleted;
+    // When the app was last installed, upgraded or removed, or received in a full map.
+    int64_t lastUpdateNs;
 
-    // Empty constructor needed for unordered map.
     AppData() {
     }
-    AppData(const int64_t v) : versionCode(v), deleted(false){};
+    AppData(const int64_t v, const int64_t timestampNs)
+        : versionCode(v), deleted(false), lastUpdateNs(timestampNs){};
 };
 
 // When calling appendUidMap, we retrieve all the ChangeRecords since the last
@@ -99,6 +103,10 @@ public:
     // Returns the app names from uid.
     std::set<string> getAppNamesFromUid(const int32_t& uid, bool returnNormalized) const;
 
+    // Returns true if the uid has an app whose normalized (lower case) name is the given one. Unlike
+    // getAppNamesFromUid(), it doesn't allocate, so it is the one to use when matching events.
+    bool hasNormalizedApp(int uid, const string& normalizedPackageName) const;
+
     int64_t getAppVersion(int uid, const string& packageName) const;
 
     // Helper for debugging contents of this uid map. Can be triggered with:
@@ -118,6 +126,10 @@ public:
     // Informs uid map that a config is removed. Used for keeping mConfigKeys up to date.
     void OnConfigRemoved(const ConfigKey& key);
 
+    // Informs uid map that reports of a config were dropped before reaching the client, so its
+    // next report has to carry a full snapshot rather than changes on top of a lost one.
+    void OnConfigDataLost(const ConfigKey& key);
+
     void assignIsolatedUid(int isolatedUid, int parentUid);
     void removeIsolatedUid(int isolatedUid, int parentUid);
 
@@ -127,6 +139,9 @@ public:
     // Gets all snapshots and changes that have occurred since the last output.
     // If every config key has received a change or snapshot record, then this
     // record is deleted.
+    // The first snapshot of a config after a full update of the map, or after clearOutput(), has
+    // all the apps. The following ones are deltas, with only the apps updated since the previous
+    // output to the config.
     void appendUidMap(const int64_t& timestamp, const ConfigKey& key,
                       std::set<string> *str_set, util::ProtoOutputStream* proto);
 
@@ -141,23 +156,41 @@ public:
     std::set<int32_t> getAppUid(const string& package) const;
 
 private:
+    // An app of a uid, with its interned names.
+    struct UidApp {
+        int packageId;
+        int normalizedPackageId;
+        AppData data;
+    };
+
     std::set<string> getAppNamesFromUidLocked(const int32_t& uid, bool returnNormalized) const;
     string normalizeAppName(const string& appName) const;
 
+    // Returns the id of the interned name, or -1 if it isn't interned.
+    int getPackageIdLocked(const string& name) const;
+    int internPackageNameLocked(const string& name);
+
+    // Returns nullptr if the uid doesn't have the app, deleted or not.
+    const UidApp* findAppLocked(int uid, const string& packageName) const;
+    UidApp* findAppLocked(int uid, const string& packageName);
+
+    // Adds the app to the uid, or replaces its data if the uid already has it.
+    void setAppLocked(int uid, const string& packageName, const AppData& data);
+    void eraseAppLocked(int uid, const string& packageName);
+
     void getListenerListCopyLocked(std::vector<wp<PackageInfoListener>>* output);
 
     // TODO: Use shared_mutex for improved read-locking if a library can be found in Android.
     mutable mutex mMutex;
     mutable mutex mIsolatedMutex;
 
-    struct PairHash {
-        size_t operator()(std::pair<int, string> p) const noexcept {
-            std::hash<std::string> hash_fn;
-            return hash_fn(std::to_string(p.first) + p.second);
-        }
-    };
-    // Maps uid and package name to application data.
-    std::unordered_map<std::pair<int, string>, AppData, PairHash> mMap;
+    // The package names, and their normalized names, indexed by their id. The names are interned
+    // again, dropping the ones no app has anymore, on each full update of the map.
+    std::vector<string> mPackageNames;
+    std::unordered_map<string, int> mPackageIds;
+
+    // Maps uid to its apps. Most uids only have one app, and few have more than a handful.
+    std::unordered_map<int, std::vector<UidApp>> mUidApps;
 
     // Maps isolated uid to the parent uid. Any metrics for an isolated uid will instead contribute
     // to the parent uid.
@@ -177,6 +210,10 @@ private:
     // Value of -1 denotes this config key has never received an upload.
     std::unordered_map<ConfigKey, int64_t> mLastUpdatePerConfigKey;
 
+    // The config keys that received a snapshot of all the apps since the last full update of the
+    // map. The next snapshots of these only have the apps updated since their last update.
+    std::unordered_set<ConfigKey> mConfigKeysWithFullSnapshot;
+
     // Returns the minimum value from mConfigKeys.
     int64_t getMinimumTimestampNs();
 
@@ -199,6 +236,7 @@ private:
     FRIEND_TEST(UidMapTest, TestOutputIncludesAtLeastOneSnapshot);
     FRIEND_TEST(UidMapTest, TestMemoryComputed);
     FRIEND_TEST(UidMapTest, TestMemoryGuardrail);
+    FRIEND_TEST(UidMapTest, TestPackageNamesInternedAgain);
 };
 
 }  // namespace statsd
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "LogEventQueue.h"
+
+#include <algorithm>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::unique_ptr;
+using std::vector;
+
+LogEventQueue::LogEventQueue(size_t capacity)
+    : mCapacity(capacity),
+      mEvents(capacity),
+      mPushCount(0),
+      mPopCount(0),
+      mConsumerWaiting(false),
+      mStopped(false) {
+}
+
+bool LogEventQueue::push(unique_ptr<LogEvent> event) {
+    const size_t pushCount = mPushCount.load(std::memory_order_relaxed);
+    // The acquire pairs with the release in popBatch(), so the consumer is done with the slot.
+    if (pushCount - mPopCount.load(std::memory_order_acquire) >= mCapacity) {
+        return false;
+    }
+    mEvents[pushCount % mCapacity] = std::move(event);
+
+    // Both the store and the load are sequentially consistent: either the consumer sees the new
+    // event before it starts waiting, or we see that it is waiting and wake it up.
+    mPushCount.store(pushCount + 1);
+    if (mConsumerWaiting.load()) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCondition.notify_one();
+    }
+    return true;
+}
+
+bool LogEventQueue::popBatch(vector<unique_ptr<LogEvent>>* out, size_t maxCount) {
+    const size_t popCount = mPopCount.load(std::memory_order_relaxed);
+    size_t pushCount = mPushCount.load(std::memory_order_acquire);
+    if (pushCount == popCount) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mConsumerWaiting.store(true);
+        while ((pushCount = mPushCount.load()) == popCount && !mStopped) {
+            mCondition.wait(lock);
+        }
+        mConsumerWaiting.store(false);
+        if (pushCount == popCount) {
+            return false;
+        }
+    }
+
+    const size_t count = std::min(pushCount - popCount, maxCount);
+    for (size_t i = 0; i < count; i++) {
+        out->push_back(std::move(mEvents[(popCount + i) % mCapacity]));
+    }
+    mPopCount.store(popCount + count, std::memory_order_release);
+    return true;
+}
+
+unique_ptr<LogEvent> LogEventQueue::tryPop() {
+    const size_t popCount = mPopCount.load(std::memory_order_relaxed);
+    if (mPushCount.load(std::memory_order_acquire) == popCount) {
+        return nullptr;
+    }
+
+    unique_ptr<LogEvent> event = std::move(mEvents[popCount % mCapacity]);
+    mPopCount.store(popCount + 1, std::memory_order_release);
+    return event;
+}
+
+void LogEventQueue::stop() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopped = true;
+    mCondition.notify_all();
+}
+
+size_t LogEventQueue::size() const {
+    // Load the pop count first: the push count can only have grown since.
+    const size_t popCount = mPopCount.load();
+    return mPushCount.load() - popCount;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
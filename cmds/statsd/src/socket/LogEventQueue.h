@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "logd/LogEvent.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * A bounded queue that hands LogEvents from the thread reading the statsd socket (the only
+ * producer) to the thread processing them (the only consumer).
+ *
+ * push() never blocks, and only takes a lock when the consumer is waiting for events, so a slow
+ * consumer can't stall the socket. Events that don't fit in the queue are dropped instead.
+ */
+class LogEventQueue {
+public:
+    explicit LogEventQueue(size_t capacity);
+
+    /**
+     * Adds an event to the queue. Returns false, and drops the event, if the queue is full.
+     * Must only be called from the producer thread.
+     */
+    bool push(std::unique_ptr<LogEvent> event);
+
+    /**
+     * Waits until the queue has events, and moves up to maxCount of them to the end of [out].
+     * Returns false once the queue has been stopped and is empty.
+     * Must only be called from the consumer thread.
+     */
+    bool popBatch(std::vector<std::unique_ptr<LogEvent>>* out, size_t maxCount);
+
+    /**
+     * Removes the oldest event from the queue without waiting. Returns nullptr if the queue is
+     * empty.
+     * Must only be called from the consumer thread.
+     */
+    std::unique_ptr<LogEvent> tryPop();
+
+    /**
+     * Makes popBatch() return false as soon as the queue is empty, instead of waiting.
+     */
+    void stop();
+
+    /**
+     * Returns the number of events in the queue.
+     */
+    size_t size() const;
+
+    size_t capacity() const {
+        return mCapacity;
+    }
+
+private:
+    const size_t mCapacity;
+
+    // Ring buffer of the events. The slot of the n-th event ever pushed is n % mCapacity.
+    std::vector<std::unique_ptr<LogEvent>> mEvents;
+
+    // The number of events pushed and popped so far. Only the producer writes mPushCount, and only
+    // the consumer writes mPopCount.
+    std::atomic<size_t> mPushCount;
+    std::atomic<size_t> mPopCount;
+
+    // Set while the consumer is waiting for mCondition, so that push() knows it must notify it.
+    std::atomic<bool> mConsumerWaiting;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+
+    // Guarded by mMutex.
+    bool mStopped;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
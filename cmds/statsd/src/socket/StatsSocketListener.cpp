@@ -29,6 +29,7 @@
 #include <cutils/sockets.h>
 #include <private/android_filesystem_config.h>
 #include <private/android_logger.h>
+#include <string.h>
 #include <unordered_map>
 
 #include "StatsSocketListener.h"
@@ -41,11 +42,49 @@ namespace statsd {
 
 static const int kLogMsgHeaderSize = 28;
 
-StatsSocketListener::StatsSocketListener(const sp<LogListener>& listener)
+// + 1 to ensure null terminator if MAX_PAYLOAD buffer is received
+static const size_t kReceiveBufferSize =
+        sizeof_log_id_t + sizeof(uint16_t) + sizeof(log_time) + LOGGER_ENTRY_MAX_PAYLOAD + 1;
+
+// The maximum number of queued events handed to the listener at once by the processing thread.
+static const size_t kMaxProcessBatchSize = 256;
+
+struct StatsSocketListener::ReceiveBuffer {
+    char data[kReceiveBufferSize];
+    struct iovec iov;
+    alignas(4) char control[CMSG_SPACE(sizeof(struct ucred))];
+};
+
+StatsSocketListener::StatsSocketListener(const sp<LogListener>& listener, size_t queueCapacity)
     : SocketListener(getLogSocket(), false /*start listen*/), mListener(listener) {
+    if (queueCapacity == 0) {
+        return;
+    }
+
+    mReceiveBuffers.reset(new ReceiveBuffer[kMaxBatchSize]);
+    mMessages.resize(kMaxBatchSize);
+    for (int i = 0; i < kMaxBatchSize; i++) {
+        ReceiveBuffer& buffer = mReceiveBuffers[i];
+        buffer.iov = {buffer.data, sizeof(buffer.data) - 1};
+        struct msghdr& hdr = mMessages[i].msg_hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = &buffer.iov;
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = buffer.control;
+    }
+
+    mQueue = std::make_unique<LogEventQueue>(queueCapacity);
+    // Room for every event that can be in flight: queued, being processed, or being read.
+    mFreeEvents = std::make_unique<LogEventQueue>(queueCapacity + kMaxProcessBatchSize +
+                                                  kMaxBatchSize);
+    mProcessingThread = std::thread([this] { processEvents(); });
 }
 
 StatsSocketListener::~StatsSocketListener() {
+    if (mQueue != nullptr) {
+        mQueue->stop();
+        mProcessingThread.join();
+    }
 }
 
 bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
@@ -55,23 +94,14 @@ bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
         name_set = true;
     }
 
-    // + 1 to ensure null terminator if MAX_PAYLOAD buffer is received
-    char buffer[sizeof_log_id_t + sizeof(uint16_t) + sizeof(log_time) + LOGGER_ENTRY_MAX_PAYLOAD +
-                1];
-    struct iovec iov = {buffer, sizeof(buffer) - 1};
-
-    alignas(4) char control[CMSG_SPACE(sizeof(struct ucred))];
-    struct msghdr hdr = {
-            NULL, 0, &iov, 1, control, sizeof(control), 0,
-    };
-
-    int socket = cli->getSocket();
+    if (mQueue != nullptr) {
+        return readBatch(cli->getSocket());
+    }
+    return readOne(cli->getSocket());
+}
 
-    // To clear the entire buffer is secure/safe, but this contributes to 1.68%
-    // overhead under logging load. We are safe because we check counts, but
-    // still need to clear null terminator
-    // memset(buffer, 0, sizeof(buffer));
-    ssize_t n = recvmsg(socket, &hdr, 0);
+// Fills [msg] from a datagram of [n] bytes in [buffer]. Returns false if the datagram is too short.
+static bool parseDatagram(char* buffer, ssize_t n, struct msghdr* hdr, log_msg* msg) {
     if (n <= (ssize_t)(sizeof(android_log_header_t))) {
         return false;
     }
@@ -80,13 +110,13 @@ bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
 
     struct ucred* cred = NULL;
 
-    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr);
     while (cmsg != NULL) {
         if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS) {
             cred = (struct ucred*)CMSG_DATA(cmsg);
             break;
         }
-        cmsg = CMSG_NXTHDR(&hdr, cmsg);
+        cmsg = CMSG_NXTHDR(hdr, cmsg);
     }
 
     struct ucred fake_cred;
@@ -99,15 +129,35 @@ bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
     char* ptr = ((char*)buffer) + sizeof(android_log_header_t);
     n -= sizeof(android_log_header_t);
 
-    log_msg msg;
+    msg->entry.len = n;
+    msg->entry.hdr_size = kLogMsgHeaderSize;
+    msg->entry.sec = time(nullptr);
+    msg->entry.pid = cred->pid;
+    msg->entry.uid = cred->uid;
+
+    memcpy(msg->buf + kLogMsgHeaderSize, ptr, n + 1);
+    return true;
+}
+
+bool StatsSocketListener::readOne(int socket) {
+    char buffer[kReceiveBufferSize];
+    struct iovec iov = {buffer, sizeof(buffer) - 1};
+
+    alignas(4) char control[CMSG_SPACE(sizeof(struct ucred))];
+    struct msghdr hdr = {
+            NULL, 0, &iov, 1, control, sizeof(control), 0,
+    };
 
-    msg.entry.len = n;
-    msg.entry.hdr_size = kLogMsgHeaderSize;
-    msg.entry.sec = time(nullptr);
-    msg.entry.pid = cred->pid;
-    msg.entry.uid = cred->uid;
+    // To clear the entire buffer is secure/safe, but this contributes to 1.68%
+    // overhead under logging load. We are safe because we check counts, but
+    // still need to clear null terminator
+    // memset(buffer, 0, sizeof(buffer));
+    ssize_t n = recvmsg(socket, &hdr, 0);
 
-    memcpy(msg.buf + kLogMsgHeaderSize, ptr, n + 1);
+    log_msg msg;
+    if (!parseDatagram(buffer, n, &hdr, &msg)) {
+        return false;
+    }
     LogEvent event(msg);
 
     // Call the listener
@@ -116,6 +166,54 @@ bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
     return true;
 }
 
+bool StatsSocketListener::readBatch(int socket) {
+    for (int i = 0; i < kMaxBatchSize; i++) {
+        // The kernel overwrites the control length with the length actually received.
+        mMessages[i].msg_hdr.msg_controllen = sizeof(mReceiveBuffers[i].control);
+    }
+
+    // Only the datagrams already waiting are read, so that a burst doesn't keep them from being
+    // handed to the processing thread.
+    int count = recvmmsg(socket, mMessages.data(), kMaxBatchSize, MSG_DONTWAIT, nullptr);
+    if (count <= 0) {
+        return false;
+    }
+
+    int dropped = 0;
+    log_msg msg;
+    for (int i = 0; i < count; i++) {
+        if (!parseDatagram(mReceiveBuffers[i].data, mMessages[i].msg_len, &mMessages[i].msg_hdr,
+                           &msg)) {
+            continue;
+        }
+        std::unique_ptr<LogEvent> event = mFreeEvents->tryPop();
+        if (event == nullptr) {
+            event = std::make_unique<LogEvent>(msg);
+        } else {
+            event->reset(msg);
+        }
+        if (!mQueue->push(std::move(event))) {
+            dropped++;
+        }
+    }
+    StatsdStats::getInstance().noteEventQueueBatch(mQueue->size(), dropped);
+    return true;
+}
+
+void StatsSocketListener::processEvents() {
+    prctl(PR_SET_NAME, "statsd.process");
+
+    std::vector<std::unique_ptr<LogEvent>> events;
+    while (mQueue->popBatch(&events, kMaxProcessBatchSize)) {
+        for (auto& event : events) {
+            mListener->OnLogEvent(event.get(), false /*reconnected, N/A in statsd socket*/);
+            // Listeners don't keep the event, so its storage can be reused for the next atoms.
+            mFreeEvents->push(std::move(event));
+        }
+        events.clear();
+    }
+}
+
 int StatsSocketListener::getLogSocket() {
     static const char socketName[] = "statsdw";
     int sock = android_get_control_socket(socketName);
@@ -15,9 +15,15 @@
  */
 #pragma once
 
+#include <sys/socket.h>
 #include <sysutils/SocketListener.h>
 #include <utils/RefBase.h>
 #include "logd/LogListener.h"
+#include "socket/LogEventQueue.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
 
 // DEFAULT_OVERFLOWUID is defined in linux/highuid.h, which is not part of
 // the uapi headers for userspace to use.  This value is filled in on the
@@ -35,19 +41,52 @@ namespace statsd {
 
 class StatsSocketListener : public SocketListener, public virtual android::RefBase {
 public:
-    StatsSocketListener(const sp<LogListener>& listener);
+    /**
+     * If queueCapacity is 0, each datagram is read and processed on the socket thread. Otherwise
+     * datagrams are read in batches, and their events are handed to a dedicated processing thread
+     * through a queue holding up to queueCapacity events.
+     */
+    StatsSocketListener(const sp<LogListener>& listener, size_t queueCapacity = 0);
 
     virtual ~StatsSocketListener();
 
+    /**
+     * The maximum number of datagrams read from the socket at once in batched mode.
+     */
+    static const int kMaxBatchSize = 64;
+
 protected:
     virtual bool onDataAvailable(SocketClient* cli);
 
 private:
     static int getLogSocket();
+
+    // Reads and processes a single datagram.
+    bool readOne(int socket);
+
+    // Reads up to kMaxBatchSize datagrams, and adds their events to mQueue.
+    bool readBatch(int socket);
+
+    // The processing thread's loop in batched mode.
+    void processEvents();
+
     /**
      * Who is going to get the events when they're read.
      */
     sp<LogListener> mListener;
+
+    // The following are only used in batched mode.
+    std::unique_ptr<LogEventQueue> mQueue;
+
+    // Events already processed, handed back by the processing thread so that the socket thread
+    // reuses their storage instead of allocating new events.
+    std::unique_ptr<LogEventQueue> mFreeEvents;
+    std::thread mProcessingThread;
+
+    // Preallocated buffers for recvmmsg, one per datagram of a batch.
+    struct ReceiveBuffer;
+    std::unique_ptr<ReceiveBuffer[]> mReceiveBuffers;
+    std::vector<struct mmsghdr> mMessages;
 };
 }  // namespace statsd
 }  // namespace os
@@ -58,6 +58,8 @@ const int FIELD_ID_PULL_ATOM_ID = 1;
 const int FIELD_ID_TOTAL_PULL = 2;
 const int FIELD_ID_TOTAL_PULL_FROM_CACHE = 3;
 const int FIELD_ID_MIN_PULL_INTERVAL_SEC = 4;
+const int FIELD_ID_PULL_TIMEOUT = 5;
+const int FIELD_ID_PULL_LATENCY_HISTOGRAM = 6;
 
 namespace {
 
@@ -405,6 +407,11 @@ void writePullerStatsToStream(const std::pair<int, StatsdStats::PulledAtomStats>
                        (long long)pair.second.totalPullFromCache);
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_MIN_PULL_INTERVAL_SEC,
                        (long long)pair.second.minPullIntervalSec);
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_PULL_TIMEOUT, (long long)pair.second.pullTimeout);
+    for (int i = 0; i < StatsdStats::kPullLatencyBucketCount; i++) {
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_PULL_LATENCY_HISTOGRAM | FIELD_COUNT_REPEATED,
+                           (long long)pair.second.pullLatencyHistogram[i]);
+    }
     protoOutput->end(token);
 }
 
@@ -0,0 +1,486 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "storage/ReportSegmentStore.h"
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <private/android_filesystem_config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <memory>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using android::base::ReadFully;
+using android::base::StringPrintf;
+using android::base::WriteFully;
+using android::base::unique_fd;
+using android::util::ProtoOutputStream;
+using std::map;
+using std::pair;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+static const uint32_t kSegmentMagic = 0x53544753;  // "SGTS"
+static const uint32_t kSegmentVersion = 1;
+
+static const char* kSegmentSuffix = ".seg";
+static const char* kTempSuffix = ".tmp";
+
+// Far above the number of configs, so that a corrupt count isn't trusted.
+static const uint32_t kMaxSegmentEntries = 10000;
+
+static const size_t kChunkSize = 16 * 1024;
+
+static bool hasSuffix(const char* name, const char* suffix) {
+    const size_t nameLen = strlen(name);
+    const size_t suffixLen = strlen(suffix);
+    return suffixLen <= nameLen && strcmp(name + nameLen - suffixLen, suffix) == 0;
+}
+
+namespace {
+
+// Decompresses the reports of a segment file, a chunk of the file at a time.
+class SegmentReader {
+public:
+    SegmentReader(int fd, uint64_t compressedSize) : mFd(fd), mRemainingInput(compressedSize) {
+        memset(&mStream, 0, sizeof(mStream));
+        mInitialized = inflateInit(&mStream) == Z_OK;
+    }
+
+    ~SegmentReader() {
+        if (mInitialized) {
+            inflateEnd(&mStream);
+        }
+    }
+
+    // Decompresses the next [size] bytes into [out], or skips them if [out] is null.
+    bool read(char* out, size_t size) {
+        if (!mInitialized) {
+            return false;
+        }
+        while (size > 0) {
+            const size_t outSize = out != nullptr ? size : std::min(size, sizeof(mScratch));
+            mStream.next_out = (Bytef*)(out != nullptr ? out : mScratch);
+            mStream.avail_out = outSize;
+            while (mStream.avail_out > 0) {
+                if (mStream.avail_in == 0) {
+                    if (mRemainingInput == 0) {
+                        return false;
+                    }
+                    const ssize_t n = ::read(
+                            mFd, mInput, std::min((uint64_t)sizeof(mInput), mRemainingInput));
+                    if (n <= 0) {
+                        return false;
+                    }
+                    mRemainingInput -= n;
+                    mStream.next_in = (Bytef*)mInput;
+                    mStream.avail_in = n;
+                }
+                const int result = inflate(&mStream, Z_NO_FLUSH);
+                if (result == Z_STREAM_END && mStream.avail_out > 0) {
+                    // The segment has fewer bytes than its index says.
+                    return false;
+                } else if (result != Z_OK && result != Z_STREAM_END) {
+                    return false;
+                }
+            }
+            if (out != nullptr) {
+                out += outSize;
+            }
+            size -= outSize;
+        }
+        return true;
+    }
+
+private:
+    const int mFd;
+    uint64_t mRemainingInput;
+    z_stream mStream;
+    bool mInitialized;
+    char mInput[kChunkSize];
+    char mScratch[kChunkSize];
+};
+
+}  // namespace
+
+ReportSegmentStore::ReportSegmentStore(const string& dir, size_t maxSegmentCount,
+                                       size_t maxTotalBytes, int64_t maxAgeSec)
+    : mDir(dir),
+      mMaxSegmentCount(maxSegmentCount),
+      mMaxTotalBytes(maxTotalBytes),
+      mMaxAgeSec(maxAgeSec) {
+}
+
+string ReportSegmentStore::getSegmentPath(uint64_t sequence) const {
+    return StringPrintf("%s/%llu%s", mDir.c_str(), (unsigned long long)sequence, kSegmentSuffix);
+}
+
+bool ReportSegmentStore::writeSegment(const vector<pair<ConfigKey, ProtoOutputStream*>>& reports,
+                                      int64_t wallClockSec) {
+    if (reports.empty()) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    loadLocked();
+
+    Segment segment;
+    segment.wallClockSec = wallClockSec;
+    uint64_t rawSize = 0;
+    for (const auto& report : reports) {
+        SegmentIndexEntry entry;
+        entry.configId = report.first.GetId();
+        entry.uid = report.first.GetUid();
+        entry.read = 0;
+        entry.rawOffset = rawSize;
+        entry.rawSize = report.second->size();
+        rawSize += entry.rawSize;
+        segment.entries.push_back(entry);
+    }
+    segment.unreadCount = segment.entries.size();
+
+    const uint64_t sequence = mNextSequence++;
+    const string path = getSegmentPath(sequence);
+    const string tempPath = path + kTempSuffix;
+    unique_fd fd(open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                      S_IRUSR | S_IWUSR));
+    if (fd == -1) {
+        ALOGE("Attempt to write %s but failed", tempPath.c_str());
+        return false;
+    }
+
+    SegmentHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kSegmentMagic;
+    header.version = kSegmentVersion;
+    header.wallClockSec = wallClockSec;
+    header.entryCount = segment.entries.size();
+    const size_t indexSize = sizeof(header) + segment.entries.size() * sizeof(SegmentIndexEntry);
+    bool success = WriteFully(fd, &header, sizeof(header)) &&
+                   WriteFully(fd, segment.entries.data(),
+                              segment.entries.size() * sizeof(SegmentIndexEntry));
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    success = success && deflateInit(&stream, Z_DEFAULT_COMPRESSION) == Z_OK;
+    uint64_t compressedSize = 0;
+    char output[kChunkSize];
+    auto compress = [&](const void* data, size_t size, int flush) {
+        stream.next_in = (Bytef*)data;
+        stream.avail_in = size;
+        do {
+            stream.next_out = (Bytef*)output;
+            stream.avail_out = sizeof(output);
+            if (deflate(&stream, flush) == Z_STREAM_ERROR) {
+                return false;
+            }
+            const size_t n = sizeof(output) - stream.avail_out;
+            if (!WriteFully(fd, output, n)) {
+                return false;
+            }
+            compressedSize += n;
+        } while (stream.avail_out == 0);
+        return true;
+    };
+    for (size_t i = 0; success && i < reports.size(); i++) {
+        auto it = reports[i].second->data();
+        while (success && it.readBuffer() != NULL) {
+            const size_t toRead = it.currentToRead();
+            success = compress(it.readBuffer(), toRead, Z_NO_FLUSH);
+            it.rp()->move(toRead);
+        }
+    }
+    success = success && compress(nullptr, 0, Z_FINISH);
+    deflateEnd(&stream);
+
+    // The index is complete once the size of the compressed reports is known, and only then is
+    // the segment synced and moved in place.
+    header.compressedSize = compressedSize;
+    success = success && pwrite(fd, &header, sizeof(header), 0) == sizeof(header) &&
+              fsync(fd) == 0;
+    if (success && fchown(fd, AID_STATSD, AID_STATSD)) {
+        VLOG("Failed to chown %s to statsd", tempPath.c_str());
+    }
+    fd.reset();
+    if (!success || rename(tempPath.c_str(), path.c_str()) != 0) {
+        ALOGE("Failed to write report segment %s", path.c_str());
+        unlink(tempPath.c_str());
+        return false;
+    }
+
+    segment.fileSize = indexSize + compressedSize;
+    mTotalBytes += segment.fileSize;
+    mSegments[sequence] = std::move(segment);
+    mSegmentsWritten++;
+    mReportsWritten += reports.size();
+    mReportBytesWritten += rawSize;
+    mCompressedBytesWritten += compressedSize;
+    // The header is written twice.
+    mDiskBytesWritten += indexSize + compressedSize + sizeof(header);
+    VLOG("Wrote %zu reports to %s, %llu bytes compressed to %llu", reports.size(), path.c_str(),
+         (unsigned long long)rawSize, (unsigned long long)compressedSize);
+
+    trimLocked(wallClockSec);
+    return true;
+}
+
+bool ReportSegmentStore::hasReports(const ConfigKey& key) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    loadLocked();
+    for (const auto& kv : mSegments) {
+        for (const SegmentIndexEntry& entry : kv.second.entries) {
+            if (!entry.read && entry.uid == key.GetUid() && entry.configId == key.GetId()) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ReportSegmentStore::appendReports(const ConfigKey& key, uint64_t fieldId,
+                                       ProtoOutputStream* proto) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    loadLocked();
+    for (auto it = mSegments.begin(); it != mSegments.end();) {
+        vector<size_t> entryIndices;
+        const vector<SegmentIndexEntry>& entries = it->second.entries;
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (!entries[i].read && entries[i].uid == key.GetUid() &&
+                entries[i].configId == key.GetId()) {
+                entryIndices.push_back(i);
+            }
+        }
+        if (entryIndices.empty()) {
+            it++;
+            continue;
+        }
+        readSegmentReportsLocked(it->first, &it->second, entryIndices, fieldId, proto);
+        if (it->second.unreadCount == 0) {
+            it = deleteSegmentLocked(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+void ReportSegmentStore::readSegmentReportsLocked(uint64_t sequence, Segment* segment,
+                                                  const vector<size_t>& entryIndices,
+                                                  uint64_t fieldId, ProtoOutputStream* proto) {
+    const string path = getSegmentPath(sequence);
+    unique_fd fd(open(path.c_str(), O_RDWR | O_CLOEXEC));
+    const size_t indexSize = sizeof(SegmentHeader) + segment->entries.size() * sizeof(SegmentIndexEntry);
+    if (fd == -1 || lseek(fd, indexSize, SEEK_SET) != (off_t)indexSize) {
+        ALOGE("Attempt to read %s but failed", path.c_str());
+        // The segment is gone, along with its reports.
+        for (const SegmentIndexEntry& entry : segment->entries) {
+            if (!entry.read) {
+                noteLostReportLocked(entry);
+            }
+        }
+        segment->unreadCount = 0;
+        return;
+    }
+
+    // Only one report at a time is decompressed in memory.
+    SegmentReader reader(fd, segment->fileSize - indexSize);
+    uint64_t rawOffset = 0;
+    bool readable = true;
+    string report;
+    for (size_t i : entryIndices) {
+        SegmentIndexEntry& entry = segment->entries[i];
+        if (readable) {
+            report.resize(entry.rawSize);
+            readable = reader.read(nullptr, entry.rawOffset - rawOffset) &&
+                       reader.read(&report[0], entry.rawSize);
+            rawOffset = entry.rawOffset + entry.rawSize;
+            if (readable) {
+                proto->write(fieldId, report.data(), report.size());
+            } else {
+                ALOGE("Report segment %s is corrupt", path.c_str());
+            }
+        }
+        if (!readable) {
+            noteLostReportLocked(entry);
+        }
+        // Even the reports that can't be read are marked, so that they aren't tried again.
+        entry.read = 1;
+        segment->unreadCount--;
+        const off_t entryOffset = sizeof(SegmentHeader) + i * sizeof(SegmentIndexEntry);
+        if (segment->unreadCount > 0 &&
+            pwrite(fd, &entry, sizeof(entry), entryOffset) == sizeof(entry)) {
+            mDiskBytesWritten += sizeof(entry);
+        }
+    }
+}
+
+map<uint64_t, ReportSegmentStore::Segment>::iterator ReportSegmentStore::deleteSegmentLocked(
+        map<uint64_t, Segment>::iterator it) {
+    const string path = getSegmentPath(it->first);
+    if (unlink(path.c_str()) != 0) {
+        VLOG("Attempt to delete %s but is not found", path.c_str());
+    }
+    mTotalBytes -= it->second.fileSize;
+    return mSegments.erase(it);
+}
+
+void ReportSegmentStore::trim(int64_t wallClockSec) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    loadLocked();
+    trimLocked(wallClockSec);
+}
+
+void ReportSegmentStore::trimLocked(int64_t wallClockSec) {
+    for (auto it = mSegments.begin(); it != mSegments.end();) {
+        const bool tooOld = wallClockSec - it->second.wallClockSec > mMaxAgeSec;
+        // The oldest segments go first, but the newest one is always kept.
+        const bool overLimits = (mSegments.size() > mMaxSegmentCount ||
+                                 mTotalBytes > mMaxTotalBytes) &&
+                                mSegments.size() > 1;
+        if (!tooOld && !overLimits) {
+            it++;
+            continue;
+        }
+        mUnreadReportsDropped += it->second.unreadCount;
+        for (const SegmentIndexEntry& entry : it->second.entries) {
+            if (!entry.read) {
+                noteLostReportLocked(entry);
+            }
+        }
+        it = deleteSegmentLocked(it);
+    }
+}
+
+void ReportSegmentStore::noteLostReportLocked(const SegmentIndexEntry& entry) {
+    mConfigsWithLostReports.insert(ConfigKey(entry.uid, entry.configId));
+}
+
+vector<ConfigKey> ReportSegmentStore::takeConfigsWithLostReports() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    vector<ConfigKey> keys(mConfigsWithLostReports.begin(), mConfigsWithLostReports.end());
+    mConfigsWithLostReports.clear();
+    return keys;
+}
+
+bool ReportSegmentStore::readSegmentLocked(const string& path, Segment* segment) {
+    unique_fd fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd == -1) {
+        return false;
+    }
+    SegmentHeader header;
+    if (!ReadFully(fd, &header, sizeof(header)) || header.magic != kSegmentMagic ||
+        header.version != kSegmentVersion || header.entryCount > kMaxSegmentEntries) {
+        return false;
+    }
+    segment->entries.resize(header.entryCount);
+    if (!ReadFully(fd, segment->entries.data(),
+                   header.entryCount * sizeof(SegmentIndexEntry))) {
+        return false;
+    }
+    struct stat st;
+    const size_t fileSize = sizeof(header) + header.entryCount * sizeof(SegmentIndexEntry) +
+                            header.compressedSize;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != fileSize) {
+        return false;
+    }
+    segment->wallClockSec = header.wallClockSec;
+    segment->fileSize = fileSize;
+    segment->unreadCount = 0;
+    for (const SegmentIndexEntry& entry : segment->entries) {
+        if (!entry.read) {
+            segment->unreadCount++;
+        }
+    }
+    return true;
+}
+
+void ReportSegmentStore::loadLocked() {
+    if (mLoaded) {
+        return;
+    }
+    mLoaded = true;
+    unique_ptr<DIR, decltype(&closedir)> dir(opendir(mDir.c_str()), closedir);
+    if (dir == NULL) {
+        VLOG("Path %s does not exist", mDir.c_str());
+        return;
+    }
+    dirent* de;
+    while ((de = readdir(dir.get()))) {
+        const char* name = de->d_name;
+        if (name[0] == '.') {
+            continue;
+        }
+        const string path = StringPrintf("%s/%s", mDir.c_str(), name);
+        if (hasSuffix(name, kTempSuffix)) {
+            // A segment that statsd stopped in the middle of writing.
+            unlink(path.c_str());
+            continue;
+        }
+        if (!hasSuffix(name, kSegmentSuffix)) {
+            continue;
+        }
+        char* end;
+        const uint64_t sequence = strtoull(name, &end, 10);
+        Segment segment;
+        if (strcmp(end, kSegmentSuffix) != 0 || !readSegmentLocked(path, &segment) ||
+            segment.unreadCount == 0) {
+            ALOGW("Deleting report segment %s", path.c_str());
+            unlink(path.c_str());
+            continue;
+        }
+        mTotalBytes += segment.fileSize;
+        mSegments[sequence] = std::move(segment);
+        mNextSequence = std::max(mNextSequence, sequence + 1);
+    }
+}
+
+void ReportSegmentStore::printStats(FILE* out) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    loadLocked();
+    size_t unreadCount = 0;
+    for (const auto& kv : mSegments) {
+        unreadCount += kv.second.unreadCount;
+    }
+    fprintf(out, "Report segments in %s: %zu segments, %zu bytes, %zu unread reports\n",
+            mDir.c_str(), mSegments.size(), mTotalBytes, unreadCount);
+    fprintf(out, "\tWritten since boot: %lld reports of %lld bytes, in %lld segments\n",
+            (long long)mReportsWritten, (long long)mReportBytesWritten,
+            (long long)mSegmentsWritten);
+    // Write amplification is the bytes written to disk per byte of report.
+    fprintf(out,
+            "\tCompression ratio: %.2f, write amplification: %.2f, unread reports dropped: %lld\n",
+            mCompressedBytesWritten > 0
+                    ? (double)mReportBytesWritten / mCompressedBytesWritten : 0.0,
+            mReportBytesWritten > 0 ? (double)mDiskBytesWritten / mReportBytesWritten : 0.0,
+            (long long)mUnreadReportsDropped);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
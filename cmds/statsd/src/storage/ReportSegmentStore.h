@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android/util/ProtoOutputStream.h>
+#include <gtest/gtest_prod.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "config/ConfigKey.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Append-only store of the ConfigMetricsReports written to disk, in segment files.
+ *
+ * Each write of reports, usually one per config, is a new segment: an index of where each report
+ * is, followed by the reports compressed together with zlib. A segment is written to a temporary
+ * file, synced once, and renamed, so a segment on disk is always complete. Reading the reports of
+ * a config decompresses its segments one report at a time, and marks the reports in the index as
+ * read. A segment is deleted once all its reports are read, or when the store is over its limits,
+ * oldest first.
+ *
+ * The segments are named <sequence number>.seg, so that they are never taken for the files of the
+ * former per report layout, which are named <time>_<uid>_<config id>.
+ *
+ * Thread safe.
+ */
+class ReportSegmentStore {
+public:
+    ReportSegmentStore(const std::string& dir, size_t maxSegmentCount, size_t maxTotalBytes,
+                       int64_t maxAgeSec);
+
+    /**
+     * Writes the reports as a new segment. Returns false if the segment couldn't be written, in
+     * which case none of the reports is stored.
+     */
+    bool writeSegment(
+            const std::vector<std::pair<ConfigKey, android::util::ProtoOutputStream*>>& reports,
+            int64_t wallClockSec);
+
+    /**
+     * Returns true if the config has reports that haven't been read.
+     */
+    bool hasReports(const ConfigKey& key);
+
+    /**
+     * Writes the reports of the config that haven't been read, oldest first, to the proto as
+     * messages of the given field, and removes them from the store.
+     */
+    void appendReports(const ConfigKey& key, uint64_t fieldId,
+                       android::util::ProtoOutputStream* proto);
+
+    /**
+     * Deletes the segments that are too old, then the oldest ones until the store is within its
+     * limits.
+     */
+    void trim(int64_t wallClockSec);
+
+    /**
+     * Returns the configs that lost unread reports since the last call, as they were trimmed or
+     * couldn't be read.
+     */
+    std::vector<ConfigKey> takeConfigsWithLostReports();
+
+    void printStats(FILE* out);
+
+private:
+    struct SegmentHeader {
+        uint32_t magic;
+        uint32_t version;
+        int64_t wallClockSec;
+        uint32_t entryCount;
+        uint32_t reserved;
+        uint64_t compressedSize;
+    };
+
+    // Where a report is in the uncompressed reports of its segment.
+    struct SegmentIndexEntry {
+        int64_t configId;
+        int32_t uid;
+        uint32_t read;
+        uint64_t rawOffset;
+        uint64_t rawSize;
+    };
+
+    struct Segment {
+        int64_t wallClockSec;
+        size_t fileSize;
+        std::vector<SegmentIndexEntry> entries;
+        size_t unreadCount;
+    };
+
+    // Reads the index of the segments on disk, the first time the store is used.
+    void loadLocked();
+
+    // Reads the index of a segment file. Returns false if the file isn't a valid segment.
+    bool readSegmentLocked(const std::string& path, Segment* segment);
+
+    // Decompresses the reports of the given entries of a segment, in order, into the proto, and
+    // marks them read. The reports that can't be decompressed are skipped.
+    void readSegmentReportsLocked(uint64_t sequence, Segment* segment,
+                                  const std::vector<size_t>& entryIndices, uint64_t fieldId,
+                                  android::util::ProtoOutputStream* proto);
+
+    // Returns the iterator of the next segment.
+    std::map<uint64_t, Segment>::iterator deleteSegmentLocked(
+            std::map<uint64_t, Segment>::iterator it);
+
+    void trimLocked(int64_t wallClockSec);
+
+    // Records the config of a report that is lost before being read.
+    void noteLostReportLocked(const SegmentIndexEntry& entry);
+
+    std::string getSegmentPath(uint64_t sequence) const;
+
+    const std::string mDir;
+    const size_t mMaxSegmentCount;
+    const size_t mMaxTotalBytes;
+    const int64_t mMaxAgeSec;
+
+    std::mutex mMutex;
+
+    bool mLoaded = false;
+
+    // The segments on disk, by sequence number, i.e. oldest first.
+    std::map<uint64_t, Segment> mSegments;
+    uint64_t mNextSequence = 0;
+    size_t mTotalBytes = 0;
+
+    // Since statsd started.
+    int64_t mSegmentsWritten = 0;
+    int64_t mReportsWritten = 0;
+    int64_t mReportBytesWritten = 0;
+    int64_t mCompressedBytesWritten = 0;
+    // Everything written to disk: the segments, and the updates of their index.
+    int64_t mDiskBytesWritten = 0;
+    int64_t mUnreadReportsDropped = 0;
+
+    // See takeConfigsWithLostReports().
+    std::unordered_set<ConfigKey> mConfigsWithLostReports;
+
+    FRIEND_TEST(ReportSegmentStoreTest, TestCompression);
+    FRIEND_TEST(ReportSegmentStoreTest, TestCorruptSegmentsDeleted);
+    FRIEND_TEST(ReportSegmentStoreTest, TestConfigsWithLostReports);
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
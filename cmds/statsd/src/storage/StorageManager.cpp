@@ -19,6 +19,7 @@
 
 #include "android-base/stringprintf.h"
 #include "guardrail/StatsdStats.h"
+#include "storage/ReportSegmentStore.h"
 #include "storage/StorageManager.h"
 #include "stats_log_util.h"
 
@@ -68,6 +69,15 @@ static string getFilePath(const char* path, int64_t timestamp, int64_t uid, int6
                         (long long)configID);
 }
 
+// The reports are written as segments of this store. The files of one report each, written before
+// it, are still read, and trimmed by trimToFit().
+static ReportSegmentStore& getReportSegmentStore() {
+    static ReportSegmentStore* store =
+            new ReportSegmentStore(STATS_DATA_DIR, StatsdStats::kMaxFileNumber,
+                                   StatsdStats::kMaxFileSize, StatsdStats::kMaxAgeSecond);
+    return *store;
+}
+
 void StorageManager::writeFile(const char* file, const void* buffer, int numBytes) {
     int fd = open(file, O_WRONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
     if (fd == -1) {
@@ -76,6 +86,7 @@ void StorageManager::writeFile(const char* file, const void* buffer, int numByte
     }
     trimToFit(STATS_SERVICE_DIR);
     trimToFit(STATS_DATA_DIR);
+    getReportSegmentStore().trim(getWallClockSec());
 
     int result = write(fd, buffer, numBytes);
     if (result == numBytes) {
@@ -160,7 +171,15 @@ void StorageManager::sendBroadcast(const char* path,
     }
 }
 
+bool StorageManager::writeConfigMetricsReports(
+        const vector<std::pair<ConfigKey, ProtoOutputStream*>>& reports) {
+    return getReportSegmentStore().writeSegment(reports, getWallClockSec());
+}
+
 bool StorageManager::hasConfigMetricsReport(const ConfigKey& key) {
+    if (getReportSegmentStore().hasReports(key)) {
+        return true;
+    }
     unique_ptr<DIR, decltype(&closedir)> dir(opendir(STATS_DATA_DIR), closedir);
     if (dir == NULL) {
         VLOG("Path %s does not exist", STATS_DATA_DIR);
@@ -195,10 +214,19 @@ void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutput
         return;
     }
 
+    // The files of one report each are older than the segments.
+    appendLegacyConfigMetricsReports(key, dir.get(), proto);
+    getReportSegmentStore().appendReports(
+            key, FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS, proto);
+}
+
+void StorageManager::appendLegacyConfigMetricsReports(const ConfigKey& key, DIR* dir,
+                                                      ProtoOutputStream* proto) {
+
     string suffix = StringPrintf("%d_%lld", key.GetUid(), (long long)key.GetId());
 
     dirent* de;
-    while ((de = readdir(dir.get()))) {
+    while ((de = readdir(dir))) {
         char* name = de->d_name;
         if (name[0] == '.') continue;
 
@@ -392,9 +420,14 @@ void StorageManager::trimToFit(const char* path) {
     }
 }
 
+vector<ConfigKey> StorageManager::takeConfigsWithLostReports() {
+    return getReportSegmentStore().takeConfigsWithLostReports();
+}
+
 void StorageManager::printStats(FILE* out) {
     printDirStats(out, STATS_SERVICE_DIR);
     printDirStats(out, STATS_DATA_DIR);
+    getReportSegmentStore().printStats(out);
 }
 
 void StorageManager::printDirStats(FILE* out, const char* path) {
@@ -20,6 +20,7 @@
 #include <android/util/ProtoOutputStream.h>
 #include <utils/Log.h>
 #include <utils/RefBase.h>
+#include <dirent.h>
 
 #include "packages/UidMap.h"
 
@@ -62,6 +63,13 @@ public:
     static void sendBroadcast(const char* path,
                               const std::function<void(const ConfigKey&)>& sendBroadcast);
 
+    /**
+     * Writes the ConfigMetricsReports of the configs to disk, compressed together in one segment
+     * of the report store. Returns false if they couldn't be written.
+     */
+    static bool writeConfigMetricsReports(
+            const std::vector<std::pair<ConfigKey, ProtoOutputStream*>>& reports);
+
     /**
      * Returns true if there's at least one report on disk.
      */
@@ -69,7 +77,7 @@ public:
 
     /**
      * Appends ConfigMetricsReport found on disk to the specific proto and
-     * delete it.
+     * delete it. The reports are read one at a time, rather than whole files.
      */
     static void appendConfigMetricsReport(const ConfigKey& key, ProtoOutputStream* proto);
 
@@ -91,6 +99,11 @@ public:
      */
     static void trimToFit(const char* dir);
 
+    /**
+     * Returns the configs whose unread reports were dropped or found corrupt since the last call.
+     */
+    static std::vector<ConfigKey> takeConfigsWithLostReports();
+
     /**
      * Returns true if there already exists identical configuration on device.
      */
@@ -103,6 +116,13 @@ public:
     static void printStats(FILE* out);
 
 private:
+    /**
+     * Appends the reports of the config that are in files of one report each, the way statsd
+     * used to write them, and deletes the files.
+     */
+    static void appendLegacyConfigMetricsReports(const ConfigKey& key, DIR* dir,
+                                                 ProtoOutputStream* proto);
+
     /**
      * Prints disk usage statistics about a directory related to statsd.
      */
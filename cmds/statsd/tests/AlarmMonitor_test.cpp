@@ -62,6 +62,28 @@ TEST(AlarmMonitor, popSoonerThan) {
     EXPECT_EQ(0u, set.size());
 }
 
+TEST(AlarmMonitor, destructorReleasesTheAlarmsOnce) {
+    sp<const InternalAlarm> a = new InternalAlarm{10};
+    sp<const InternalAlarm> b = new InternalAlarm{20};
+    sp<const InternalAlarm> c = new InternalAlarm{30};
+    {
+        AlarmMonitor am(2, [](const sp<IStatsCompanionService>&, int64_t){},
+                        [](const sp<IStatsCompanionService>&){});
+        am.add(a);
+        am.add(b);
+        am.add(c);
+        EXPECT_EQ(2, a->getStrongCount());
+
+        // a is popped, and released by the monitor, before it's destroyed with b and c armed.
+        EXPECT_EQ(1u, am.popSoonerThan(15).size());
+        EXPECT_EQ(1, a->getStrongCount());
+        EXPECT_EQ(2, b->getStrongCount());
+    }
+    EXPECT_EQ(1, a->getStrongCount());
+    EXPECT_EQ(1, b->getStrongCount());
+    EXPECT_EQ(1, c->getStrongCount());
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
@@ -171,6 +171,33 @@ TEST(AtomMatcherTest, TestSubDimension) {
     EXPECT_TRUE(dim.contains(subDim4));
 }
 
+TEST(AtomMatcherTest, TestDimensionHashFollowsValues) {
+    int pos[] = {1, 1, 1};
+    Field field(10, pos, 2);
+
+    HashableDimensionKey dim1;
+    dim1.addValue(FieldValue(field, Value((int32_t)10025)));
+    HashableDimensionKey dim2;
+    dim2.addValue(FieldValue(field, Value((int32_t)10026)));
+    EXPECT_NE(dim1.getHash(), dim2.getHash());
+    EXPECT_FALSE(dim1 == dim2);
+
+    // The hash is recomputed after the values change, and is kept by copies.
+    dim2.setValue(0, FieldValue(field, Value((int32_t)10025)));
+    EXPECT_EQ(dim1.getHash(), dim2.getHash());
+    EXPECT_TRUE(dim1 == dim2);
+    HashableDimensionKey dim3(dim2);
+    EXPECT_EQ(dim1.getHash(), dim3.getHash());
+    EXPECT_EQ(hashDimension(dim3), dim3.getHash());
+
+    dim3.addValue(FieldValue(field, Value("tag")));
+    EXPECT_EQ(hashDimension(dim3), dim3.getHash());
+    EXPECT_FALSE(dim1 == dim3);
+    HashableDimensionKey dim4(dim3.getValues());
+    EXPECT_EQ(dim3.getHash(), dim4.getHash());
+    EXPECT_TRUE(dim3 == dim4);
+}
+
 TEST(AtomMatcherTest, TestMetric2ConditionLink) {
     AttributionNodeInternal attribution_node1;
     attribution_node1.set_uid(1111);
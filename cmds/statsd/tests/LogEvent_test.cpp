@@ -159,6 +159,100 @@ TEST(LogEventTest, TestLogParsing2) {
 }
 
 
+static const int kLogMsgHeaderSize = 28;
+
+static void write4Bytes(int val, std::vector<char>* buffer) {
+    buffer->push_back(static_cast<char>(val));
+    buffer->push_back(static_cast<char>((val >> 8) & 0xFF));
+    buffer->push_back(static_cast<char>((val >> 16) & 0xFF));
+    buffer->push_back(static_cast<char>((val >> 24) & 0xFF));
+}
+
+static void write8Bytes(int64_t val, std::vector<char>* buffer) {
+    write4Bytes(static_cast<int>(val), buffer);
+    write4Bytes(static_cast<int>(val >> 32), buffer);
+}
+
+// Builds a log_msg with the given elements after the timestamp and the atom id.
+static void getLogMsg(int32_t tagId, const std::vector<char>& elements, int elementCount,
+                      log_msg* msg) {
+    std::vector<char> buffer;
+    write4Bytes(1937006964, &buffer);  // the event tag shared by all stats logs
+    buffer.push_back(EVENT_TYPE_LIST);
+    buffer.push_back(elementCount + 2);
+    buffer.push_back(EVENT_TYPE_LONG);
+    write8Bytes(2000, &buffer);
+    buffer.push_back(EVENT_TYPE_INT);
+    write4Bytes(tagId, &buffer);
+    buffer.insert(buffer.end(), elements.begin(), elements.end());
+
+    msg->entry.len = buffer.size();
+    msg->entry.hdr_size = kLogMsgHeaderSize;
+    msg->entry.sec = 0;
+    msg->entry.nsec = 0;
+    msg->entry.uid = 1000;
+    std::copy(buffer.begin(), buffer.end(), msg->buf + kLogMsgHeaderSize);
+}
+
+TEST(LogEventTest, TestResetFromLogMsg) {
+    // A string, and a list of two [int, string] lists.
+    std::vector<char> elements;
+    elements.push_back(EVENT_TYPE_STRING);
+    write4Bytes(5, &elements);
+    elements.insert(elements.end(), {'h', 'e', 'l', 'l', 'o'});
+    elements.push_back(EVENT_TYPE_LIST);
+    elements.push_back(2);
+    for (int i = 1; i <= 2; i++) {
+        elements.push_back(EVENT_TYPE_LIST);
+        elements.push_back(2);
+        elements.push_back(EVENT_TYPE_INT);
+        write4Bytes(1000 * i, &elements);
+        elements.push_back(EVENT_TYPE_STRING);
+        write4Bytes(4, &elements);
+        elements.insert(elements.end(), {'t', 'a', 'g', static_cast<char>('0' + i)});
+    }
+
+    log_msg msg;
+    getLogMsg(1, elements, 2, &msg);
+    LogEvent event(msg);
+    EXPECT_EQ(1, event.GetTagId());
+    EXPECT_EQ(2000, event.GetElapsedTimestampNs());
+    EXPECT_EQ(1000u, event.GetUid());
+
+    // Same fields as in TestLogParsing2.
+    const auto& items = event.getValues();
+    ASSERT_EQ((size_t)5, items.size());
+    EXPECT_EQ(0x00010000, items[0].mField.getField());
+    EXPECT_EQ("hello", items[0].mValue.str_value);
+    EXPECT_EQ(0x2020101, items[1].mField.getField());
+    EXPECT_EQ(1000, items[1].mValue.int_value);
+    EXPECT_EQ(0x2020182, items[2].mField.getField());
+    EXPECT_EQ("tag1", items[2].mValue.str_value);
+    EXPECT_EQ(0x2028201, items[3].mField.getField());
+    EXPECT_EQ(2000, items[3].mValue.int_value);
+    EXPECT_EQ(0x2028282, items[4].mField.getField());
+    EXPECT_EQ("tag2", items[4].mValue.str_value);
+
+    // A smaller event, whose int takes the place of the string.
+    elements.clear();
+    elements.push_back(EVENT_TYPE_INT);
+    write4Bytes(10, &elements);
+    getLogMsg(2, elements, 1, &msg);
+    event.reset(msg);
+    EXPECT_EQ(2, event.GetTagId());
+    ASSERT_EQ((size_t)1, event.getValues().size());
+    EXPECT_EQ(0x00010000, event.getValues()[0].mField.getField());
+    EXPECT_EQ(Type::INT, event.getValues()[0].mValue.getType());
+    EXPECT_EQ(10, event.getValues()[0].mValue.int_value);
+
+    // A truncated event only has the values that were read in full.
+    msg.entry.len -= 2;
+    event.reset(msg);
+    EXPECT_EQ(2, event.GetTagId());
+    EXPECT_EQ((size_t)0, event.getValues().size());
+}
+
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -19,6 +19,7 @@
 #include "src/metrics/CountMetricProducer.h"
 #include "src/metrics/GaugeMetricProducer.h"
 #include "src/metrics/MetricProducer.h"
+#include "src/metrics/MetricsManager.h"
 #include "src/metrics/ValueMetricProducer.h"
 #include "src/metrics/metrics_manager_util.h"
 #include "statsd_test_util.h"
@@ -445,6 +446,43 @@ TEST(MetricsManagerTest, testAlertWithUnknownMetric) {
                                   noReportMetricIds));
 }
 
+namespace android {
+namespace os {
+namespace statsd {
+
+TEST(MetricsManagerTest, TestTagIdToMatcherIndices) {
+    StatsdConfig config = buildGoodConfig();
+    config.add_allowed_log_source("AID_ROOT");
+
+    AtomMatcher* eventMatcher = config.add_atom_matcher();
+    eventMatcher->set_id(StringToId("WAKELOCK"));
+    eventMatcher->mutable_simple_atom_matcher()->set_atom_id(10 /*WAKELOCK_STATE_CHANGED*/);
+
+    eventMatcher = config.add_atom_matcher();
+    eventMatcher->set_id(StringToId("SCREEN_IS_ON_OR_WAKELOCK"));
+    AtomMatcher_Combination* combination = eventMatcher->mutable_combination();
+    combination->set_operation(LogicalOperation::OR);
+    combination->add_matcher(StringToId("SCREEN_IS_ON"));
+    combination->add_matcher(StringToId("WAKELOCK"));
+
+    sp<UidMap> uidMap = new UidMap();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> periodicAlarmMonitor;
+    MetricsManager metricsManager(kConfigKey, config, timeBaseSec, timeBaseSec, uidMap,
+                                  anomalyAlarmMonitor, periodicAlarmMonitor);
+    EXPECT_TRUE(metricsManager.isConfigValid());
+
+    // Matchers are indexed in config order: SCREEN_IS_ON, SCREEN_IS_OFF, SCREEN_ON_OR_OFF,
+    // WAKELOCK, SCREEN_IS_ON_OR_WAKELOCK. A combination matcher brings along all its children.
+    EXPECT_EQ(2u, metricsManager.mTagIdToMatcherIndices.size());
+    EXPECT_EQ((vector<int>{0, 1, 2, 3, 4}), metricsManager.mTagIdToMatcherIndices[2]);
+    EXPECT_EQ((vector<int>{0, 3, 4}), metricsManager.mTagIdToMatcherIndices[10]);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
@@ -19,6 +19,7 @@
 #include "guardrail/StatsdStats.h"
 #include "logd/LogEvent.h"
 #include "packages/UidMap.h"
+#include "stats_log_util.h"
 #include "statslog.h"
 
 #include <gmock/gmock.h>
@@ -27,6 +28,9 @@
 #include "tests/statsd_test_util.h"
 
 #include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 using namespace android;
 using namespace testing;
@@ -339,6 +343,108 @@ TEST(StatsLogProcessorTest, TestOutOfOrderLogs) {
     EXPECT_FALSE(p.mInReconnection);
 }
 
+namespace {
+
+// Returns the sum of the counts of all the count metrics of the reports.
+int64_t countInReports(const vector<uint8_t>& bytes) {
+    ConfigMetricsReportList output;
+    EXPECT_TRUE(output.ParseFromArray(bytes.data(), bytes.size()));
+    int64_t count = 0;
+    for (const auto& report : output.reports()) {
+        for (const auto& metric : report.metrics()) {
+            for (const auto& data : metric.count_metrics().data()) {
+                for (const auto& bucket : data.bucket_info()) {
+                    count += bucket.count();
+                }
+            }
+        }
+    }
+    return count;
+}
+
+}  // namespace
+
+TEST(StatsLogProcessorTest, TestDumpReportWhileWritingToDisk) {
+    StatsdConfig config;
+    config.add_allowed_log_source("AID_ROOT");
+    auto screenOnMatcher = CreateScreenTurnedOnAtomMatcher();
+    *config.add_atom_matcher() = screenOnMatcher;
+    auto countMetric = config.add_count_metric();
+    countMetric->set_id(StringToId("ScreenTurnedOn"));
+    countMetric->set_what(screenOnMatcher.id());
+    countMetric->set_bucket(FIVE_MINUTES);
+
+    const int64_t bucketStartTimeNs = 10000000000;
+    const int events = 100;
+    ConfigKey cfgKey(0, 987654321);
+    for (int i = 0; i < 20; i++) {
+        auto processor =
+                CreateStatsLogProcessor(bucketStartTimeNs, bucketStartTimeNs, config, cfgKey);
+        for (int j = 0; j < events; j++) {
+            auto event = CreateScreenStateChangedEvent(android::view::DISPLAY_STATE_ON,
+                                                       bucketStartTimeNs + j + 1);
+            processor->OnLogEvent(event.get());
+        }
+
+        std::thread writer([&processor] { processor->WriteDataToDisk(DEVICE_SHUTDOWN); });
+        vector<uint8_t> bytes;
+        processor->onDumpReport(cfgKey, getElapsedRealtimeNs(), true, ADB_DUMP, &bytes);
+        writer.join();
+        // Whether the dump runs before the write, or while the write is in progress, it gets all
+        // the events: either from memory, or from the report on disk once written.
+        EXPECT_EQ(events, countInReports(bytes));
+
+        // Reads what the write left on disk.
+        processor->onDumpReport(cfgKey, getElapsedRealtimeNs(), true, ADB_DUMP, &bytes);
+        EXPECT_EQ(0, countInReports(bytes));
+    }
+}
+
+TEST(StatsLogProcessorTest, TestDumpReportWaitsForDiskWriteWithoutBlockingEvents) {
+    StatsdConfig config;
+    config.add_allowed_log_source("AID_ROOT");
+    auto screenOnMatcher = CreateScreenTurnedOnAtomMatcher();
+    *config.add_atom_matcher() = screenOnMatcher;
+    auto countMetric = config.add_count_metric();
+    countMetric->set_id(StringToId("ScreenTurnedOn"));
+    countMetric->set_what(screenOnMatcher.id());
+    countMetric->set_bucket(FIVE_MINUTES);
+
+    const int64_t bucketStartTimeNs = 10000000000;
+    ConfigKey cfgKey(0, 987654321);
+    auto processor = CreateStatsLogProcessor(bucketStartTimeNs, bucketStartTimeNs, config, cfgKey);
+
+    // A write to disk is in progress.
+    {
+        std::lock_guard<std::mutex> lock(processor->mMetricsMutex);
+        processor->mDiskWritesInProgress++;
+    }
+    std::atomic<bool> dumped(false);
+    std::thread dump([&processor, &cfgKey, &dumped] {
+        vector<uint8_t> bytes;
+        processor->onDumpReport(cfgKey, getElapsedRealtimeNs(), true, ADB_DUMP, &bytes);
+        dumped = true;
+    });
+
+    // The dump waits for the write, but the events are still processed meanwhile.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (int i = 0; i < 10; i++) {
+        auto event = CreateScreenStateChangedEvent(android::view::DISPLAY_STATE_ON,
+                                                   bucketStartTimeNs + i + 1);
+        processor->OnLogEvent(event.get());
+    }
+    EXPECT_EQ(10u, processor->mLogCount);
+    EXPECT_FALSE(dumped);
+
+    {
+        std::lock_guard<std::mutex> lock(processor->mMetricsMutex);
+        processor->mDiskWritesInProgress--;
+        processor->mDiskWritesDone.notify_all();
+    }
+    dump.join();
+    EXPECT_TRUE(dumped);
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
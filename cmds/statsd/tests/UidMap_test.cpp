@@ -378,6 +378,132 @@ TEST(UidMapTest, TestMemoryGuardrail) {
     EXPECT_EQ(1U, m.mChanges.size());
 }
 
+TEST(UidMapTest, TestHasNormalizedApp) {
+    UidMap m;
+    vector<int32_t> uids;
+    vector<int64_t> versions;
+    vector<String16> apps;
+    uids.push_back(1000);
+    uids.push_back(1000);
+    uids.push_back(2000);
+    apps.push_back(String16("App1.Sharing.1"));
+    apps.push_back(String16(kApp2.c_str()));
+    apps.push_back(String16(kApp2.c_str()));
+    versions.push_back(4);
+    versions.push_back(5);
+    versions.push_back(6);
+    m.updateMap(1, uids, versions, apps);
+
+    EXPECT_TRUE(m.hasNormalizedApp(1000, kApp1));
+    EXPECT_FALSE(m.hasNormalizedApp(1000, "App1.Sharing.1"));
+    EXPECT_TRUE(m.hasNormalizedApp(1000, kApp2));
+    EXPECT_TRUE(m.hasNormalizedApp(2000, kApp2));
+    EXPECT_FALSE(m.hasNormalizedApp(2000, kApp1));
+    EXPECT_FALSE(m.hasNormalizedApp(3000, kApp2));
+
+    m.removeApp(2, String16(kApp2.c_str()), 1000);
+    EXPECT_FALSE(m.hasNormalizedApp(1000, kApp2));
+    EXPECT_TRUE(m.hasNormalizedApp(2000, kApp2));
+    EXPECT_EQ(std::set<int32_t>({2000}), m.getAppUid(kApp2));
+}
+
+TEST(UidMapTest, TestDeltaSnapshot) {
+    UidMap m;
+    ConfigKey config1(1, StringToId("config1"));
+    ConfigKey config2(1, StringToId("config2"));
+    m.OnConfigUpdated(config1);
+    m.OnConfigUpdated(config2);
+    vector<int32_t> uids;
+    vector<int64_t> versions;
+    vector<String16> apps;
+    uids.push_back(1000);
+    uids.push_back(1001);
+    apps.push_back(String16(kApp1.c_str()));
+    apps.push_back(String16(kApp2.c_str()));
+    versions.push_back(4);
+    versions.push_back(5);
+    m.updateMap(1, uids, versions, apps);
+
+    ProtoOutputStream proto;
+    UidMapping results;
+    m.appendUidMap(2, config1, nullptr, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    EXPECT_FALSE(results.snapshots(0).is_delta());
+    EXPECT_EQ(2, results.snapshots(0).package_info_size());
+
+    // Only the upgraded app.
+    m.updateApp(3, String16(kApp1.c_str()), 1000, 40);
+    proto.clear();
+    m.appendUidMap(4, config1, nullptr, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    EXPECT_TRUE(results.snapshots(0).is_delta());
+    ASSERT_EQ(1, results.snapshots(0).package_info_size());
+    EXPECT_EQ(kApp1, results.snapshots(0).package_info(0).name());
+    EXPECT_EQ(40, results.snapshots(0).package_info(0).version());
+
+    // Nothing changed since.
+    proto.clear();
+    m.appendUidMap(5, config1, nullptr, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    EXPECT_TRUE(results.snapshots(0).is_delta());
+    EXPECT_EQ(0, results.snapshots(0).package_info_size());
+
+    // The other config still gets all the apps first.
+    proto.clear();
+    m.appendUidMap(6, config2, nullptr, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    EXPECT_FALSE(results.snapshots(0).is_delta());
+    EXPECT_EQ(2, results.snapshots(0).package_info_size());
+
+    // A full update of the map, and clearing the output, send all the apps again.
+    m.updateMap(7, uids, versions, apps);
+    proto.clear();
+    m.appendUidMap(8, config1, nullptr, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    EXPECT_FALSE(results.snapshots(0).is_delta());
+    EXPECT_EQ(2, results.snapshots(0).package_info_size());
+
+    m.clearOutput();
+    proto.clear();
+    m.appendUidMap(9, config1, nullptr, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    EXPECT_FALSE(results.snapshots(0).is_delta());
+    EXPECT_EQ(2, results.snapshots(0).package_info_size());
+
+    // The reports of the config with the full snapshot were lost, so it's sent again.
+    m.OnConfigDataLost(config1);
+    proto.clear();
+    m.appendUidMap(10, config1, nullptr, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    EXPECT_FALSE(results.snapshots(0).is_delta());
+    EXPECT_EQ(2, results.snapshots(0).package_info_size());
+
+    proto.clear();
+    m.appendUidMap(11, config1, nullptr, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    EXPECT_TRUE(results.snapshots(0).is_delta());
+}
+
+TEST(UidMapTest, TestPackageNamesInternedAgain) {
+    UidMap m;
+    vector<int32_t> uids;
+    vector<int64_t> versions;
+    vector<String16> apps;
+    uids.push_back(1000);
+    apps.push_back(String16("App1"));
+    versions.push_back(1);
+    m.updateMap(1, uids, versions, apps);
+    m.updateApp(2, String16(kApp2.c_str()), 1001, 1);
+    // "App1", "app1" and kApp2.
+    EXPECT_EQ(3U, m.mPackageNames.size());
+
+    // kApp2 isn't in the new map, so its name goes away.
+    m.updateMap(3, uids, versions, apps);
+    EXPECT_EQ(2U, m.mPackageNames.size());
+    EXPECT_TRUE(m.hasApp(1000, "App1"));
+    EXPECT_FALSE(m.hasApp(1001, kApp2));
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
@@ -0,0 +1,162 @@
+// Copyright (C) 2018 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/anomaly/AlarmTimerWheel.h"
+
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+using std::multimap;
+using std::set;
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+static set<const AlarmTimerWheelNode*> pop(AlarmTimerWheel* wheel, uint32_t timeSec) {
+    vector<const AlarmTimerWheelNode*> expired;
+    wheel->popSoonerThan(timeSec, &expired);
+    return set<const AlarmTimerWheelNode*>(expired.begin(), expired.end());
+}
+
+TEST(AlarmTimerWheelTest, TestArmAndCancel) {
+    AlarmTimerWheel wheel;
+    AlarmTimerWheelNode a, b, c;
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_EQ(0u, wheel.getSoonestAlarmTimeSec());
+
+    EXPECT_TRUE(wheel.arm(&a, 30));
+    EXPECT_TRUE(wheel.arm(&b, 10));
+    EXPECT_TRUE(wheel.arm(&c, 20));
+    // Already armed.
+    EXPECT_FALSE(wheel.arm(&b, 5));
+    EXPECT_EQ(3u, wheel.size());
+    EXPECT_EQ(10u, wheel.getSoonestAlarmTimeSec());
+
+    EXPECT_TRUE(wheel.cancel(&b));
+    EXPECT_FALSE(wheel.cancel(&b));
+    EXPECT_EQ(20u, wheel.getSoonestAlarmTimeSec());
+    EXPECT_TRUE(wheel.cancel(&a));
+    EXPECT_EQ(20u, wheel.getSoonestAlarmTimeSec());
+    EXPECT_TRUE(wheel.cancel(&c));
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_EQ(0u, wheel.getSoonestAlarmTimeSec());
+
+    // A cancelled alarm can be armed again.
+    EXPECT_TRUE(wheel.arm(&b, 40));
+    EXPECT_EQ(40u, wheel.getSoonestAlarmTimeSec());
+}
+
+TEST(AlarmTimerWheelTest, TestPopAcrossLevels) {
+    AlarmTimerWheel wheel;
+    AlarmTimerWheelNode a, b, c, d, e;
+    // Each of them in a different level.
+    wheel.arm(&a, 50);
+    wheel.arm(&b, 4000);
+    wheel.arm(&c, 4001);
+    wheel.arm(&d, 300000);
+    wheel.arm(&e, 4000000000u);
+
+    EXPECT_TRUE(pop(&wheel, 49).empty());
+    EXPECT_EQ((set<const AlarmTimerWheelNode*>{&a}), pop(&wheel, 50));
+    // b and c move to lower levels, and only b expires.
+    EXPECT_EQ((set<const AlarmTimerWheelNode*>{&b}), pop(&wheel, 4000));
+    EXPECT_EQ(4001u, wheel.getSoonestAlarmTimeSec());
+    // A jump past several alarms at once.
+    EXPECT_EQ((set<const AlarmTimerWheelNode*>{&c, &d}), pop(&wheel, 1000000));
+    EXPECT_EQ(4000000000u, wheel.getSoonestAlarmTimeSec());
+    EXPECT_EQ((set<const AlarmTimerWheelNode*>{&e}), pop(&wheel, UINT32_MAX));
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(AlarmTimerWheelTest, TestAlarmsArmedInThePast) {
+    AlarmTimerWheel wheel;
+    AlarmTimerWheelNode a, b, c;
+    EXPECT_TRUE(pop(&wheel, 1000).empty());
+
+    wheel.arm(&a, 900);
+    wheel.arm(&b, 1000);
+    wheel.arm(&c, 1001);
+    EXPECT_EQ(900u, wheel.getSoonestAlarmTimeSec());
+
+    // The wheel doesn't move back, but only the alarms up to the given time expire.
+    EXPECT_EQ((set<const AlarmTimerWheelNode*>{&a}), pop(&wheel, 950));
+    EXPECT_EQ(1000u, wheel.getSoonestAlarmTimeSec());
+    EXPECT_EQ((set<const AlarmTimerWheelNode*>{&b, &c}), pop(&wheel, 1001));
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(AlarmTimerWheelTest, TestMatchesSortedAlarms) {
+    const int kAlarmCount = 200;
+    std::mt19937 random(1);
+    AlarmTimerWheel wheel;
+    vector<AlarmTimerWheelNode> alarms(kAlarmCount);
+    multimap<uint32_t, const AlarmTimerWheelNode*> expectedAlarms;
+    uint32_t nowSec = 0;
+
+    for (int i = 0; i < 20000; i++) {
+        AlarmTimerWheelNode* alarm = &alarms[random() % kAlarmCount];
+        switch (random() % 4) {
+            case 0:
+            case 1: {
+                // Mostly near the current time, sometimes in the past or far ahead.
+                const uint32_t timeSec = random() % 10 == 0 ? random() : nowSec + random() % 5000;
+                const bool wasArmed = alarm->wheel != nullptr;
+                EXPECT_EQ(!wasArmed, wheel.arm(alarm, timeSec));
+                if (!wasArmed) {
+                    expectedAlarms.emplace(timeSec, alarm);
+                }
+                break;
+            }
+            case 2: {
+                const bool wasArmed = alarm->wheel != nullptr;
+                EXPECT_EQ(wasArmed, wheel.cancel(alarm));
+                if (wasArmed) {
+                    for (auto it = expectedAlarms.find(alarm->timeSec);; it++) {
+                        if (it->second == alarm) {
+                            expectedAlarms.erase(it);
+                            break;
+                        }
+                    }
+                }
+                break;
+            }
+            default: {
+                nowSec += random() % 1000;
+                set<const AlarmTimerWheelNode*> expectedExpired;
+                while (!expectedAlarms.empty() && expectedAlarms.begin()->first <= nowSec) {
+                    expectedExpired.insert(expectedAlarms.begin()->second);
+                    expectedAlarms.erase(expectedAlarms.begin());
+                }
+                ASSERT_EQ(expectedExpired, pop(&wheel, nowSec));
+            }
+        }
+        ASSERT_EQ(expectedAlarms.size(), wheel.size());
+        ASSERT_EQ(expectedAlarms.empty() ? 0u : expectedAlarms.begin()->first,
+                  wheel.getSoonestAlarmTimeSec());
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -0,0 +1,209 @@
+// Copyright (C) 2018 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/external/StatsPullerManagerImpl.h"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using std::shared_ptr;
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Pulled atoms with pullers in kAllPullAtomInfo, as StatsPuller reads its cool down from there.
+const int kTagId1 = android::util::KERNEL_WAKELOCK;
+const int kTagId2 = android::util::SUBSYSTEM_SLEEP_STATE;
+
+class FakePuller : public StatsPuller {
+public:
+    FakePuller(int tagId, std::chrono::milliseconds pullDuration = std::chrono::milliseconds(0))
+        : StatsPuller(tagId), mPullDuration(pullDuration) {
+    }
+
+    std::atomic<int> pullCount{0};
+
+private:
+    bool PullInternal(vector<shared_ptr<LogEvent>>* data) override {
+        pullCount++;
+        std::this_thread::sleep_for(mPullDuration);
+        return true;
+    }
+
+    const std::chrono::milliseconds mPullDuration;
+};
+
+class FakeReceiver : public PullDataReceiver {
+public:
+    void onDataPulled(const vector<shared_ptr<LogEvent>>& data) override {
+        dataPulledCount++;
+    }
+
+    int dataPulledCount = 0;
+};
+
+static PullAtomInfo createPullAtomInfo(const sp<StatsPuller>& puller,
+                                       int64_t pullTimeoutNs = 10 * NS_PER_SEC) {
+    PullAtomInfo info;
+    info.puller = puller;
+    info.pullTimeoutNs = pullTimeoutNs;
+    return info;
+}
+
+TEST(StatsPullerManagerImplTest, TestSharedPull) {
+    sp<FakePuller> puller = new FakePuller(kTagId1);
+    StatsPullerManagerImpl manager({{kTagId1, createPullAtomInfo(puller)}});
+    sp<FakeReceiver> receiver1 = new FakeReceiver();
+    sp<FakeReceiver> receiver2 = new FakeReceiver();
+    const int64_t bucketSizeNs = 60 * NS_PER_SEC;
+    manager.RegisterReceiver(kTagId1, receiver1, 100 * NS_PER_SEC, bucketSizeNs);
+    manager.RegisterReceiver(kTagId1, receiver2, 100 * NS_PER_SEC, bucketSizeNs);
+
+    manager.OnAlarmFired(100 * NS_PER_SEC);
+    EXPECT_EQ(1, puller->pullCount.load());
+    EXPECT_EQ(1, receiver1->dataPulledCount);
+    EXPECT_EQ(1, receiver2->dataPulledCount);
+    EXPECT_EQ(160 * NS_PER_SEC, manager.mNextPullTimeNs);
+}
+
+TEST(StatsPullerManagerImplTest, TestCoalescedPullTime) {
+    sp<FakePuller> puller1 = new FakePuller(kTagId1);
+    sp<FakePuller> puller2 = new FakePuller(kTagId2);
+    StatsPullerManagerImpl manager(
+            {{kTagId1, createPullAtomInfo(puller1)}, {kTagId2, createPullAtomInfo(puller2)}});
+    sp<FakeReceiver> receiver1 = new FakeReceiver();
+    sp<FakeReceiver> receiver2 = new FakeReceiver();
+    sp<FakeReceiver> receiver3 = new FakeReceiver();
+    const int64_t bucketSizeNs = 60 * 60 * NS_PER_SEC;
+    const int64_t pullTimeNs = 100 * NS_PER_SEC;
+
+    manager.RegisterReceiver(kTagId1, receiver1, pullTimeNs, bucketSizeNs);
+    EXPECT_EQ(pullTimeNs, manager.mNextPullTimeNs);
+    // Within the window: the alarm moves to its pull time, so both are pulled by one alarm.
+    manager.RegisterReceiver(kTagId2, receiver2, pullTimeNs + 3 * NS_PER_SEC, bucketSizeNs);
+    EXPECT_EQ(pullTimeNs + 3 * NS_PER_SEC, manager.mNextPullTimeNs);
+    // Outside of the window.
+    manager.RegisterReceiver(kTagId2, receiver3, pullTimeNs + 30 * NS_PER_SEC, bucketSizeNs);
+    EXPECT_EQ(pullTimeNs + 3 * NS_PER_SEC, manager.mNextPullTimeNs);
+
+    manager.OnAlarmFired(pullTimeNs + 3 * NS_PER_SEC);
+    EXPECT_EQ(1, receiver1->dataPulledCount);
+    EXPECT_EQ(1, receiver2->dataPulledCount);
+    EXPECT_EQ(0, receiver3->dataPulledCount);
+    EXPECT_EQ(pullTimeNs + 30 * NS_PER_SEC, manager.mNextPullTimeNs);
+
+    manager.OnAlarmFired(pullTimeNs + 30 * NS_PER_SEC);
+    EXPECT_EQ(1, receiver3->dataPulledCount);
+    // The next buckets of receiver1 and receiver2 are still coalesced.
+    EXPECT_EQ(pullTimeNs + bucketSizeNs + 3 * NS_PER_SEC, manager.mNextPullTimeNs);
+}
+
+TEST(StatsPullerManagerImplTest, TestConcurrentPulls) {
+    const auto pullDuration = std::chrono::milliseconds(300);
+    sp<FakePuller> puller1 = new FakePuller(kTagId1, pullDuration);
+    sp<FakePuller> puller2 = new FakePuller(kTagId2, pullDuration);
+    StatsPullerManagerImpl manager(
+            {{kTagId1, createPullAtomInfo(puller1)}, {kTagId2, createPullAtomInfo(puller2)}});
+    sp<FakeReceiver> receiver1 = new FakeReceiver();
+    sp<FakeReceiver> receiver2 = new FakeReceiver();
+    manager.RegisterReceiver(kTagId1, receiver1, 100 * NS_PER_SEC, 60 * NS_PER_SEC);
+    manager.RegisterReceiver(kTagId2, receiver2, 100 * NS_PER_SEC, 60 * NS_PER_SEC);
+
+    const auto start = std::chrono::steady_clock::now();
+    manager.OnAlarmFired(100 * NS_PER_SEC);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 2 * pullDuration);
+    EXPECT_EQ(1, receiver1->dataPulledCount);
+    EXPECT_EQ(1, receiver2->dataPulledCount);
+}
+
+TEST(StatsPullerManagerImplTest, TestPullTimeout) {
+    sp<FakePuller> slowPuller = new FakePuller(kTagId1, std::chrono::milliseconds(2000));
+    sp<FakePuller> puller = new FakePuller(kTagId2);
+    StatsPullerManagerImpl manager({{kTagId1, createPullAtomInfo(slowPuller, NS_PER_SEC / 10)},
+                                    {kTagId2, createPullAtomInfo(puller)}});
+    sp<FakeReceiver> receiver1 = new FakeReceiver();
+    sp<FakeReceiver> receiver2 = new FakeReceiver();
+    manager.RegisterReceiver(kTagId1, receiver1, 100 * NS_PER_SEC, 60 * NS_PER_SEC);
+    manager.RegisterReceiver(kTagId2, receiver2, 100 * NS_PER_SEC, 60 * NS_PER_SEC);
+
+    const auto start = std::chrono::steady_clock::now();
+    manager.OnAlarmFired(100 * NS_PER_SEC);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+    EXPECT_EQ(0, receiver1->dataPulledCount);
+    EXPECT_EQ(1, receiver2->dataPulledCount);
+    // The receiver of the slow puller is still due, and retried before the next bucket.
+    EXPECT_EQ(100 * NS_PER_SEC, manager.mReceivers[kTagId1].front().nextPullTimeNs);
+    EXPECT_EQ(100 * NS_PER_SEC + StatsPullerManagerImpl::kPullCoalesceWindowNs,
+              manager.mNextPullTimeNs);
+}
+
+TEST(StatsPullerManagerImplTest, TestPullInFlightIsSkipped) {
+    sp<FakePuller> slowPuller = new FakePuller(kTagId1, std::chrono::milliseconds(1000));
+    StatsPullerManagerImpl manager({{kTagId1, createPullAtomInfo(slowPuller, NS_PER_SEC / 10)}});
+    sp<FakeReceiver> receiver = new FakeReceiver();
+    manager.RegisterReceiver(kTagId1, receiver, 100 * NS_PER_SEC, 60 * NS_PER_SEC);
+
+    manager.OnAlarmFired(100 * NS_PER_SEC);
+    EXPECT_EQ(0, receiver->dataPulledCount);
+    // The only receiver is still due, so the alarm is re-armed for a retry.
+    EXPECT_EQ(100 * NS_PER_SEC + StatsPullerManagerImpl::kPullCoalesceWindowNs,
+              manager.mNextPullTimeNs);
+    // The pull that timed out is still running, so the next alarm doesn't start another one.
+    manager.OnAlarmFired(101 * NS_PER_SEC);
+    EXPECT_EQ(1, slowPuller->pullCount.load());
+    EXPECT_EQ(0, receiver->dataPulledCount);
+    EXPECT_EQ(101 * NS_PER_SEC + StatsPullerManagerImpl::kPullCoalesceWindowNs,
+              manager.mNextPullTimeNs);
+
+    // Once it's done, the atom is pulled again.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    manager.OnAlarmFired(102 * NS_PER_SEC);
+    EXPECT_EQ(2, slowPuller->pullCount.load());
+}
+
+TEST(StatsPullerManagerImplTest, TestNotLockedWhileWaitingForPulls) {
+    const auto pullDuration = std::chrono::milliseconds(1000);
+    sp<FakePuller> slowPuller = new FakePuller(kTagId1, pullDuration);
+    StatsPullerManagerImpl manager({{kTagId1, createPullAtomInfo(slowPuller)}});
+    sp<FakeReceiver> receiver1 = new FakeReceiver();
+    sp<FakeReceiver> receiver2 = new FakeReceiver();
+    manager.RegisterReceiver(kTagId1, receiver1, 100 * NS_PER_SEC, 60 * NS_PER_SEC);
+
+    std::thread alarm([&manager] { manager.OnAlarmFired(100 * NS_PER_SEC); });
+    while (slowPuller->pullCount.load() == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // Registering doesn't wait for the pull to finish.
+    const auto start = std::chrono::steady_clock::now();
+    manager.RegisterReceiver(kTagId2, receiver2, 200 * NS_PER_SEC, 60 * NS_PER_SEC);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, pullDuration / 2);
+    alarm.join();
+
+    EXPECT_EQ(1, receiver1->dataPulledCount);
+    EXPECT_EQ(160 * NS_PER_SEC, manager.mNextPullTimeNs);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -320,6 +320,28 @@ TEST(StatsdStatsTest, TestSystemServerCrash) {
     EXPECT_EQ(StatsdStats::kMaxSystemServerRestarts + 1, report.system_restart_sec(maxCount - 1));
 }
 
+TEST(StatsdStatsTest, TestEventQueue) {
+    StatsdStats stats;
+    stats.noteEventQueueBatch(10, 0);
+    stats.noteEventQueueBatch(100, 5);
+    stats.noteEventQueueBatch(50, 3);
+
+    vector<uint8_t> output;
+    stats.dumpStats(&output, true /*reset*/);
+    StatsdStatsReport report;
+    EXPECT_TRUE(report.ParseFromArray(&output[0], output.size()));
+    EXPECT_TRUE(report.has_event_queue_stats());
+    EXPECT_EQ(100, report.event_queue_stats().max_queue_depth());
+    EXPECT_EQ(2, report.event_queue_stats().overflow_count());
+    EXPECT_EQ(8, report.event_queue_stats().dropped_event_count());
+
+    output.clear();
+    stats.dumpStats(&output, false);
+    EXPECT_TRUE(report.ParseFromArray(&output[0], output.size()));
+    EXPECT_EQ(0, report.event_queue_stats().max_queue_depth());
+    EXPECT_EQ(0, report.event_queue_stats().dropped_event_count());
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -25,6 +25,7 @@
 
 using namespace testing;
 using android::sp;
+using android::util::ProtoOutputStream;
 using std::set;
 using std::unordered_map;
 using std::vector;
@@ -72,11 +73,11 @@ TEST(CountMetricProducerTest, TestNonDimensionalEvents) {
     EXPECT_EQ(1UL, countProducer.mPastBuckets.size());
     EXPECT_TRUE(countProducer.mPastBuckets.find(DEFAULT_METRIC_DIMENSION_KEY) !=
                 countProducer.mPastBuckets.end());
-    const auto& buckets = countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY];
+    const auto& buckets = countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY);
     EXPECT_EQ(1UL, buckets.size());
     EXPECT_EQ(bucketStartTimeNs, buckets[0].mBucketStartNs);
     EXPECT_EQ(bucketStartTimeNs + bucketSizeNs, buckets[0].mBucketEndNs);
-    EXPECT_EQ(2LL, buckets[0].mCount);
+    EXPECT_EQ(2LL, buckets[0].mValue);
 
     // 1 matched event happens in bucket 2.
     LogEvent event3(tagId, bucketStartTimeNs + bucketSizeNs + 2);
@@ -87,18 +88,18 @@ TEST(CountMetricProducerTest, TestNonDimensionalEvents) {
     EXPECT_EQ(1UL, countProducer.mPastBuckets.size());
     EXPECT_TRUE(countProducer.mPastBuckets.find(DEFAULT_METRIC_DIMENSION_KEY) !=
                 countProducer.mPastBuckets.end());
-    EXPECT_EQ(2UL, countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
-    const auto& bucketInfo2 = countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY][1];
+    EXPECT_EQ(2UL, countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
+    const auto bucketInfo2 = countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY)[1];
     EXPECT_EQ(bucket2StartTimeNs, bucketInfo2.mBucketStartNs);
     EXPECT_EQ(bucket2StartTimeNs + bucketSizeNs, bucketInfo2.mBucketEndNs);
-    EXPECT_EQ(1LL, bucketInfo2.mCount);
+    EXPECT_EQ(1LL, bucketInfo2.mValue);
 
     // nothing happens in bucket 3. we should not record anything for bucket 3.
     countProducer.flushIfNeededLocked(bucketStartTimeNs + 3 * bucketSizeNs + 1);
     EXPECT_EQ(1UL, countProducer.mPastBuckets.size());
     EXPECT_TRUE(countProducer.mPastBuckets.find(DEFAULT_METRIC_DIMENSION_KEY) !=
                 countProducer.mPastBuckets.end());
-    const auto& buckets3 = countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY];
+    const auto& buckets3 = countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY);
     EXPECT_EQ(2UL, buckets3.size());
 }
 
@@ -136,12 +137,12 @@ TEST(CountMetricProducerTest, TestEventsWithNonSlicedCondition) {
     EXPECT_TRUE(countProducer.mPastBuckets.find(DEFAULT_METRIC_DIMENSION_KEY) !=
                 countProducer.mPastBuckets.end());
     {
-        const auto& buckets = countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY];
+        const auto& buckets = countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY);
         EXPECT_EQ(1UL, buckets.size());
         const auto& bucketInfo = buckets[0];
         EXPECT_EQ(bucketStartTimeNs, bucketInfo.mBucketStartNs);
         EXPECT_EQ(bucketStartTimeNs + bucketSizeNs, bucketInfo.mBucketEndNs);
-        EXPECT_EQ(1LL, bucketInfo.mCount);
+        EXPECT_EQ(1LL, bucketInfo.mValue);
     }
 }
 
@@ -193,12 +194,12 @@ TEST(CountMetricProducerTest, TestEventsWithSlicedCondition) {
     EXPECT_EQ(1UL, countProducer.mPastBuckets.size());
     EXPECT_TRUE(countProducer.mPastBuckets.find(DEFAULT_METRIC_DIMENSION_KEY) !=
                 countProducer.mPastBuckets.end());
-    const auto& buckets = countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY];
+    const auto& buckets = countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY);
     EXPECT_EQ(1UL, buckets.size());
     const auto& bucketInfo = buckets[0];
     EXPECT_EQ(bucketStartTimeNs, bucketInfo.mBucketStartNs);
     EXPECT_EQ(bucketStartTimeNs + bucketSizeNs, bucketInfo.mBucketEndNs);
-    EXPECT_EQ(1LL, bucketInfo.mCount);
+    EXPECT_EQ(1LL, bucketInfo.mValue);
 }
 
 TEST(CountMetricProducerTest, TestEventWithAppUpgrade) {
@@ -235,11 +236,12 @@ TEST(CountMetricProducerTest, TestEventWithAppUpgrade) {
     // App upgrade forces bucket flush.
     // Check that there's a past bucket and the bucket end is not adjusted.
     countProducer.notifyAppUpgrade(eventUpgradeTimeNs, "ANY.APP", 1, 1);
-    EXPECT_EQ(1UL, countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(1UL, countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
     EXPECT_EQ((long long)bucketStartTimeNs,
-              countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY][0].mBucketStartNs);
+              countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY)[0]
+                      .mBucketStartNs);
     EXPECT_EQ((long long)eventUpgradeTimeNs,
-              countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY][0].mBucketEndNs);
+              countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY)[0].mBucketEndNs);
     EXPECT_EQ(eventUpgradeTimeNs, countProducer.mCurrentBucketStartTimeNs);
     // Anomaly tracker only contains full buckets.
     EXPECT_EQ(0, anomalyTracker->getSumOverPastBuckets(DEFAULT_METRIC_DIMENSION_KEY));
@@ -250,7 +252,7 @@ TEST(CountMetricProducerTest, TestEventWithAppUpgrade) {
     event2.write("222");  // uid
     event2.init();
     countProducer.onMatchedLogEvent(1 /*log matcher index*/, event2);
-    EXPECT_EQ(1UL, countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(1UL, countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
     EXPECT_EQ(eventUpgradeTimeNs, countProducer.mCurrentBucketStartTimeNs);
     EXPECT_EQ(0, anomalyTracker->getSumOverPastBuckets(DEFAULT_METRIC_DIMENSION_KEY));
 
@@ -259,7 +261,7 @@ TEST(CountMetricProducerTest, TestEventWithAppUpgrade) {
     event3.write("333");  // uid
     event3.init();
     countProducer.onMatchedLogEvent(1 /*log matcher index*/, event3);
-    EXPECT_EQ(2UL, countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(2UL, countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
     EXPECT_EQ(lastEndTimeNs, countProducer.mCurrentBucketStartTimeNs);
     EXPECT_EQ(2, anomalyTracker->getSumOverPastBuckets(DEFAULT_METRIC_DIMENSION_KEY));
 }
@@ -290,11 +292,12 @@ TEST(CountMetricProducerTest, TestEventWithAppUpgradeInNextBucket) {
     // App upgrade forces bucket flush.
     // Check that there's a past bucket and the bucket end is not adjusted.
     countProducer.notifyAppUpgrade(eventUpgradeTimeNs, "ANY.APP", 1, 1);
-    EXPECT_EQ(1UL, countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(1UL, countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
     EXPECT_EQ((int64_t)bucketStartTimeNs,
-              countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY][0].mBucketStartNs);
+              countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY)[0]
+                      .mBucketStartNs);
     EXPECT_EQ(bucketStartTimeNs + bucketSizeNs,
-              countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY][0].mBucketEndNs);
+              countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY)[0].mBucketEndNs);
     EXPECT_EQ(eventUpgradeTimeNs, countProducer.mCurrentBucketStartTimeNs);
 
     // Next event occurs in same bucket as partial bucket created.
@@ -302,18 +305,19 @@ TEST(CountMetricProducerTest, TestEventWithAppUpgradeInNextBucket) {
     event2.write("222");  // uid
     event2.init();
     countProducer.onMatchedLogEvent(1 /*log matcher index*/, event2);
-    EXPECT_EQ(1UL, countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(1UL, countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
 
     // Third event in following bucket.
     LogEvent event3(tagId, bucketStartTimeNs + 121 * NS_PER_SEC + 10);
     event3.write("333");  // uid
     event3.init();
     countProducer.onMatchedLogEvent(1 /*log matcher index*/, event3);
-    EXPECT_EQ(2UL, countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(2UL, countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
     EXPECT_EQ((int64_t)eventUpgradeTimeNs,
-              countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY][1].mBucketStartNs);
+              countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY)[1]
+                      .mBucketStartNs);
     EXPECT_EQ(bucketStartTimeNs + 2 * bucketSizeNs,
-              countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY][1].mBucketEndNs);
+              countProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY)[1].mBucketEndNs);
 }
 
 TEST(CountMetricProducerTest, TestAnomalyDetectionUnSliced) {
@@ -389,6 +393,70 @@ TEST(CountMetricProducerTest, TestAnomalyDetectionUnSliced) {
             std::ceil(1.0 * event7.GetElapsedTimestampNs() / NS_PER_SEC + refPeriodSec));
 }
 
+static StatsLogReport outputStreamToProto(ProtoOutputStream* proto) {
+    vector<uint8_t> bytes;
+    bytes.resize(proto->size());
+    size_t pos = 0;
+    auto iter = proto->data();
+    while (iter.readBuffer() != NULL) {
+        size_t toRead = iter.currentToRead();
+        std::memcpy(&bytes[pos], iter.readBuffer(), toRead);
+        pos += toRead;
+        iter.rp()->move(toRead);
+    }
+    StatsLogReport report;
+    report.ParseFromArray(bytes.data(), bytes.size());
+    return report;
+}
+
+TEST(CountMetricProducerTest, TestEventsAfterPrepareDumpReport) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+    int64_t bucket2StartTimeNs = bucketStartTimeNs + bucketSizeNs;
+    int64_t bucket3StartTimeNs = bucketStartTimeNs + 2 * bucketSizeNs;
+    int tagId = 1;
+
+    CountMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+
+    LogEvent event1(tagId, bucketStartTimeNs + 1);
+    event1.init();
+    LogEvent event2(tagId, bucket2StartTimeNs + 2);
+    event2.init();
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    CountMetricProducer countProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, wizard,
+                                      bucketStartTimeNs);
+    countProducer.setBucketSize(60 * NS_PER_SEC);
+
+    countProducer.onMatchedLogEvent(1 /*log matcher index*/, event1);
+    std::unique_ptr<PreparedDumpReport> prepared = countProducer.prepareDumpReport(
+            bucket2StartTimeNs + 1, false /* include_current_partial_bucket */);
+
+    // An event processed before the prepared report is written goes to the next report.
+    countProducer.onMatchedLogEvent(1 /*log matcher index*/, event2);
+
+    ProtoOutputStream output;
+    countProducer.writeDumpReport(prepared.get(), nullptr, &output);
+    StatsLogReport report = outputStreamToProto(&output);
+    EXPECT_EQ(1, report.metric_id());
+    ASSERT_EQ(1, report.count_metrics().data_size());
+    ASSERT_EQ(1, report.count_metrics().data(0).bucket_info_size());
+    EXPECT_EQ(0, report.count_metrics().data(0).bucket_info(0).bucket_num());
+    EXPECT_EQ(1, report.count_metrics().data(0).bucket_info(0).count());
+
+    ProtoOutputStream output2;
+    countProducer.onDumpReport(bucket3StartTimeNs + 1, false /* include_current_partial_bucket */,
+                               nullptr, &output2);
+    report = outputStreamToProto(&output2);
+    ASSERT_EQ(1, report.count_metrics().data_size());
+    ASSERT_EQ(1, report.count_metrics().data(0).bucket_info_size());
+    EXPECT_EQ(1, report.count_metrics().data(0).bucket_info(0).bucket_num());
+    EXPECT_EQ(1, report.count_metrics().data(0).bucket_info(0).count());
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -0,0 +1,107 @@
+// Copyright (C) 2018 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/metrics/PastBucketStore.h"
+#include "src/stats_util.h"
+
+#include <gtest/gtest.h>
+#include <limits>
+#include <vector>
+
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+static MetricDimensionKey getDimensionKey(int32_t uid) {
+    int pos[] = {1, 0, 0};
+    HashableDimensionKey dimension;
+    dimension.addValue(FieldValue(Field(10, pos, 0), Value(uid)));
+    return MetricDimensionKey(dimension, DEFAULT_DIMENSION_KEY);
+}
+
+TEST(PastBucketStoreTest, TestBucketsRoundTrip) {
+    const int64_t bucketSizeNs = 60LL * 1000 * 1000 * 1000;
+    const MetricDimensionKey key1 = getDimensionKey(1000);
+    const MetricDimensionKey key2 = getDimensionKey(1001);
+    const vector<int64_t> values = {5, 3, -7, std::numeric_limits<int64_t>::max(),
+                                    std::numeric_limits<int64_t>::min()};
+
+    PastBucketStore store;
+    for (size_t i = 0; i < values.size(); i++) {
+        const int64_t startNs = i * bucketSizeNs;
+        store.add(key1, startNs, startNs + bucketSizeNs, values[i]);
+        // key2 only has every other bucket.
+        if (i % 2 == 0) {
+            store.add(key2, startNs, startNs + bucketSizeNs, i);
+        }
+    }
+    // A partial bucket.
+    store.add(key2, 5 * bucketSizeNs, 5 * bucketSizeNs + 10, 100);
+
+    EXPECT_EQ(2UL, store.size());
+    vector<PastBucket> buckets = store.getBuckets(key1);
+    ASSERT_EQ(values.size(), buckets.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        EXPECT_EQ((int64_t)(i * bucketSizeNs), buckets[i].mBucketStartNs);
+        EXPECT_EQ((int64_t)((i + 1) * bucketSizeNs), buckets[i].mBucketEndNs);
+        EXPECT_EQ(values[i], buckets[i].mValue);
+    }
+
+    buckets = store.getBuckets(key2);
+    ASSERT_EQ(4UL, buckets.size());
+    EXPECT_EQ(0, buckets[0].mValue);
+    EXPECT_EQ(2 * bucketSizeNs, buckets[1].mBucketStartNs);
+    EXPECT_EQ(2, buckets[1].mValue);
+    EXPECT_EQ(4 * bucketSizeNs, buckets[2].mBucketStartNs);
+    EXPECT_EQ(4, buckets[2].mValue);
+    EXPECT_EQ(5 * bucketSizeNs, buckets[3].mBucketStartNs);
+    EXPECT_EQ(5 * bucketSizeNs + 10, buckets[3].mBucketEndNs);
+    EXPECT_EQ(100, buckets[3].mValue);
+
+    EXPECT_TRUE(store.getBuckets(getDimensionKey(1002)).empty());
+
+    store.clear();
+    EXPECT_TRUE(store.empty());
+    EXPECT_EQ(0UL, store.byteSize());
+}
+
+TEST(PastBucketStoreTest, TestByteSizeIsSmallerThanBuckets) {
+    const int64_t bucketSizeNs = 60LL * 1000 * 1000 * 1000;
+    PastBucketStore store;
+    for (int64_t i = 0; i < 100; i++) {
+        for (int32_t uid = 0; uid < 100; uid++) {
+            store.add(getDimensionKey(uid), i * bucketSizeNs, (i + 1) * bucketSizeNs, i % 3);
+        }
+    }
+
+    // At least one byte for the boundary and one for the value of each bucket, the boundary table
+    // and the overhead of each column.
+    const size_t minByteSize = 100UL * 100 * 2 + 100 * 2 * sizeof(int64_t) +
+                               100 * PastBucketStore::kColumnOverheadBytes;
+    EXPECT_GE(store.byteSize(), minByteSize);
+    // Allocated vectors at most double their size.
+    EXPECT_LE(store.byteSize(), 2 * minByteSize);
+    EXPECT_LT(store.byteSize(), 100UL * 100 * sizeof(PastBucket));
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
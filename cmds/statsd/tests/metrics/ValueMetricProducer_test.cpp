@@ -107,8 +107,9 @@ TEST(ValueMetricProducerTest, TestNonDimensionalEvents) {
     EXPECT_EQ(0, curInterval.tainted);
     EXPECT_EQ(0, curInterval.sum);
     EXPECT_EQ(1UL, valueProducer.mPastBuckets.size());
-    EXPECT_EQ(1UL, valueProducer.mPastBuckets.begin()->second.size());
-    EXPECT_EQ(12, valueProducer.mPastBuckets.begin()->second.back().mValue);
+    EXPECT_EQ(1UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
+    EXPECT_EQ(12,
+              valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).back().mValue);
 
     allData.clear();
     event = make_shared<LogEvent>(tagId, bucket4StartTimeNs + 1);
@@ -124,8 +125,9 @@ TEST(ValueMetricProducerTest, TestNonDimensionalEvents) {
     EXPECT_EQ(0, curInterval.tainted);
     EXPECT_EQ(0, curInterval.sum);
     EXPECT_EQ(1UL, valueProducer.mPastBuckets.size());
-    EXPECT_EQ(2UL, valueProducer.mPastBuckets.begin()->second.size());
-    EXPECT_EQ(13, valueProducer.mPastBuckets.begin()->second.back().mValue);
+    EXPECT_EQ(2UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
+    EXPECT_EQ(13,
+              valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).back().mValue);
 }
 
 /*
@@ -183,8 +185,9 @@ TEST(ValueMetricProducerTest, TestPulledEventsTakeAbsoluteValueOnReset) {
     EXPECT_EQ(0, curInterval.tainted);
     EXPECT_EQ(0, curInterval.sum);
     EXPECT_EQ(1UL, valueProducer.mPastBuckets.size());
-    EXPECT_EQ(1UL, valueProducer.mPastBuckets.begin()->second.size());
-    EXPECT_EQ(10, valueProducer.mPastBuckets.begin()->second.back().mValue);
+    EXPECT_EQ(1UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
+    EXPECT_EQ(10,
+              valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).back().mValue);
 
     allData.clear();
     event = make_shared<LogEvent>(tagId, bucket4StartTimeNs + 1);
@@ -199,8 +202,9 @@ TEST(ValueMetricProducerTest, TestPulledEventsTakeAbsoluteValueOnReset) {
     EXPECT_EQ(0, curInterval.tainted);
     EXPECT_EQ(0, curInterval.sum);
     EXPECT_EQ(1UL, valueProducer.mPastBuckets.size());
-    EXPECT_EQ(2UL, valueProducer.mPastBuckets.begin()->second.size());
-    EXPECT_EQ(26, valueProducer.mPastBuckets.begin()->second.back().mValue);
+    EXPECT_EQ(2UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
+    EXPECT_EQ(26,
+              valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).back().mValue);
 }
 
 /*
@@ -271,8 +275,9 @@ TEST(ValueMetricProducerTest, TestPulledEventsTakeZeroOnReset) {
     EXPECT_EQ(0, curInterval.tainted);
     EXPECT_EQ(0, curInterval.sum);
     EXPECT_EQ(1UL, valueProducer.mPastBuckets.size());
-    EXPECT_EQ(1UL, valueProducer.mPastBuckets.begin()->second.size());
-    EXPECT_EQ(26, valueProducer.mPastBuckets.begin()->second.back().mValue);
+    EXPECT_EQ(1UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
+    EXPECT_EQ(26,
+              valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).back().mValue);
 }
 
 /*
@@ -344,8 +349,9 @@ TEST(ValueMetricProducerTest, TestEventsWithNonSlicedCondition) {
     // startUpdated:false tainted:0 sum:0 start:110
     EXPECT_EQ(110, curInterval.start);
     EXPECT_EQ(1UL, valueProducer.mPastBuckets.size());
-    EXPECT_EQ(1UL, valueProducer.mPastBuckets.begin()->second.size());
-    EXPECT_EQ(10, valueProducer.mPastBuckets.begin()->second.back().mValue);
+    EXPECT_EQ(1UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
+    EXPECT_EQ(10,
+              valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).back().mValue);
 
     valueProducer.onConditionChanged(false, bucket2StartTimeNs + 1);
 
@@ -379,7 +385,7 @@ TEST(ValueMetricProducerTest, TestPushedEventsWithUpgrade) {
     EXPECT_EQ(1UL, valueProducer.mCurrentSlicedBucket.size());
 
     valueProducer.notifyAppUpgrade(eventUpgradeTimeNs, "ANY.APP", 1, 1);
-    EXPECT_EQ(1UL, valueProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(1UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
     EXPECT_EQ(eventUpgradeTimeNs, valueProducer.mCurrentBucketStartTimeNs);
 
     shared_ptr<LogEvent> event2 = make_shared<LogEvent>(tagId, bucketStartTimeNs + 59 * NS_PER_SEC);
@@ -387,7 +393,7 @@ TEST(ValueMetricProducerTest, TestPushedEventsWithUpgrade) {
     event2->write(10);
     event2->init();
     valueProducer.onMatchedLogEvent(1 /*log matcher index*/, *event2);
-    EXPECT_EQ(1UL, valueProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(1UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
     EXPECT_EQ(eventUpgradeTimeNs, valueProducer.mCurrentBucketStartTimeNs);
 
     // Next value should create a new bucket.
@@ -396,7 +402,7 @@ TEST(ValueMetricProducerTest, TestPushedEventsWithUpgrade) {
     event3->write(10);
     event3->init();
     valueProducer.onMatchedLogEvent(1 /*log matcher index*/, *event3);
-    EXPECT_EQ(2UL, valueProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(2UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
     EXPECT_EQ(bucketStartTimeNs + bucketSizeNs, valueProducer.mCurrentBucketStartTimeNs);
 }
 
@@ -439,9 +445,9 @@ TEST(ValueMetricProducerTest, TestPulledValueWithUpgrade) {
     EXPECT_EQ(1UL, valueProducer.mCurrentSlicedBucket.size());
 
     valueProducer.notifyAppUpgrade(eventUpgradeTimeNs, "ANY.APP", 1, 1);
-    EXPECT_EQ(1UL, valueProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(1UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
     EXPECT_EQ(eventUpgradeTimeNs, valueProducer.mCurrentBucketStartTimeNs);
-    EXPECT_EQ(20L, valueProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY][0].mValue);
+    EXPECT_EQ(20L, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY)[0].mValue);
 
     allData.clear();
     event = make_shared<LogEvent>(tagId, bucket2StartTimeNs + 1);
@@ -450,9 +456,9 @@ TEST(ValueMetricProducerTest, TestPulledValueWithUpgrade) {
     event->init();
     allData.push_back(event);
     valueProducer.onDataPulled(allData);
-    EXPECT_EQ(2UL, valueProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(2UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
     EXPECT_EQ(bucket2StartTimeNs, valueProducer.mCurrentBucketStartTimeNs);
-    EXPECT_EQ(30L, valueProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY][1].mValue);
+    EXPECT_EQ(30L, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY)[1].mValue);
 }
 
 TEST(ValueMetricProducerTest, TestPulledValueWithUpgradeWhileConditionFalse) {
@@ -500,9 +506,11 @@ TEST(ValueMetricProducerTest, TestPulledValueWithUpgradeWhileConditionFalse) {
     valueProducer.notifyAppUpgrade(bucket2StartTimeNs-50, "ANY.APP", 1, 1);
     // Expect one full buckets already done and starting a partial bucket.
     EXPECT_EQ(bucket2StartTimeNs-50, valueProducer.mCurrentBucketStartTimeNs);
-    EXPECT_EQ(1UL, valueProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
-    EXPECT_EQ(bucketStartTimeNs, valueProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY][0].mBucketStartNs);
-    EXPECT_EQ(20L, valueProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY][0].mValue);
+    EXPECT_EQ(1UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
+    EXPECT_EQ(bucketStartTimeNs,
+              valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY)[0]
+                      .mBucketStartNs);
+    EXPECT_EQ(20L, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY)[0].mValue);
     EXPECT_FALSE(valueProducer.mCondition);
 }
 
@@ -544,8 +552,9 @@ TEST(ValueMetricProducerTest, TestPushedEventsWithoutCondition) {
 
     valueProducer.flushIfNeededLocked(bucket3StartTimeNs);
     EXPECT_EQ(1UL, valueProducer.mPastBuckets.size());
-    EXPECT_EQ(1UL, valueProducer.mPastBuckets.begin()->second.size());
-    EXPECT_EQ(30, valueProducer.mPastBuckets.begin()->second.back().mValue);
+    EXPECT_EQ(1UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
+    EXPECT_EQ(30,
+              valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).back().mValue);
 }
 
 TEST(ValueMetricProducerTest, TestPushedEventsWithCondition) {
@@ -610,8 +619,9 @@ TEST(ValueMetricProducerTest, TestPushedEventsWithCondition) {
 
     valueProducer.flushIfNeededLocked(bucket3StartTimeNs);
     EXPECT_EQ(1UL, valueProducer.mPastBuckets.size());
-    EXPECT_EQ(1UL, valueProducer.mPastBuckets.begin()->second.size());
-    EXPECT_EQ(50, valueProducer.mPastBuckets.begin()->second.back().mValue);
+    EXPECT_EQ(1UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
+    EXPECT_EQ(50,
+              valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).back().mValue);
 }
 
 TEST(ValueMetricProducerTest, TestAnomalyDetection) {
@@ -751,8 +761,9 @@ TEST(ValueMetricProducerTest, TestBucketBoundaryNoCondition) {
     EXPECT_EQ(0, curInterval.tainted);
     EXPECT_EQ(0, curInterval.sum);
     EXPECT_EQ(1UL, valueProducer.mPastBuckets.size());
-    EXPECT_EQ(1UL, valueProducer.mPastBuckets.begin()->second.size());
-    EXPECT_EQ(12, valueProducer.mPastBuckets.begin()->second.back().mValue);
+    EXPECT_EQ(1UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
+    EXPECT_EQ(12,
+              valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).back().mValue);
 
     // pull 3 come late.
     // The previous bucket gets closed with error. (Has start value 23, no ending)
@@ -773,8 +784,9 @@ TEST(ValueMetricProducerTest, TestBucketBoundaryNoCondition) {
     EXPECT_EQ(36, curInterval.start);
     EXPECT_EQ(0, curInterval.sum);
     EXPECT_EQ(1UL, valueProducer.mPastBuckets.size());
-    EXPECT_EQ(1UL, valueProducer.mPastBuckets.begin()->second.size());
-    EXPECT_EQ(12, valueProducer.mPastBuckets.begin()->second.back().mValue);
+    EXPECT_EQ(1UL, valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).size());
+    EXPECT_EQ(12,
+              valueProducer.mPastBuckets.getBuckets(DEFAULT_METRIC_DIMENSION_KEY).back().mValue);
 }
 
 /*
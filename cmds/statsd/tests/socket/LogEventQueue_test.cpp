@@ -0,0 +1,89 @@
+// Copyright (C) 2018 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/socket/LogEventQueue.h"
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::unique_ptr;
+using std::vector;
+
+static unique_ptr<LogEvent> makeEvent(int64_t timestampNs) {
+    return std::make_unique<LogEvent>(10 /*tagId*/, timestampNs);
+}
+
+TEST(LogEventQueueTest, TestDropsEventsWhenFull) {
+    LogEventQueue queue(2);
+    EXPECT_TRUE(queue.push(makeEvent(1)));
+    EXPECT_TRUE(queue.push(makeEvent(2)));
+    EXPECT_FALSE(queue.push(makeEvent(3)));
+    EXPECT_EQ(2u, queue.size());
+
+    vector<unique_ptr<LogEvent>> events;
+    EXPECT_TRUE(queue.popBatch(&events, 1));
+    EXPECT_EQ(1u, events.size());
+    EXPECT_EQ(1, events[0]->GetElapsedTimestampNs());
+
+    // The slot of the popped event can be reused.
+    EXPECT_TRUE(queue.push(makeEvent(4)));
+    EXPECT_TRUE(queue.popBatch(&events, 10));
+    EXPECT_EQ(3u, events.size());
+    EXPECT_EQ(2, events[1]->GetElapsedTimestampNs());
+    EXPECT_EQ(4, events[2]->GetElapsedTimestampNs());
+    EXPECT_EQ(0u, queue.size());
+}
+
+TEST(LogEventQueueTest, TestConsumerThreadGetsEventsInOrder) {
+    const int eventCount = 10000;
+    LogEventQueue queue(16);
+
+    vector<int64_t> timestamps;
+    std::thread consumer([&] {
+        vector<unique_ptr<LogEvent>> events;
+        while (queue.popBatch(&events, 4)) {
+            for (const auto& event : events) {
+                timestamps.push_back(event->GetElapsedTimestampNs());
+            }
+            events.clear();
+        }
+    });
+
+    for (int i = 0; i < eventCount; i++) {
+        while (!queue.push(makeEvent(i))) {
+            std::this_thread::yield();
+        }
+    }
+    queue.stop();
+    consumer.join();
+
+    ASSERT_EQ((size_t)eventCount, timestamps.size());
+    for (int i = 0; i < eventCount; i++) {
+        EXPECT_EQ(i, timestamps[i]);
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -0,0 +1,209 @@
+// Copyright (C) 2018 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/storage/ReportSegmentStore.h"
+#include "frameworks/base/cmds/statsd/src/stats_log.pb.h"
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <dirent.h>
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <memory>
+#include <vector>
+
+using android::util::FIELD_COUNT_REPEATED;
+using android::util::FIELD_TYPE_INT64;
+using android::util::FIELD_TYPE_MESSAGE;
+using android::util::ProtoOutputStream;
+using std::make_unique;
+using std::pair;
+using std::unique_ptr;
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+const uint64_t kReportsFieldId = FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | 2;
+
+const ConfigKey kConfigKey1(1000, 1);
+const ConfigKey kConfigKey2(1000, 2);
+
+// A report identified by its last_report_elapsed_nanos.
+static unique_ptr<ProtoOutputStream> createReport(int64_t id) {
+    auto proto = make_unique<ProtoOutputStream>();
+    proto->write(FIELD_TYPE_INT64 | 3, (long long)id);
+    return proto;
+}
+
+static bool writeSegment(ReportSegmentStore* store, const vector<pair<ConfigKey, int64_t>>& reports,
+                         int64_t wallClockSec = 100) {
+    vector<unique_ptr<ProtoOutputStream>> protos;
+    vector<pair<ConfigKey, ProtoOutputStream*>> segment;
+    for (const auto& report : reports) {
+        protos.push_back(createReport(report.second));
+        segment.emplace_back(report.first, protos.back().get());
+    }
+    return store->writeSegment(segment, wallClockSec);
+}
+
+// Returns the ids of the reports of the config.
+static vector<int64_t> readReports(ReportSegmentStore* store, const ConfigKey& key) {
+    ProtoOutputStream proto;
+    store->appendReports(key, kReportsFieldId, &proto);
+    std::string bytes;
+    auto it = proto.data();
+    while (it.readBuffer() != NULL) {
+        size_t toRead = it.currentToRead();
+        bytes.append((const char*)it.readBuffer(), toRead);
+        it.rp()->move(toRead);
+    }
+    ConfigMetricsReportList reportList;
+    EXPECT_TRUE(reportList.ParseFromString(bytes));
+    vector<int64_t> ids;
+    for (const auto& report : reportList.reports()) {
+        ids.push_back(report.last_report_elapsed_nanos());
+    }
+    return ids;
+}
+
+static size_t countFiles(const char* dir) {
+    unique_ptr<DIR, decltype(&closedir)> d(opendir(dir), closedir);
+    size_t count = 0;
+    while (dirent* de = readdir(d.get())) {
+        if (de->d_name[0] != '.') {
+            count++;
+        }
+    }
+    return count;
+}
+
+TEST(ReportSegmentStoreTest, TestReadReportsOfConfig) {
+    TemporaryDir dir;
+    ReportSegmentStore store(dir.path, 100, 1024 * 1024, 1000);
+    EXPECT_FALSE(store.hasReports(kConfigKey1));
+
+    ASSERT_TRUE(writeSegment(&store, {{kConfigKey1, 1}, {kConfigKey2, 2}}));
+    ASSERT_TRUE(writeSegment(&store, {{kConfigKey2, 3}, {kConfigKey1, 4}}));
+    EXPECT_TRUE(store.hasReports(kConfigKey1));
+    EXPECT_TRUE(store.hasReports(kConfigKey2));
+
+    EXPECT_EQ(vector<int64_t>({1, 4}), readReports(&store, kConfigKey1));
+    EXPECT_FALSE(store.hasReports(kConfigKey1));
+    EXPECT_TRUE(readReports(&store, kConfigKey1).empty());
+    // The segments still have reports of the other config.
+    EXPECT_EQ(2u, countFiles(dir.path));
+
+    EXPECT_EQ(vector<int64_t>({2, 3}), readReports(&store, kConfigKey2));
+    EXPECT_EQ(0u, countFiles(dir.path));
+}
+
+TEST(ReportSegmentStoreTest, TestLoadFromDisk) {
+    TemporaryDir dir;
+    {
+        ReportSegmentStore store(dir.path, 100, 1024 * 1024, 1000);
+        ASSERT_TRUE(writeSegment(&store, {{kConfigKey1, 1}, {kConfigKey2, 2}}));
+        EXPECT_EQ(vector<int64_t>({1}), readReports(&store, kConfigKey1));
+    }
+
+    // As if statsd restarted: the read reports stay read.
+    ReportSegmentStore store(dir.path, 100, 1024 * 1024, 1000);
+    EXPECT_FALSE(store.hasReports(kConfigKey1));
+    EXPECT_TRUE(store.hasReports(kConfigKey2));
+    ASSERT_TRUE(writeSegment(&store, {{kConfigKey2, 3}}));
+    EXPECT_EQ(vector<int64_t>({2, 3}), readReports(&store, kConfigKey2));
+}
+
+TEST(ReportSegmentStoreTest, TestTrim) {
+    TemporaryDir dir;
+    ReportSegmentStore store(dir.path, 2, 1024 * 1024, 1000);
+    ASSERT_TRUE(writeSegment(&store, {{kConfigKey1, 1}}, 100));
+    ASSERT_TRUE(writeSegment(&store, {{kConfigKey1, 2}}, 200));
+    ASSERT_TRUE(writeSegment(&store, {{kConfigKey1, 3}}, 300));
+    // Over the segment count, the oldest one is gone.
+    EXPECT_EQ(2u, countFiles(dir.path));
+
+    // Too old.
+    store.trim(1250);
+    EXPECT_EQ(1u, countFiles(dir.path));
+    EXPECT_EQ(vector<int64_t>({3}), readReports(&store, kConfigKey1));
+}
+
+TEST(ReportSegmentStoreTest, TestConfigsWithLostReports) {
+    TemporaryDir dir;
+    ReportSegmentStore store(dir.path, 2, 1024 * 1024, 1000);
+    ASSERT_TRUE(writeSegment(&store, {{kConfigKey1, 1}, {kConfigKey2, 1}}, 100));
+    EXPECT_EQ(vector<int64_t>({1}), readReports(&store, kConfigKey2));
+    ASSERT_TRUE(writeSegment(&store, {{kConfigKey1, 2}}, 200));
+    EXPECT_TRUE(store.takeConfigsWithLostReports().empty());
+
+    // The report of kConfigKey2 in the trimmed segment was already read.
+    ASSERT_TRUE(writeSegment(&store, {{kConfigKey1, 3}}, 300));
+    vector<ConfigKey> lost = store.takeConfigsWithLostReports();
+    ASSERT_EQ(1u, lost.size());
+    EXPECT_EQ(kConfigKey1, lost[0]);
+    EXPECT_TRUE(store.takeConfigsWithLostReports().empty());
+
+    // Reports that can't be read are lost as well.
+    for (const auto& segment : store.mSegments) {
+        ASSERT_EQ(0, truncate(store.getSegmentPath(segment.first).c_str(), 0));
+    }
+    EXPECT_TRUE(readReports(&store, kConfigKey1).empty());
+    lost = store.takeConfigsWithLostReports();
+    ASSERT_EQ(1u, lost.size());
+    EXPECT_EQ(kConfigKey1, lost[0]);
+}
+
+TEST(ReportSegmentStoreTest, TestCompression) {
+    TemporaryDir dir;
+    ReportSegmentStore store(dir.path, 100, 1024 * 1024, 1000);
+    auto proto = make_unique<ProtoOutputStream>();
+    for (int i = 0; i < 10000; i++) {
+        proto->write(FIELD_TYPE_INT64 | 3, (long long)i % 10);
+    }
+    const size_t rawSize = proto->size();
+    ASSERT_TRUE(store.writeSegment({{kConfigKey1, proto.get()}}, 100));
+    EXPECT_LT(store.mTotalBytes, rawSize / 10);
+    EXPECT_EQ(1u, readReports(&store, kConfigKey1).size());
+}
+
+TEST(ReportSegmentStoreTest, TestCorruptSegmentsDeleted) {
+    TemporaryDir dir;
+    {
+        ReportSegmentStore store(dir.path, 100, 1024 * 1024, 1000);
+        ASSERT_TRUE(writeSegment(&store, {{kConfigKey1, 1}}));
+    }
+    std::string corruptPath = std::string(dir.path) + "/5.seg";
+    ASSERT_TRUE(android::base::WriteStringToFile("not a segment", corruptPath));
+    std::string tempPath = std::string(dir.path) + "/6.seg.tmp";
+    ASSERT_TRUE(android::base::WriteStringToFile("half a segment", tempPath));
+
+    ReportSegmentStore store(dir.path, 100, 1024 * 1024, 1000);
+    EXPECT_TRUE(store.hasReports(kConfigKey1));
+    EXPECT_EQ(1u, store.mSegments.size());
+    EXPECT_EQ(1u, countFiles(dir.path));
+    // The sequence numbers go on from the last valid segment.
+    EXPECT_EQ(1u, store.mNextSequence);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
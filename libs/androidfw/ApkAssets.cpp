@@ -16,6 +16,8 @@
 
 #include "androidfw/ApkAssets.h"
 
+#include <unistd.h>
+
 #include <algorithm>
 
 #include "android-base/errors.h"
@@ -30,6 +32,7 @@
 #include "androidfw/Asset.h"
 #include "androidfw/Idmap.h"
 #include "androidfw/ResourceTypes.h"
+#include "androidfw/ResourcesIndex.h"
 #include "androidfw/Util.h"
 
 namespace android {
@@ -44,12 +47,56 @@ ApkAssets::ApkAssets(void* unmanaged_handle, const std::string& path)
 }
 
 std::unique_ptr<const ApkAssets> ApkAssets::Load(const std::string& path, bool system) {
-  return LoadImpl({} /*fd*/, path, nullptr, nullptr, system, false /*load_as_shared_library*/);
+  return LoadImpl({} /*fd*/, path, nullptr, nullptr, nullptr, system,
+                  false /*load_as_shared_library*/);
+}
+
+std::unique_ptr<const ApkAssets> ApkAssets::LoadWithIndex(const std::string& path,
+                                                          const std::string& index_path,
+                                                          bool system) {
+  // A missing or unreadable index is not an error, the APK is just loaded the slow way.
+  std::unique_ptr<Asset> index_asset;
+  if (access(index_path.c_str(), R_OK) == 0) {
+    index_asset = CreateAssetFromFile(index_path);
+  }
+  return LoadImpl({} /*fd*/, path, nullptr, nullptr, std::move(index_asset), system,
+                  false /*load_as_shared_library*/);
+}
+
+bool ApkAssets::CreateIndex(const std::string& path, const std::string& index_path) {
+  std::unique_ptr<const ApkAssets> apk_assets = Load(path);
+  if (apk_assets == nullptr) {
+    return false;
+  }
+
+  ::ZipString entry_name(kResourcesArsc.c_str());
+  ::ZipEntry entry;
+  if (::FindEntry(apk_assets->zip_handle_.get(), entry_name, &entry) != 0 ||
+      apk_assets->resources_asset_ == nullptr) {
+    LOG(ERROR) << "APK '" << path << "' has no " << kResourcesArsc << " to index.";
+    return false;
+  }
+
+  const StringPiece data(
+      reinterpret_cast<const char*>(apk_assets->resources_asset_->getBuffer(true /*wordAligned*/)),
+      apk_assets->resources_asset_->getLength());
+  std::string index_data;
+  if (!ResourcesIndex::Create(data, entry.crc32, &index_data)) {
+    return false;
+  }
+
+  if (!base::WriteStringToFile(index_data, index_path)) {
+    LOG(ERROR) << "Failed to write resources index '" << index_path
+               << "': " << SystemErrorCodeToString(errno);
+    return false;
+  }
+  return true;
 }
 
 std::unique_ptr<const ApkAssets> ApkAssets::LoadAsSharedLibrary(const std::string& path,
                                                                 bool system) {
-  return LoadImpl({} /*fd*/, path, nullptr, nullptr, system, true /*load_as_shared_library*/);
+  return LoadImpl({} /*fd*/, path, nullptr, nullptr, nullptr, system,
+                  true /*load_as_shared_library*/);
 }
 
 std::unique_ptr<const ApkAssets> ApkAssets::LoadOverlay(const std::string& idmap_path,
@@ -68,14 +115,15 @@ std::unique_ptr<const ApkAssets> ApkAssets::LoadOverlay(const std::string& idmap
     return {};
   }
   return LoadImpl({} /*fd*/, loaded_idmap->OverlayApkPath(), std::move(idmap_asset),
-                  std::move(loaded_idmap), system, false /*load_as_shared_library*/);
+                  std::move(loaded_idmap), nullptr /*index_asset*/, system,
+                  false /*load_as_shared_library*/);
 }
 
 std::unique_ptr<const ApkAssets> ApkAssets::LoadFromFd(unique_fd fd,
                                                        const std::string& friendly_name,
                                                        bool system, bool force_shared_lib) {
   return LoadImpl(std::move(fd), friendly_name, nullptr /*idmap_asset*/, nullptr /*loaded_idmap*/,
-                  system, force_shared_lib);
+                  nullptr /*index_asset*/, system, force_shared_lib);
 }
 
 std::unique_ptr<Asset> ApkAssets::CreateAssetFromFile(const std::string& path) {
@@ -101,7 +149,8 @@ std::unique_ptr<Asset> ApkAssets::CreateAssetFromFile(const std::string& path) {
 
 std::unique_ptr<const ApkAssets> ApkAssets::LoadImpl(
     unique_fd fd, const std::string& path, std::unique_ptr<Asset> idmap_asset,
-    std::unique_ptr<const LoadedIdmap> loaded_idmap, bool system, bool load_as_shared_library) {
+    std::unique_ptr<const LoadedIdmap> loaded_idmap, std::unique_ptr<Asset> index_asset,
+    bool system, bool load_as_shared_library) {
   ::ZipArchiveHandle unmanaged_handle;
   int32_t result;
   if (fd >= 0) {
@@ -146,8 +195,28 @@ std::unique_ptr<const ApkAssets> ApkAssets::LoadImpl(
   const StringPiece data(
       reinterpret_cast<const char*>(loaded_apk->resources_asset_->getBuffer(true /*wordAligned*/)),
       loaded_apk->resources_asset_->getLength());
+
+  // Only trust an index that was generated for this exact resources.arsc. Otherwise fall back to
+  // walking the table.
+  std::unique_ptr<const ResourcesIndex> index;
+  if (index_asset != nullptr) {
+    const StringPiece index_data(
+        reinterpret_cast<const char*>(index_asset->getBuffer(true /*wordAligned*/)),
+        static_cast<size_t>(index_asset->getLength()));
+    index = ResourcesIndex::Load(index_data);
+    if (index != nullptr && !index->Matches(entry.crc32, data.size())) {
+      LOG(WARNING) << "Ignoring stale resources index for APK '" << path << "'.";
+      index.reset();
+    }
+
+    // Must retain ownership of the index Asset, since the name indices point into its data.
+    if (index != nullptr) {
+      loaded_apk->index_asset_ = std::move(index_asset);
+    }
+  }
+
   loaded_apk->loaded_arsc_ =
-      LoadedArsc::Load(data, loaded_idmap.get(), system, load_as_shared_library);
+      LoadedArsc::Load(data, loaded_idmap.get(), system, load_as_shared_library, index.get());
   if (loaded_apk->loaded_arsc_ == nullptr) {
     LOG(ERROR) << "Failed to load '" << kResourcesArsc << "' in APK '" << path << "'.";
     return {};
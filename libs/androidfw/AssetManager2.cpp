@@ -37,31 +37,6 @@
 
 namespace android {
 
-struct FindEntryResult {
-  // A pointer to the resource table entry for this resource.
-  // If the size of the entry is > sizeof(ResTable_entry), it can be cast to
-  // a ResTable_map_entry and processed as a bag/map.
-  const ResTable_entry* entry;
-
-  // The configuration for which the resulting entry was defined. This is already swapped to host
-  // endianness.
-  ResTable_config config;
-
-  // The bitmask of configuration axis with which the resource value varies.
-  uint32_t type_flags;
-
-  // The dynamic package ID map for the package from which this resource came from.
-  const DynamicRefTable* dynamic_ref_table;
-
-  // The string pool reference to the type's name. This uses a different string pool than
-  // the global string pool, but this is hidden from the caller.
-  StringPoolRef type_string_ref;
-
-  // The string pool reference to the entry's name. This uses a different string pool than
-  // the global string pool, but this is hidden from the caller.
-  StringPoolRef entry_string_ref;
-};
-
 AssetManager2::AssetManager2() {
   memset(&configuration_, 0, sizeof(configuration_));
 }
@@ -71,6 +46,10 @@ bool AssetManager2::SetApkAssets(const std::vector<const ApkAssets*>& apk_assets
   apk_assets_ = apk_assets;
   BuildDynamicRefTable();
   RebuildFilterList();
+
+  // Cached entries point into the PackageGroups that were just rebuilt, so they must always go,
+  // even when the caller knows that no existing resource has changed.
+  cached_entries_.Clear();
   if (invalidate_caches) {
     InvalidateCaches(static_cast<uint32_t>(-1));
   }
@@ -320,6 +299,21 @@ ApkAssetsCookie AssetManager2::FindEntry(uint32_t resid, uint16_t density_overri
     desired_config = &density_override_config;
   }
 
+  // If desired_config is the same as the set configuration, then we can use our filtered list
+  // and we don't need to match the configurations, since they already matched.
+  const bool use_fast_path = desired_config == &configuration_;
+
+  // Results for the set configuration are cached, so a repeated lookup never has to walk the
+  // configurations again.
+  if (use_fast_path) {
+    if (const CachedEntry* cached_entry = cached_entries_.Find(resid)) {
+      entry_cache_hits_.fetch_add(1u, std::memory_order_relaxed);
+      *out_entry = cached_entry->entry;
+      return cached_entry->cookie;
+    }
+    entry_cache_misses_.fetch_add(1u, std::memory_order_relaxed);
+  }
+
   if (!is_valid_resid(resid)) {
     LOG(ERROR) << base::StringPrintf("Invalid ID 0x%08x.", resid);
     return kInvalidCookie;
@@ -346,10 +340,6 @@ ApkAssetsCookie AssetManager2::FindEntry(uint32_t resid, uint16_t density_overri
   uint32_t best_offset = 0u;
   uint32_t type_flags = 0u;
 
-  // If desired_config is the same as the set configuration, then we can use our filtered list
-  // and we don't need to match the configurations, since they already matched.
-  const bool use_fast_path = desired_config == &configuration_;
-
   for (size_t pi = 0; pi < package_count; pi++) {
     const ConfiguredPackage& loaded_package_impl = package_group.packages_[pi];
     const LoadedPackage* loaded_package = loaded_package_impl.loaded_package_;
@@ -452,6 +442,11 @@ ApkAssetsCookie AssetManager2::FindEntry(uint32_t resid, uint16_t density_overri
   out_entry->entry_string_ref =
       StringPoolRef(best_package->GetKeyStringPool(), best_entry->key.index);
   out_entry->dynamic_ref_table = &package_group.dynamic_ref_table;
+
+  if (use_fast_path) {
+    cached_entries_.Insert(resid, std::unique_ptr<CachedEntry>(
+                                      new CachedEntry{best_cookie, *out_entry}));
+  }
   return best_cookie;
 }
 
@@ -568,6 +563,14 @@ ApkAssetsCookie AssetManager2::ResolveReference(ApkAssetsCookie cookie, Res_valu
 }
 
 const ResolvedBag* AssetManager2::GetBag(uint32_t resid) {
+  // Bags that were already resolved are found without taking a lock.
+  if (const ResolvedBag* cached_bag = cached_bags_.Find(resid)) {
+    return cached_bag;
+  }
+
+  // Only one thread resolves bags at a time. Threads that missed the cache for the same bag (or
+  // for a bag sharing the same parents) will find it cached once they get the lock.
+  std::lock_guard<std::mutex> lock(bag_resolution_lock_);
   auto found_resids = std::vector<uint32_t>();
   return GetBag(resid, found_resids);
 }
@@ -575,9 +578,8 @@ const ResolvedBag* AssetManager2::GetBag(uint32_t resid) {
 const ResolvedBag* AssetManager2::GetBag(uint32_t resid, std::vector<uint32_t>& child_resids) {
   ATRACE_NAME("AssetManager::GetBag");
 
-  auto cached_iter = cached_bags_.find(resid);
-  if (cached_iter != cached_bags_.end()) {
-    return cached_iter->second.get();
+  if (const ResolvedBag* cached_bag = cached_bags_.Find(resid)) {
+    return cached_bag;
   }
 
   FindEntryResult entry;
@@ -641,9 +643,7 @@ const ResolvedBag* AssetManager2::GetBag(uint32_t resid, std::vector<uint32_t>&
     }
     new_bag->type_spec_flags = entry.type_flags;
     new_bag->entry_count = static_cast<uint32_t>(entry_count);
-    ResolvedBag* result = new_bag.get();
-    cached_bags_[resid] = std::move(new_bag);
-    return result;
+    return cached_bags_.Insert(resid, std::move(new_bag));
   }
 
   // In case the parent is a dynamic reference, resolve it.
@@ -751,9 +751,7 @@ const ResolvedBag* AssetManager2::GetBag(uint32_t resid, std::vector<uint32_t>&
   // Combine flags from the parent and our own bag.
   new_bag->type_spec_flags = entry.type_flags | parent_bag->type_spec_flags;
   new_bag->entry_count = static_cast<uint32_t>(actual_count);
-  ResolvedBag* result = new_bag.get();
-  cached_bags_[resid] = std::move(new_bag);
-  return result;
+  return cached_bags_.Insert(resid, std::move(new_bag));
 }
 
 static bool Utf8ToUtf16(const StringPiece& str, std::u16string* out) {
@@ -854,19 +852,21 @@ void AssetManager2::RebuildFilterList() {
 void AssetManager2::InvalidateCaches(uint32_t diff) {
   if (diff == 0xffffffffu) {
     // Everything must go.
-    cached_bags_.clear();
+    cached_bags_.Clear();
+    cached_entries_.Clear();
     return;
   }
 
   // Be more conservative with what gets purged. Only if the bag has other possible
   // variations with respect to what changed (diff) should we remove it.
-  for (auto iter = cached_bags_.cbegin(); iter != cached_bags_.cend();) {
-    if (diff & iter->second->type_spec_flags) {
-      iter = cached_bags_.erase(iter);
-    } else {
-      ++iter;
-    }
-  }
+  cached_bags_.EraseIf([diff](uint32_t /*resid*/, const ResolvedBag& bag) -> bool {
+    return (diff & bag.type_spec_flags) != 0u;
+  });
+
+  // The same goes for resolved entries.
+  cached_entries_.EraseIf([diff](uint32_t /*resid*/, const CachedEntry& cached_entry) -> bool {
+    return (diff & cached_entry.entry.type_flags) != 0u;
+  });
 }
 
 std::unique_ptr<Theme> AssetManager2::NewTheme() {
@@ -880,27 +880,13 @@ Theme::~Theme() = default;
 
 namespace {
 
-struct ThemeEntry {
-  ApkAssetsCookie cookie;
-  uint32_t type_spec_flags;
-  Res_value value;
-};
-
-struct ThemeType {
-  int entry_count;
-  ThemeEntry entries[0];
-};
-
-constexpr size_t kTypeCount = std::numeric_limits<uint8_t>::max() + 1;
+inline bool IsUndefined(const Res_value& value) {
+  // @null is different than @empty.
+  return value.dataType == Res_value::TYPE_NULL && value.data != Res_value::DATA_NULL_EMPTY;
+}
 
 }  // namespace
 
-struct Theme::Package {
-  // Each element of Type will be a dynamically sized object
-  // allocated to have the entries stored contiguously with the Type.
-  std::array<util::unique_cptr<ThemeType>, kTypeCount> types;
-};
-
 bool Theme::ApplyStyle(uint32_t resid, bool force) {
   ATRACE_NAME("Theme::ApplyStyle");
 
@@ -912,118 +898,147 @@ bool Theme::ApplyStyle(uint32_t resid, bool force) {
   // Merge the flags from this style.
   type_spec_flags_ |= bag->type_spec_flags;
 
-  int last_type_idx = -1;
-  int last_package_idx = -1;
-  Package* last_package = nullptr;
-  ThemeType* last_type = nullptr;
-
-  // Iterate backwards, because each bag is sorted in ascending key ID order, meaning we will only
-  // need to perform one resize per type.
-  using reverse_bag_iterator = std::reverse_iterator<const ResolvedBag::Entry*>;
-  const auto bag_iter_end = reverse_bag_iterator(begin(bag));
-  for (auto bag_iter = reverse_bag_iterator(end(bag)); bag_iter != bag_iter_end; ++bag_iter) {
-    const uint32_t attr_resid = bag_iter->key;
+  // Bags are sorted in ascending key ID order, unless keys from a shared library were assigned
+  // a runtime package ID that sorts differently. Only sort a copy in that rare case.
+  auto key_less = [](const ResolvedBag::Entry& a, const ResolvedBag::Entry& b) -> bool {
+    return a.key < b.key;
+  };
+  const ResolvedBag::Entry* bag_iter = begin(bag);
+  const ResolvedBag::Entry* bag_iter_end = end(bag);
+  std::vector<ResolvedBag::Entry> sorted_bag;
+  if (!std::is_sorted(bag_iter, bag_iter_end, key_less)) {
+    sorted_bag.assign(bag_iter, bag_iter_end);
+    std::stable_sort(sorted_bag.begin(), sorted_bag.end(), key_less);
+    bag_iter = sorted_bag.data();
+    bag_iter_end = bag_iter + sorted_bag.size();
+  }
 
-    // If the resource ID passed in is not a style, the key can be some other identifier that is not
-    // a resource ID. We should fail fast instead of operating with strange resource IDs.
-    if (!is_valid_resid(attr_resid)) {
+  // If the resource ID passed in is not a style, the key can be some other identifier that is not
+  // a resource ID. We should fail fast instead of operating with strange resource IDs.
+  for (const ResolvedBag::Entry* iter = bag_iter; iter != bag_iter_end; ++iter) {
+    if (!is_valid_resid(iter->key)) {
       return false;
     }
+  }
 
-    // We don't use the 0-based index for the type so that we can avoid doing ID validation
-    // upon lookup. Instead, we keep space for the type ID 0 in our data structures. Since
-    // the construction of this type is guarded with a resource ID check, it will never be
-    // populated, and querying type ID 0 will always fail.
-    const int package_idx = get_package_id(attr_resid);
-    const int type_idx = get_type_id(attr_resid);
-    const int entry_idx = get_entry_id(attr_resid);
-
-    if (last_package_idx != package_idx) {
-      std::unique_ptr<Package>& package = packages_[package_idx];
-      if (package == nullptr) {
-        package.reset(new Package());
-      }
-      last_package_idx = package_idx;
-      last_package = package.get();
-      last_type_idx = -1;
+  auto apply_bag_entry = [&](const ResolvedBag::Entry& bag_entry, Entry* entry) {
+    if (force || IsUndefined(entry->value)) {
+      entry->cookie = bag_entry.cookie;
+      entry->type_spec_flags |= bag->type_spec_flags;
+      entry->value = bag_entry.value;
     }
+  };
+
+  if (entries_ != nullptr && entries_.use_count() == 1) {
+    // No other theme shares our attributes, so the style is merged into them in place. The
+    // attributes that are new to us are appended, then merged into their sorted position.
+    std::vector<Entry>& entries = *entries_;
+    const size_t old_count = entries.size();
+    size_t old_index = 0u;
+    for (; bag_iter != bag_iter_end; ++bag_iter) {
+      const uint32_t attr_resid = bag_iter->key;
+      while (old_index != old_count && entries[old_index].attr_resid < attr_resid) {
+        old_index++;
+      }
 
-    if (last_type_idx != type_idx) {
-      util::unique_cptr<ThemeType>& type = last_package->types[type_idx];
-      if (type == nullptr) {
-        // Allocate enough memory to contain this entry_idx. Since we're iterating in reverse over
-        // a sorted list of attributes, this shouldn't be resized again during this method call.
-        type.reset(reinterpret_cast<ThemeType*>(
-            calloc(sizeof(ThemeType) + (entry_idx + 1) * sizeof(ThemeEntry), 1)));
-        type->entry_count = entry_idx + 1;
-      } else if (entry_idx >= type->entry_count) {
-        // Reallocate the memory to contain this entry_idx. Since we're iterating in reverse over
-        // a sorted list of attributes, this shouldn't be resized again during this method call.
-        const int new_count = entry_idx + 1;
-        type.reset(reinterpret_cast<ThemeType*>(
-            realloc(type.release(), sizeof(ThemeType) + (new_count * sizeof(ThemeEntry)))));
-
-        // Clear out the newly allocated space (which isn't zeroed).
-        memset(type->entries + type->entry_count, 0,
-               (new_count - type->entry_count) * sizeof(ThemeEntry));
-        type->entry_count = new_count;
+      if (old_index != old_count && entries[old_index].attr_resid == attr_resid) {
+        apply_bag_entry(*bag_iter, &entries[old_index]);
+      } else {
+        if (entries.size() == old_count || entries.back().attr_resid != attr_resid) {
+          Entry new_entry;
+          memset(&new_entry, 0, sizeof(new_entry));
+          new_entry.attr_resid = attr_resid;
+          entries.push_back(new_entry);
+        }
+        apply_bag_entry(*bag_iter, &entries.back());
       }
-      last_type_idx = type_idx;
-      last_type = type.get();
     }
 
-    ThemeEntry& entry = last_type->entries[entry_idx];
-    if (force || (entry.value.dataType == Res_value::TYPE_NULL &&
-                  entry.value.data != Res_value::DATA_NULL_EMPTY)) {
-      entry.cookie = bag_iter->cookie;
-      entry.type_spec_flags |= bag->type_spec_flags;
-      entry.value = bag_iter->value;
+    if (entries.size() != old_count) {
+      std::inplace_merge(entries.begin(), entries.begin() + old_count, entries.end(),
+                         [](const Entry& a, const Entry& b) -> bool {
+                           return a.attr_resid < b.attr_resid;
+                         });
+    }
+    return true;
+  }
+
+  // Our attributes are shared with other themes, so they are merged with the style's into new
+  // storage, leaving the shared one as it is.
+  const size_t old_count = entries_ != nullptr ? entries_->size() : 0u;
+  const Entry* old_iter = old_count != 0u ? entries_->data() : nullptr;
+  const Entry* const old_iter_end = old_iter + old_count;
+
+  auto new_entries = std::make_shared<std::vector<Entry>>();
+  new_entries->reserve(old_count + bag->entry_count);
+
+  for (; bag_iter != bag_iter_end; ++bag_iter) {
+    const uint32_t attr_resid = bag_iter->key;
+
+    // Take our attributes that come before this one as-is.
+    while (old_iter != old_iter_end && old_iter->attr_resid < attr_resid) {
+      new_entries->push_back(*old_iter++);
     }
+
+    if (new_entries->empty() || new_entries->back().attr_resid != attr_resid) {
+      if (old_iter != old_iter_end && old_iter->attr_resid == attr_resid) {
+        new_entries->push_back(*old_iter++);
+      } else {
+        Entry new_entry;
+        memset(&new_entry, 0, sizeof(new_entry));
+        new_entry.attr_resid = attr_resid;
+        new_entries->push_back(new_entry);
+      }
+    }
+    apply_bag_entry(*bag_iter, &new_entries->back());
   }
+
+  // Take the rest of our attributes as-is.
+  new_entries->insert(new_entries->end(), old_iter, old_iter_end);
+  entries_ = std::move(new_entries);
   return true;
 }
 
 ApkAssetsCookie Theme::GetAttribute(uint32_t resid, Res_value* out_value,
                                     uint32_t* out_flags) const {
+  if (entries_ == nullptr) {
+    return kInvalidCookie;
+  }
+
   int cnt = 20;
 
   uint32_t type_spec_flags = 0u;
 
+  const auto entries_begin = entries_->begin();
+  const auto entries_end = entries_->end();
   do {
-    const int package_idx = get_package_id(resid);
-    const Package* package = packages_[package_idx].get();
-    if (package != nullptr) {
-      // The themes are constructed with a 1-based type ID, so no need to decrement here.
-      const int type_idx = get_type_id(resid);
-      const ThemeType* type = package->types[type_idx].get();
-      if (type != nullptr) {
-        const int entry_idx = get_entry_id(resid);
-        if (entry_idx < type->entry_count) {
-          const ThemeEntry& entry = type->entries[entry_idx];
-          type_spec_flags |= entry.type_spec_flags;
-
-          if (entry.value.dataType == Res_value::TYPE_ATTRIBUTE) {
-            if (cnt > 0) {
-              cnt--;
-              resid = entry.value.data;
-              continue;
-            }
-            return kInvalidCookie;
-          }
+    const auto iter = std::lower_bound(entries_begin, entries_end, resid,
+                                       [](const Entry& entry, uint32_t attr_resid) -> bool {
+                                         return entry.attr_resid < attr_resid;
+                                       });
+    if (iter == entries_end || iter->attr_resid != resid) {
+      break;
+    }
 
-          // @null is different than @empty.
-          if (entry.value.dataType == Res_value::TYPE_NULL &&
-              entry.value.data != Res_value::DATA_NULL_EMPTY) {
-            return kInvalidCookie;
-          }
+    const Entry& entry = *iter;
+    type_spec_flags |= entry.type_spec_flags;
 
-          *out_value = entry.value;
-          *out_flags = type_spec_flags;
-          return entry.cookie;
-        }
+    if (entry.value.dataType == Res_value::TYPE_ATTRIBUTE) {
+      if (cnt > 0) {
+        cnt--;
+        resid = entry.value.data;
+        continue;
       }
+      return kInvalidCookie;
+    }
+
+    if (IsUndefined(entry.value)) {
+      return kInvalidCookie;
     }
-    break;
+
+    *out_value = entry.value;
+    *out_flags = type_spec_flags;
+    return entry.cookie;
   } while (true);
   return kInvalidCookie;
 }
@@ -1049,9 +1064,7 @@ ApkAssetsCookie Theme::ResolveAttributeReference(ApkAssetsCookie cookie, Res_val
 
 void Theme::Clear() {
   type_spec_flags_ = 0u;
-  for (std::unique_ptr<Package>& package : packages_) {
-    package.reset();
-  }
+  entries_.reset();
 }
 
 bool Theme::SetTo(const Theme& o) {
@@ -1061,36 +1074,20 @@ bool Theme::SetTo(const Theme& o) {
 
   type_spec_flags_ = o.type_spec_flags_;
 
-  const bool copy_only_system = asset_manager_ != o.asset_manager_;
-
-  for (size_t p = 0; p < packages_.size(); p++) {
-    const Package* package = o.packages_[p].get();
-    if (package == nullptr || (copy_only_system && p != 0x01)) {
-      // The other theme doesn't have this package, clear ours.
-      packages_[p].reset();
-      continue;
-    }
-
-    if (packages_[p] == nullptr) {
-      // The other theme has this package, but we don't. Make one.
-      packages_[p].reset(new Package());
-    }
-
-    for (size_t t = 0; t < package->types.size(); t++) {
-      const ThemeType* type = package->types[t].get();
-      if (type == nullptr) {
-        // The other theme doesn't have this type, clear ours.
-        packages_[p]->types[t].reset();
-        continue;
-      }
+  if (asset_manager_ == o.asset_manager_ || o.entries_ == nullptr) {
+    // Share the storage. While it is shared, applying a style to either theme copies it.
+    entries_ = o.entries_;
+    return true;
+  }
 
-      // Create a new type and update it to theirs.
-      const size_t type_alloc_size = sizeof(ThemeType) + (type->entry_count * sizeof(ThemeEntry));
-      void* copied_data = malloc(type_alloc_size);
-      memcpy(copied_data, type, type_alloc_size);
-      packages_[p]->types[t].reset(reinterpret_cast<ThemeType*>(copied_data));
+  // Only the attributes of the system package are compatible between different AssetManagers.
+  auto new_entries = std::make_shared<std::vector<Entry>>();
+  for (const Entry& entry : *o.entries_) {
+    if (get_package_id(entry.attr_resid) == 0x01) {
+      new_entries->push_back(entry);
     }
   }
+  entries_ = std::move(new_entries);
   return true;
 }
 
@@ -318,6 +318,204 @@ void LoadedPackage::CollectLocales(bool canonicalize, std::set<std::string>* out
   }
 }
 
+// FNV-1a hash of an entry name, seeded with the type it belongs to.
+static uint32_t HashEntryName(uint8_t type_index, const char* name, size_t len) {
+  uint32_t hash = 2166136261u ^ type_index;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619u;
+  }
+  return hash;
+}
+
+void LoadedPackage::BuildNameIndex() const {
+  ATRACE_NAME("LoadedPackage::BuildNameIndex");
+
+  struct NamedEntry {
+    uint32_t key_index;
+    uint16_t entry_index;
+    uint8_t type_index;
+  };
+
+  // The same entry is usually defined for several configurations, so only record it the first
+  // time it is seen.
+  std::vector<NamedEntry> named_entries;
+  std::vector<bool> seen;
+  const size_t type_count = std::min<size_t>(type_specs_.size(), 256u);
+  for (size_t type_idx = 0; type_idx < type_count; type_idx++) {
+    const TypeSpecPtr& type_spec = type_specs_[type_idx];
+    if (type_spec == nullptr) {
+      continue;
+    }
+
+    seen.assign(dtohl(type_spec->type_spec->entryCount), false);
+    auto add_entry = [&](const ResTable_type* type, uint16_t entry_idx, uint32_t offset) {
+      if (offset == ResTable_type::NO_ENTRY) {
+        return;
+      }
+
+      if (entry_idx >= seen.size()) {
+        seen.resize(entry_idx + 1, false);
+      } else if (seen[entry_idx]) {
+        return;
+      }
+
+      const ResTable_entry* entry = GetEntryFromOffset(type, offset);
+      if (entry == nullptr) {
+        return;
+      }
+      seen[entry_idx] = true;
+      named_entries.push_back(NamedEntry{dtohl(entry->key.index), entry_idx,
+                                         static_cast<uint8_t>(type_idx)});
+    };
+
+    const auto iter_end = type_spec->types + type_spec->type_count;
+    for (auto iter = type_spec->types; iter != iter_end; ++iter) {
+      const ResTable_type* type = *iter;
+      const size_t entry_count = dtohl(type->entryCount);
+      const uint8_t* offsets_start =
+          reinterpret_cast<const uint8_t*>(type) + dtohs(type->header.headerSize);
+      if (type->flags & ResTable_type::FLAG_SPARSE) {
+        const ResTable_sparseTypeEntry* sparse_indices =
+            reinterpret_cast<const ResTable_sparseTypeEntry*>(offsets_start);
+        for (size_t i = 0; i < entry_count; i++) {
+          add_entry(type, dtohs(sparse_indices[i].idx),
+                    uint32_t{dtohs(sparse_indices[i].offset)} * 4u);
+        }
+      } else {
+        const uint32_t* entry_offsets = reinterpret_cast<const uint32_t*>(offsets_start);
+        for (size_t entry_idx = 0; entry_idx < entry_count; entry_idx++) {
+          add_entry(type, static_cast<uint16_t>(entry_idx), dtohl(entry_offsets[entry_idx]));
+        }
+      }
+    }
+  }
+
+  // Keep the load factor at or below 50% so that probe sequences stay short.
+  size_t capacity = 16u;
+  while (capacity < named_entries.size() * 2u) {
+    capacity <<= 1;
+  }
+  name_index_storage_.assign(capacity, NameIndexSlot{});
+
+  const size_t mask = capacity - 1u;
+  std::string name8;
+  for (const NamedEntry& named_entry : named_entries) {
+    size_t len;
+    const char* name = key_string_pool_.string8At(named_entry.key_index, &len);
+    if (name == nullptr) {
+      const char16_t* name16 = key_string_pool_.stringAt(named_entry.key_index, &len);
+      if (name16 == nullptr) {
+        continue;
+      }
+      name8 = util::Utf16ToUtf8(StringPiece16(name16, len));
+      name = name8.data();
+      len = name8.size();
+    }
+
+    const uint32_t hash = HashEntryName(named_entry.type_index, name, len);
+    size_t slot_idx = hash & mask;
+    while (name_index_storage_[slot_idx].occupied) {
+      slot_idx = (slot_idx + 1u) & mask;
+    }
+
+    NameIndexSlot& slot = name_index_storage_[slot_idx];
+    slot.hash = hash;
+    slot.key_index = named_entry.key_index;
+    slot.entry_index = named_entry.entry_index;
+    slot.type_index = named_entry.type_index;
+    slot.occupied = 1u;
+  }
+
+  name_index_ = name_index_storage_.data();
+  name_index_size_ = name_index_storage_.size();
+}
+
+bool LoadedPackage::VerifyNameIndex(const NameIndexSlot* name_index, size_t size) const {
+  // FindEntryByName() masks the hash and probes until it finds an empty slot.
+  if ((size & (size - 1u)) != 0u) {
+    LOG(ERROR) << "Indexed name index has invalid size " << size << ".";
+    return false;
+  }
+
+  // BuildNameIndex() records any entry a type chunk defines, even past the type spec's entry
+  // count, so bound the entry indices the same way.
+  std::vector<size_t> entry_counts(type_specs_.size(), 0u);
+  for (size_t type_idx = 0; type_idx < entry_counts.size(); type_idx++) {
+    const TypeSpecPtr& type_spec = type_specs_[type_idx];
+    if (type_spec == nullptr) {
+      continue;
+    }
+
+    size_t entry_count = dtohl(type_spec->type_spec->entryCount);
+    const auto iter_end = type_spec->types + type_spec->type_count;
+    for (auto iter = type_spec->types; iter != iter_end; ++iter) {
+      const ResTable_type* type = *iter;
+      const size_t type_entry_count = dtohl(type->entryCount);
+      if ((type->flags & ResTable_type::FLAG_SPARSE) == 0) {
+        entry_count = std::max(entry_count, type_entry_count);
+      } else if (type_entry_count != 0u) {
+        // Sparse entries are sorted by index.
+        const ResTable_sparseTypeEntry* sparse_indices =
+            reinterpret_cast<const ResTable_sparseTypeEntry*>(
+                reinterpret_cast<const uint8_t*>(type) + dtohs(type->header.headerSize));
+        entry_count =
+            std::max<size_t>(entry_count, dtohs(sparse_indices[type_entry_count - 1].idx) + 1u);
+      }
+    }
+    entry_counts[type_idx] = entry_count;
+  }
+
+  bool has_empty_slot = false;
+  for (size_t i = 0; i < size; i++) {
+    const NameIndexSlot& slot = name_index[i];
+    if (!slot.occupied) {
+      has_empty_slot = true;
+      continue;
+    }
+
+    if (type_specs_[slot.type_index] == nullptr) {
+      LOG(ERROR) << StringPrintf("Indexed name index refers to missing type %02x.",
+                                 slot.type_index);
+      return false;
+    }
+
+    if (slot.entry_index >= entry_counts[slot.type_index]) {
+      LOG(ERROR) << "Indexed name index refers to out of range entry " << slot.entry_index
+                 << ".";
+      return false;
+    }
+
+    if (slot.key_index >= key_string_pool_.size()) {
+      LOG(ERROR) << "Indexed name index refers to out of range key " << slot.key_index << ".";
+      return false;
+    }
+  }
+
+  if (!has_empty_slot) {
+    LOG(ERROR) << "Indexed name index has no empty slot.";
+    return false;
+  }
+  return true;
+}
+
+const LoadedPackage::NameIndexSlot* LoadedPackage::GetNameIndex(size_t* out_size) const {
+  std::call_once(name_index_once_, [this]() { BuildNameIndex(); });
+  *out_size = name_index_size_;
+  return name_index_;
+}
+
+bool LoadedPackage::KeyEquals(uint32_t key_index, const std::string& name8,
+                              const std::u16string& name16) const {
+  size_t len;
+  const char* key = key_string_pool_.string8At(key_index, &len);
+  if (key != nullptr) {
+    return name8.compare(0, std::string::npos, key, len) == 0;
+  }
+
+  const char16_t* key16 = key_string_pool_.stringAt(key_index, &len);
+  return key16 != nullptr && name16.compare(0, std::u16string::npos, key16, len) == 0;
+}
+
 uint32_t LoadedPackage::FindEntryByName(const std::u16string& type_name,
                                         const std::u16string& entry_name) const {
   ssize_t type_idx = type_string_pool_.indexOfString(type_name.data(), type_name.size());
@@ -325,33 +523,29 @@ uint32_t LoadedPackage::FindEntryByName(const std::u16string& type_name,
     return 0u;
   }
 
-  ssize_t key_idx = key_string_pool_.indexOfString(entry_name.data(), entry_name.size());
-  if (key_idx < 0) {
+  const TypeSpec* type_spec = type_specs_[type_idx].get();
+  if (type_spec == nullptr) {
     return 0u;
   }
 
-  const TypeSpec* type_spec = type_specs_[type_idx].get();
-  if (type_spec == nullptr) {
+  size_t name_index_size;
+  const NameIndexSlot* name_index = GetNameIndex(&name_index_size);
+  if (name_index_size == 0u) {
     return 0u;
   }
 
-  const auto iter_end = type_spec->types + type_spec->type_count;
-  for (auto iter = type_spec->types; iter != iter_end; ++iter) {
-    const ResTable_type* type = *iter;
-    size_t entry_count = dtohl(type->entryCount);
-    for (size_t entry_idx = 0; entry_idx < entry_count; entry_idx++) {
-      const uint32_t* entry_offsets = reinterpret_cast<const uint32_t*>(
-          reinterpret_cast<const uint8_t*>(type) + dtohs(type->header.headerSize));
-      const uint32_t offset = dtohl(entry_offsets[entry_idx]);
-      if (offset != ResTable_type::NO_ENTRY) {
-        const ResTable_entry* entry = reinterpret_cast<const ResTable_entry*>(
-            reinterpret_cast<const uint8_t*>(type) + dtohl(type->entriesStart) + offset);
-        if (dtohl(entry->key.index) == static_cast<uint32_t>(key_idx)) {
-          // The package ID will be overridden by the caller (due to runtime assignment of package
-          // IDs for shared libraries).
-          return make_resid(0x00, type_idx + type_id_offset_ + 1, entry_idx);
-        }
-      }
+  const std::string entry_name8 = util::Utf16ToUtf8(entry_name);
+  const uint32_t hash =
+      HashEntryName(static_cast<uint8_t>(type_idx), entry_name8.data(), entry_name8.size());
+  const size_t mask = name_index_size - 1u;
+  for (size_t slot_idx = hash & mask; name_index[slot_idx].occupied;
+       slot_idx = (slot_idx + 1u) & mask) {
+    const NameIndexSlot& slot = name_index[slot_idx];
+    if (slot.hash == hash && slot.type_index == static_cast<uint8_t>(type_idx) &&
+        KeyEquals(slot.key_index, entry_name8, entry_name)) {
+      // The package ID will be overridden by the caller (due to runtime assignment of package
+      // IDs for shared libraries).
+      return make_resid(0x00, type_idx + type_id_offset_ + 1, slot.entry_index);
     }
   }
   return 0u;
@@ -366,16 +560,17 @@ const LoadedPackage* LoadedArsc::GetPackageById(uint8_t package_id) const {
   return nullptr;
 }
 
-std::unique_ptr<const LoadedPackage> LoadedPackage::Load(const Chunk& chunk,
+// typeIdOffset was added at some point, but we still must recognize apps built before this
+// was added.
+constexpr static size_t kMinPackageSize =
+    sizeof(ResTable_package) - sizeof(ResTable_package::typeIdOffset);
+
+std::unique_ptr<LoadedPackage> LoadedPackage::LoadHeader(const Chunk& chunk,
                                                          const LoadedIdmap* loaded_idmap,
-                                                         bool system, bool load_as_shared_library) {
-  ATRACE_NAME("LoadedPackage::Load");
+                                                         bool system,
+                                                         bool load_as_shared_library) {
   std::unique_ptr<LoadedPackage> loaded_package(new LoadedPackage());
 
-  // typeIdOffset was added at some point, but we still must recognize apps built before this
-  // was added.
-  constexpr size_t kMinPackageSize =
-      sizeof(ResTable_package) - sizeof(ResTable_package::typeIdOffset);
   const ResTable_package* header = chunk.header<ResTable_package, kMinPackageSize>();
   if (header == nullptr) {
     LOG(ERROR) << "RES_TABLE_PACKAGE_TYPE too small.";
@@ -408,6 +603,55 @@ std::unique_ptr<const LoadedPackage> LoadedPackage::Load(const Chunk& chunk,
 
   util::ReadUtf16StringFromDevice(header->name, arraysize(header->name),
                                   &loaded_package->package_name_);
+  return loaded_package;
+}
+
+static bool LoadDynamicPackageMap(const Chunk& chunk,
+                                  std::vector<DynamicPackageEntry>* out_dynamic_package_map) {
+  const ResTable_lib_header* lib = chunk.header<ResTable_lib_header>();
+  if (lib == nullptr) {
+    LOG(ERROR) << "RES_TABLE_LIBRARY_TYPE too small.";
+    return false;
+  }
+
+  if (chunk.data_size() / sizeof(ResTable_lib_entry) < dtohl(lib->count)) {
+    LOG(ERROR) << "RES_TABLE_LIBRARY_TYPE too small to hold entries.";
+    return false;
+  }
+
+  out_dynamic_package_map->reserve(dtohl(lib->count));
+
+  const ResTable_lib_entry* const entry_begin =
+      reinterpret_cast<const ResTable_lib_entry*>(chunk.data_ptr());
+  const ResTable_lib_entry* const entry_end = entry_begin + dtohl(lib->count);
+  for (auto entry_iter = entry_begin; entry_iter != entry_end; ++entry_iter) {
+    std::string package_name;
+    util::ReadUtf16StringFromDevice(entry_iter->packageName, arraysize(entry_iter->packageName),
+                                    &package_name);
+
+    if (dtohl(entry_iter->packageId) >= std::numeric_limits<uint8_t>::max()) {
+      LOG(ERROR) << StringPrintf(
+          "Package ID %02x in RES_TABLE_LIBRARY_TYPE too large for package '%s'.",
+          dtohl(entry_iter->packageId), package_name.c_str());
+      return false;
+    }
+
+    out_dynamic_package_map->emplace_back(std::move(package_name), dtohl(entry_iter->packageId));
+  }
+  return true;
+}
+
+std::unique_ptr<const LoadedPackage> LoadedPackage::Load(const Chunk& chunk,
+                                                         const LoadedIdmap* loaded_idmap,
+                                                         bool system, bool load_as_shared_library) {
+  ATRACE_NAME("LoadedPackage::Load");
+  std::unique_ptr<LoadedPackage> loaded_package =
+      LoadHeader(chunk, loaded_idmap, system, load_as_shared_library);
+  if (loaded_package == nullptr) {
+    return {};
+  }
+
+  const ResTable_package* header = chunk.header<ResTable_package, kMinPackageSize>();
 
   // A map of TypeSpec builders, each associated with an type index.
   // We use these to accumulate the set of Types available for a TypeSpec, and later build a single,
@@ -518,38 +762,9 @@ std::unique_ptr<const LoadedPackage> LoadedPackage::Load(const Chunk& chunk,
       } break;
 
       case RES_TABLE_LIBRARY_TYPE: {
-        const ResTable_lib_header* lib = child_chunk.header<ResTable_lib_header>();
-        if (lib == nullptr) {
-          LOG(ERROR) << "RES_TABLE_LIBRARY_TYPE too small.";
-          return {};
-        }
-
-        if (child_chunk.data_size() / sizeof(ResTable_lib_entry) < dtohl(lib->count)) {
-          LOG(ERROR) << "RES_TABLE_LIBRARY_TYPE too small to hold entries.";
+        if (!LoadDynamicPackageMap(child_chunk, &loaded_package->dynamic_package_map_)) {
           return {};
         }
-
-        loaded_package->dynamic_package_map_.reserve(dtohl(lib->count));
-
-        const ResTable_lib_entry* const entry_begin =
-            reinterpret_cast<const ResTable_lib_entry*>(child_chunk.data_ptr());
-        const ResTable_lib_entry* const entry_end = entry_begin + dtohl(lib->count);
-        for (auto entry_iter = entry_begin; entry_iter != entry_end; ++entry_iter) {
-          std::string package_name;
-          util::ReadUtf16StringFromDevice(entry_iter->packageName,
-                                          arraysize(entry_iter->packageName), &package_name);
-
-          if (dtohl(entry_iter->packageId) >= std::numeric_limits<uint8_t>::max()) {
-            LOG(ERROR) << StringPrintf(
-                "Package ID %02x in RES_TABLE_LIBRARY_TYPE too large for package '%s'.",
-                dtohl(entry_iter->packageId), package_name.c_str());
-            return {};
-          }
-
-          loaded_package->dynamic_package_map_.emplace_back(std::move(package_name),
-                                                            dtohl(entry_iter->packageId));
-        }
-
       } break;
 
       default:
@@ -588,6 +803,183 @@ std::unique_ptr<const LoadedPackage> LoadedPackage::Load(const Chunk& chunk,
   return std::move(loaded_package);
 }
 
+// Returns the chunk at `offset` in `data`, or nullptr if it doesn't fit.
+static const ResChunk_header* ChunkAt(const StringPiece& data, uint32_t offset) {
+  if ((offset & 0x03) != 0 || offset > data.size() ||
+      data.size() - offset < sizeof(ResChunk_header)) {
+    return nullptr;
+  }
+
+  const ResChunk_header* header =
+      reinterpret_cast<const ResChunk_header*>(data.data() + offset);
+  const size_t header_size = dtohs(header->headerSize);
+  const size_t size = dtohl(header->size);
+  if (header_size < sizeof(ResChunk_header) || size < header_size ||
+      size > data.size() - offset) {
+    return nullptr;
+  }
+  return header;
+}
+
+std::unique_ptr<const LoadedPackage> LoadedPackage::LoadFromIndex(
+    const StringPiece& data, const ResourcesIndex_package* index, bool system,
+    bool load_as_shared_library) {
+  ATRACE_NAME("LoadedPackage::LoadFromIndex");
+  const ResChunk_header* package_chunk = ChunkAt(data, dtohl(index->package_offset));
+  if (package_chunk == nullptr || dtohs(package_chunk->type) != RES_TABLE_PACKAGE_TYPE) {
+    LOG(ERROR) << "Indexed RES_TABLE_PACKAGE_TYPE is out of bounds.";
+    return {};
+  }
+
+  std::unique_ptr<LoadedPackage> loaded_package = LoadHeader(
+      Chunk(package_chunk), nullptr /*loaded_idmap*/, system, load_as_shared_library);
+  if (loaded_package == nullptr) {
+    return {};
+  }
+
+  const ResChunk_header* type_strings = ChunkAt(data, dtohl(index->type_strings_offset));
+  const ResChunk_header* key_strings = ChunkAt(data, dtohl(index->key_strings_offset));
+  if (type_strings == nullptr || key_strings == nullptr ||
+      loaded_package->type_string_pool_.setTo(type_strings, dtohl(type_strings->size)) !=
+          NO_ERROR ||
+      loaded_package->key_string_pool_.setTo(key_strings, dtohl(key_strings->size)) !=
+          NO_ERROR) {
+    LOG(ERROR) << "Indexed RES_STRING_POOL_TYPE corrupt.";
+    return {};
+  }
+
+  if (index->library_offset != 0u) {
+    const ResChunk_header* library = ChunkAt(data, dtohl(index->library_offset));
+    if (library == nullptr ||
+        !LoadDynamicPackageMap(Chunk(library), &loaded_package->dynamic_package_map_)) {
+      return {};
+    }
+  }
+
+  // The index only records where the chunks are, so each of them gets the same validation as
+  // when the table is walked. Any failure makes the caller walk the table instead.
+  for (const ResourcesIndex_typeSpec* type_spec_index : ResourcesIndex::GetTypeSpecs(index)) {
+    const ResChunk_header* type_spec_chunk =
+        ChunkAt(data, dtohl(type_spec_index->type_spec_offset));
+    if (type_spec_chunk == nullptr || dtohs(type_spec_chunk->type) != RES_TABLE_TYPE_SPEC_TYPE) {
+      LOG(ERROR) << "Indexed RES_TABLE_TYPE_SPEC_TYPE is out of bounds or of the wrong type.";
+      return {};
+    }
+
+    const Chunk chunk(type_spec_chunk);
+    const ResTable_typeSpec* type_spec = chunk.header<ResTable_typeSpec>();
+    if (type_spec == nullptr) {
+      LOG(ERROR) << "Indexed RES_TABLE_TYPE_SPEC_TYPE too small.";
+      return {};
+    }
+
+    if (type_spec->id == 0) {
+      LOG(ERROR) << "Indexed RES_TABLE_TYPE_SPEC_TYPE has invalid ID 0.";
+      return {};
+    }
+
+    if (loaded_package->type_id_offset_ + static_cast<int>(type_spec->id) >
+        std::numeric_limits<uint8_t>::max()) {
+      LOG(ERROR) << "Indexed RES_TABLE_TYPE_SPEC_TYPE has out of range ID.";
+      return {};
+    }
+
+    const size_t entry_count = dtohl(type_spec->entryCount);
+    if (entry_count > std::numeric_limits<uint16_t>::max() ||
+        entry_count * sizeof(uint32_t) > chunk.data_size()) {
+      LOG(ERROR) << "Indexed RES_TABLE_TYPE_SPEC_TYPE has too many entries (" << entry_count
+                 << ").";
+      return {};
+    }
+
+    if (loaded_package->type_specs_[type_spec->id - 1] != nullptr) {
+      LOG(ERROR) << StringPrintf("Indexed RES_TABLE_TYPE_SPEC_TYPE already defined for ID %02x.",
+                                 type_spec->id);
+      return {};
+    }
+
+    TypeSpecPtrBuilder builder(type_spec, nullptr /*idmap_header*/);
+    const uint32_t type_count = dtohl(type_spec_index->type_count);
+    for (uint32_t i = 0; i < type_count; i++) {
+      const ResChunk_header* type_chunk = ChunkAt(data, dtohl(type_spec_index->type_offsets[i]));
+      if (type_chunk == nullptr || dtohs(type_chunk->type) != RES_TABLE_TYPE_TYPE) {
+        LOG(ERROR) << "Indexed RES_TABLE_TYPE_TYPE is out of bounds or of the wrong type.";
+        return {};
+      }
+
+      const ResTable_type* type = Chunk(type_chunk).header<ResTable_type, kResTableTypeMinSize>();
+      if (type == nullptr) {
+        LOG(ERROR) << "Indexed RES_TABLE_TYPE_TYPE too small.";
+        return {};
+      }
+
+      if (!VerifyResTableType(type)) {
+        return {};
+      }
+
+      if (type->id != type_spec->id) {
+        LOG(ERROR) << StringPrintf(
+            "Indexed RES_TABLE_TYPE_TYPE with ID %02x doesn't match RES_TABLE_TYPE_SPEC_TYPE %02x.",
+            type->id, type_spec->id);
+        return {};
+      }
+      builder.AddType(type);
+    }
+
+    TypeSpecPtr type_spec_ptr = builder.Build();
+    if (type_spec_ptr == nullptr) {
+      LOG(ERROR) << "Too many type configurations, overflow detected.";
+      return {};
+    }
+    loaded_package->type_specs_.editItemAt(type_spec->id - 1) = std::move(type_spec_ptr);
+  }
+
+  // Adopt the precomputed name index, if there is one, instead of building it on first use.
+  const uint32_t name_index_count = dtohl(index->name_index_count);
+  if (name_index_count != 0u) {
+    const ResourcesIndex_nameSlot* name_index = ResourcesIndex::GetNameIndex(index);
+    if (!loaded_package->VerifyNameIndex(name_index, name_index_count)) {
+      return {};
+    }
+
+    LoadedPackage* package = loaded_package.get();
+    std::call_once(package->name_index_once_, [&]() {
+      package->name_index_ = name_index;
+      package->name_index_size_ = name_index_count;
+    });
+  }
+
+  return std::move(loaded_package);
+}
+
+bool LoadedArsc::LoadFromIndex(const StringPiece& data, const ResourcesIndex& index,
+                               bool load_as_shared_library) {
+  const ResChunk_header* table_chunk = ChunkAt(data, 0u);
+  if (table_chunk == nullptr || dtohs(table_chunk->type) != RES_TABLE_TYPE) {
+    LOG(ERROR) << "Indexed RES_TABLE_TYPE is corrupt.";
+    return false;
+  }
+
+  if (index.GetGlobalStringsOffset() != 0u) {
+    const ResChunk_header* pool = ChunkAt(data, index.GetGlobalStringsOffset());
+    if (pool == nullptr || global_string_pool_.setTo(pool, dtohl(pool->size)) != NO_ERROR) {
+      LOG(ERROR) << "Indexed RES_STRING_POOL_TYPE corrupt.";
+      return false;
+    }
+  }
+
+  packages_.reserve(index.GetPackages().size());
+  for (const ResourcesIndex_package* package_index : index.GetPackages()) {
+    std::unique_ptr<const LoadedPackage> loaded_package =
+        LoadedPackage::LoadFromIndex(data, package_index, system_, load_as_shared_library);
+    if (!loaded_package) {
+      return false;
+    }
+    packages_.push_back(std::move(loaded_package));
+  }
+  return true;
+}
+
 bool LoadedArsc::LoadTable(const Chunk& chunk, const LoadedIdmap* loaded_idmap,
                            bool load_as_shared_library) {
   const ResTable_header* header = chunk.header<ResTable_header>();
@@ -652,13 +1044,27 @@ bool LoadedArsc::LoadTable(const Chunk& chunk, const LoadedIdmap* loaded_idmap,
 
 std::unique_ptr<const LoadedArsc> LoadedArsc::Load(const StringPiece& data,
                                                    const LoadedIdmap* loaded_idmap, bool system,
-                                                   bool load_as_shared_library) {
+                                                   bool load_as_shared_library,
+                                                   const ResourcesIndex* index) {
   ATRACE_NAME("LoadedArsc::LoadTable");
 
   // Not using make_unique because the constructor is private.
   std::unique_ptr<LoadedArsc> loaded_arsc(new LoadedArsc());
   loaded_arsc->system_ = system;
 
+  // The index doesn't describe how an overlay maps onto its target, so only use it for regular
+  // tables.
+  if (index != nullptr && loaded_idmap == nullptr) {
+    if (loaded_arsc->LoadFromIndex(data, *index, load_as_shared_library)) {
+      return std::move(loaded_arsc);
+    }
+
+    // The index doesn't describe this table after all, walk it from a clean state.
+    LOG(WARNING) << "Ignoring invalid resources index, walking the table instead.";
+    loaded_arsc.reset(new LoadedArsc());
+    loaded_arsc->system_ = system;
+  }
+
   ChunkIterator iter(data.data(), data.size());
   while (iter.HasNext()) {
     const Chunk chunk = iter.Next();
@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_RESOURCES
+
+#include "androidfw/ResourcesIndex.h"
+
+#include <map>
+
+#include "android-base/logging.h"
+#include "android-base/stringprintf.h"
+#include "utils/ByteOrder.h"
+#include "utils/Trace.h"
+
+#ifdef _WIN32
+#ifdef ERROR
+#undef ERROR
+#endif
+#endif
+
+#include "androidfw/Chunk.h"
+#include "androidfw/LoadedArsc.h"
+#include "androidfw/ResourceTypes.h"
+
+using ::android::base::StringPrintf;
+
+namespace android {
+
+namespace {
+
+// The chunk offsets of a single type spec, gathered while walking a package.
+struct TypeSpecOffsets {
+  uint32_t type_spec_offset;
+  std::vector<uint32_t> type_offsets;
+};
+
+bool is_word_aligned(const void* data) {
+  return (reinterpret_cast<uintptr_t>(data) & 0x03) == 0;
+}
+
+template <typename T>
+void AppendStruct(const T& value, std::string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendUint32(uint32_t value, std::string* out) {
+  AppendStruct(htodl(value), out);
+}
+
+}  // namespace
+
+uint32_t ResourcesIndex::GetGlobalStringsOffset() const {
+  return dtohl(header_->global_strings_offset);
+}
+
+bool ResourcesIndex::Matches(uint32_t arsc_crc32, size_t arsc_size) const {
+  return dtohl(header_->arsc_crc32) == arsc_crc32 && dtohl(header_->arsc_size) == arsc_size;
+}
+
+std::vector<const ResourcesIndex_typeSpec*> ResourcesIndex::GetTypeSpecs(
+    const ResourcesIndex_package* package) {
+  std::vector<const ResourcesIndex_typeSpec*> type_specs;
+  const uint32_t type_spec_count = dtohl(package->type_spec_count);
+  type_specs.reserve(type_spec_count);
+
+  const uint8_t* data_ptr = reinterpret_cast<const uint8_t*>(package + 1);
+  for (uint32_t i = 0; i < type_spec_count; i++) {
+    const ResourcesIndex_typeSpec* type_spec =
+        reinterpret_cast<const ResourcesIndex_typeSpec*>(data_ptr);
+    type_specs.push_back(type_spec);
+    data_ptr += sizeof(*type_spec) + dtohl(type_spec->type_count) * sizeof(uint32_t);
+  }
+  return type_specs;
+}
+
+const ResourcesIndex_nameSlot* ResourcesIndex::GetNameIndex(
+    const ResourcesIndex_package* package) {
+  const uint8_t* data_ptr = reinterpret_cast<const uint8_t*>(package) + dtohl(package->size);
+  return reinterpret_cast<const ResourcesIndex_nameSlot*>(data_ptr) -
+         dtohl(package->name_index_count);
+}
+
+std::unique_ptr<const ResourcesIndex> ResourcesIndex::Load(const StringPiece& index_data) {
+  ATRACE_CALL();
+  if (!is_word_aligned(index_data.data())) {
+    LOG(ERROR) << "Resources index is not word aligned.";
+    return {};
+  }
+
+  if (index_data.size() < sizeof(ResourcesIndex_header)) {
+    LOG(ERROR) << "Resources index is too small.";
+    return {};
+  }
+
+  const ResourcesIndex_header* header =
+      reinterpret_cast<const ResourcesIndex_header*>(index_data.data());
+  if (dtohl(header->magic) != kMagic || dtohl(header->version) != kVersion) {
+    LOG(ERROR) << StringPrintf("Resources index has invalid magic/version (0x%08x, 0x%08x).",
+                               dtohl(header->magic), dtohl(header->version));
+    return {};
+  }
+
+  // Can't use make_unique because the constructor is private.
+  std::unique_ptr<ResourcesIndex> index(new ResourcesIndex(header));
+
+  const uint8_t* data_ptr = reinterpret_cast<const uint8_t*>(index_data.data()) + sizeof(*header);
+  size_t data_size = index_data.size() - sizeof(*header);
+
+  const uint32_t package_count = dtohl(header->package_count);
+  for (uint32_t i = 0; i < package_count; i++) {
+    if (data_size < sizeof(ResourcesIndex_package)) {
+      LOG(ERROR) << "Resources index too small for the number of packages.";
+      return {};
+    }
+
+    const ResourcesIndex_package* package =
+        reinterpret_cast<const ResourcesIndex_package*>(data_ptr);
+    const size_t package_size = dtohl(package->size);
+    if (package_size > data_size || (package_size & 0x03) != 0) {
+      LOG(ERROR) << "Resources index package record has invalid size.";
+      return {};
+    }
+
+    // Make sure the type spec records and the name index fit within the package record.
+    size_t remaining = package_size - sizeof(*package);
+    const uint8_t* type_spec_ptr = data_ptr + sizeof(*package);
+    const uint32_t type_spec_count = dtohl(package->type_spec_count);
+    for (uint32_t j = 0; j < type_spec_count; j++) {
+      if (remaining < sizeof(ResourcesIndex_typeSpec)) {
+        LOG(ERROR) << "Resources index too small for the number of type specs.";
+        return {};
+      }
+
+      const ResourcesIndex_typeSpec* type_spec =
+          reinterpret_cast<const ResourcesIndex_typeSpec*>(type_spec_ptr);
+      const size_t type_count = dtohl(type_spec->type_count);
+      if ((remaining - sizeof(*type_spec)) / sizeof(uint32_t) < type_count) {
+        LOG(ERROR) << "Resources index too small for the number of types.";
+        return {};
+      }
+
+      const size_t type_spec_size = sizeof(*type_spec) + type_count * sizeof(uint32_t);
+      type_spec_ptr += type_spec_size;
+      remaining -= type_spec_size;
+    }
+
+    const size_t name_index_count = dtohl(package->name_index_count);
+    if (remaining / sizeof(ResourcesIndex_nameSlot) != name_index_count ||
+        remaining % sizeof(ResourcesIndex_nameSlot) != 0) {
+      LOG(ERROR) << "Resources index has a name index of the wrong size.";
+      return {};
+    }
+
+    // FindEntryByName() probes the name index with a mask, so it must be a power of two.
+    if ((name_index_count & (name_index_count - 1u)) != 0) {
+      LOG(ERROR) << "Resources index has a name index of invalid size " << name_index_count << ".";
+      return {};
+    }
+
+    index->packages_.push_back(package);
+    data_ptr += package_size;
+    data_size -= package_size;
+  }
+
+  // Need to force a move for mingw32.
+  return std::move(index);
+}
+
+bool ResourcesIndex::Create(const StringPiece& arsc_data, uint32_t arsc_crc32,
+                            std::string* out_index) {
+  ATRACE_CALL();
+  CHECK(out_index != nullptr);
+
+  // Fully load the table first, so that every chunk recorded in the index has been validated.
+  std::unique_ptr<const LoadedArsc> loaded_arsc = LoadedArsc::Load(arsc_data);
+  if (loaded_arsc == nullptr) {
+    LOG(ERROR) << "Can't create a resources index for a malformed table.";
+    return false;
+  }
+
+  const uint8_t* const arsc_base = reinterpret_cast<const uint8_t*>(arsc_data.data());
+  auto offset_of = [&](const void* ptr) -> uint32_t {
+    return static_cast<uint32_t>(reinterpret_cast<const uint8_t*>(ptr) - arsc_base);
+  };
+
+  ChunkIterator iter(arsc_data.data(), arsc_data.size());
+  if (!iter.HasNext()) {
+    LOG(ERROR) << "Can't create a resources index for an empty table.";
+    return false;
+  }
+
+  const Chunk table_chunk = iter.Next();
+  if (table_chunk.type() != RES_TABLE_TYPE || iter.HasNext() ||
+      table_chunk.header<ResChunk_header>() != reinterpret_cast<const ResChunk_header*>(arsc_base)) {
+    LOG(ERROR) << "Resources index only supports tables made of a single RES_TABLE_TYPE.";
+    return false;
+  }
+
+  uint32_t global_strings_offset = 0u;
+  std::string packages_data;
+  size_t packages_seen = 0u;
+
+  ChunkIterator table_iter(table_chunk.data_ptr(), table_chunk.data_size());
+  while (table_iter.HasNext()) {
+    const Chunk child_chunk = table_iter.Next();
+    if (child_chunk.type() == RES_STRING_POOL_TYPE) {
+      // Only the first string pool is used, just like in LoadedArsc.
+      if (global_strings_offset == 0u) {
+        global_strings_offset = offset_of(child_chunk.header<ResChunk_header>());
+      }
+      continue;
+    } else if (child_chunk.type() != RES_TABLE_PACKAGE_TYPE) {
+      continue;
+    }
+
+    if (packages_seen >= loaded_arsc->GetPackages().size()) {
+      return false;
+    }
+    const LoadedPackage* loaded_package = loaded_arsc->GetPackages()[packages_seen++].get();
+
+    const ResTable_package* package_header = child_chunk.header<ResTable_package>();
+    const uintptr_t header_address = reinterpret_cast<uintptr_t>(package_header);
+
+    ResourcesIndex_package package = {};
+    package.package_offset = offset_of(package_header);
+
+    // Keyed by type ID, so that the type specs are recorded in the same order LoadedPackage uses.
+    std::map<uint8_t, TypeSpecOffsets> type_specs;
+
+    ChunkIterator package_iter(child_chunk.data_ptr(), child_chunk.data_size());
+    while (package_iter.HasNext()) {
+      const Chunk package_child = package_iter.Next();
+      const uint32_t offset = offset_of(package_child.header<ResChunk_header>());
+      switch (package_child.type()) {
+        case RES_STRING_POOL_TYPE: {
+          const uintptr_t pool_address =
+              reinterpret_cast<uintptr_t>(package_child.header<ResChunk_header>());
+          if (pool_address == header_address + dtohl(package_header->typeStrings)) {
+            package.type_strings_offset = offset;
+          } else if (pool_address == header_address + dtohl(package_header->keyStrings)) {
+            package.key_strings_offset = offset;
+          }
+        } break;
+
+        case RES_TABLE_TYPE_SPEC_TYPE: {
+          const ResTable_typeSpec* type_spec = package_child.header<ResTable_typeSpec>();
+          auto result = type_specs.insert(std::make_pair(type_spec->id, TypeSpecOffsets{}));
+          if (result.second) {
+            result.first->second.type_spec_offset = offset;
+          }
+        } break;
+
+        case RES_TABLE_TYPE_TYPE: {
+          const ResTable_type* type = package_child.header<ResTable_type, kResTableTypeMinSize>();
+          type_specs[type->id].type_offsets.push_back(offset);
+        } break;
+
+        case RES_TABLE_LIBRARY_TYPE:
+          package.library_offset = offset;
+          break;
+
+        default:
+          break;
+      }
+    }
+
+    if (package.type_strings_offset == 0u || package.key_strings_offset == 0u) {
+      LOG(ERROR) << "Resources index requires every package to have type and key string pools.";
+      return false;
+    }
+
+    size_t name_index_count;
+    const ResourcesIndex_nameSlot* name_index = loaded_package->GetNameIndex(&name_index_count);
+
+    std::string type_specs_data;
+    for (const auto& entry : type_specs) {
+      AppendUint32(entry.second.type_spec_offset, &type_specs_data);
+      AppendUint32(static_cast<uint32_t>(entry.second.type_offsets.size()), &type_specs_data);
+      for (uint32_t type_offset : entry.second.type_offsets) {
+        AppendUint32(type_offset, &type_specs_data);
+      }
+    }
+
+    const size_t package_size = sizeof(package) + type_specs_data.size() +
+                                name_index_count * sizeof(ResourcesIndex_nameSlot);
+    package.size = htodl(static_cast<uint32_t>(package_size));
+    package.package_offset = htodl(package.package_offset);
+    package.type_strings_offset = htodl(package.type_strings_offset);
+    package.key_strings_offset = htodl(package.key_strings_offset);
+    package.library_offset = htodl(package.library_offset);
+    package.type_spec_count = htodl(static_cast<uint32_t>(type_specs.size()));
+    package.name_index_count = htodl(static_cast<uint32_t>(name_index_count));
+
+    AppendStruct(package, &packages_data);
+    packages_data.append(type_specs_data);
+    packages_data.append(reinterpret_cast<const char*>(name_index),
+                         name_index_count * sizeof(ResourcesIndex_nameSlot));
+  }
+
+  if (table_iter.HadFatalError() || packages_seen != loaded_arsc->GetPackages().size()) {
+    return false;
+  }
+
+  ResourcesIndex_header header = {};
+  header.magic = htodl(kMagic);
+  header.version = htodl(kVersion);
+  header.arsc_crc32 = htodl(arsc_crc32);
+  header.arsc_size = htodl(static_cast<uint32_t>(arsc_data.size()));
+  header.global_strings_offset = htodl(global_strings_offset);
+  header.package_count = htodl(static_cast<uint32_t>(packages_seen));
+
+  out_index->clear();
+  out_index->reserve(sizeof(header) + packages_data.size());
+  AppendStruct(header, out_index);
+  out_index->append(packages_data);
+  return true;
+}
+
+}  // namespace android
@@ -39,6 +39,20 @@ class ApkAssets {
   // filter out this package when computing what configurations/resources are available.
   static std::unique_ptr<const ApkAssets> Load(const std::string& path, bool system = false);
 
+  // Creates an ApkAssets, using the resources index at `index_path` (see CreateIndex()) to locate
+  // the chunks of the resource table and to adopt its precomputed name indices. If the index is
+  // missing, malformed or was generated for a different resources.arsc, the APK is loaded as with
+  // Load().
+  // If `system` is true, the package is marked as a system package, and allows some functions to
+  // filter out this package when computing what configurations/resources are available.
+  static std::unique_ptr<const ApkAssets> LoadWithIndex(const std::string& path,
+                                                        const std::string& index_path,
+                                                        bool system = false);
+
+  // Generates the resources index of the APK at `path` and writes it to `index_path`.
+  // Returns false if the APK can't be loaded or the file can't be written.
+  static bool CreateIndex(const std::string& path, const std::string& index_path);
+
   // Creates an ApkAssets, but forces any package with ID 0x7f to be loaded as a shared library.
   // If `system` is true, the package is marked as a system package, and allows some functions to
   // filter out this package when computing what configurations/resources are available.
@@ -83,6 +97,7 @@ class ApkAssets {
   static std::unique_ptr<const ApkAssets> LoadImpl(base::unique_fd fd, const std::string& path,
                                                    std::unique_ptr<Asset> idmap_asset,
                                                    std::unique_ptr<const LoadedIdmap> loaded_idmap,
+                                                   std::unique_ptr<Asset> index_asset,
                                                    bool system, bool load_as_shared_library);
 
   // Creates an Asset from any file on the file system.
@@ -96,6 +111,7 @@ class ApkAssets {
   const std::string path_;
   std::unique_ptr<Asset> resources_asset_;
   std::unique_ptr<Asset> idmap_asset_;
+  std::unique_ptr<Asset> index_asset_;
   std::unique_ptr<const LoadedArsc> loaded_arsc_;
 };
 
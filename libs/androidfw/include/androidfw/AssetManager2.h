@@ -20,13 +20,18 @@
 #include "android-base/macros.h"
 
 #include <array>
+#include <atomic>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 #include "androidfw/ApkAssets.h"
 #include "androidfw/Asset.h"
 #include "androidfw/AssetManager.h"
+#include "androidfw/ConcurrentResidCache.h"
 #include "androidfw/ResourceTypes.h"
 #include "androidfw/Util.h"
 
@@ -69,10 +74,37 @@ struct ResolvedBag {
   Entry entries[0];
 };
 
-struct FindEntryResult;
+struct FindEntryResult {
+  // A pointer to the resource table entry for this resource.
+  // If the size of the entry is > sizeof(ResTable_entry), it can be cast to
+  // a ResTable_map_entry and processed as a bag/map.
+  const ResTable_entry* entry;
+
+  // The configuration for which the resulting entry was defined. This is already swapped to host
+  // endianness.
+  ResTable_config config;
+
+  // The bitmask of configuration axis with which the resource value varies.
+  uint32_t type_flags;
+
+  // The dynamic package ID map for the package from which this resource came from.
+  const DynamicRefTable* dynamic_ref_table;
+
+  // The string pool reference to the type's name. This uses a different string pool than
+  // the global string pool, but this is hidden from the caller.
+  StringPoolRef type_string_ref;
+
+  // The string pool reference to the entry's name. This uses a different string pool than
+  // the global string pool, but this is hidden from the caller.
+  StringPoolRef entry_string_ref;
+};
 
 // AssetManager2 is the main entry point for accessing assets and resources.
 // AssetManager2 provides caching of resources retrieved via the underlying ApkAssets.
+//
+// Resource lookups (GetResource(), GetBag() and friends) may be called concurrently from
+// multiple threads, as long as no thread is changing the AssetManager's ApkAssets or
+// configuration at the same time.
 class AssetManager2 {
  public:
   struct ResourceName {
@@ -229,6 +261,9 @@ class AssetManager2 {
   //      ...
   //    }
   //  }
+  //
+  // Bags that have already been resolved are returned without taking a lock. Concurrent calls
+  // that miss the cache are serialized, so each bag is only resolved once.
   const ResolvedBag* GetBag(uint32_t resid);
 
   // Creates a new Theme from this AssetManager.
@@ -244,6 +279,17 @@ class AssetManager2 {
 
   void DumpToLog() const;
 
+  // Returns the number of FindEntry() lookups that were served from the resolved-entry cache.
+  inline size_t GetEntryCacheHits() const {
+    return entry_cache_hits_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the number of FindEntry() lookups that had to search the configurations because the
+  // resource was not in the resolved-entry cache.
+  inline size_t GetEntryCacheMisses() const {
+    return entry_cache_misses_.load(std::memory_order_relaxed);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(AssetManager2);
 
@@ -332,7 +378,22 @@ class AssetManager2 {
 
   // Cached set of bags. These are cached because they can inherit keys from parent bags,
   // which involves some calculation.
-  std::unordered_map<uint32_t, util::unique_cptr<ResolvedBag>> cached_bags_;
+  ConcurrentResidCache<ResolvedBag, util::unique_cptr<ResolvedBag>> cached_bags_;
+
+  // Serializes the resolution of bags that are not yet in cached_bags_.
+  std::mutex bag_resolution_lock_;
+
+  // A resolved entry along with the cookie of the ApkAssets it was found in.
+  struct CachedEntry {
+    ApkAssetsCookie cookie;
+    FindEntryResult entry;
+  };
+
+  // Cached results of FindEntry() for the current configuration, keyed by resource ID.
+  // Entries are only added when no density override is requested, and are filled lazily.
+  mutable ConcurrentResidCache<CachedEntry> cached_entries_;
+  mutable std::atomic<size_t> entry_cache_hits_{0u};
+  mutable std::atomic<size_t> entry_cache_misses_{0u};
 };
 
 class Theme {
@@ -397,11 +458,18 @@ class Theme {
   AssetManager2* asset_manager_;
   uint32_t type_spec_flags_ = 0u;
 
-  // Defined in the cpp.
-  struct Package;
+  // A single attribute defined by this theme.
+  struct Entry {
+    uint32_t attr_resid;
+    ApkAssetsCookie cookie;
+    uint32_t type_spec_flags;
+    Res_value value;
+  };
 
-  constexpr static size_t kPackageCount = std::numeric_limits<uint8_t>::max() + 1;
-  std::array<std::unique_ptr<Package>, kPackageCount> packages_;
+  // All attributes defined by this theme, sorted by attribute resource ID. SetTo() shares the
+  // storage with another Theme, so ApplyStyle() only modifies it in place while this Theme is its
+  // only owner, and merges into a copy otherwise. May be nullptr if the theme is empty.
+  std::shared_ptr<std::vector<Entry>> entries_;
 };
 
 inline const ResolvedBag::Entry* begin(const ResolvedBag* bag) {
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROIDFW_CONCURRENTRESIDCACHE_H_
+#define ANDROIDFW_CONCURRENTRESIDCACHE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "android-base/macros.h"
+
+namespace android {
+
+// Caches immutable values by resource ID, optimized for many concurrent readers.
+//
+// Find() never takes a lock. It probes an open-addressing table whose slots are written once and
+// which is published through an atomic pointer. Insert() is serialized by an internal mutex and
+// publishes a larger copy of the table when it fills up. Tables that have been replaced are kept
+// alive until the next call to Clear() or EraseIf(), so readers that are still probing them are
+// never left with a dangling pointer.
+//
+// Clear() and EraseIf() are NOT safe to call concurrently with Find() or Insert(). They are meant
+// to be called when the owner is being reconfigured and has exclusive access.
+//
+// `Ptr` is the owning pointer type used to hold values, such as std::unique_ptr<T> or
+// util::unique_cptr<T>. Resource ID 0 is reserved to mark empty slots and can't be cached.
+template <typename T, typename Ptr = std::unique_ptr<T>>
+class ConcurrentResidCache {
+ public:
+  ConcurrentResidCache() : table_(nullptr) {
+  }
+
+  // Returns the value cached for `resid`, or nullptr if there is none.
+  const T* Find(uint32_t resid) const {
+    const Table* table = table_.load(std::memory_order_acquire);
+    if (table == nullptr || resid == 0u) {
+      return nullptr;
+    }
+
+    for (size_t i = Hash(resid) & table->mask;; i = (i + 1u) & table->mask) {
+      const uint32_t key = table->slots[i].key.load(std::memory_order_acquire);
+      if (key == resid) {
+        return table->slots[i].value.load(std::memory_order_relaxed);
+      } else if (key == 0u) {
+        return nullptr;
+      }
+    }
+  }
+
+  // Caches `value` for `resid` and returns a pointer to the cached value. If another value was
+  // already cached for `resid`, `value` is discarded and the existing value is returned instead.
+  const T* Insert(uint32_t resid, Ptr value) {
+    std::lock_guard<std::mutex> lock(write_lock_);
+    if (const T* existing = Find(resid)) {
+      return existing;
+    }
+
+    const T* result = value.get();
+    values_.push_back(std::make_pair(resid, std::move(value)));
+
+    Table* table = table_.load(std::memory_order_relaxed);
+    if (table == nullptr || (values_.size() * 2u) > (table->mask + 1u)) {
+      // Publish a larger table. The old one stays alive for readers still probing it.
+      PublishTable();
+    } else {
+      InsertIntoTable(table, resid, result);
+    }
+    return result;
+  }
+
+  // Removes all cached values for which `pred(resid, value)` returns true.
+  // Must not be called concurrently with Find() or Insert().
+  template <typename Func>
+  void EraseIf(Func pred) {
+    const size_t old_size = values_.size();
+    auto new_end = std::remove_if(
+        values_.begin(), values_.end(),
+        [&](const std::pair<uint32_t, Ptr>& entry) { return pred(entry.first, *entry.second); });
+    values_.erase(new_end, values_.end());
+    retired_tables_.clear();
+    if (values_.size() != old_size) {
+      PublishTable();
+    }
+  }
+
+  // Removes all cached values.
+  // Must not be called concurrently with Find() or Insert().
+  void Clear() {
+    values_.clear();
+    retired_tables_.clear();
+    current_table_.reset();
+    table_.store(nullptr, std::memory_order_release);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ConcurrentResidCache);
+
+  struct Slot {
+    std::atomic<uint32_t> key;
+    std::atomic<const T*> value;
+  };
+
+  struct Table {
+    explicit Table(size_t capacity) : mask(capacity - 1u), slots(new Slot[capacity]) {
+      for (size_t i = 0; i < capacity; i++) {
+        slots[i].key.store(0u, std::memory_order_relaxed);
+        slots[i].value.store(nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    size_t mask;
+    std::unique_ptr<Slot[]> slots;
+  };
+
+  static size_t Hash(uint32_t resid) {
+    // Resource IDs are dense within a type, so mix the bits to spread types across the table.
+    return static_cast<size_t>(resid * 0x9e3779b1u);
+  }
+
+  static void InsertIntoTable(Table* table, uint32_t resid, const T* value) {
+    size_t i = Hash(resid) & table->mask;
+    while (table->slots[i].key.load(std::memory_order_relaxed) != 0u) {
+      i = (i + 1u) & table->mask;
+    }
+
+    // The value must be visible before the key that makes it reachable.
+    table->slots[i].value.store(value, std::memory_order_relaxed);
+    table->slots[i].key.store(resid, std::memory_order_release);
+  }
+
+  // Builds a new table holding every value in values_ and publishes it.
+  void PublishTable() {
+    size_t capacity = 16u;
+    while (capacity < values_.size() * 4u) {
+      capacity <<= 1;
+    }
+
+    std::unique_ptr<Table> new_table(new Table(capacity));
+    for (const auto& entry : values_) {
+      InsertIntoTable(new_table.get(), entry.first, entry.second.get());
+    }
+
+    table_.store(new_table.get(), std::memory_order_release);
+    if (current_table_ != nullptr) {
+      retired_tables_.push_back(std::move(current_table_));
+    }
+    current_table_ = std::move(new_table);
+  }
+
+  // The table that readers probe. Points at current_table_.
+  std::atomic<Table*> table_;
+
+  // Guards everything below against concurrent inserts.
+  std::mutex write_lock_;
+  std::unique_ptr<Table> current_table_;
+  std::vector<std::unique_ptr<Table>> retired_tables_;
+  std::vector<std::pair<uint32_t, Ptr>> values_;
+};
+
+}  // namespace android
+
+#endif  // ANDROIDFW_CONCURRENTRESIDCACHE_H_
@@ -18,6 +18,7 @@
 #define LOADEDARSC_H_
 
 #include <memory>
+#include <mutex>
 #include <set>
 #include <vector>
 
@@ -27,6 +28,7 @@
 #include "androidfw/Chunk.h"
 #include "androidfw/Idmap.h"
 #include "androidfw/ResourceTypes.h"
+#include "androidfw/ResourcesIndex.h"
 #include "androidfw/Util.h"
 
 namespace android {
@@ -82,6 +84,14 @@ class LoadedPackage {
                                                    const LoadedIdmap* loaded_idmap, bool system,
                                                    bool load_as_shared_library);
 
+  // Loads a package of the table `data` from the chunk offsets recorded in a resources index.
+  // Each recorded chunk is validated as when the table is walked, as is the precomputed name
+  // index, which is then adopted instead of being built on the first FindEntryByName().
+  static std::unique_ptr<const LoadedPackage> LoadFromIndex(const StringPiece& data,
+                                                            const ResourcesIndex_package* index,
+                                                            bool system,
+                                                            bool load_as_shared_library);
+
   ~LoadedPackage();
 
   // Finds the entry with the specified type name and entry name. The names are in UTF-16 because
@@ -89,6 +99,9 @@ class LoadedPackage {
   // the default policy in AAPT2 is to build UTF-8 string pools, this needs to change.
   // Returns a partial resource ID, with the package ID left as 0x00. The caller is responsible
   // for patching the correct package ID to the resource ID.
+  //
+  // The first call builds a hash index of every entry name in the package, so that this and all
+  // subsequent lookups avoid scanning the key string pool and the type chunks.
   uint32_t FindEntryByName(const std::u16string& type_name, const std::u16string& entry_name) const;
 
   static const ResTable_entry* GetEntry(const ResTable_type* type_chunk, uint16_t entry_index);
@@ -170,8 +183,34 @@ class LoadedPackage {
  private:
   DISALLOW_COPY_AND_ASSIGN(LoadedPackage);
 
+  friend class ResourcesIndex;
+
   LoadedPackage();
 
+  // Creates a LoadedPackage from the header of a RES_TABLE_PACKAGE_TYPE chunk.
+  static std::unique_ptr<LoadedPackage> LoadHeader(const Chunk& chunk,
+                                                   const LoadedIdmap* loaded_idmap, bool system,
+                                                   bool load_as_shared_library);
+
+  // A slot in the open-addressing table that maps a (type, entry name) pair to an entry index.
+  // This has the same layout as the name index stored in a resources index.
+  using NameIndexSlot = ResourcesIndex_nameSlot;
+
+  // Populates name_index_storage_. Called at most once, unless the name index was loaded from a
+  // resources index.
+  void BuildNameIndex() const;
+
+  // Returns true if `name_index`, loaded from a resources index, can be probed safely: its size is
+  // a power of two, it has an empty slot, and every occupied slot refers to an existing type,
+  // entry and key.
+  bool VerifyNameIndex(const NameIndexSlot* name_index, size_t size) const;
+
+  // Returns the name index, building it if necessary. The size is always a power of two.
+  const NameIndexSlot* GetNameIndex(size_t* out_size) const;
+
+  // Returns true if the string at `key_index` in key_string_pool_ equals the given name.
+  bool KeyEquals(uint32_t key_index, const std::string& name8, const std::u16string& name16) const;
+
   ResStringPool type_string_pool_;
   ResStringPool key_string_pool_;
   std::string package_name_;
@@ -183,6 +222,13 @@ class LoadedPackage {
 
   ByteBucketArray<TypeSpecPtr> type_specs_;
   std::vector<DynamicPackageEntry> dynamic_package_map_;
+
+  // The name index, either built lazily into name_index_storage_ or pointing into a mmapped
+  // resources index.
+  mutable std::once_flag name_index_once_;
+  mutable std::vector<NameIndexSlot> name_index_storage_;
+  mutable const NameIndexSlot* name_index_ = nullptr;
+  mutable size_t name_index_size_ = 0u;
 };
 
 // Read-only view into a resource table. This class validates all data
@@ -195,10 +241,13 @@ class LoadedArsc {
   // If `load_as_shared_library` is set to true, the application package (0x7f) is treated
   // as a shared library (0x00). When loaded into an AssetManager, the package will be assigned an
   // ID.
+  // If `index` is set, the table is loaded from the chunk offsets it records instead of walking
+  // the chunks. The caller must have checked that the index was generated for `data`.
   static std::unique_ptr<const LoadedArsc> Load(const StringPiece& data,
                                                 const LoadedIdmap* loaded_idmap = nullptr,
                                                 bool system = false,
-                                                bool load_as_shared_library = false);
+                                                bool load_as_shared_library = false,
+                                                const ResourcesIndex* index = nullptr);
 
   // Create an empty LoadedArsc. This is used when an APK has no resources.arsc.
   static std::unique_ptr<const LoadedArsc> CreateEmpty();
@@ -228,6 +277,8 @@ class LoadedArsc {
 
   LoadedArsc() = default;
   bool LoadTable(const Chunk& chunk, const LoadedIdmap* loaded_idmap, bool load_as_shared_library);
+  bool LoadFromIndex(const StringPiece& data, const ResourcesIndex& index,
+                     bool load_as_shared_library);
 
   ResStringPool global_string_pool_;
   std::vector<std::unique_ptr<const LoadedPackage>> packages_;
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RESOURCESINDEX_H_
+#define RESOURCESINDEX_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "android-base/macros.h"
+
+#include "androidfw/StringPiece.h"
+
+namespace android {
+
+// A resources index is a sidecar file generated once per APK, much like an IDMAP. It records
+// where every chunk of the APK's resources.arsc lives, along with the precomputed entry name
+// index of each package. The file is mmapped read-only, so its pages are shared between processes.
+//
+// LoadedArsc still validates every chunk the index points to, and the name indices too, so
+// loading the table costs about as much as walking it. What the index saves is building the name
+// index of a package on its first lookup by name, which scans every entry of every type and
+// hashes its name, along with the private memory that index takes in each process. See
+// BM_AssetManagerLoadFrameworkAssetsWithIndexAndGetResourceId.
+//
+// All structures are 4-byte aligned and stored in device byte order, except for the name index
+// slots, which are used in place and so are stored in host byte order. An index is always generated
+// on the host that uses it. All offsets are relative to the start of resources.arsc.
+
+struct alignas(uint32_t) ResourcesIndex_header {
+  // Always 0x58444952 ('RIDX')
+  uint32_t magic;
+
+  uint32_t version;
+
+  // The CRC32 and size of the resources.arsc this index was generated for. An index is only used
+  // when both match.
+  uint32_t arsc_crc32;
+  uint32_t arsc_size;
+
+  // The offset of the global string pool, or 0 if the table has none.
+  uint32_t global_strings_offset;
+
+  uint32_t package_count;
+
+  // Followed by `package_count` ResourcesIndex_package records.
+};
+
+struct alignas(uint32_t) ResourcesIndex_package {
+  // The size of this record, including the type spec records and name index that follow it.
+  uint32_t size;
+
+  uint32_t package_offset;
+  uint32_t type_strings_offset;
+  uint32_t key_strings_offset;
+
+  // The offset of the RES_TABLE_LIBRARY_TYPE chunk, or 0 if the package has none.
+  uint32_t library_offset;
+
+  uint32_t type_spec_count;
+  uint32_t name_index_count;
+
+  // Followed by `type_spec_count` ResourcesIndex_typeSpec records, and then by
+  // `name_index_count` ResourcesIndex_nameSlot records.
+};
+
+struct alignas(uint32_t) ResourcesIndex_typeSpec {
+  uint32_t type_spec_offset;
+  uint32_t type_count;
+
+  // The offsets of the RES_TABLE_TYPE_TYPE chunks of this type, in the order they appear in the
+  // table.
+  uint32_t type_offsets[0];
+};
+
+// A slot of the open-addressing table that maps a (type, entry name) pair to an entry index.
+// See LoadedPackage::FindEntryByName().
+struct alignas(uint32_t) ResourcesIndex_nameSlot {
+  // Hash of the type index and the UTF-8 entry name.
+  uint32_t hash;
+
+  // Index of the entry name in the package's key string pool.
+  uint32_t key_index;
+
+  uint16_t entry_index;
+  uint8_t type_index;
+  uint8_t occupied;
+};
+
+// Represents a loaded resources index. The data must outlive this object.
+class ResourcesIndex {
+ public:
+  constexpr static uint32_t kMagic = 0x58444952u;
+  constexpr static uint32_t kVersion = 1u;
+
+  // Loads a resources index from memory. Only the structure of the index is validated here.
+  // Returns nullptr if the index is malformed.
+  static std::unique_ptr<const ResourcesIndex> Load(const StringPiece& index_data);
+
+  // Generates the index for `arsc_data`, whose CRC32 is `arsc_crc32`, into `out_index`.
+  // The table is fully loaded and validated first. Returns false if it is malformed.
+  static bool Create(const StringPiece& arsc_data, uint32_t arsc_crc32, std::string* out_index);
+
+  // Returns true if this index was generated for a resources.arsc with the given CRC32 and size.
+  bool Matches(uint32_t arsc_crc32, size_t arsc_size) const;
+
+  uint32_t GetGlobalStringsOffset() const;
+
+  inline const std::vector<const ResourcesIndex_package*>& GetPackages() const {
+    return packages_;
+  }
+
+  // Returns the type spec records that follow `package`, in order.
+  static std::vector<const ResourcesIndex_typeSpec*> GetTypeSpecs(
+      const ResourcesIndex_package* package);
+
+  // Returns the name index that follows the type spec records of `package`.
+  static const ResourcesIndex_nameSlot* GetNameIndex(const ResourcesIndex_package* package);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ResourcesIndex);
+
+  explicit ResourcesIndex(const ResourcesIndex_header* header) : header_(header) {
+  }
+
+  const ResourcesIndex_header* header_;
+  std::vector<const ResourcesIndex_package*> packages_;
+};
+
+}  // namespace android
+
+#endif  // RESOURCESINDEX_H_
@@ -16,9 +16,13 @@
 
 #include "androidfw/ApkAssets.h"
 
+#include <functional>
+
 #include "android-base/file.h"
 #include "android-base/test_utils.h"
 #include "android-base/unique_fd.h"
+#include "androidfw/ResourceUtils.h"
+#include "androidfw/ResourcesIndex.h"
 #include "androidfw/Util.h"
 
 #include "TestHelpers.h"
@@ -28,6 +32,7 @@ using ::android::base::unique_fd;
 using ::com::android::basic::R;
 using ::testing::Eq;
 using ::testing::Ge;
+using ::testing::Gt;
 using ::testing::NotNull;
 using ::testing::SizeIs;
 using ::testing::StrEq;
@@ -112,6 +117,169 @@ TEST(ApkAssetsTest, LoadApkWithIdmap) {
   ASSERT_THAT(ApkAssets::LoadOverlay(tf.path), NotNull());
 }
 
+TEST(ApkAssetsTest, LoadApkWithIndex) {
+  const std::string path = GetTestDataPath() + "/basic/basic.apk";
+  TemporaryFile tf;
+  close(tf.fd);
+
+  // Open something so that the destructor of TemporaryFile closes a valid fd.
+  tf.fd = open("/dev/null", O_WRONLY);
+
+  ASSERT_TRUE(ApkAssets::CreateIndex(path, tf.path));
+
+  std::unique_ptr<const ApkAssets> loaded_apk = ApkAssets::LoadWithIndex(path, tf.path);
+  ASSERT_THAT(loaded_apk, NotNull());
+
+  const LoadedArsc* loaded_arsc = loaded_apk->GetLoadedArsc();
+  ASSERT_THAT(loaded_arsc, NotNull());
+
+  const LoadedPackage* package = loaded_arsc->GetPackageById(0x7fu);
+  ASSERT_THAT(package, NotNull());
+  EXPECT_THAT(package->FindEntryByName(u"layout", u"main"),
+              Eq(R::layout::main & 0x00ffffffu));
+  EXPECT_THAT(package->FindEntryByName(u"integer", u"number1"),
+              Eq(R::integer::number1 & 0x00ffffffu));
+  EXPECT_THAT(package->FindEntryByName(u"layout", u"does_not_exist"), Eq(0u));
+
+  // The entries are the same as when the table is walked.
+  std::unique_ptr<const ApkAssets> walked_apk = ApkAssets::Load(path);
+  ASSERT_THAT(walked_apk, NotNull());
+  const LoadedPackage* walked_package = walked_apk->GetLoadedArsc()->GetPackageById(0x7fu);
+  ASSERT_THAT(walked_package, NotNull());
+
+  const uint8_t type_index = get_type_id(R::string::test1) - 1;
+  const uint16_t entry_index = get_entry_id(R::string::test1);
+  const TypeSpec* type_spec = package->GetTypeSpecByTypeIndex(type_index);
+  const TypeSpec* walked_type_spec = walked_package->GetTypeSpecByTypeIndex(type_index);
+  ASSERT_THAT(type_spec, NotNull());
+  ASSERT_THAT(walked_type_spec, NotNull());
+  ASSERT_THAT(type_spec->type_count, Eq(walked_type_spec->type_count));
+  for (size_t i = 0; i < type_spec->type_count; i++) {
+    EXPECT_THAT(dtohl(type_spec->types[i]->header.size),
+                Eq(dtohl(walked_type_spec->types[i]->header.size)));
+    EXPECT_THAT(LoadedPackage::GetEntry(type_spec->types[i], entry_index) != nullptr,
+                Eq(LoadedPackage::GetEntry(walked_type_spec->types[i], entry_index) != nullptr));
+  }
+}
+
+TEST(ApkAssetsTest, LoadApkIgnoresIndexOfOtherApk) {
+  TemporaryFile tf;
+  close(tf.fd);
+
+  // Open something so that the destructor of TemporaryFile closes a valid fd.
+  tf.fd = open("/dev/null", O_WRONLY);
+
+  ASSERT_TRUE(ApkAssets::CreateIndex(GetTestDataPath() + "/styles/styles.apk", tf.path));
+
+  // The index doesn't match this APK's resources.arsc, so the table is walked instead.
+  std::unique_ptr<const ApkAssets> loaded_apk =
+      ApkAssets::LoadWithIndex(GetTestDataPath() + "/basic/basic.apk", tf.path);
+  ASSERT_THAT(loaded_apk, NotNull());
+
+  const LoadedPackage* package = loaded_apk->GetLoadedArsc()->GetPackageById(0x7fu);
+  ASSERT_THAT(package, NotNull());
+  EXPECT_THAT(package->FindEntryByName(u"layout", u"main"),
+              Eq(R::layout::main & 0x00ffffffu));
+
+  // A missing index is not an error either.
+  EXPECT_THAT(ApkAssets::LoadWithIndex(GetTestDataPath() + "/basic/basic.apk",
+                                       GetTestDataPath() + "/basic/does_not_exist.idx"),
+              NotNull());
+}
+
+TEST(ApkAssetsTest, LoadApkWalksTableWhenIndexIsCorrupt) {
+  const std::string path = GetTestDataPath() + "/basic/basic.apk";
+  TemporaryFile tf;
+  close(tf.fd);
+
+  // Open something so that the destructor of TemporaryFile closes a valid fd.
+  tf.fd = open("/dev/null", O_WRONLY);
+
+  ASSERT_TRUE(ApkAssets::CreateIndex(path, tf.path));
+
+  // Point the first type of the first type spec at the type spec chunk itself. The index still
+  // matches the APK, but the chunk it points to is not a RES_TABLE_TYPE_TYPE.
+  std::string index_data;
+  ASSERT_TRUE(base::ReadFileToString(tf.path, &index_data));
+  const size_t type_spec_offset = sizeof(ResourcesIndex_header) + sizeof(ResourcesIndex_package);
+  ASSERT_THAT(index_data.size(), Gt(type_spec_offset + sizeof(ResourcesIndex_typeSpec)));
+  ResourcesIndex_typeSpec* type_spec =
+      reinterpret_cast<ResourcesIndex_typeSpec*>(&index_data[type_spec_offset]);
+  ASSERT_THAT(dtohl(type_spec->type_count), Gt(0u));
+  type_spec->type_offsets[0] = type_spec->type_spec_offset;
+  ASSERT_TRUE(base::WriteStringToFile(index_data, tf.path));
+
+  std::unique_ptr<const ApkAssets> loaded_apk = ApkAssets::LoadWithIndex(path, tf.path);
+  ASSERT_THAT(loaded_apk, NotNull());
+
+  const LoadedPackage* package = loaded_apk->GetLoadedArsc()->GetPackageById(0x7fu);
+  ASSERT_THAT(package, NotNull());
+  EXPECT_THAT(package->FindEntryByName(u"layout", u"main"),
+              Eq(R::layout::main & 0x00ffffffu));
+
+  const TypeSpec* walked_type_spec =
+      package->GetTypeSpecByTypeIndex(get_type_id(R::string::test1) - 1);
+  ASSERT_THAT(walked_type_spec, NotNull());
+  for (size_t i = 0; i < walked_type_spec->type_count; i++) {
+    EXPECT_THAT(dtohs(walked_type_spec->types[i]->header.type), Eq(RES_TABLE_TYPE_TYPE));
+  }
+}
+
+TEST(ApkAssetsTest, LoadApkWalksTableWhenNameIndexIsCorrupt) {
+  const std::string path = GetTestDataPath() + "/basic/basic.apk";
+  TemporaryFile tf;
+  close(tf.fd);
+
+  // Open something so that the destructor of TemporaryFile closes a valid fd.
+  tf.fd = open("/dev/null", O_WRONLY);
+
+  ASSERT_TRUE(ApkAssets::CreateIndex(path, tf.path));
+
+  std::string index_data;
+  ASSERT_TRUE(base::ReadFileToString(tf.path, &index_data));
+  const ResourcesIndex_package* package_index = reinterpret_cast<const ResourcesIndex_package*>(
+      &index_data[sizeof(ResourcesIndex_header)]);
+  const size_t name_index_count = dtohl(package_index->name_index_count);
+  ASSERT_THAT(name_index_count, Gt(0u));
+
+  // The single package record ends the file, and the name index ends the package record.
+  const size_t name_index_offset =
+      index_data.size() - name_index_count * sizeof(ResourcesIndex_nameSlot);
+  auto corrupt_name_index = [&](const std::function<void(ResourcesIndex_nameSlot*)>& corrupt) {
+    std::string corrupt_data = index_data;
+    corrupt(reinterpret_cast<ResourcesIndex_nameSlot*>(&corrupt_data[name_index_offset]));
+    ASSERT_TRUE(base::WriteStringToFile(corrupt_data, tf.path));
+
+    std::unique_ptr<const ApkAssets> loaded_apk = ApkAssets::LoadWithIndex(path, tf.path);
+    ASSERT_THAT(loaded_apk, NotNull());
+
+    // The name index was rejected, so the lookups go through the one built from the table.
+    const LoadedPackage* package = loaded_apk->GetLoadedArsc()->GetPackageById(0x7fu);
+    ASSERT_THAT(package, NotNull());
+    EXPECT_THAT(package->FindEntryByName(u"layout", u"main"),
+                Eq(R::layout::main & 0x00ffffffu));
+    EXPECT_THAT(package->FindEntryByName(u"layout", u"does_not_exist"), Eq(0u));
+  };
+
+  // A full table would make the probing of a missing name loop forever.
+  corrupt_name_index([&](ResourcesIndex_nameSlot* slots) {
+    for (size_t i = 0; i < name_index_count; i++) {
+      if (!slots[i].occupied) {
+        slots[i] = slots[name_index_count - 1];
+        slots[i].occupied = 1u;
+      }
+    }
+  });
+
+  corrupt_name_index([&](ResourcesIndex_nameSlot* slots) {
+    for (size_t i = 0; i < name_index_count; i++) {
+      if (slots[i].occupied) {
+        slots[i].key_index = 0xffffffffu;
+      }
+    }
+  });
+}
+
 TEST(ApkAssetsTest, CreateAndDestroyAssetKeepsApkAssetsOpen) {
   std::unique_ptr<const ApkAssets> loaded_apk =
       ApkAssets::Load(GetTestDataPath() + "/basic/basic.apk");
@@ -17,6 +17,7 @@
 #include "benchmark/benchmark.h"
 
 #include "android-base/stringprintf.h"
+#include "android-base/test_utils.h"
 #include "androidfw/ApkAssets.h"
 #include "androidfw/AssetManager.h"
 #include "androidfw/AssetManager2.h"
@@ -68,6 +69,22 @@ static void BM_AssetManagerLoadFrameworkAssets(benchmark::State& state) {
 }
 BENCHMARK(BM_AssetManagerLoadFrameworkAssets);
 
+static void BM_AssetManagerLoadFrameworkAssetsWithIndex(benchmark::State& state) {
+  std::string path = kFrameworkPath;
+  TemporaryFile tf;
+  if (!ApkAssets::CreateIndex(path, tf.path)) {
+    state.SkipWithError("Failed to create resources index");
+    return;
+  }
+
+  while (state.KeepRunning()) {
+    std::unique_ptr<const ApkAssets> apk = ApkAssets::LoadWithIndex(path, tf.path);
+    AssetManager2 assets;
+    assets.SetApkAssets({apk.get()});
+  }
+}
+BENCHMARK(BM_AssetManagerLoadFrameworkAssetsWithIndex);
+
 static void BM_AssetManagerLoadFrameworkAssetsOld(benchmark::State& state) {
   String8 path(kFrameworkPath);
   while (state.KeepRunning()) {
@@ -128,6 +145,95 @@ static void BM_AssetManagerGetResourceFrameworkLocaleOld(benchmark::State& state
 }
 BENCHMARK(BM_AssetManagerGetResourceFrameworkLocaleOld);
 
+// A spread of names from framework-res. The last one is a private attribute, which is only found
+// after falling back to '^attr-private'.
+static const char* const kFrameworkResourceNames[] = {
+    "android:string/ok",
+    "android:string/cancel",
+    "android:drawable/ic_menu_close_clear_cancel",
+    "android:layout/simple_list_item_1",
+    "android:dimen/status_bar_height",
+    "android:attr/textColorPrimary",
+    "android:attr/windowActionBar",
+    "android:style/Theme_Material_Light",
+    "android:id/content",
+    "android:bool/config_enableNightMode",
+    "android:attr/preferenceFrameLayoutStyle",
+};
+
+static void BM_AssetManagerGetResourceIdFramework(benchmark::State& state) {
+  std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(kFrameworkPath);
+  if (apk == nullptr) {
+    state.SkipWithError("Failed to load assets");
+    return;
+  }
+
+  AssetManager2 assets;
+  assets.SetApkAssets({apk.get()});
+
+  std::vector<std::string> names(std::begin(kFrameworkResourceNames),
+                                 std::end(kFrameworkResourceNames));
+  while (state.KeepRunning()) {
+    for (const std::string& name : names) {
+      benchmark::DoNotOptimize(assets.GetResourceId(name));
+    }
+  }
+}
+BENCHMARK(BM_AssetManagerGetResourceIdFramework);
+
+static void BM_AssetManagerGetResourceIdFrameworkOld(benchmark::State& state) {
+  AssetManager assets;
+  if (!assets.addAssetPath(String8(kFrameworkPath), nullptr /*cookie*/, false /*appAsLib*/,
+                           true /*isSystemAssets*/)) {
+    state.SkipWithError("Failed to load assets");
+    return;
+  }
+
+  const ResTable& table = assets.getResources(true);
+
+  std::vector<String16> names;
+  for (const char* name : kFrameworkResourceNames) {
+    names.push_back(String16(name));
+  }
+
+  while (state.KeepRunning()) {
+    for (const String16& name : names) {
+      benchmark::DoNotOptimize(table.identifierForName(name.string(), name.size()));
+    }
+  }
+}
+BENCHMARK(BM_AssetManagerGetResourceIdFrameworkOld);
+
+// The first lookup by name in a freshly loaded package builds its name index, unless the index
+// was loaded from a resources index. This is what a resources index saves, since the chunks it
+// records are validated as much as when the table is walked.
+static void BM_AssetManagerLoadFrameworkAssetsAndGetResourceId(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(kFrameworkPath);
+    AssetManager2 assets;
+    assets.SetApkAssets({apk.get()});
+    benchmark::DoNotOptimize(assets.GetResourceId(kFrameworkResourceNames[0]));
+  }
+}
+BENCHMARK(BM_AssetManagerLoadFrameworkAssetsAndGetResourceId);
+
+static void BM_AssetManagerLoadFrameworkAssetsWithIndexAndGetResourceId(
+    benchmark::State& state) {
+  TemporaryFile tf;
+  if (!ApkAssets::CreateIndex(kFrameworkPath, tf.path)) {
+    state.SkipWithError("Failed to create resources index");
+    return;
+  }
+
+  while (state.KeepRunning()) {
+    std::unique_ptr<const ApkAssets> apk = ApkAssets::LoadWithIndex(kFrameworkPath, tf.path);
+    AssetManager2 assets;
+    assets.SetApkAssets({apk.get()});
+    benchmark::DoNotOptimize(assets.GetResourceId(kFrameworkResourceNames[0]));
+  }
+}
+BENCHMARK(BM_AssetManagerLoadFrameworkAssetsWithIndexAndGetResourceId);
+
 static void BM_AssetManagerGetBag(benchmark::State& state) {
   std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(GetTestDataPath() + "/styles/styles.apk");
   if (apk == nullptr) {
@@ -151,6 +257,30 @@ static void BM_AssetManagerGetBag(benchmark::State& state) {
 }
 BENCHMARK(BM_AssetManagerGetBag);
 
+// Resolves a cached bag from several threads sharing one AssetManager2.
+static void BM_AssetManagerGetBagConcurrent(benchmark::State& state) {
+  static std::unique_ptr<const ApkAssets> apk;
+  static std::unique_ptr<AssetManager2> assets;
+  if (state.thread_index == 0) {
+    apk = ApkAssets::Load(GetTestDataPath() + "/styles/styles.apk");
+    assets = std::unique_ptr<AssetManager2>(new AssetManager2());
+    if (apk != nullptr) {
+      assets->SetApkAssets({apk.get()});
+    }
+  }
+
+  while (state.KeepRunning()) {
+    const ResolvedBag* bag = assets->GetBag(app::R::style::StyleTwo);
+    benchmark::DoNotOptimize(bag);
+  }
+
+  if (state.thread_index == 0) {
+    assets.reset();
+    apk.reset();
+  }
+}
+BENCHMARK(BM_AssetManagerGetBagConcurrent)->ThreadRange(1, 8)->UseRealTime();
+
 static void BM_AssetManagerGetBagOld(benchmark::State& state) {
   AssetManager assets;
   if (!assets.addAssetPath(String8((GetTestDataPath() + "/styles/styles.apk").data()),
@@ -17,6 +17,8 @@
 #include "androidfw/AssetManager2.h"
 #include "androidfw/AssetManager.h"
 
+#include <thread>
+
 #include "android-base/logging.h"
 
 #include "TestHelpers.h"
@@ -145,6 +147,56 @@ TEST_F(AssetManager2Test, FindsResourceFromMultipleApkAssets) {
   EXPECT_EQ(Res_value::TYPE_STRING, value.dataType);
 }
 
+TEST_F(AssetManager2Test, CachesResolvedEntriesForCurrentConfiguration) {
+  ResTable_config desired_config;
+  memset(&desired_config, 0, sizeof(desired_config));
+  desired_config.language[0] = 'd';
+  desired_config.language[1] = 'e';
+
+  AssetManager2 assetmanager;
+  assetmanager.SetConfiguration(desired_config);
+  assetmanager.SetApkAssets({basic_assets_.get(), basic_de_fr_assets_.get()});
+
+  Res_value value;
+  ResTable_config selected_config;
+  uint32_t flags;
+
+  ApkAssetsCookie cookie =
+      assetmanager.GetResource(basic::R::string::test1, false /*may_be_bag*/,
+                               0 /*density_override*/, &value, &selected_config, &flags);
+  ASSERT_EQ(1, cookie);
+  EXPECT_EQ(0u, assetmanager.GetEntryCacheHits());
+  EXPECT_EQ(1u, assetmanager.GetEntryCacheMisses());
+
+  cookie = assetmanager.GetResource(basic::R::string::test1, false /*may_be_bag*/,
+                                    0 /*density_override*/, &value, &selected_config, &flags);
+  ASSERT_EQ(1, cookie);
+  EXPECT_EQ('d', selected_config.language[0]);
+  EXPECT_EQ('e', selected_config.language[1]);
+  EXPECT_EQ(1u, assetmanager.GetEntryCacheHits());
+  EXPECT_EQ(1u, assetmanager.GetEntryCacheMisses());
+
+  // Density overrides bypass the cache.
+  cookie = assetmanager.GetResource(basic::R::string::test1, false /*may_be_bag*/,
+                                    ACONFIGURATION_DENSITY_HIGH, &value, &selected_config, &flags);
+  ASSERT_EQ(1, cookie);
+  EXPECT_EQ(1u, assetmanager.GetEntryCacheHits());
+  EXPECT_EQ(1u, assetmanager.GetEntryCacheMisses());
+
+  // Changing the locale must purge the cached entry, since the string varies by locale.
+  desired_config.language[0] = 'f';
+  desired_config.language[1] = 'r';
+  assetmanager.SetConfiguration(desired_config);
+
+  cookie = assetmanager.GetResource(basic::R::string::test1, false /*may_be_bag*/,
+                                    0 /*density_override*/, &value, &selected_config, &flags);
+  ASSERT_EQ(1, cookie);
+  EXPECT_EQ('f', selected_config.language[0]);
+  EXPECT_EQ('r', selected_config.language[1]);
+  EXPECT_EQ(1u, assetmanager.GetEntryCacheHits());
+  EXPECT_EQ(2u, assetmanager.GetEntryCacheMisses());
+}
+
 TEST_F(AssetManager2Test, FindsResourceFromSharedLibrary) {
   AssetManager2 assetmanager;
 
@@ -340,6 +392,43 @@ TEST_F(AssetManager2Test, MergeStylesCircularDependency) {
   ASSERT_EQ(3u, bag_one->entry_count);
 }
 
+TEST_F(AssetManager2Test, ResolvesBagsConcurrently) {
+  AssetManager2 assetmanager;
+  assetmanager.SetApkAssets({style_assets_.get()});
+
+  const uint32_t kStyles[] = {app::R::style::StyleOne, app::R::style::StyleTwo,
+                              app::R::style::StyleThree, app::R::style::StyleFour};
+  constexpr size_t kStyleCount = sizeof(kStyles) / sizeof(kStyles[0]);
+  constexpr size_t kThreadCount = 8;
+
+  // Every thread races to resolve the same bags, starting at a different style.
+  std::vector<std::array<const ResolvedBag*, kStyleCount>> results(kThreadCount);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreadCount; t++) {
+    threads.emplace_back([&, t]() {
+      for (int iteration = 0; iteration < 1000; iteration++) {
+        for (size_t i = 0; i < kStyleCount; i++) {
+          const size_t style_idx = (i + t) % kStyleCount;
+          results[t][style_idx] = assetmanager.GetBag(kStyles[style_idx]);
+        }
+      }
+    });
+  }
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  // Each bag was resolved exactly once, so every thread got the same pointer.
+  for (size_t i = 0; i < kStyleCount; i++) {
+    const ResolvedBag* bag = assetmanager.GetBag(kStyles[i]);
+    ASSERT_NE(nullptr, bag);
+    for (size_t t = 0; t < kThreadCount; t++) {
+      EXPECT_EQ(bag, results[t][i]);
+    }
+  }
+}
+
 TEST_F(AssetManager2Test, ResolveReferenceToResource) {
   AssetManager2 assetmanager;
   assetmanager.SetApkAssets({basic_assets_.get()});
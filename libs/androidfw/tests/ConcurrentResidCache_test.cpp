@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "androidfw/ConcurrentResidCache.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace android {
+
+TEST(ConcurrentResidCacheTest, FindsInsertedValues) {
+  ConcurrentResidCache<int> cache;
+  EXPECT_EQ(nullptr, cache.Find(0x7f010000u));
+
+  const int* value = cache.Insert(0x7f010000u, std::unique_ptr<int>(new int(1)));
+  ASSERT_NE(nullptr, value);
+  EXPECT_EQ(1, *value);
+  EXPECT_EQ(value, cache.Find(0x7f010000u));
+  EXPECT_EQ(nullptr, cache.Find(0x7f010001u));
+}
+
+TEST(ConcurrentResidCacheTest, KeepsFirstInsertedValue) {
+  ConcurrentResidCache<int> cache;
+  const int* first = cache.Insert(0x7f010000u, std::unique_ptr<int>(new int(1)));
+  const int* second = cache.Insert(0x7f010000u, std::unique_ptr<int>(new int(2)));
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(1, *cache.Find(0x7f010000u));
+}
+
+TEST(ConcurrentResidCacheTest, ValuesSurviveGrowth) {
+  ConcurrentResidCache<int> cache;
+  std::vector<const int*> values;
+  for (int i = 0; i < 1000; i++) {
+    values.push_back(cache.Insert(0x7f010000u + i, std::unique_ptr<int>(new int(i))));
+  }
+
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(values[i], cache.Find(0x7f010000u + i));
+    EXPECT_EQ(i, *values[i]);
+  }
+}
+
+TEST(ConcurrentResidCacheTest, EraseIfAndClear) {
+  ConcurrentResidCache<int> cache;
+  for (int i = 0; i < 100; i++) {
+    cache.Insert(0x7f010000u + i, std::unique_ptr<int>(new int(i)));
+  }
+
+  cache.EraseIf([](uint32_t /*resid*/, const int& value) -> bool { return value % 2 == 0; });
+  for (int i = 0; i < 100; i++) {
+    const int* value = cache.Find(0x7f010000u + i);
+    if (i % 2 == 0) {
+      EXPECT_EQ(nullptr, value);
+    } else {
+      ASSERT_NE(nullptr, value);
+      EXPECT_EQ(i, *value);
+    }
+  }
+
+  cache.Clear();
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(nullptr, cache.Find(0x7f010000u + i));
+  }
+}
+
+TEST(ConcurrentResidCacheTest, ConcurrentInsertsAndFinds) {
+  constexpr int kThreadCount = 8;
+  constexpr int kResidCount = 4096;
+
+  ConcurrentResidCache<int> cache;
+  std::atomic<int> failures(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreadCount; t++) {
+    threads.emplace_back([&, t]() {
+      // Each thread inserts every resid, starting at a different offset, so that inserts race
+      // with each other and with lookups while the table grows.
+      for (int i = 0; i < kResidCount; i++) {
+        const uint32_t resid = 0x7f010000u + ((i + t * 512) % kResidCount);
+        const int* value = cache.Insert(resid, std::unique_ptr<int>(new int(resid)));
+        if (value == nullptr || *value != static_cast<int>(resid) || cache.Find(resid) != value) {
+          failures++;
+        }
+      }
+    });
+  }
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(0, failures.load());
+  for (int i = 0; i < kResidCount; i++) {
+    const int* value = cache.Find(0x7f010000u + i);
+    ASSERT_NE(nullptr, value);
+    EXPECT_EQ(static_cast<int>(0x7f010000u + i), *value);
+  }
+}
+
+}  // namespace android
@@ -90,6 +90,49 @@ TEST(LoadedArscTest, LoadSparseEntryApp) {
   ASSERT_THAT(LoadedPackage::GetEntry(type, entry_index), NotNull());
 }
 
+TEST(LoadedArscTest, FindEntryByName) {
+  std::string contents;
+  ASSERT_TRUE(ReadFileFromZipToString(GetTestDataPath() + "/basic/basic.apk", "resources.arsc",
+                                      &contents));
+
+  std::unique_ptr<const LoadedArsc> loaded_arsc = LoadedArsc::Load(StringPiece(contents));
+  ASSERT_THAT(loaded_arsc, NotNull());
+
+  const LoadedPackage* package =
+      loaded_arsc->GetPackageById(get_package_id(basic::R::layout::main));
+  ASSERT_THAT(package, NotNull());
+
+  EXPECT_THAT(package->FindEntryByName(u"layout", u"main"),
+              Eq(fix_package_id(basic::R::layout::main, 0)));
+  EXPECT_THAT(package->FindEntryByName(u"integer", u"number1"),
+              Eq(fix_package_id(basic::R::integer::number1, 0)));
+
+  // Repeated lookups go through the same index.
+  EXPECT_THAT(package->FindEntryByName(u"layout", u"main"),
+              Eq(fix_package_id(basic::R::layout::main, 0)));
+
+  // The name exists, but not under this type.
+  EXPECT_THAT(package->FindEntryByName(u"string", u"main"), Eq(0u));
+  EXPECT_THAT(package->FindEntryByName(u"layout", u"does_not_exist"), Eq(0u));
+  EXPECT_THAT(package->FindEntryByName(u"no_such_type", u"main"), Eq(0u));
+}
+
+TEST(LoadedArscTest, FindSparseEntryByName) {
+  std::string contents;
+  ASSERT_TRUE(ReadFileFromZipToString(GetTestDataPath() + "/sparse/sparse.apk", "resources.arsc",
+                                      &contents));
+
+  std::unique_ptr<const LoadedArsc> loaded_arsc = LoadedArsc::Load(StringPiece(contents));
+  ASSERT_THAT(loaded_arsc, NotNull());
+
+  const LoadedPackage* package =
+      loaded_arsc->GetPackageById(get_package_id(sparse::R::string::foo_999));
+  ASSERT_THAT(package, NotNull());
+
+  EXPECT_THAT(package->FindEntryByName(u"string", u"foo_999"),
+              Eq(fix_package_id(sparse::R::string::foo_999, 0)));
+}
+
 TEST(LoadedArscTest, LoadSharedLibrary) {
   std::string contents;
   ASSERT_TRUE(ReadFileFromZipToString(GetTestDataPath() + "/lib_one/lib_one.apk", "resources.arsc",
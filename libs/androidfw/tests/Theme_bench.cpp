@@ -61,6 +61,45 @@ static void BM_ThemeApplyStyleFrameworkOld(benchmark::State& state) {
 }
 BENCHMARK(BM_ThemeApplyStyleFrameworkOld);
 
+static void BM_ThemeSetToFramework(benchmark::State& state) {
+  std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(kFrameworkPath);
+  if (apk == nullptr) {
+    state.SkipWithError("Failed to load assets");
+    return;
+  }
+
+  AssetManager2 assets;
+  assets.SetApkAssets({apk.get()});
+
+  auto theme = assets.NewTheme();
+  theme->ApplyStyle(kStyleId, false /* force */);
+
+  while (state.KeepRunning()) {
+    auto copy = assets.NewTheme();
+    copy->SetTo(*theme);
+  }
+}
+BENCHMARK(BM_ThemeSetToFramework);
+
+static void BM_ThemeSetToFrameworkOld(benchmark::State& state) {
+  AssetManager assets;
+  if (!assets.addAssetPath(String8(kFrameworkPath), nullptr /* cookie */, false /* appAsLib */,
+                           true /* isSystemAsset */)) {
+    state.SkipWithError("Failed to load assets");
+    return;
+  }
+
+  const ResTable& res_table = assets.getResources(true);
+  std::unique_ptr<ResTable::Theme> theme{new ResTable::Theme(res_table)};
+  theme->applyStyle(kStyleId, false /* force */);
+
+  while (state.KeepRunning()) {
+    std::unique_ptr<ResTable::Theme> copy{new ResTable::Theme(res_table)};
+    copy->setTo(*theme);
+  }
+}
+BENCHMARK(BM_ThemeSetToFrameworkOld);
+
 static void BM_ThemeGetAttribute(benchmark::State& state) {
   std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(kFrameworkPath);
 
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <android-base/file.h>
+#include <android/util/ProtoOutputStream.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string>
+#include <unistd.h>
+#include "benchmark/benchmark.h"
+
+namespace android {
+namespace util {
+
+// Returns the number of write syscalls of the process, writev included, or -1.
+static int64_t writeSyscalls() {
+    std::string io;
+    if (!android::base::ReadFileToString("/proc/self/io", &io)) return -1;
+    size_t pos = io.find("syscw: ");
+    return pos == std::string::npos ? -1 : atoll(io.c_str() + pos + 7);
+}
+
+// Flushes a proto of the given size to /dev/null, either with ProtoOutputStream::flush, or a
+// write per chunk of the buffer as the flush used to.
+static void BM_Flush(benchmark::State& state) {
+    const bool writev = state.range(0);
+    ProtoOutputStream proto;
+    proto.write(FIELD_TYPE_STRING | 1, std::string(state.range(1) * 1024, 'x'));
+    proto.size();  // compact it beforehand.
+    int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+    int errors = 0;
+    int64_t startSyscalls = writeSyscalls();
+    while (state.KeepRunning()) {
+        if (writev) {
+            errors += !proto.flush(fd);
+            continue;
+        }
+        EncodedBuffer::iterator it = proto.data();
+        while (it.readBuffer() != NULL) {
+            errors += !android::base::WriteFully(fd, it.readBuffer(), it.currentToRead());
+            it.rp()->move(it.currentToRead());
+        }
+    }
+    int64_t syscalls = writeSyscalls() - startSyscalls;
+    close(fd);
+    state.SetLabel(writev ? "writev" : "write per chunk");
+    state.SetBytesProcessed(state.iterations() * proto.size());
+    state.counters["syscalls"] = (double)syscalls / state.iterations();
+    state.counters["errors"] = errors;
+}
+BENCHMARK(BM_Flush)
+        ->Args({true, 64})
+        ->Args({false, 64})
+        ->Args({true, 1024})
+        ->Args({false, 1024})
+        ->Unit(benchmark::kMicrosecond);
+
+}  //  namespace util
+}  //  namespace android
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <android/util/ProtoOutputStream.h>
+#include <android/util/ProtoReader.h>
+#include <android/util/protobuf.h>
+#include <string>
+#include "benchmark/benchmark.h"
+
+namespace android {
+namespace util {
+
+// Entries like the ones of a log section: a few varints and two strings each.
+static void writeEntries(size_t bytes, ProtoOutputStream* proto) {
+    for (int i = 0; proto->bytesWritten() < bytes; i++) {
+        uint64_t token = proto->start(FIELD_TYPE_MESSAGE | 1);
+        proto->write(FIELD_TYPE_INT64 | 1, 1536000000000LL + i);
+        proto->write(FIELD_TYPE_INT32 | 2, 1000 + i % 50);
+        proto->write(FIELD_TYPE_INT32 | 3, 1234 + i % 50);
+        proto->write(FIELD_TYPE_STRING | 4, std::string("ActivityManager"));
+        proto->write(FIELD_TYPE_STRING | 5,
+                     "Start proc " + std::to_string(i) + ":com.example.app/u0a42 for service");
+        proto->end(token);
+    }
+}
+
+// Skips the value of a field, or adds it to sum.
+static void readValue(uint32_t fieldTag, EncodedBuffer::iterator* it, uint64_t* sum) {
+    switch (read_wire_type(fieldTag)) {
+        case WIRE_TYPE_VARINT:
+            *sum += it->readRawVarint();
+            break;
+        case WIRE_TYPE_FIXED64:
+            it->rp()->move(8);
+            break;
+        case WIRE_TYPE_LENGTH_DELIMITED: {
+            size_t size = it->readRawVarint();
+            *sum += size;
+            it->rp()->move(size);
+            break;
+        }
+        case WIRE_TYPE_FIXED32:
+            it->rp()->move(4);
+            break;
+    }
+}
+
+// Decodes the entries with EncodedBuffer::iterator, the way the consumers of the data do.
+static void BM_DecodeWithIterator(benchmark::State& state) {
+    ProtoOutputStream proto;
+    writeEntries(state.range(0) * 1024 * 1024, &proto);
+    EncodedBuffer::iterator data = proto.data();
+
+    uint64_t sum = 0;
+    while (state.KeepRunning()) {
+        EncodedBuffer::iterator it = data;
+        while (it.hasNext()) {
+            uint32_t fieldTag = it.readRawVarint();
+            if (read_wire_type(fieldTag) != WIRE_TYPE_LENGTH_DELIMITED) {
+                readValue(fieldTag, &it, &sum);
+                continue;
+            }
+            size_t size = it.readRawVarint();
+            size_t end = it.rp()->pos() + size;
+            while (it.rp()->pos() < end) {
+                readValue(it.readRawVarint(), &it, &sum);
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_DecodeWithIterator)->Arg(1)->Arg(4)->Unit(benchmark::kMicrosecond);
+
+static void BM_DecodeWithProtoReader(benchmark::State& state) {
+    ProtoOutputStream proto;
+    writeEntries(state.range(0) * 1024 * 1024, &proto);
+    EncodedBuffer::iterator data = proto.data();
+
+    uint64_t sum = 0;
+    while (state.KeepRunning()) {
+        ProtoReader reader(data);
+        while (reader.next()) {
+            uint64_t token = reader.start();
+            while (reader.next()) {
+                sum += reader.wireType() == WIRE_TYPE_VARINT ? reader.readVarint()
+                                                              : reader.length();
+            }
+            reader.end(token);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_DecodeWithProtoReader)->Arg(1)->Arg(4)->Unit(benchmark::kMicrosecond);
+
+}  //  namespace util
+}  //  namespace android
@@ -39,6 +39,10 @@ class EncodedBuffer
 public:
     EncodedBuffer();
     EncodedBuffer(size_t chunkSize);
+    /**
+     * Takes the chunks of the other buffer, which is left empty.
+     */
+    EncodedBuffer(EncodedBuffer&& other);
     ~EncodedBuffer();
 
     class Pointer {
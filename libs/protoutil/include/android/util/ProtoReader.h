@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UTIL_PROTO_READER_H
+#define ANDROID_UTIL_PROTO_READER_H
+
+#include <android/util/EncodedBuffer.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace util {
+
+/**
+ * Class to read the fields of protobuf encoded data without copying it.
+ *
+ * The data is either the chunks of an EncodedBuffer, or a single span of memory such as a
+ * mmapped file, and must outlive the reader. next() moves to the next field, then its value is
+ * read with the function of its wire type. A length delimited field is either read as bytes, one
+ * contiguous span at a time, or read as a message: start() returns a token, next() returns the
+ * fields of the message until its end, and end(token) goes back to the parent message, the same
+ * way messages are written with ProtoOutputStream. What isn't read of a field is skipped.
+ *
+ * Reading stops at malformed data, e.g. a truncated field or a message longer than its parent:
+ * next() returns false, and hasError() returns true.
+ */
+class ProtoReader
+{
+public:
+    /**
+     * Reads the data of the iterator, from its read pointer to the end.
+     */
+    ProtoReader(EncodedBuffer::iterator data);
+    ProtoReader(const uint8_t* data, size_t size);
+    ~ProtoReader();
+
+    /**
+     * Moves to the next field of the current message. Returns false at the end of the message,
+     * or if the data is malformed.
+     */
+    bool next();
+
+    uint32_t fieldId() const;
+    uint8_t wireType() const;
+
+    /**
+     * Returns the value of the current field, which must have the matching wire type.
+     */
+    uint64_t readVarint() const;
+    uint32_t readFixed32() const;
+    uint64_t readFixed64() const;
+
+    /**
+     * Returns the size of the current length delimited field.
+     */
+    size_t length() const;
+
+    /**
+     * Returns the next contiguous span of the bytes of the current length delimited field, and
+     * its size in size. Returns NULL once all the bytes are read.
+     */
+    const uint8_t* readBytes(size_t* size);
+
+    /**
+     * Returns the bytes of the current length delimited field that haven't been read, copied.
+     */
+    std::string readString();
+
+    /**
+     * Starts reading the current length delimited field as a message.
+     * Returns a token to pass to end(token) once done with the message.
+     */
+    uint64_t start();
+    void end(uint64_t token);
+
+    /**
+     * Returns true if the data is malformed.
+     */
+    bool hasError() const;
+
+    /**
+     * Returns the number of bytes read, or skipped.
+     */
+    size_t bytesRead() const;
+
+private:
+    struct Span {
+        const uint8_t* data;
+        size_t size;
+    };
+
+    std::vector<Span> mSpans;
+    size_t mSpan;   // The index of the span of the read position.
+    size_t mOffset; // The read position in the span.
+    size_t mPos;    // The read position in the whole data.
+    size_t mLimit;  // The end of the message being read.
+
+    uint32_t mFieldTag;
+    uint64_t mValue;
+    size_t mRemaining; // The bytes of the current length delimited field left to read.
+    bool mError;
+
+    void init();
+    void skip(size_t amt);
+    bool readRawByte(uint8_t* byte);
+    bool readRawVarint(uint64_t* val);
+    bool readRawFixed(size_t size, uint64_t* val);
+};
+
+} // util
+} // android
+
+#endif // ANDROID_UTIL_PROTO_READER_H
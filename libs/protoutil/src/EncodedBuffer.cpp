@@ -16,6 +16,9 @@
 #define LOG_TAG "libprotoutil"
 
 #include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include <android/util/EncodedBuffer.h>
 #include <android/util/protobuf.h>
@@ -94,6 +97,17 @@ EncodedBuffer::EncodedBuffer(size_t chunkSize)
     mEp = Pointer(mChunkSize);
 }
 
+EncodedBuffer::EncodedBuffer(EncodedBuffer&& other)
+        :mChunkSize(other.mChunkSize),
+         mBuffers(std::move(other.mBuffers)),
+         mWp(other.mWp),
+         mEp(other.mEp)
+{
+    other.mBuffers.clear();
+    other.mWp.rewind();
+    other.mEp.rewind();
+}
+
 EncodedBuffer::~EncodedBuffer()
 {
     for (size_t i=0; i<mBuffers.size(); i++) {
@@ -276,9 +290,16 @@ EncodedBuffer::copy(size_t srcPos, size_t size)
     Pointer cp(mChunkSize);
     cp.move(srcPos);
 
-    while (cp.pos() < srcPos + size) {
-        writeRawByte(*at(cp));
-        cp.move();
+    // Copies as many bytes at a time as both the source and the destination chunks have. The
+    // data is only ever copied backward, so the bytes are read before they are overwritten.
+    while (size > 0) {
+        uint8_t* buf = writeBuffer();
+        if (buf == NULL) return;
+        size_t amt = std::min(size, std::min(mChunkSize - cp.offset(), mChunkSize - mWp.offset()));
+        memmove(buf, at(cp), amt);
+        mWp.move(amt);
+        cp.move(amt);
+        size -= amt;
     }
 }
 
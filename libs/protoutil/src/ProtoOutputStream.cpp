@@ -15,7 +15,13 @@
  */
 #define LOG_TAG "libprotoutil"
 
+#include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <vector>
 
 #include <android/util/protobuf.h>
 #include <android/util/ProtoOutputStream.h>
@@ -467,30 +473,37 @@ ProtoOutputStream::size()
     return mBuffer.size();
 }
 
-static bool write_all(int fd, uint8_t const* buf, size_t size)
-{
-    while (size > 0) {
-        ssize_t amt = ::write(fd, buf, size);
-        if (amt < 0) {
-            return false;
-        }
-        size -= amt;
-        buf += amt;
-    }
-    return true;
-}
-
 bool
 ProtoOutputStream::flush(int fd)
 {
     if (fd < 0) return false;
     if (!compact()) return false;
 
+    // Writes all the chunks with one syscall, unless there are more than IOV_MAX of them or the
+    // write is partial.
+    std::vector<struct iovec> iov;
     EncodedBuffer::iterator it = mBuffer.begin();
     while (it.readBuffer() != NULL) {
-        if (!write_all(fd, it.readBuffer(), it.currentToRead())) return false;
+        iov.push_back({const_cast<uint8_t*>(it.readBuffer()), it.currentToRead()});
         it.rp()->move(it.currentToRead());
     }
+    size_t first = 0;
+    while (first < iov.size()) {
+        ssize_t amt = ::writev(fd, &iov[first], std::min(iov.size() - first, (size_t)IOV_MAX));
+        if (amt < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        // Moves past what was written.
+        while (first < iov.size() && (size_t)amt >= iov[first].iov_len) {
+            amt -= iov[first].iov_len;
+            first++;
+        }
+        if (amt > 0) {
+            iov[first].iov_base = (uint8_t*)iov[first].iov_base + amt;
+            iov[first].iov_len -= amt;
+        }
+    }
     return true;
 }
 
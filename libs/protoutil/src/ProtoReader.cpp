@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "libprotoutil"
+
+#include <android/util/protobuf.h>
+#include <android/util/ProtoReader.h>
+
+#include <algorithm>
+
+namespace android {
+namespace util {
+
+// A varint is at most 10 bytes.
+const size_t MAX_VARINT_SIZE = 10;
+
+ProtoReader::ProtoReader(EncodedBuffer::iterator data)
+        :mSpans()
+{
+    while (data.readBuffer() != NULL) {
+        mSpans.push_back({data.readBuffer(), data.currentToRead()});
+        data.rp()->move(data.currentToRead());
+    }
+    init();
+}
+
+ProtoReader::ProtoReader(const uint8_t* data, size_t size)
+        :mSpans()
+{
+    if (size > 0) {
+        mSpans.push_back({data, size});
+    }
+    init();
+}
+
+ProtoReader::~ProtoReader()
+{
+}
+
+void
+ProtoReader::init()
+{
+    mSpan = 0;
+    mOffset = 0;
+    mPos = 0;
+    mLimit = 0;
+    for (size_t i = 0; i < mSpans.size(); i++) {
+        mLimit += mSpans[i].size;
+    }
+    mFieldTag = 0;
+    mValue = 0;
+    mRemaining = 0;
+    mError = false;
+}
+
+void
+ProtoReader::skip(size_t amt)
+{
+    mPos += amt;
+    while (amt > 0) {
+        size_t left = mSpans[mSpan].size - mOffset;
+        if (amt < left) {
+            mOffset += amt;
+            return;
+        }
+        amt -= left;
+        mSpan++;
+        mOffset = 0;
+    }
+}
+
+bool
+ProtoReader::readRawByte(uint8_t* byte)
+{
+    if (mPos >= mLimit) return false;
+    *byte = mSpans[mSpan].data[mOffset];
+    skip(1);
+    return true;
+}
+
+bool
+ProtoReader::readRawVarint(uint64_t* val)
+{
+    if (mPos >= mLimit) return false;
+
+    // The varint is usually within the current span, decode it there.
+    const uint8_t* p = mSpans[mSpan].data + mOffset;
+    size_t available = std::min(mLimit - mPos, mSpans[mSpan].size - mOffset);
+    uint64_t result = 0;
+    for (size_t i = 0; i < available && i < MAX_VARINT_SIZE; i++) {
+        result |= (uint64_t)(p[i] & 0x7F) << (7 * i);
+        if ((p[i] & 0x80) == 0) {
+            skip(i + 1);
+            *val = result;
+            return true;
+        }
+    }
+    if (available >= MAX_VARINT_SIZE) return false;
+
+    // Otherwise read it a byte at a time across the spans.
+    result = 0;
+    for (size_t i = 0; i < MAX_VARINT_SIZE; i++) {
+        uint8_t byte;
+        if (!readRawByte(&byte)) return false;
+        result |= (uint64_t)(byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            *val = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+ProtoReader::readRawFixed(size_t size, uint64_t* val)
+{
+    uint64_t result = 0;
+    for (size_t i = 0; i < size; i++) {
+        uint8_t byte;
+        if (!readRawByte(&byte)) return false;
+        result |= (uint64_t)byte << (8 * i);
+    }
+    *val = result;
+    return true;
+}
+
+bool
+ProtoReader::next()
+{
+    if (mError) return false;
+    // Skips what is left of the current field.
+    skip(mRemaining);
+    mRemaining = 0;
+    if (mPos >= mLimit) return false;
+
+    uint64_t tag;
+    bool ok = readRawVarint(&tag) && tag <= UINT32_MAX;
+    if (ok) {
+        mFieldTag = (uint32_t)tag;
+        switch (wireType()) {
+            case WIRE_TYPE_VARINT:
+                ok = readRawVarint(&mValue);
+                break;
+            case WIRE_TYPE_FIXED64:
+                ok = readRawFixed(sizeof(uint64_t), &mValue);
+                break;
+            case WIRE_TYPE_FIXED32:
+                ok = readRawFixed(sizeof(uint32_t), &mValue);
+                break;
+            case WIRE_TYPE_LENGTH_DELIMITED:
+                ok = readRawVarint(&mValue) && mValue <= mLimit - mPos;
+                if (ok) mRemaining = mValue;
+                break;
+            default:
+                ok = false; // The groups are deprecated, and not supported.
+                break;
+        }
+    }
+    if (!ok) mError = true;
+    return ok;
+}
+
+uint32_t
+ProtoReader::fieldId() const
+{
+    return read_field_id(mFieldTag);
+}
+
+uint8_t
+ProtoReader::wireType() const
+{
+    return read_wire_type(mFieldTag);
+}
+
+uint64_t
+ProtoReader::readVarint() const
+{
+    return mValue;
+}
+
+uint32_t
+ProtoReader::readFixed32() const
+{
+    return (uint32_t)mValue;
+}
+
+uint64_t
+ProtoReader::readFixed64() const
+{
+    return mValue;
+}
+
+size_t
+ProtoReader::length() const
+{
+    return wireType() == WIRE_TYPE_LENGTH_DELIMITED ? mValue : 0;
+}
+
+const uint8_t*
+ProtoReader::readBytes(size_t* size)
+{
+    if (mRemaining == 0) return NULL;
+    const uint8_t* bytes = mSpans[mSpan].data + mOffset;
+    *size = std::min(mRemaining, mSpans[mSpan].size - mOffset);
+    skip(*size);
+    mRemaining -= *size;
+    return bytes;
+}
+
+std::string
+ProtoReader::readString()
+{
+    std::string str;
+    str.reserve(mRemaining);
+    size_t size;
+    for (const uint8_t* bytes = readBytes(&size); bytes != NULL; bytes = readBytes(&size)) {
+        str.append((const char*)bytes, size);
+    }
+    return str;
+}
+
+uint64_t
+ProtoReader::start()
+{
+    uint64_t token = mLimit;
+    if (wireType() != WIRE_TYPE_LENGTH_DELIMITED) {
+        mError = true;
+        return token;
+    }
+    mLimit = mPos + mRemaining;
+    mRemaining = 0;
+    return token;
+}
+
+void
+ProtoReader::end(uint64_t token)
+{
+    // Skips the fields of the message that weren't read.
+    if (!mError) skip(mLimit - mPos);
+    mLimit = token;
+    mRemaining = 0;
+}
+
+bool
+ProtoReader::hasError() const
+{
+    return mError;
+}
+
+size_t
+ProtoReader::bytesRead() const
+{
+    return mPos;
+}
+
+} // util
+} // android
@@ -0,0 +1,45 @@
+// Copyright (C) 2018 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <android/util/ProtoOutputStream.h>
+#include <android/util/protobuf.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace android::base;
+using namespace android::util;
+
+TEST(ProtoOutputStreamTest, FlushMoreThanIovMaxChunks) {
+    // Over IOV_MAX chunks of 8KB, so that the flush takes more than one writev. The bytes differ
+    // from a chunk to the next, so that chunks written out of order, or twice, are caught.
+    std::string str(9 * 1024 * 1024, 'a');
+    for (size_t i = 0; i < str.size(); i++) {
+        str[i] += (i / 8192 + i) % 26;
+    }
+    ProtoOutputStream proto;
+    proto.write(FIELD_TYPE_STRING | 1, str);
+
+    TemporaryFile tf;
+    ASSERT_TRUE(proto.flush(tf.fd));
+    std::string content;
+    ASSERT_TRUE(ReadFileToString(tf.path, &content));
+
+    // Field 1, length delimited, then the length as a varint.
+    uint8_t header[12];
+    uint8_t* p = write_length_delimited_tag_header(header, 1, str.size());
+    std::string expected = std::string((char*)header, p - header) + str;
+    ASSERT_EQ(expected.size(), content.size());
+    EXPECT_TRUE(expected == content);
+}
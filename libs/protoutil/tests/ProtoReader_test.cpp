@@ -0,0 +1,208 @@
+// Copyright (C) 2018 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <android-base/test_utils.h>
+#include <android/util/ProtoOutputStream.h>
+#include <android/util/ProtoReader.h>
+#include <android/util/protobuf.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace android::util;
+using ::testing::StrEq;
+
+TEST(ProtoReaderTest, ReadFields) {
+    ProtoOutputStream proto;
+    proto.write(FIELD_TYPE_INT64 | 1, -1LL);
+    proto.write(FIELD_TYPE_FIXED32 | 2, 0x12345678);
+    proto.write(FIELD_TYPE_FIXED64 | 3, 0x123456789abcdefLL);
+    proto.write(FIELD_TYPE_STRING | 4, std::string("android"));
+    proto.write(FIELD_TYPE_BOOL | 5, true);
+
+    ProtoReader reader(proto.data());
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(1u, reader.fieldId());
+    EXPECT_EQ(WIRE_TYPE_VARINT, reader.wireType());
+    EXPECT_EQ(UINT64_MAX, reader.readVarint());
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(2u, reader.fieldId());
+    EXPECT_EQ(WIRE_TYPE_FIXED32, reader.wireType());
+    EXPECT_EQ(0x12345678u, reader.readFixed32());
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(3u, reader.fieldId());
+    EXPECT_EQ(WIRE_TYPE_FIXED64, reader.wireType());
+    EXPECT_EQ(0x123456789abcdefULL, reader.readFixed64());
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(4u, reader.fieldId());
+    EXPECT_EQ(WIRE_TYPE_LENGTH_DELIMITED, reader.wireType());
+    EXPECT_EQ(7u, reader.length());
+    EXPECT_THAT(reader.readString(), StrEq("android"));
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(5u, reader.fieldId());
+    EXPECT_EQ(1u, reader.readVarint());
+    EXPECT_FALSE(reader.next());
+    EXPECT_FALSE(reader.hasError());
+    EXPECT_EQ(proto.size(), reader.bytesRead());
+}
+
+TEST(ProtoReaderTest, ReadMessages) {
+    ProtoOutputStream proto;
+    uint64_t token = proto.start(FIELD_TYPE_MESSAGE | 1);
+    proto.write(FIELD_TYPE_INT32 | 1, 10);
+    uint64_t nested = proto.start(FIELD_TYPE_MESSAGE | 2);
+    proto.write(FIELD_TYPE_STRING | 1, std::string("skipped"));
+    proto.end(nested);
+    proto.write(FIELD_TYPE_INT32 | 3, 30);
+    proto.end(token);
+    proto.write(FIELD_TYPE_INT32 | 2, 20);
+
+    ProtoReader reader(proto.data());
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(1u, reader.fieldId());
+    token = reader.start();
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(10u, reader.readVarint());
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(2u, reader.fieldId());
+    // Nothing of the nested message is read, it is skipped.
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(3u, reader.fieldId());
+    EXPECT_EQ(30u, reader.readVarint());
+    EXPECT_FALSE(reader.next());
+    reader.end(token);
+
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(2u, reader.fieldId());
+    EXPECT_EQ(20u, reader.readVarint());
+    EXPECT_FALSE(reader.next());
+    EXPECT_FALSE(reader.hasError());
+}
+
+TEST(ProtoReaderTest, EndSkipsTheRestOfTheMessage) {
+    ProtoOutputStream proto;
+    uint64_t token = proto.start(FIELD_TYPE_MESSAGE | 1);
+    proto.write(FIELD_TYPE_INT32 | 1, 10);
+    proto.write(FIELD_TYPE_INT32 | 2, 20);
+    proto.end(token);
+    proto.write(FIELD_TYPE_INT32 | 2, 30);
+
+    ProtoReader reader(proto.data());
+    ASSERT_TRUE(reader.next());
+    token = reader.start();
+    ASSERT_TRUE(reader.next());
+    reader.end(token);
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(2u, reader.fieldId());
+    EXPECT_EQ(30u, reader.readVarint());
+}
+
+TEST(ProtoReaderTest, ReadBytesAcrossChunks) {
+    // Longer than a chunk of the buffer, so the field is in several spans.
+    std::string str(20 * 1024, 'a');
+    for (size_t i = 0; i < str.size(); i++) {
+        str[i] += i % 26;
+    }
+    ProtoOutputStream proto;
+    proto.write(FIELD_TYPE_INT32 | 1, 1);
+    proto.write(FIELD_TYPE_STRING | 2, str);
+    proto.write(FIELD_TYPE_INT32 | 3, 3);
+
+    ProtoReader reader(proto.data());
+    ASSERT_TRUE(reader.next());
+    ASSERT_TRUE(reader.next());
+    ASSERT_EQ(str.size(), reader.length());
+    std::string read;
+    int spans = 0;
+    size_t size;
+    for (const uint8_t* bytes = reader.readBytes(&size); bytes != NULL;
+         bytes = reader.readBytes(&size)) {
+        read.append((const char*)bytes, size);
+        spans++;
+    }
+    EXPECT_GT(spans, 1);
+    EXPECT_EQ(str, read);
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(3u, reader.fieldId());
+    EXPECT_FALSE(reader.next());
+    EXPECT_FALSE(reader.hasError());
+}
+
+TEST(ProtoReaderTest, ReadVarintAcrossChunks) {
+    EncodedBuffer buffer(4);
+    buffer.writeHeader(1, WIRE_TYPE_VARINT);
+    buffer.writeRawVarint64(UINT64_C(1522865904593));
+    buffer.writeHeader(2, WIRE_TYPE_VARINT);
+    buffer.writeRawVarint64(UINT64_MAX);
+
+    ProtoReader reader(buffer.begin());
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(UINT64_C(1522865904593), reader.readVarint());
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(2u, reader.fieldId());
+    EXPECT_EQ(UINT64_MAX, reader.readVarint());
+    EXPECT_FALSE(reader.next());
+    EXPECT_FALSE(reader.hasError());
+}
+
+TEST(ProtoReaderTest, TruncatedField) {
+    const uint8_t data[] = {0x0a, 0x05, 'a', 'b'};  // field 1, 5 bytes long.
+    ProtoReader reader(data, sizeof(data));
+    EXPECT_FALSE(reader.next());
+    EXPECT_TRUE(reader.hasError());
+}
+
+TEST(ProtoReaderTest, MessageLongerThanParent) {
+    // Field 1 is a message of 4 bytes, whose field 2 claims 6.
+    const uint8_t data[] = {0x0a, 0x04, 0x12, 0x06, 'a', 'b', 'c', 'd'};
+    ProtoReader reader(data, sizeof(data));
+    ASSERT_TRUE(reader.next());
+    uint64_t token = reader.start();
+    EXPECT_FALSE(reader.next());
+    EXPECT_TRUE(reader.hasError());
+    reader.end(token);
+    EXPECT_FALSE(reader.next());
+}
+
+TEST(ProtoReaderTest, ReadMmappedFile) {
+    ProtoOutputStream proto;
+    for (int i = 0; i < 10000; i++) {
+        uint64_t token = proto.start(FIELD_TYPE_MESSAGE | 1);
+        proto.write(FIELD_TYPE_INT32 | 1, i);
+        proto.write(FIELD_TYPE_STRING | 2, std::string("entry"));
+        proto.end(token);
+    }
+    TemporaryFile tf;
+    ASSERT_TRUE(proto.flush(tf.fd));
+    struct stat st;
+    ASSERT_EQ(0, fstat(tf.fd, &st));
+    ASSERT_EQ(proto.size(), (size_t)st.st_size);
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, tf.fd, 0);
+    ASSERT_NE(MAP_FAILED, data);
+
+    ProtoReader reader((const uint8_t*)data, st.st_size);
+    int count = 0;
+    while (reader.next()) {
+        uint64_t token = reader.start();
+        ASSERT_TRUE(reader.next());
+        EXPECT_EQ((uint64_t)count, reader.readVarint());
+        ASSERT_TRUE(reader.next());
+        EXPECT_THAT(reader.readString(), StrEq("entry"));
+        reader.end(token);
+        count++;
+    }
+    EXPECT_FALSE(reader.hasError());
+    EXPECT_EQ(10000, count);
+    munmap(data, st.st_size);
+}
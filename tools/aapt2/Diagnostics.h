@@ -20,6 +20,8 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "android-base/macros.h"
 #include "androidfw/StringPiece.h"
@@ -142,6 +144,30 @@ class SourcePathDiagnostics : public IDiagnostics {
   DISALLOW_COPY_AND_ASSIGN(SourcePathDiagnostics);
 };
 
+// Records messages so that they can be logged to another IDiagnostics later, in order. This
+// lets work done on a background thread report its messages as if it had run serially.
+class BufferedDiagnostics : public IDiagnostics {
+ public:
+  BufferedDiagnostics() = default;
+
+  void Log(Level level, DiagMessageActual& actual_msg) override {
+    messages_.push_back(std::make_pair(level, actual_msg));
+  }
+
+  // Logs all recorded messages to `diag` and forgets them.
+  void FlushTo(IDiagnostics* diag) {
+    for (auto& message : messages_) {
+      diag->Log(message.first, message.second);
+    }
+    messages_.clear();
+  }
+
+ private:
+  std::vector<std::pair<Level, DiagMessageActual>> messages_;
+
+  DISALLOW_COPY_AND_ASSIGN(BufferedDiagnostics);
+};
+
 }  // namespace aapt
 
 #endif /* AAPT_DIAGNOSTICS_H */
@@ -29,6 +29,7 @@
 #include "androidfw/StringPiece.h"
 
 #include "Diagnostics.h"
+#include "link/IncludeCache.h"
 #include "util/Files.h"
 #include "util/Util.h"
 
@@ -41,7 +42,7 @@ namespace aapt {
 static const char* sMajorVersion = "2";
 
 // Update minor version whenever a feature or flag is added.
-static const char* sMinorVersion = "19";
+static const char* sMinorVersion = "20";
 
 static void PrintVersion() {
   std::cerr << StringPrintf("Android Asset Packaging Tool (aapt) %s:%s", sMajorVersion,
@@ -54,18 +55,20 @@ static void PrintUsage() {
 }
 
 extern int Compile(const std::vector<StringPiece>& args, IDiagnostics* diagnostics);
-extern int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics);
+extern int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics,
+                IncludeCache* include_cache);
 extern int Dump(const std::vector<StringPiece>& args);
 extern int Diff(const std::vector<StringPiece>& args);
 extern int Optimize(const std::vector<StringPiece>& args);
 extern int Convert(const std::vector<StringPiece>& args);
 
+// `include_cache` is set when running as a daemon, to keep the include APKs of links loaded.
 static int ExecuteCommand(const StringPiece& command, const std::vector<StringPiece>& args,
-                          IDiagnostics* diagnostics) {
+                          IDiagnostics* diagnostics, IncludeCache* include_cache) {
   if (command == "compile" || command == "c") {
     return Compile(args, diagnostics);
   } else if (command == "link" || command == "l") {
-    return Link(args, diagnostics);
+    return Link(args, diagnostics, include_cache);
   } else if (command == "dump" || command == "d") {
     return Dump(args);
   } else if (command == "diff") {
@@ -88,7 +91,9 @@ static void RunDaemon(IDiagnostics* diagnostics) {
   // Run in daemon mode. The first line of input is the command. This can be 'quit' which ends
   // the daemon mode. Each subsequent line is a single parameter to the command. The end of a
   // invocation is signaled by providing an empty line. At any point, an EOF signal or the
-  // command 'quit' will end the daemon mode.
+  // command 'quit' will end the daemon mode. The command '--stats' prints how often the APKs
+  // included by links were reused from previous links.
+  IncludeCache include_cache;
   while (true) {
     std::vector<std::string> raw_args;
     for (std::string line; std::getline(std::cin, line) && !line.empty();) {
@@ -108,9 +113,16 @@ static void RunDaemon(IDiagnostics* diagnostics) {
       break;
     }
 
+    if (raw_args[0] == "--stats") {
+      include_cache.PrintStats(&std::cout);
+      std::cout.flush();
+      std::cerr << "Done" << std::endl;
+      continue;
+    }
+
     std::vector<StringPiece> args;
     args.insert(args.end(), ++raw_args.begin(), raw_args.end());
-    int ret = ExecuteCommand(raw_args[0], args, diagnostics);
+    int ret = ExecuteCommand(raw_args[0], args, diagnostics, &include_cache);
     if (ret != 0) {
       std::cerr << "Error" << std::endl;
     }
@@ -142,7 +154,7 @@ int MainImpl(int argc, char** argv) {
   const StringPiece command(argv[0]);
   if (command != "daemon" && command != "m") {
     // Single execution.
-    const int result = aapt::ExecuteCommand(command, args, &diagnostics);
+    const int result = aapt::ExecuteCommand(command, args, &diagnostics, nullptr /*include_cache*/);
     if (result < 0) {
       aapt::PrintUsage();
     }
@@ -30,6 +30,7 @@
 #include "Flags.h"
 #include "ResourceParser.h"
 #include "ResourceTable.h"
+#include "ResourceUtils.h"
 #include "compile/IdAssigner.h"
 #include "compile/InlineXmlFormatParser.h"
 #include "compile/Png.h"
@@ -43,6 +44,7 @@
 #include "io/StringStream.h"
 #include "io/Util.h"
 #include "util/Files.h"
+#include "util/JobServer.h"
 #include "util/Maybe.h"
 #include "util/Util.h"
 #include "xml/XmlDom.h"
@@ -128,6 +130,9 @@ struct CompileOptions {
   bool no_png_crunch = false;
   bool legacy_mode = false;
   bool verbose = false;
+
+  // The maximum number of files to compile in parallel.
+  size_t jobs = 1u;
 };
 
 static std::string BuildIntermediateContainerFilename(const ResourcePathData& data) {
@@ -694,12 +699,80 @@ class CompileContext : public IAaptContext {
   bool verbose_ = false;
 };
 
+// Determines how to compile a single resource file and compiles it into `writer`.
+// Returns false if there was an error.
+static bool CompileResource(IAaptContext* context, const CompileOptions& options,
+                            ResourcePathData* path_data, IArchiveWriter* writer) {
+  if (options.verbose) {
+    context->GetDiagnostics()->Note(DiagMessage(path_data->source) << "processing");
+  }
+
+  if (!IsValidFile(context, path_data->source.path)) {
+    return false;
+  }
+
+  // Determine how to compile the file based on its type.
+  auto compile_func = &CompileFile;
+  if (path_data->resource_dir == "values" && path_data->extension == "xml") {
+    compile_func = &CompileTable;
+    // We use a different extension (not necessary anymore, but avoids altering the existing
+    // build system logic).
+    path_data->extension = "arsc";
+
+  } else if (const ResourceType* type = ParseResourceType(path_data->resource_dir)) {
+    if (*type != ResourceType::kRaw) {
+      if (path_data->extension == "xml") {
+        compile_func = &CompileXml;
+      } else if ((!options.no_png_crunch && path_data->extension == "png")
+          || path_data->extension == "9.png") {
+        compile_func = &CompilePng;
+      }
+    }
+  } else {
+    context->GetDiagnostics()->Error(DiagMessage()
+                                     << "invalid file path '" << path_data->source << "'");
+    return false;
+  }
+
+  // Treat periods as a reserved character that should not be present in a file name
+  // Legacy support for AAPT which did not reserve periods
+  if (compile_func != &CompileFile && !options.legacy_mode
+      && std::count(path_data->name.begin(), path_data->name.end(), '.') != 0) {
+    context->GetDiagnostics()->Error(DiagMessage() << "resource file '" << path_data->source.path
+                                                   << "' name cannot contain '.' other than for"
+                                                   << "specifying the extension");
+    return false;
+  }
+
+  // Compile the file.
+  const std::string out_path = BuildIntermediateContainerFilename(*path_data);
+  return compile_func(context, options, *path_data, writer, out_path);
+}
+
+static bool FinishArchive(IAaptContext* context, const StringPiece& output_path,
+                          IArchiveWriter* writer) {
+  if (!writer->Finish()) {
+    context->GetDiagnostics()->Error(DiagMessage(output_path)
+                                     << "failed to write archive: " << writer->GetError());
+    return false;
+  }
+  return true;
+}
+
+// The result of compiling one file on a worker thread, held until it can be written out in order.
+struct CompileResult {
+  BufferedDiagnostics diagnostics;
+  BufferedArchiveWriter writer;
+  bool success = false;
+};
+
 // Entry point for compilation phase. Parses arguments and dispatches to the correct steps.
 int Compile(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
   CompileContext context(diagnostics);
   CompileOptions options;
 
   bool verbose = false;
+  Maybe<std::string> jobs;
   Flags flags =
       Flags()
           .RequiredFlag("-o", "Output path", &options.output_path)
@@ -715,6 +788,11 @@ int Compile(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
           .OptionalSwitch("--no-crunch", "Disables PNG processing", &options.no_png_crunch)
           .OptionalSwitch("--legacy", "Treat errors that used to be valid in AAPT as warnings",
                           &options.legacy_mode)
+          .OptionalFlag("-j",
+                        "Compiles up to this many files in parallel. When run by make, parallel\n"
+                        "jobs also take tokens from make's jobserver. Ignored with\n"
+                        "--output-text-symbols",
+                        &jobs)
           .OptionalSwitch("-v", "Enables verbose logging", &verbose);
   if (!flags.Parse("aapt2 compile", args, &std::cerr)) {
     return 1;
@@ -722,6 +800,21 @@ int Compile(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
 
   context.SetVerbose(verbose);
 
+  if (jobs) {
+    Maybe<uint32_t> maybe_jobs = ResourceUtils::ParseInt(jobs.value());
+    if (!maybe_jobs || maybe_jobs.value() == 0u) {
+      context.GetDiagnostics()->Error(DiagMessage() << "invalid number of jobs '" << jobs.value()
+                                                    << "'");
+      return 1;
+    }
+    options.jobs = maybe_jobs.value();
+  }
+
+  // Every file would write to the same text symbols file.
+  if (options.generate_text_symbols_path) {
+    options.jobs = 1u;
+  }
+
   std::unique_ptr<IArchiveWriter> archive_writer;
 
   std::vector<ResourcePathData> input_data;
@@ -761,56 +854,38 @@ int Compile(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
   }
 
   bool error = false;
-  for (ResourcePathData& path_data : input_data) {
-    if (options.verbose) {
-      context.GetDiagnostics()->Note(DiagMessage(path_data.source) << "processing");
-    }
-
-    if (!IsValidFile(&context, path_data.source.path)) {
-      error = true;
-      continue;
-    }
-
-    // Determine how to compile the file based on its type.
-    auto compile_func = &CompileFile;
-    if (path_data.resource_dir == "values" && path_data.extension == "xml") {
-      compile_func = &CompileTable;
-      // We use a different extension (not necessary anymore, but avoids altering the existing
-      // build system logic).
-      path_data.extension = "arsc";
-
-    } else if (const ResourceType* type = ParseResourceType(path_data.resource_dir)) {
-      if (*type != ResourceType::kRaw) {
-        if (path_data.extension == "xml") {
-          compile_func = &CompileXml;
-        } else if ((!options.no_png_crunch && path_data.extension == "png")
-            || path_data.extension == "9.png") {
-          compile_func = &CompilePng;
+  if (options.jobs <= 1u) {
+    for (ResourcePathData& path_data : input_data) {
+      error |= !CompileResource(&context, options, &path_data, archive_writer.get());
+    }
+    return error || !FinishArchive(&context, options.output_path, archive_writer.get()) ? 1 : 0;
+  }
+
+  // Compile files in parallel, each into its own buffer, and write them out in input order so
+  // that the output and diagnostics are the same as when compiling serially.
+  std::unique_ptr<JobServer> job_server = JobServer::FromEnvironment();
+  std::vector<std::unique_ptr<CompileResult>> results(input_data.size());
+  ParallelForOrdered(
+      input_data.size(), options.jobs, job_server.get(),
+      [&](size_t i) {
+        std::unique_ptr<CompileResult> result = util::make_unique<CompileResult>();
+        CompileContext job_context(&result->diagnostics);
+        job_context.SetVerbose(verbose);
+        result->success = CompileResource(&job_context, options, &input_data[i], &result->writer);
+        results[i] = std::move(result);
+      },
+      [&](size_t i) {
+        std::unique_ptr<CompileResult> result = std::move(results[i]);
+        result->diagnostics.FlushTo(context.GetDiagnostics());
+        if (!result->writer.WriteTo(archive_writer.get())) {
+          context.GetDiagnostics()->Error(DiagMessage(input_data[i].source)
+                                          << "failed to write compiled file: "
+                                          << archive_writer->GetError());
+          error = true;
         }
-      }
-    } else {
-      context.GetDiagnostics()->Error(DiagMessage()
-                                      << "invalid file path '" << path_data.source << "'");
-      error = true;
-      continue;
-    }
-
-    // Treat periods as a reserved character that should not be present in a file name
-    // Legacy support for AAPT which did not reserve periods
-    if (compile_func != &CompileFile && !options.legacy_mode
-        && std::count(path_data.name.begin(), path_data.name.end(), '.') != 0) {
-      error = true;
-      context.GetDiagnostics()->Error(DiagMessage() << "resource file '" << path_data.source.path
-                                                    << "' name cannot contain '.' other than for"
-                                                    << "specifying the extension");
-      continue;
-    }
-
-    // Compile the file.
-    const std::string out_path = BuildIntermediateContainerFilename(path_data);
-    error |= !compile_func(&context, options, path_data, archive_writer.get(), out_path);
-  }
-  return error ? 1 : 0;
+        error |= !result->success;
+      });
+  return error || !FinishArchive(&context, options.output_path, archive_writer.get()) ? 1 : 0;
 }
 
 }  // namespace aapt
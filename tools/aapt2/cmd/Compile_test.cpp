@@ -93,4 +93,40 @@ TEST(CompilerTest, MultiplePeriods) {
   ASSERT_EQ(remove(path5_out.c_str()), 0);
 }
 
+TEST(CompilerTest, ParallelCompileMatchesSerialCompile) {
+  StdErrDiagnostics diag;
+  const std::string kResDir = android::base::Dirname(android::base::GetExecutablePath())
+      + "/integration-tests/CompileTest/res";
+  const std::vector<std::string> inputs = {kResDir + "/values/values.xml",
+                                           kResDir + "/drawable/image.png",
+                                           kResDir + "/drawable/image.9.png"};
+  const std::vector<std::string> outputs = {kResDir + "/values_values.arsc.flat",
+                                            kResDir + "/drawable_image.png.flat",
+                                            kResDir + "/drawable_image.9.png.flat"};
+
+  auto compile = [&](const char* jobs, std::vector<std::string>* out_contents) {
+    std::vector<android::StringPiece> args(inputs.begin(), inputs.end());
+    args.push_back("-o");
+    args.push_back(kResDir);
+    args.push_back("-j");
+    args.push_back(jobs);
+    ASSERT_EQ(aapt::Compile(args, &diag), 0);
+
+    for (const std::string& output : outputs) {
+      std::string contents;
+      ASSERT_TRUE(android::base::ReadFileToString(output, &contents));
+      out_contents->push_back(std::move(contents));
+      ASSERT_EQ(remove(output.c_str()), 0);
+    }
+  };
+
+  std::vector<std::string> serial_contents;
+  compile("1", &serial_contents);
+
+  std::vector<std::string> parallel_contents;
+  compile("4", &parallel_contents);
+
+  EXPECT_EQ(serial_contents, parallel_contents);
+}
+
 }
\ No newline at end of file
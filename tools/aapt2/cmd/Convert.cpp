@@ -385,7 +385,16 @@ int Convert(const vector<StringPiece>& args) {
   }
 
 
-  return ConvertApk(&context, std::move(apk), serializer.get(), writer.get()) ? 0 : 1;
+  if (!ConvertApk(&context, std::move(apk), serializer.get(), writer.get())) {
+    return 1;
+  }
+
+  if (!writer->Finish()) {
+    context.GetDiagnostics()->Error(DiagMessage(output_path)
+                                    << "failed to write archive: " << writer->GetError());
+    return 1;
+  }
+  return 0;
 }
 
 }  // namespace aapt
@@ -17,7 +17,10 @@
 #include <sys/stat.h>
 #include <cinttypes>
 
+#include <algorithm>
 #include <queue>
+#include <set>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -53,6 +56,8 @@
 #include "java/JavaClassGenerator.h"
 #include "java/ManifestClassGenerator.h"
 #include "java/ProguardRules.h"
+#include "link/IncludeCache.h"
+#include "link/LinkCache.h"
 #include "link/Linkers.h"
 #include "link/ManifestFixer.h"
 #include "link/NoDefaultResourceRemover.h"
@@ -135,6 +140,12 @@ struct LinkOptions {
   // In order to work around this limitation, we allow the use of traditionally reserved
   // resource IDs [those between 0x02 and 0x7E].
   bool allow_reserved_package_id = false;
+
+  // Directory in which linked XML files are cached between invocations.
+  Maybe<std::string> incremental_dir;
+
+  // Set by long-running processes to keep the include APKs loaded between links.
+  IncludeCache* include_cache = nullptr;
 };
 
 class LinkContext : public IAaptContext {
@@ -325,6 +336,12 @@ struct ResourceFileFlattenerOptions {
   bool update_proguard_spec = false;
   OutputFormat output_format = OutputFormat::kApk;
   std::unordered_set<std::string> extensions_to_not_compress;
+
+  // When set, linked XML files are looked up in and stored to this cache. `cache_environment` must
+  // identify everything outside of a file that linking it depends on, such as the options and the
+  // included APKs, except for the symbols it looks up, which the cache checks per file.
+  LinkCache* cache = nullptr;
+  std::string cache_environment;
 };
 
 // A sampling of public framework resource IDs.
@@ -372,13 +389,30 @@ class ResourceFileFlattener {
 
     // The destination to write this file to.
     std::string dst_path;
+
+    // The key of this file in the LinkCache, and the cached documents if it was found.
+    std::string cache_key;
+    bool cache_hit = false;
+    std::vector<LinkCache::Document> cached_docs;
+
+    // The symbols looked up while linking this file, stored along with its documents.
+    SymbolTable::Lookups symbol_lookups;
   };
 
   uint32_t GetCompressionFlags(const StringPiece& str);
 
+  std::string GetCacheKey(const ResourceEntry* entry, const FileReference* file_ref,
+                          const ConfigDescription& config, const io::IData& data);
+
   std::vector<std::unique_ptr<xml::XmlResource>> LinkAndVersionXmlFile(ResourceTable* table,
                                                                        FileOperation* file_op);
 
+  bool WriteCachedFile(ResourceTable* table, FileOperation* file_op,
+                       IArchiveWriter* archive_writer);
+
+  bool LinkAndFlattenXmlFile(ResourceTable* table, const ConfigDescription& config,
+                             FileOperation* file_op, IArchiveWriter* archive_writer);
+
   ResourceFileFlattenerOptions options_;
   IAaptContext* context_;
   proguard::KeepSet* keep_set_;
@@ -460,6 +494,36 @@ static bool IsVectorElement(const std::string& name) {
          name == "objectAnimator" || name == "gradient" || name == "animated-selector";
 }
 
+std::string ResourceFileFlattener::GetCacheKey(const ResourceEntry* entry,
+                                               const FileReference* file_ref,
+                                               const ConfigDescription& config,
+                                               const io::IData& data) {
+  LinkCache::KeyBuilder key;
+  key.Append(options_.cache_environment);
+  key.Append(static_cast<uint64_t>(options_.keep_raw_values))
+      .Append(static_cast<uint64_t>(options_.no_auto_version))
+      .Append(static_cast<uint64_t>(options_.no_version_vectors))
+      .Append(static_cast<uint64_t>(options_.no_version_transitions))
+      .Append(static_cast<uint64_t>(options_.no_xml_namespaces))
+      .Append(static_cast<uint64_t>(options_.output_format));
+  key.Append(entry->name).Append(config.to_string()).Append(*file_ref->path);
+  key.Append(static_cast<uint64_t>(file_ref->type)).Append(data.data(), data.size());
+
+  // Auto-versioning depends on the other configurations of the entry, and on which attributes
+  // can be degraded.
+  for (const auto& config_value : entry->values) {
+    key.Append(config_value->config.to_string());
+  }
+  std::set<ResourceId> degraded_attrs;
+  for (const auto& rule : rules_) {
+    degraded_attrs.insert(rule.first);
+  }
+  for (const ResourceId& id : degraded_attrs) {
+    key.Append(id.id);
+  }
+  return key.ToString();
+}
+
 template <typename T>
 std::vector<T> make_singleton_vec(T&& val) {
   std::vector<T> vec;
@@ -532,6 +596,112 @@ ResourceFile::Type XmlFileTypeForOutputFormat(OutputFormat format) {
   return ResourceFile::Type::kUnknown;
 }
 
+bool ResourceFileFlattener::WriteCachedFile(ResourceTable* table, FileOperation* file_op,
+                                            IArchiveWriter* archive_writer) {
+  xml::XmlResource* xml_res = file_op->xml_to_flatten.get();
+  if (context_->IsVerbose()) {
+    context_->GetDiagnostics()->Note(DiagMessage(xml_res->file.source)
+                                     << "using cached output for " << xml_res->file.name);
+  }
+
+  if (options_.update_proguard_spec) {
+    // The rules are collected from the linked XML, so this much still needs to be done.
+    xml::StripAndroidStudioAttributes(xml_res->root.get());
+    XmlReferenceLinker xml_linker;
+    if (!xml_linker.Consume(context_, xml_res) ||
+        !proguard::CollectProguardRules(xml_res, keep_set_)) {
+      return false;
+    }
+  }
+
+  for (const LinkCache::Document& doc : file_op->cached_docs) {
+    if (doc.config != file_op->config) {
+      // Re-add the auto-versioned configurations, as LinkAndVersionXmlFile() would have.
+      std::unique_ptr<FileReference> file_ref =
+          util::make_unique<FileReference>(table->string_pool.MakeRef(doc.path));
+      file_ref->SetSource(xml_res->file.source);
+      file_ref->type = XmlFileTypeForOutputFormat(options_.output_format);
+      if (!table->AddResourceMangled(xml_res->file.name, doc.config, {}, std::move(file_ref),
+                                     context_->GetDiagnostics())) {
+        return false;
+      }
+    }
+
+    if (!LinkCache::WriteDocument(doc, archive_writer)) {
+      context_->GetDiagnostics()->Error(DiagMessage(doc.path) << "failed to write to archive: "
+                                                              << archive_writer->GetError());
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ResourceFileFlattener::LinkAndFlattenXmlFile(ResourceTable* table,
+                                                  const ConfigDescription& config,
+                                                  FileOperation* file_op,
+                                                  IArchiveWriter* archive_writer) {
+  // Record what the file looks up, so that its cache entry only depends on those symbols.
+  SymbolTable* symbols = context_->GetExternalSymbols();
+  if (options_.cache != nullptr) {
+    symbols->SetLookupRecorder(&file_op->symbol_lookups);
+  }
+  std::vector<std::unique_ptr<xml::XmlResource>> versioned_docs =
+      LinkAndVersionXmlFile(table, file_op);
+  symbols->SetLookupRecorder(nullptr);
+  if (versioned_docs.empty()) {
+    return false;
+  }
+
+  // When caching, the documents are written to the archive once they are all in the cache.
+  BufferedArchiveWriter buffered_writer;
+  std::vector<ConfigDescription> doc_configs;
+  IArchiveWriter* writer = options_.cache != nullptr ? &buffered_writer : archive_writer;
+
+  bool error = false;
+  for (std::unique_ptr<xml::XmlResource>& doc : versioned_docs) {
+    std::string dst_path = file_op->dst_path;
+    if (doc->file.config != file_op->config) {
+      // Only add the new versioned configurations.
+      if (context_->IsVerbose()) {
+        context_->GetDiagnostics()->Note(DiagMessage(doc->file.source)
+                                         << "auto-versioning resource from config '"
+                                         << config << "' -> '" << doc->file.config << "'");
+      }
+
+      const ResourceFile& file = doc->file;
+      dst_path = ResourceUtils::BuildResourceFileName(file, context_->GetNameMangler());
+
+      std::unique_ptr<FileReference> file_ref =
+          util::make_unique<FileReference>(table->string_pool.MakeRef(dst_path));
+      file_ref->SetSource(doc->file.source);
+      // Update the output format of this XML file.
+      file_ref->type = XmlFileTypeForOutputFormat(options_.output_format);
+      if (!table->AddResourceMangled(file.name, file.config, {}, std::move(file_ref),
+                                     context_->GetDiagnostics())) {
+        return false;
+      }
+    }
+
+    error |= !FlattenXml(context_, *doc, dst_path, options_.keep_raw_values,
+                         false /*utf16*/, options_.output_format, writer);
+    doc_configs.push_back(doc->file.config);
+  }
+
+  if (error || options_.cache == nullptr) {
+    return !error;
+  }
+
+  options_.cache->Put(file_op->cache_key, file_op->symbol_lookups, symbols, buffered_writer,
+                      doc_configs);
+  if (!buffered_writer.WriteTo(archive_writer)) {
+    context_->GetDiagnostics()->Error(DiagMessage(file_op->dst_path)
+                                      << "failed to write to archive: "
+                                      << archive_writer->GetError());
+    return false;
+  }
+  return true;
+}
+
 bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archive_writer) {
   bool error = false;
   std::map<std::pair<ConfigDescription, StringPiece>, FileOperation> config_sorted_files;
@@ -605,6 +775,12 @@ bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archiv
               }
             }
 
+            if (options_.cache != nullptr) {
+              file_op.cache_key = GetCacheKey(entry.get(), file_ref, config_value->config, *data);
+              file_op.cache_hit = options_.cache->Find(
+                  file_op.cache_key, context_->GetExternalSymbols(), &file_op.cached_docs);
+            }
+
             // Update the type that this file will be written as.
             file_ref->type = XmlFileTypeForOutputFormat(options_.output_format);
 
@@ -628,41 +804,10 @@ bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archiv
         const ConfigDescription& config = map_entry.first.first;
         FileOperation& file_op = map_entry.second;
 
-        if (file_op.xml_to_flatten) {
-          std::vector<std::unique_ptr<xml::XmlResource>> versioned_docs =
-              LinkAndVersionXmlFile(table, &file_op);
-          if (versioned_docs.empty()) {
-            error = true;
-            continue;
-          }
-
-          for (std::unique_ptr<xml::XmlResource>& doc : versioned_docs) {
-            std::string dst_path = file_op.dst_path;
-            if (doc->file.config != file_op.config) {
-              // Only add the new versioned configurations.
-              if (context_->IsVerbose()) {
-                context_->GetDiagnostics()->Note(DiagMessage(doc->file.source)
-                                                 << "auto-versioning resource from config '"
-                                                 << config << "' -> '" << doc->file.config << "'");
-              }
-
-              const ResourceFile& file = doc->file;
-              dst_path = ResourceUtils::BuildResourceFileName(file, context_->GetNameMangler());
-
-              std::unique_ptr<FileReference> file_ref =
-                  util::make_unique<FileReference>(table->string_pool.MakeRef(dst_path));
-              file_ref->SetSource(doc->file.source);
-              // Update the output format of this XML file.
-              file_ref->type = XmlFileTypeForOutputFormat(options_.output_format);
-              if (!table->AddResourceMangled(file.name, file.config, {}, std::move(file_ref),
-                                             context_->GetDiagnostics())) {
-                return false;
-              }
-            }
-
-            error |= !FlattenXml(context_, *doc, dst_path, options_.keep_raw_values,
-                                 false /*utf16*/, options_.output_format, archive_writer);
-          }
+        if (file_op.cache_hit) {
+          error |= !WriteCachedFile(table, &file_op, archive_writer);
+        } else if (file_op.xml_to_flatten) {
+          error |= !LinkAndFlattenXmlFile(table, config, &file_op, archive_writer);
         } else {
           error |= !io::CopyFileToArchive(context_, file_op.file_to_copy, file_op.dst_path,
                                           GetCompressionFlags(file_op.dst_path), archive_writer);
@@ -841,30 +986,86 @@ class LinkCommand {
     }
   }
 
+  // Loads the include at `path`. A static library is stored in `out_static_apk`, which is set to
+  // nullptr if `path` is a regular APK.
+  bool LoadInclude(const std::string& path, std::shared_ptr<LoadedApk>* out_static_apk) {
+    IncludeCache* include_cache = options_.include_cache;
+    if (include_cache != nullptr) {
+      // With --no-static-lib-packages the table of a static library is modified, so it can't be
+      // shared.
+      const IncludeCache::Include* include = include_cache->FindInclude(path);
+      if (include != nullptr &&
+          (include->static_library == nullptr || !options_.no_static_lib_packages)) {
+        *out_static_apk = include->static_library;
+        return true;
+      }
+    }
+
+    std::string error;
+    auto zip_collection = io::ZipFileCollection::Create(path, &error);
+    if (zip_collection == nullptr) {
+      context_->GetDiagnostics()->Error(DiagMessage() << "failed to open APK: " << error);
+      return false;
+    }
+
+    out_static_apk->reset();
+    if (zip_collection->FindFile(kProtoResourceTablePath) != nullptr) {
+      // Load this as a static library include.
+      *out_static_apk = LoadedApk::LoadProtoApkFromFileCollection(
+          Source(path), std::move(zip_collection), context_->GetDiagnostics());
+      if (*out_static_apk == nullptr) {
+        return false;
+      }
+    }
+
+    if (include_cache != nullptr &&
+        (*out_static_apk == nullptr || !options_.no_static_lib_packages)) {
+      include_cache->AddInclude(path, IncludeCache::Include{*out_static_apk});
+    }
+    return true;
+  }
+
+  // Loads the regular APKs among the include paths into one symbol source.
+  std::shared_ptr<AssetManagerSymbolSource> LoadIncludeAssets(
+      const std::vector<std::string>& paths) {
+    IncludeCache* include_cache = options_.include_cache;
+    if (include_cache != nullptr) {
+      if (std::shared_ptr<AssetManagerSymbolSource> asset_source =
+              include_cache->FindAssetSource(paths)) {
+        return asset_source;
+      }
+    }
+
+    auto asset_source = std::make_shared<AssetManagerSymbolSource>();
+    for (const std::string& path : paths) {
+      if (!asset_source->AddAssetPath(path)) {
+        context_->GetDiagnostics()->Error(DiagMessage()
+                                          << "failed to load include path " << path);
+        return {};
+      }
+    }
+
+    if (include_cache != nullptr) {
+      include_cache->AddAssetSource(paths, asset_source);
+    }
+    return asset_source;
+  }
+
   // Creates a SymbolTable that loads symbols from the various APKs.
   // Pre-condition: context_->GetCompilationPackage() needs to be set.
   bool LoadSymbolsFromIncludePaths() {
-    auto asset_source = util::make_unique<AssetManagerSymbolSource>();
+    std::vector<std::string> asset_paths;
     for (const std::string& path : options_.include_paths) {
       if (context_->IsVerbose()) {
         context_->GetDiagnostics()->Note(DiagMessage() << "including " << path);
       }
 
-      std::string error;
-      auto zip_collection = io::ZipFileCollection::Create(path, &error);
-      if (zip_collection == nullptr) {
-        context_->GetDiagnostics()->Error(DiagMessage() << "failed to open APK: " << error);
+      std::shared_ptr<LoadedApk> static_apk;
+      if (!LoadInclude(path, &static_apk)) {
         return false;
       }
 
-      if (zip_collection->FindFile(kProtoResourceTablePath) != nullptr) {
-        // Load this as a static library include.
-        std::unique_ptr<LoadedApk> static_apk = LoadedApk::LoadProtoApkFromFileCollection(
-            Source(path), std::move(zip_collection), context_->GetDiagnostics());
-        if (static_apk == nullptr) {
-          return false;
-        }
-
+      if (static_apk != nullptr) {
         if (context_->GetPackageType() != PackageType::kStaticLib) {
           // Can't include static libraries when not building a static library (they have no IDs
           // assigned).
@@ -894,14 +1095,15 @@ class LinkCommand {
             util::make_unique<ResourceTableSymbolSource>(table));
         static_library_includes_.push_back(std::move(static_apk));
       } else {
-        if (!asset_source->AddAssetPath(path)) {
-          context_->GetDiagnostics()->Error(DiagMessage()
-                                            << "failed to load include path " << path);
-          return false;
-        }
+        asset_paths.push_back(path);
       }
     }
 
+    std::shared_ptr<AssetManagerSymbolSource> asset_source = LoadIncludeAssets(asset_paths);
+    if (asset_source == nullptr) {
+      return false;
+    }
+
     // Capture the shared libraries so that the final resource table can be properly flattened
     // with support for shared libraries.
     for (auto& entry : asset_source->GetAssignedPackageIds()) {
@@ -924,7 +1126,8 @@ class LinkCommand {
       }
     }
 
-    context_->GetExternalSymbols()->AppendSource(std::move(asset_source));
+    context_->GetExternalSymbols()->AppendSource(
+        util::make_unique<SharedSymbolSource>(std::move(asset_source)));
     return true;
   }
 
@@ -1058,12 +1261,30 @@ class LinkCommand {
     return true;
   }
 
-  std::unique_ptr<IArchiveWriter> MakeArchiveWriter(const StringPiece& out) {
-    if (options_.output_to_directory) {
-      return CreateDirectoryArchiveWriter(context_->GetDiagnostics(), out);
-    } else {
-      return CreateZipFileArchiveWriter(context_->GetDiagnostics(), out);
+  // Entries are compressed and written on background threads while the link goes on, so the
+  // writer must be finished before the archive is considered complete.
+  std::unique_ptr<PipelinedArchiveWriter> MakeArchiveWriter(const StringPiece& out) {
+    if (!options_.output_to_directory) {
+      // Deflating the entries is spread over a few threads, only appending them is serial.
+      const size_t jobs = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+      return PipelinedArchiveWriter::CreateZipFile(context_->GetDiagnostics(), out, jobs);
     }
+
+    std::unique_ptr<IArchiveWriter> writer =
+        CreateDirectoryArchiveWriter(context_->GetDiagnostics(), out);
+    if (!writer) {
+      return {};
+    }
+    return util::make_unique<PipelinedArchiveWriter>(std::move(writer));
+  }
+
+  bool FinishArchiveWriter(IArchiveWriter* writer, const StringPiece& out) {
+    if (!writer->Finish()) {
+      context_->GetDiagnostics()->Error(DiagMessage(out) << "failed to write archive: "
+                                                         << writer->GetError());
+      return false;
+    }
+    return true;
   }
 
   bool FlattenTable(ResourceTable* table, OutputFormat format, IArchiveWriter* writer) {
@@ -1569,6 +1790,31 @@ class LinkCommand {
     return true;
   }
 
+  // Opens the cache of linked XML files in `dir`. The symbols each XML file references are
+  // recorded with its cache entry, so they are not part of the environment.
+  bool OpenLinkCache(const std::string& dir) {
+    link_cache_ = LinkCache::Open(dir, context_->GetDiagnostics());
+    if (!link_cache_) {
+      return false;
+    }
+
+    LinkCache::KeyBuilder environment;
+    environment.AppendFileStat(android::base::GetExecutablePath());
+    environment.Append(context_->GetCompilationPackage())
+        .Append(context_->GetPackageId())
+        .Append(static_cast<uint64_t>(context_->GetPackageType()))
+        .Append(static_cast<uint64_t>(context_->GetMinSdkVersion()))
+        .Append(included_feature_base_.value_or_default({}));
+    for (const std::string& package : table_merger_->merged_packages()) {
+      environment.Append(package);
+    }
+    for (const std::string& path : options_.include_paths) {
+      environment.AppendFileStat(path);
+    }
+    link_cache_environment_ = environment.ToString();
+    return true;
+  }
+
   // Writes the AndroidManifest, ResourceTable, and all XML files referenced by the ResourceTable
   // to the IArchiveWriter.
   bool WriteApk(IArchiveWriter* writer, proguard::KeepSet* keep_set, xml::XmlResource* manifest,
@@ -1591,6 +1837,8 @@ class LinkCommand {
     file_flattener_options.update_proguard_spec =
         static_cast<bool>(options_.generate_proguard_rules_path);
     file_flattener_options.output_format = options_.output_format;
+    file_flattener_options.cache = link_cache_.get();
+    file_flattener_options.cache_environment = link_cache_environment_;
 
     ResourceFileFlattener file_flattener(file_flattener_options, context_, keep_set);
 
@@ -1860,10 +2108,17 @@ class LinkCommand {
       }
     }
 
+    if (options_.incremental_dir && !OpenLinkCache(options_.incremental_dir.value())) {
+      return 1;
+    }
+
     proguard::KeepSet proguard_keep_set =
         proguard::KeepSet(options_.generate_conditional_proguard_rules);
     proguard::KeepSet proguard_main_dex_keep_set;
 
+    // The split APKs, and the paths they are written to.
+    std::vector<std::pair<std::string, std::unique_ptr<PipelinedArchiveWriter>>> split_writers;
+
     if (context_->GetPackageType() == PackageType::kStaticLib) {
       if (options_.table_splitter_options.config_filter != nullptr ||
           !options_.table_splitter_options.preferred_densities.empty()) {
@@ -1893,7 +2148,7 @@ class LinkCommand {
                                            << "'");
         }
 
-        std::unique_ptr<IArchiveWriter> archive_writer = MakeArchiveWriter(*path_iter);
+        std::unique_ptr<PipelinedArchiveWriter> archive_writer = MakeArchiveWriter(*path_iter);
         if (!archive_writer) {
           context_->GetDiagnostics()->Error(DiagMessage() << "failed to create archive");
           return 1;
@@ -1915,13 +2170,17 @@ class LinkCommand {
           return 1;
         }
 
+        // Finish writing the split in the background, while the next one is generated.
+        split_writers.push_back(std::make_pair(*path_iter, std::move(archive_writer)));
+
         ++path_iter;
         ++split_constraints_iter;
       }
     }
 
     // Start writing the base APK.
-    std::unique_ptr<IArchiveWriter> archive_writer = MakeArchiveWriter(options_.output_path);
+    std::unique_ptr<PipelinedArchiveWriter> archive_writer =
+        MakeArchiveWriter(options_.output_path);
     if (!archive_writer) {
       context_->GetDiagnostics()->Error(DiagMessage() << "failed to create archive");
       return 1;
@@ -1993,6 +2252,26 @@ class LinkCommand {
                            proguard_main_dex_keep_set)) {
       return 1;
     }
+
+    for (auto& split_writer : split_writers) {
+      if (!FinishArchiveWriter(split_writer.second.get(), split_writer.first)) {
+        return 1;
+      }
+    }
+
+    if (!FinishArchiveWriter(archive_writer.get(), options_.output_path)) {
+      return 1;
+    }
+
+    if (link_cache_) {
+      if (context_->IsVerbose()) {
+        context_->GetDiagnostics()->Note(DiagMessage()
+                                         << "reused " << link_cache_->GetHitCount() << " of "
+                                         << link_cache_->GetHitCount() + link_cache_->GetMissCount()
+                                         << " linked XML files");
+      }
+      link_cache_->Prune();
+    }
     return 0;
   }
 
@@ -2016,18 +2295,24 @@ class LinkCommand {
   std::vector<std::unique_ptr<LoadedApk>> merged_apks_;
 
   // The set of included APKs (not merged). This is mainly here to retain ownership of the APKs.
-  std::vector<std::unique_ptr<LoadedApk>> static_library_includes_;
+  std::vector<std::shared_ptr<LoadedApk>> static_library_includes_;
 
   // The set of shared libraries being used, mapping their assigned package ID to package name.
   std::map<size_t, std::string> shared_libs_;
 
   // The package name of the base application, if it is included.
   Maybe<std::string> included_feature_base_;
+
+  // Set when linked XML files are cached between invocations (--incremental-dir).
+  std::unique_ptr<LinkCache> link_cache_;
+  std::string link_cache_environment_;
 };
 
-int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
+int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics,
+         IncludeCache* include_cache) {
   LinkContext context(diagnostics);
   LinkOptions options;
+  options.include_cache = include_cache;
   std::vector<std::string> overlay_arg_list;
   std::vector<std::string> extra_java_packages;
   Maybe<std::string> package_id;
@@ -2188,6 +2473,10 @@ int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
                             "Syntax: path/to/output.apk:<config>[,<config>[...]].\n"
                             "On Windows, use a semicolon ';' separator instead.",
                             &split_args)
+          .OptionalFlag("--incremental-dir",
+                        "Directory in which to cache linked XML files, so that files that did\n"
+                        "not change since the last link with the same directory are reused.",
+                        &options.incremental_dir)
           .OptionalSwitch("-v", "Enables verbose logging.", &verbose)
           .OptionalSwitch("--debug-mode",
                           "Inserts android:debuggable=\"true\" in to the application node of the\n"
@@ -2347,4 +2636,8 @@ int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
   return cmd.Run(arg_list);
 }
 
+int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
+  return Link(args, diagnostics, nullptr /*include_cache*/);
+}
+
 }  // namespace aapt
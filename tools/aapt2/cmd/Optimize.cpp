@@ -78,6 +78,9 @@ struct OptimizeOptions {
   // Set of artifacts to keep when generating multi-APK splits. If the list is empty, all artifacts
   // are kept and will be written as output.
   std::unordered_set<std::string> kept_artifacts;
+
+  // The maximum number of multi-APK artifacts to generate in parallel.
+  size_t jobs = 1u;
 };
 
 class OptimizeContext : public IAaptContext {
@@ -190,7 +193,8 @@ class OptimizeCommand {
         return 1;
       }
 
-      if (!WriteSplitApk(split_table.get(), split_manifest.get(), split_writer.get())) {
+      if (!WriteSplitApk(split_table.get(), split_manifest.get(), split_writer.get()) ||
+          !FinishArchive(*path_iter, split_writer.get())) {
         return 1;
       }
 
@@ -202,7 +206,7 @@ class OptimizeCommand {
       MultiApkGenerator generator{apk.get(), context_};
       MultiApkGeneratorOptions generator_options = {
           options_.output_dir.value(), options_.apk_artifacts.value(),
-          options_.table_flattener_options, options_.kept_artifacts};
+          options_.table_flattener_options, options_.kept_artifacts, options_.jobs};
       if (!generator.FromBaseApk(generator_options)) {
         return 1;
       }
@@ -211,7 +215,12 @@ class OptimizeCommand {
     if (options_.output_path) {
       std::unique_ptr<IArchiveWriter> writer =
           CreateZipFileArchiveWriter(context_->GetDiagnostics(), options_.output_path.value());
-      if (!apk->WriteToArchive(context_, options_.table_flattener_options, writer.get())) {
+      if (!writer) {
+        return 1;
+      }
+
+      if (!apk->WriteToArchive(context_, options_.table_flattener_options, writer.get()) ||
+          !FinishArchive(options_.output_path.value(), writer.get())) {
         return 1;
       }
     }
@@ -220,6 +229,15 @@ class OptimizeCommand {
   }
 
  private:
+  bool FinishArchive(const std::string& path, IArchiveWriter* writer) {
+    if (!writer->Finish()) {
+      context_->GetDiagnostics()->Error(DiagMessage(path)
+                                        << "failed to write archive: " << writer->GetError());
+      return false;
+    }
+    return true;
+  }
+
   bool WriteSplitApk(ResourceTable* table, xml::XmlResource* manifest, IArchiveWriter* writer) {
     BigBuffer manifest_buffer(4096);
     XmlFlattener xml_flattener(&manifest_buffer, {});
@@ -326,6 +344,7 @@ int Optimize(const std::vector<StringPiece>& args) {
   std::vector<std::string> configs;
   std::vector<std::string> split_args;
   std::unordered_set<std::string> kept_artifacts;
+  Maybe<std::string> jobs;
   bool verbose = false;
   bool print_only = false;
   Flags flags =
@@ -364,6 +383,10 @@ int Optimize(const std::vector<StringPiece>& args) {
           .OptionalSwitch("--enable-resource-obfuscation",
                           "Enables obfuscation of key string pool to single value",
                           &options.table_flattener_options.collapse_key_stringpool)
+          .OptionalFlag("-j",
+                        "Generates up to this many multi-APK artifacts in parallel. When run by\n"
+                        "make, parallel jobs also take tokens from make's jobserver.",
+                        &jobs)
           .OptionalSwitch("-v", "Enables verbose logging", &verbose);
 
   if (!flags.Parse("aapt2 optimize", args, &std::cerr)) {
@@ -381,6 +404,15 @@ int Optimize(const std::vector<StringPiece>& args) {
   context.SetVerbose(verbose);
   IDiagnostics* diag = context.GetDiagnostics();
 
+  if (jobs) {
+    Maybe<uint32_t> maybe_jobs = ResourceUtils::ParseInt(jobs.value());
+    if (!maybe_jobs || maybe_jobs.value() == 0u) {
+      diag->Error(DiagMessage() << "invalid number of jobs '" << jobs.value() << "'");
+      return 1;
+    }
+    options.jobs = maybe_jobs.value();
+  }
+
   if (config_path) {
     std::string& path = config_path.value();
     Maybe<ConfigurationParser> for_path = ConfigurationParser::ForPath(path);
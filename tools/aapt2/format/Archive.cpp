@@ -16,7 +16,12 @@
 
 #include "format/Archive.h"
 
+#include <zlib.h>
+
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -27,6 +32,7 @@
 #include "androidfw/StringPiece.h"
 #include "ziparchive/zip_writer.h"
 
+#include "io/BigBufferStream.h"
 #include "util/Files.h"
 
 using ::android::StringPiece;
@@ -106,6 +112,11 @@ class DirectoryWriter : public IArchiveWriter {
     return !in->HadError();
   }
 
+  bool Finish() override {
+    // Each entry is a complete file once it's finished.
+    return !file_ && error_.empty();
+  }
+
   bool HadError() const override {
     return !error_.empty();
   }
@@ -225,6 +236,25 @@ class ZipFileWriter : public IArchiveWriter {
     }
   }
 
+  bool Finish() override {
+    if (!writer_) {
+      return false;
+    }
+
+    int32_t result = writer_->Finish();
+    writer_.reset();
+    if (result != 0) {
+      error_ = ZipWriter::ErrorCodeString(result);
+      return false;
+    }
+
+    if (fflush(file_.get()) != 0) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+    return true;
+  }
+
   bool HadError() const override {
     return !error_.empty();
   }
@@ -249,6 +279,534 @@ class ZipFileWriter : public IArchiveWriter {
 
 }  // namespace
 
+bool BufferedArchiveWriter::WriteFile(const StringPiece& path, uint32_t flags,
+                                      io::InputStream* in) {
+  if (!StartEntry(path, flags)) {
+    return false;
+  }
+  entries_.back().written_as_file = true;
+
+  const void* data = nullptr;
+  size_t len = 0;
+  while (in->Next(&data, &len)) {
+    if (!Write(data, static_cast<int>(len))) {
+      return false;
+    }
+  }
+
+  if (in->HadError()) {
+    error_ = in->GetError();
+    return false;
+  }
+  return FinishEntry();
+}
+
+bool BufferedArchiveWriter::StartEntry(const StringPiece& path, uint32_t flags) {
+  if (in_entry_) {
+    return false;
+  }
+
+  entries_.push_back(
+      Entry{path.to_string(), flags, util::make_unique<BigBuffer>(4096), false /*written_as_file*/});
+  in_entry_ = true;
+  return true;
+}
+
+bool BufferedArchiveWriter::Write(const void* data, int len) {
+  if (!in_entry_) {
+    return false;
+  }
+
+  if (len <= 0) {
+    return true;
+  }
+
+  BigBuffer* buffer = entries_.back().data.get();
+  void* dst = buffer->NextBlock<uint8_t>(static_cast<size_t>(len));
+  memcpy(dst, data, static_cast<size_t>(len));
+  return true;
+}
+
+bool BufferedArchiveWriter::FinishEntry() {
+  if (!in_entry_) {
+    return false;
+  }
+  in_entry_ = false;
+  return true;
+}
+
+bool BufferedArchiveWriter::Finish() {
+  // The entries are only written to an archive by WriteTo(), so there is nothing to complete.
+  return !in_entry_ && error_.empty();
+}
+
+bool BufferedArchiveWriter::HadError() const {
+  return !error_.empty();
+}
+
+std::string BufferedArchiveWriter::GetError() const {
+  return error_;
+}
+
+bool BufferedArchiveWriter::WriteTo(IArchiveWriter* writer) const {
+  // An unfinished entry is dropped, just like a file that failed to compile.
+  const size_t finished_count = in_entry_ ? entries_.size() - 1u : entries_.size();
+  for (size_t i = 0; i < finished_count; i++) {
+    const Entry& entry = entries_[i];
+    if (entry.written_as_file) {
+      // WriteFile() may need to rewind the data, e.g. to store it uncompressed.
+      io::BigBufferInputStream in(entry.data.get());
+      if (!writer->WriteFile(entry.path, entry.flags, &in)) {
+        return false;
+      }
+      continue;
+    }
+
+    if (!writer->StartEntry(entry.path, entry.flags)) {
+      return false;
+    }
+
+    for (const BigBuffer::Block& block : *entry.data) {
+      if (!writer->Write(block.buffer.get(), static_cast<int>(block.size))) {
+        return false;
+      }
+    }
+
+    if (!writer->FinishEntry()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+namespace {
+
+// Zip structures, see https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT.
+constexpr uint32_t kLocalFileHeaderSignature = 0x04034b50u;
+constexpr uint32_t kCentralDirectoryHeaderSignature = 0x02014b50u;
+constexpr uint32_t kEndOfCentralDirectorySignature = 0x06054b50u;
+constexpr size_t kLocalFileHeaderSize = 30u;
+constexpr uint16_t kZipVersion = 20u;
+constexpr uint16_t kStoredMethod = 0u;
+constexpr uint16_t kDeflatedMethod = 8u;
+
+// Every entry is dated 1980-01-01 00:00, the earliest DOS date, as ZipWriter does for entries
+// without a time.
+constexpr uint16_t kDosTime = 0u;
+constexpr uint16_t kDosDate = (0u << 9) | (1u << 5) | 1u;
+
+// Appends the `size` low bytes of `value` to `out`, in little-endian order.
+void AppendLittleEndian(uint64_t value, size_t size, std::string* out) {
+  for (size_t i = 0; i < size; i++) {
+    out->push_back(static_cast<char>((value >> (i * 8)) & 0xffu));
+  }
+}
+
+// Deflates `in` into `out` with the same settings as ZipWriter.
+bool Deflate(const BigBuffer& in, BigBuffer* out) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) !=
+      Z_OK) {
+    return false;
+  }
+
+  BigBuffer::const_iterator iter = in.begin();
+  int result;
+  do {
+    if (stream.avail_in == 0u && iter != in.end()) {
+      stream.next_in = iter->buffer.get();
+      stream.avail_in = static_cast<uInt>(iter->size);
+      ++iter;
+    }
+
+    size_t available;
+    stream.next_out = reinterpret_cast<Bytef*>(out->NextBlock(&available));
+    stream.avail_out = static_cast<uInt>(available);
+    result = deflate(&stream, iter == in.end() ? Z_FINISH : Z_NO_FLUSH);
+    out->BackUp(stream.avail_out);
+
+    // Z_BUF_ERROR only means that no progress was possible, e.g. for an empty block.
+  } while (result == Z_OK || result == Z_BUF_ERROR);
+
+  deflateEnd(&stream);
+  return result == Z_STREAM_END;
+}
+
+}  // namespace
+
+// An entry of a BufferedArchiveWriter, ready to be appended to a zip file as is.
+struct PreparedZipEntry {
+  // The flags of the entry. ArchiveEntry::kCompress is only set if the data is deflated.
+  uint32_t flags = 0u;
+
+  uint32_t crc32 = 0u;
+  size_t uncompressed_size = 0u;
+
+  // The deflated data if the entry is compressed. Otherwise the entry's own data is stored.
+  std::unique_ptr<BigBuffer> deflated;
+};
+
+// Computes the checksum of `entry`, and deflates it if it asks to be compressed. Like
+// ZipFileWriter, an entry added with WriteFile() is stored instead if it doesn't compress by at
+// least 10%. Only reads `entry`, so entries can be prepared on any thread.
+static bool PrepareZipEntry(const BufferedArchiveWriter::Entry& entry, PreparedZipEntry* out) {
+  out->flags = entry.flags;
+  out->uncompressed_size = entry.data->size();
+
+  uLong crc = crc32(0L, Z_NULL, 0);
+  for (const BigBuffer::Block& block : *entry.data) {
+    crc = crc32(crc, block.buffer.get(), static_cast<uInt>(block.size));
+  }
+  out->crc32 = static_cast<uint32_t>(crc);
+
+  if ((entry.flags & ArchiveEntry::kCompress) == 0) {
+    return true;
+  }
+
+  std::unique_ptr<BigBuffer> deflated = util::make_unique<BigBuffer>(32u * 1024u);
+  if (!Deflate(*entry.data, deflated.get())) {
+    return false;
+  }
+
+  if (entry.written_as_file &&
+      deflated->size() + (deflated->size() / 10) > out->uncompressed_size) {
+    out->flags &= ~ArchiveEntry::kCompress;
+    return true;
+  }
+  out->deflated = std::move(deflated);
+  return true;
+}
+
+// Writes a zip file out of entries prepared with PrepareZipEntry(), one at a time. Only the
+// central directory is held in memory. Like ZipWriter, Zip64 is not supported.
+class PreparedZipWriter {
+ public:
+  PreparedZipWriter() = default;
+
+  bool Open(const StringPiece& path) {
+    file_ = {::android::base::utf8::fopen(path.to_string().c_str(), "w+b"), fclose};
+    if (!file_) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+    return true;
+  }
+
+  bool WriteEntry(const BufferedArchiveWriter::Entry& entry, const PreparedZipEntry& prepared) {
+    const BigBuffer& data = prepared.deflated ? *prepared.deflated : *entry.data;
+    if (offset_ > std::numeric_limits<uint32_t>::max() ||
+        data.size() > std::numeric_limits<uint32_t>::max() ||
+        prepared.uncompressed_size > std::numeric_limits<uint32_t>::max() ||
+        entry.path.size() > std::numeric_limits<uint16_t>::max() ||
+        entry_count_ == std::numeric_limits<uint16_t>::max()) {
+      error_ = "archive is too large";
+      return false;
+    }
+
+    // Aligned entries are padded with the extra field, like ZipWriter::kAlign32 does.
+    size_t padding = 0u;
+    if ((prepared.flags & ArchiveEntry::kAlign) != 0) {
+      const uint64_t data_offset = offset_ + kLocalFileHeaderSize + entry.path.size();
+      padding = (4u - (data_offset % 4u)) % 4u;
+    }
+
+    const uint16_t method = prepared.deflated ? kDeflatedMethod : kStoredMethod;
+    std::string header;
+    AppendLittleEndian(kLocalFileHeaderSignature, 4u, &header);
+    AppendLittleEndian(kZipVersion, 2u, &header);
+    AppendLittleEndian(0u, 2u, &header);  // General purpose flags.
+    AppendLittleEndian(method, 2u, &header);
+    AppendLittleEndian(kDosTime, 2u, &header);
+    AppendLittleEndian(kDosDate, 2u, &header);
+    AppendLittleEndian(prepared.crc32, 4u, &header);
+    AppendLittleEndian(data.size(), 4u, &header);
+    AppendLittleEndian(prepared.uncompressed_size, 4u, &header);
+    AppendLittleEndian(entry.path.size(), 2u, &header);
+    AppendLittleEndian(padding, 2u, &header);
+    header += entry.path;
+    header.append(padding, '\0');
+
+    AppendLittleEndian(kCentralDirectoryHeaderSignature, 4u, &central_directory_);
+    AppendLittleEndian(kZipVersion, 2u, &central_directory_);  // Version made by.
+    AppendLittleEndian(kZipVersion, 2u, &central_directory_);  // Version needed.
+    AppendLittleEndian(0u, 2u, &central_directory_);
+    AppendLittleEndian(method, 2u, &central_directory_);
+    AppendLittleEndian(kDosTime, 2u, &central_directory_);
+    AppendLittleEndian(kDosDate, 2u, &central_directory_);
+    AppendLittleEndian(prepared.crc32, 4u, &central_directory_);
+    AppendLittleEndian(data.size(), 4u, &central_directory_);
+    AppendLittleEndian(prepared.uncompressed_size, 4u, &central_directory_);
+    AppendLittleEndian(entry.path.size(), 2u, &central_directory_);
+    AppendLittleEndian(0u, 2u, &central_directory_);  // Extra field length.
+    AppendLittleEndian(0u, 2u, &central_directory_);  // Comment length.
+    AppendLittleEndian(0u, 2u, &central_directory_);  // Disk number.
+    AppendLittleEndian(0u, 2u, &central_directory_);  // Internal attributes.
+    AppendLittleEndian(0u, 4u, &central_directory_);  // External attributes.
+    AppendLittleEndian(offset_, 4u, &central_directory_);
+    central_directory_ += entry.path;
+
+    if (!WriteBytes(header.data(), header.size())) {
+      return false;
+    }
+    for (const BigBuffer::Block& block : data) {
+      if (!WriteBytes(block.buffer.get(), block.size)) {
+        return false;
+      }
+    }
+    entry_count_++;
+    return true;
+  }
+
+  // Writes the central directory. No entry can be added afterwards.
+  bool Finish() {
+    if (offset_ > std::numeric_limits<uint32_t>::max()) {
+      error_ = "archive is too large";
+      return false;
+    }
+
+    std::string end;
+    AppendLittleEndian(kEndOfCentralDirectorySignature, 4u, &end);
+    AppendLittleEndian(0u, 2u, &end);  // Disk number.
+    AppendLittleEndian(0u, 2u, &end);  // Disk of the central directory.
+    AppendLittleEndian(entry_count_, 2u, &end);
+    AppendLittleEndian(entry_count_, 2u, &end);
+    AppendLittleEndian(central_directory_.size(), 4u, &end);
+    AppendLittleEndian(offset_, 4u, &end);
+    AppendLittleEndian(0u, 2u, &end);  // Comment length.
+
+    if (!WriteBytes(central_directory_.data(), central_directory_.size()) ||
+        !WriteBytes(end.data(), end.size())) {
+      return false;
+    }
+    if (fflush(file_.get()) != 0) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+    return true;
+  }
+
+  std::string GetError() const {
+    return error_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PreparedZipWriter);
+
+  bool WriteBytes(const void* data, size_t len) {
+    if (fwrite(data, 1, len, file_.get()) != len) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+    offset_ += len;
+    return true;
+  }
+
+  std::unique_ptr<FILE, decltype(fclose)*> file_ = {nullptr, fclose};
+  uint64_t offset_ = 0u;
+  size_t entry_count_ = 0u;
+  std::string central_directory_;
+  std::string error_;
+};
+
+constexpr size_t PipelinedArchiveWriter::kDefaultMaxPendingBytes;
+
+PipelinedArchiveWriter::PipelinedArchiveWriter(std::unique_ptr<IArchiveWriter> writer,
+                                               size_t max_pending_bytes)
+    : PipelinedArchiveWriter(std::move(writer), {} /*zip_writer*/, 1u /*jobs*/,
+                             max_pending_bytes) {
+}
+
+PipelinedArchiveWriter::PipelinedArchiveWriter(std::unique_ptr<IArchiveWriter> writer,
+                                               std::unique_ptr<PreparedZipWriter> zip_writer,
+                                               size_t jobs, size_t max_pending_bytes)
+    : writer_(std::move(writer)),
+      zip_writer_(std::move(zip_writer)),
+      max_pending_bytes_(max_pending_bytes) {
+  for (size_t i = 0; i < std::max<size_t>(jobs, 1u); i++) {
+    threads_.emplace_back([this]() { Run(); });
+  }
+}
+
+std::unique_ptr<PipelinedArchiveWriter> PipelinedArchiveWriter::CreateZipFile(
+    IDiagnostics* diag, const StringPiece& path, size_t jobs, size_t max_pending_bytes) {
+  std::unique_ptr<PreparedZipWriter> zip_writer = util::make_unique<PreparedZipWriter>();
+  if (!zip_writer->Open(path)) {
+    diag->Error(DiagMessage(path) << zip_writer->GetError());
+    return {};
+  }
+
+  // Not using make_unique because the constructor is private.
+  return std::unique_ptr<PipelinedArchiveWriter>(new PipelinedArchiveWriter(
+      {} /*writer*/, std::move(zip_writer), jobs, max_pending_bytes));
+}
+
+PipelinedArchiveWriter::~PipelinedArchiveWriter() {
+  StopThreads();
+}
+
+void PipelinedArchiveWriter::StopThreads() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+  }
+  cond_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+bool PipelinedArchiveWriter::Finish() {
+  if (current_entry_ || finished_) {
+    return false;
+  }
+  finished_ = true;
+
+  // Only once every entry was written can the underlying archive be finished.
+  StopThreads();
+  if (HadError()) {
+    return false;
+  }
+
+  const bool finished = zip_writer_ != nullptr ? zip_writer_->Finish() : writer_->Finish();
+  if (!finished) {
+    std::string error = zip_writer_ != nullptr ? zip_writer_->GetError() : writer_->GetError();
+    std::lock_guard<std::mutex> lock(mutex_);
+    error_ = error.empty() ? "failed to finish archive" : std::move(error);
+  }
+  return finished;
+}
+
+bool PipelinedArchiveWriter::WriteFile(const StringPiece& path, uint32_t flags,
+                                       io::InputStream* in) {
+  if (current_entry_ || finished_ || HadError()) {
+    return false;
+  }
+
+  // The buffered entry remembers that it was added as a file, so the underlying archive still
+  // gets the chance to store it uncompressed if it doesn't compress well.
+  std::unique_ptr<BufferedArchiveWriter> entry = util::make_unique<BufferedArchiveWriter>();
+  if (!entry->WriteFile(path, flags, in)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_.empty()) {
+      error_ = entry->HadError() ? entry->GetError() : "failed to read " + path.to_string();
+    }
+    return false;
+  }
+  Enqueue(std::move(entry));
+  return !HadError();
+}
+
+bool PipelinedArchiveWriter::StartEntry(const StringPiece& path, uint32_t flags) {
+  if (current_entry_ || finished_ || HadError()) {
+    return false;
+  }
+  current_entry_ = util::make_unique<BufferedArchiveWriter>();
+  return current_entry_->StartEntry(path, flags);
+}
+
+bool PipelinedArchiveWriter::Write(const void* data, int len) {
+  if (!current_entry_) {
+    return false;
+  }
+  return current_entry_->Write(data, len);
+}
+
+bool PipelinedArchiveWriter::FinishEntry() {
+  if (!current_entry_ || !current_entry_->FinishEntry()) {
+    return false;
+  }
+  Enqueue(std::move(current_entry_));
+  return !HadError();
+}
+
+bool PipelinedArchiveWriter::HadError() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !error_.empty();
+}
+
+std::string PipelinedArchiveWriter::GetError() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return error_;
+}
+
+bool PipelinedArchiveWriter::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [&]() { return next_to_write_ == next_index_; });
+  return error_.empty();
+}
+
+void PipelinedArchiveWriter::Enqueue(std::unique_ptr<BufferedArchiveWriter> entry) {
+  const size_t size = entry->GetEntries().front().data->size();
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // Always accept an entry when nothing else is pending, so that an entry larger than the bound
+  // can still be written.
+  cond_.wait(lock, [&]() {
+    return pending_bytes_ == 0u || pending_bytes_ + size <= max_pending_bytes_;
+  });
+  queue_.push_back(PendingEntry{std::move(entry), size, next_index_++});
+  pending_bytes_ += size;
+  lock.unlock();
+  cond_.notify_all();
+}
+
+void PipelinedArchiveWriter::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cond_.wait(lock, [&]() { return done_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+
+    PendingEntry pending = std::move(queue_.front());
+    queue_.pop_front();
+
+    // Once an entry failed, the remaining ones are dropped.
+    bool skip = !error_.empty();
+    lock.unlock();
+
+    // Compressing is the expensive part, and is done in parallel with the other threads.
+    const BufferedArchiveWriter::Entry& entry = pending.entry->GetEntries().front();
+    PreparedZipEntry prepared;
+    std::string error;
+    if (!skip && zip_writer_ != nullptr && !PrepareZipEntry(entry, &prepared)) {
+      error = "failed to compress " + entry.path;
+    }
+
+    // The entries are taken in order, so the ones before this one are all being processed and
+    // this one's turn comes.
+    lock.lock();
+    cond_.wait(lock, [&]() { return next_to_write_ == pending.index; });
+    skip = !error_.empty() || !error.empty();
+    lock.unlock();
+
+    if (!skip) {
+      if (zip_writer_ != nullptr) {
+        if (!zip_writer_->WriteEntry(entry, prepared)) {
+          error = zip_writer_->GetError();
+        }
+      } else if (!pending.entry->WriteTo(writer_.get())) {
+        error = writer_->GetError();
+        if (error.empty()) {
+          error = "failed to write " + entry.path;
+        }
+      }
+    }
+    prepared.deflated.reset();
+    pending.entry.reset();
+
+    lock.lock();
+    if (!error.empty() && error_.empty()) {
+      error_ = std::move(error);
+    }
+    pending_bytes_ -= pending.size;
+    next_to_write_++;
+    cond_.notify_all();
+  }
+}
+
 std::unique_ptr<IArchiveWriter> CreateDirectoryArchiveWriter(IDiagnostics* diag,
                                                              const StringPiece& path) {
   std::unique_ptr<DirectoryWriter> writer = util::make_unique<DirectoryWriter>();
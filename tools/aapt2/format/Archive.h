@@ -17,11 +17,16 @@
 #ifndef AAPT_FORMAT_ARCHIVE_H
 #define AAPT_FORMAT_ARCHIVE_H
 
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "android-base/macros.h"
 #include "androidfw/StringPiece.h"
 #include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 
@@ -62,6 +67,11 @@ class IArchiveWriter : public ::google::protobuf::io::CopyingOutputStream {
   // valid between calls to StartEntry and FinishEntry.
   virtual bool Write(const void* buffer, int size) = 0;
 
+  // Completes the archive, for instance by writing the central directory of a zip file. No entry
+  // can be added afterwards. Returns false if the archive couldn't be completed, the error
+  // message can then be retrieved from GetError().
+  virtual bool Finish() = 0;
+
   // Returns true if there was an error writing to the archive.
   // The resulting error message can be retrieved from GetError().
   virtual bool HadError() const = 0;
@@ -70,6 +80,144 @@ class IArchiveWriter : public ::google::protobuf::io::CopyingOutputStream {
   virtual std::string GetError() const = 0;
 };
 
+// An IArchiveWriter that holds its entries in memory until they are written to another archive
+// with WriteTo(). This lets entries be produced on several threads and still be written to the
+// final archive in a deterministic order.
+class BufferedArchiveWriter : public IArchiveWriter {
+ public:
+  BufferedArchiveWriter() = default;
+
+  bool WriteFile(const android::StringPiece& path, uint32_t flags, io::InputStream* in) override;
+  bool StartEntry(const android::StringPiece& path, uint32_t flags) override;
+  bool FinishEntry() override;
+  bool Write(const void* buffer, int size) override;
+  bool Finish() override;
+  bool HadError() const override;
+  std::string GetError() const override;
+
+  // Writes all finished entries to `writer`, in the order they were started. Each entry is written
+  // with the same calls that were used to add it, so the result is the same as if the entries had
+  // been written to `writer` directly.
+  bool WriteTo(IArchiveWriter* writer) const;
+
+  struct Entry {
+    std::string path;
+    uint32_t flags;
+    std::unique_ptr<BigBuffer> data;
+
+    // True if the entry was added with WriteFile(), as opposed to StartEntry()/FinishEntry().
+    bool written_as_file;
+  };
+
+  // Returns the entries added so far. The last one is unfinished if an entry was started but not
+  // finished.
+  const std::vector<Entry>& GetEntries() const {
+    return entries_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BufferedArchiveWriter);
+
+  std::vector<Entry> entries_;
+  bool in_entry_ = false;
+  std::string error_;
+};
+
+class PreparedZipWriter;
+
+// An IArchiveWriter that buffers each entry in memory and hands it to background threads, which
+// write the entries to another archive in the order they were added. Compressing an entry is
+// usually the most expensive part of writing it, so this lets the caller produce the next entries
+// while the previous ones are being compressed.
+//
+// Errors of the underlying archive are reported by the next call to this writer once they happen,
+// and at the latest by Finish(). The background threads never use an IDiagnostics, errors are only
+// reported through GetError() on the caller's thread.
+class PipelinedArchiveWriter : public IArchiveWriter {
+ public:
+  // The default bound on the size of the entries waiting to be written. Adding an entry blocks
+  // while it is exceeded.
+  static constexpr size_t kDefaultMaxPendingBytes = 64u * 1024u * 1024u;
+
+  // Writes the entries to `writer` on a single background thread.
+  explicit PipelinedArchiveWriter(std::unique_ptr<IArchiveWriter> writer,
+                                  size_t max_pending_bytes = kDefaultMaxPendingBytes);
+
+  // Creates a zip file at `path`, whose entries are deflated on up to `jobs` threads in parallel,
+  // and appended to the file one at a time, in the order they were added. Entries added with
+  // WriteFile() are stored uncompressed if they don't compress well, like with
+  // CreateZipFileArchiveWriter(). Returns nullptr and logs an error if the file can't be created.
+  static std::unique_ptr<PipelinedArchiveWriter> CreateZipFile(
+      IDiagnostics* diag, const android::StringPiece& path, size_t jobs,
+      size_t max_pending_bytes = kDefaultMaxPendingBytes);
+
+  // Writes the remaining entries before destroying the underlying archive. The archive is only
+  // complete if Finish() was called.
+  ~PipelinedArchiveWriter() override;
+
+  bool WriteFile(const android::StringPiece& path, uint32_t flags, io::InputStream* in) override;
+  bool StartEntry(const android::StringPiece& path, uint32_t flags) override;
+  bool FinishEntry() override;
+  bool Write(const void* buffer, int size) override;
+
+  // Waits until every entry was written, then completes the underlying archive.
+  bool Finish() override;
+
+  bool HadError() const override;
+  std::string GetError() const override;
+
+  // Waits until every entry added so far was written to the underlying archive. Returns false if
+  // writing any of them failed.
+  bool Flush();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PipelinedArchiveWriter);
+
+  struct PendingEntry {
+    std::unique_ptr<BufferedArchiveWriter> entry;
+    size_t size;
+
+    // The position of the entry in the archive.
+    size_t index;
+  };
+
+  PipelinedArchiveWriter(std::unique_ptr<IArchiveWriter> writer,
+                         std::unique_ptr<PreparedZipWriter> zip_writer, size_t jobs,
+                         size_t max_pending_bytes);
+
+  void Enqueue(std::unique_ptr<BufferedArchiveWriter> entry);
+  void Run();
+
+  // Lets the threads write the remaining entries, and joins them.
+  void StopThreads();
+
+  // Exactly one of the two is set. Entries are deflated by the threads before being appended to
+  // `zip_writer_`, and written as they are to `writer_`.
+  std::unique_ptr<IArchiveWriter> writer_;
+  std::unique_ptr<PreparedZipWriter> zip_writer_;
+  const size_t max_pending_bytes_;
+
+  // The entry started with StartEntry() and not finished yet. Only used by the caller's thread.
+  std::unique_ptr<BufferedArchiveWriter> current_entry_;
+
+  // Whether Finish() was called. Only used by the caller's thread.
+  bool finished_ = false;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<PendingEntry> queue_;
+  size_t pending_bytes_ = 0u;
+
+  // The index of the next entry added, and of the next entry to append to the archive. The thread
+  // that took an entry appends it once its index comes up, so appends never overlap.
+  size_t next_index_ = 0u;
+  size_t next_to_write_ = 0u;
+  bool done_ = false;
+  std::string error_;
+
+  std::vector<std::thread> threads_;
+};
+
 std::unique_ptr<IArchiveWriter> CreateDirectoryArchiveWriter(IDiagnostics* diag,
                                                              const android::StringPiece& path);
 
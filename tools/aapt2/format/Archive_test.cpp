@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "format/Archive.h"
+
+#include "android-base/test_utils.h"
+
+#include "io/StringStream.h"
+#include "io/ZipArchive.h"
+#include "test/Test.h"
+
+using ::testing::NotNull;
+using ::testing::SizeIs;
+using ::testing::StrEq;
+
+namespace aapt {
+
+// An archive that fails to start any entry.
+class FailingArchiveWriter : public BufferedArchiveWriter {
+ public:
+  bool StartEntry(const android::StringPiece& path, uint32_t flags) override {
+    return false;
+  }
+
+  bool HadError() const override {
+    return true;
+  }
+
+  std::string GetError() const override {
+    return "disk full";
+  }
+};
+
+// An archive that can't be finished.
+class UnfinishableArchiveWriter : public BufferedArchiveWriter {
+ public:
+  bool Finish() override {
+    return false;
+  }
+
+  std::string GetError() const override {
+    return "disk full";
+  }
+};
+
+static std::string ReadEntry(const BufferedArchiveWriter::Entry& entry) {
+  std::string data;
+  for (const BigBuffer::Block& block : *entry.data) {
+    data.append(reinterpret_cast<const char*>(block.buffer.get()), block.size);
+  }
+  return data;
+}
+
+TEST(PipelinedArchiveWriterTest, WritesEntriesInOrder) {
+  std::unique_ptr<BufferedArchiveWriter> buffered = util::make_unique<BufferedArchiveWriter>();
+  BufferedArchiveWriter* buffered_ptr = buffered.get();
+
+  // A bound smaller than every entry makes each one wait for the previous one.
+  PipelinedArchiveWriter writer(std::move(buffered), 1u /*max_pending_bytes*/);
+  for (int i = 0; i < 10; i++) {
+    const std::string path = "res/raw/file" + std::to_string(i);
+    if (i % 2 == 0) {
+      io::StringInputStream in("file " + std::to_string(i));
+      ASSERT_TRUE(writer.WriteFile(path, ArchiveEntry::kCompress, &in));
+    } else {
+      ASSERT_TRUE(writer.StartEntry(path, 0u));
+      ASSERT_TRUE(writer.Write("entry ", 6));
+      ASSERT_TRUE(writer.Write(std::to_string(i).data(), 1));
+      ASSERT_TRUE(writer.FinishEntry());
+    }
+  }
+  ASSERT_TRUE(writer.Flush());
+
+  const std::vector<BufferedArchiveWriter::Entry>& entries = buffered_ptr->GetEntries();
+  ASSERT_THAT(entries, SizeIs(10u));
+  for (size_t i = 0; i < entries.size(); i++) {
+    EXPECT_THAT(entries[i].path, StrEq("res/raw/file" + std::to_string(i)));
+    if (i % 2 == 0) {
+      EXPECT_TRUE(entries[i].written_as_file);
+      EXPECT_EQ(ArchiveEntry::kCompress, entries[i].flags);
+      EXPECT_THAT(ReadEntry(entries[i]), StrEq("file " + std::to_string(i)));
+    } else {
+      EXPECT_FALSE(entries[i].written_as_file);
+      EXPECT_THAT(ReadEntry(entries[i]), StrEq("entry " + std::to_string(i)));
+    }
+  }
+}
+
+TEST(PipelinedArchiveWriterTest, ReportsErrorsOfUnderlyingArchive) {
+  PipelinedArchiveWriter writer(util::make_unique<FailingArchiveWriter>());
+
+  io::StringInputStream in("data");
+  writer.WriteFile("res/raw/file", 0u, &in);
+  EXPECT_FALSE(writer.Flush());
+  EXPECT_TRUE(writer.HadError());
+  EXPECT_THAT(writer.GetError(), StrEq("disk full"));
+
+  // No more entries are accepted.
+  EXPECT_FALSE(writer.StartEntry("res/raw/other", 0u));
+}
+
+TEST(PipelinedArchiveWriterTest, ReportsErrorsFinishingUnderlyingArchive) {
+  PipelinedArchiveWriter writer(util::make_unique<UnfinishableArchiveWriter>());
+
+  io::StringInputStream in("data");
+  ASSERT_TRUE(writer.WriteFile("res/raw/file", 0u, &in));
+  EXPECT_FALSE(writer.Finish());
+  EXPECT_TRUE(writer.HadError());
+  EXPECT_THAT(writer.GetError(), StrEq("disk full"));
+}
+
+TEST(PipelinedArchiveWriterTest, AcceptsNoEntryOnceFinished) {
+  std::unique_ptr<BufferedArchiveWriter> buffered = util::make_unique<BufferedArchiveWriter>();
+  BufferedArchiveWriter* buffered_ptr = buffered.get();
+  PipelinedArchiveWriter writer(std::move(buffered));
+
+  io::StringInputStream in("data");
+  ASSERT_TRUE(writer.WriteFile("res/raw/file", 0u, &in));
+  ASSERT_TRUE(writer.Finish());
+  EXPECT_THAT(buffered_ptr->GetEntries(), SizeIs(1u));
+
+  io::StringInputStream other_in("data");
+  EXPECT_FALSE(writer.WriteFile("res/raw/other", 0u, &other_in));
+  EXPECT_FALSE(writer.StartEntry("res/raw/other", 0u));
+  EXPECT_FALSE(writer.Finish());
+}
+
+TEST(PipelinedArchiveWriterTest, WritesZipFileWithParallelCompression) {
+  TemporaryDir dir;
+  std::string path = dir.path;
+  file::AppendPath(&path, "test.apk");
+  StdErrDiagnostics diag;
+
+  // Compressible and incompressible entries, some of them aligned, across several threads.
+  std::string incompressible(4096u, '\0');
+  uint32_t seed = 1u;
+  for (char& c : incompressible) {
+    seed = seed * 1103515245u + 12345u;
+    c = static_cast<char>(seed >> 16);
+  }
+  {
+    std::unique_ptr<PipelinedArchiveWriter> writer =
+        PipelinedArchiveWriter::CreateZipFile(&diag, path, 4u /*jobs*/, 1u /*max_pending_bytes*/);
+    ASSERT_THAT(writer, NotNull());
+    for (int i = 0; i < 20; i++) {
+      const std::string entry_path = "res/raw/file" + std::to_string(i);
+      if (i % 2 == 0) {
+        io::StringInputStream in(i % 4 == 0 ? std::string(1000u + i, 'a') : incompressible);
+        ASSERT_TRUE(writer->WriteFile(entry_path, ArchiveEntry::kCompress, &in));
+      } else {
+        const std::string contents = "entry " + std::to_string(i);
+        ASSERT_TRUE(writer->StartEntry(entry_path, ArchiveEntry::kAlign));
+        ASSERT_TRUE(writer->Write(contents.data(), static_cast<int>(contents.size())));
+        ASSERT_TRUE(writer->FinishEntry());
+      }
+    }
+    ASSERT_TRUE(writer->Finish());
+  }
+
+  std::string error;
+  std::unique_ptr<io::ZipFileCollection> collection = io::ZipFileCollection::Create(path, &error);
+  ASSERT_THAT(collection, NotNull()) << error;
+  for (int i = 0; i < 20; i++) {
+    io::IFile* file = collection->FindFile("res/raw/file" + std::to_string(i));
+    ASSERT_THAT(file, NotNull());
+    std::unique_ptr<io::IData> data = file->OpenAsData();
+    ASSERT_THAT(data, NotNull());
+    const std::string contents(reinterpret_cast<const char*>(data->data()), data->size());
+    if (i % 4 == 0) {
+      EXPECT_TRUE(file->WasCompressed());
+      EXPECT_EQ(std::string(1000u + i, 'a'), contents);
+    } else if (i % 2 == 0) {
+      // Stored, since it doesn't compress well.
+      EXPECT_FALSE(file->WasCompressed());
+      EXPECT_EQ(incompressible, contents);
+    } else {
+      EXPECT_FALSE(file->WasCompressed());
+      EXPECT_THAT(contents, StrEq("entry " + std::to_string(i)));
+    }
+  }
+}
+
+}  // namespace aapt
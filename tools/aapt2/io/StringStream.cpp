@@ -51,6 +51,15 @@ size_t StringInputStream::TotalSize() const {
   return str_.size();
 }
 
+bool StringInputStream::CanRewind() const {
+  return true;
+}
+
+bool StringInputStream::Rewind() {
+  offset_ = 0;
+  return true;
+}
+
 StringOutputStream::StringOutputStream(std::string* str, size_t buffer_capacity)
     : str_(str),
       buffer_capacity_(buffer_capacity),
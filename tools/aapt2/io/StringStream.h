@@ -47,6 +47,10 @@ class StringInputStream : public KnownSizeInputStream {
 
   size_t TotalSize() const override;
 
+  bool CanRewind() const override;
+
+  bool Rewind() override;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(StringInputStream);
 
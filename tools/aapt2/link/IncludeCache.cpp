@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "link/IncludeCache.h"
+
+#include <sys/stat.h>
+
+#include "android-base/stringprintf.h"
+
+using ::android::base::StringPrintf;
+
+namespace aapt {
+
+IncludeCache::FileStamp IncludeCache::GetFileStamp(const std::string& path) {
+  FileStamp stamp;
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0) {
+    stamp.size = static_cast<int64_t>(st.st_size);
+    stamp.mtime = static_cast<int64_t>(st.st_mtime);
+  }
+  return stamp;
+}
+
+const IncludeCache::Include* IncludeCache::FindInclude(const std::string& path) {
+  auto iter = includes_.find(path);
+  if (iter == includes_.end() || !(iter->second.stamp == GetFileStamp(path))) {
+    include_miss_count_++;
+    return nullptr;
+  }
+  include_hit_count_++;
+  return &iter->second.include;
+}
+
+void IncludeCache::AddInclude(const std::string& path, Include include) {
+  includes_[path] = IncludeEntry{GetFileStamp(path), std::move(include)};
+}
+
+std::shared_ptr<AssetManagerSymbolSource> IncludeCache::FindAssetSource(
+    const std::vector<std::string>& paths) {
+  auto iter = asset_sources_.find(paths);
+  if (iter != asset_sources_.end()) {
+    bool changed = false;
+    for (size_t i = 0; i < paths.size(); i++) {
+      if (!(iter->second.stamps[i] == GetFileStamp(paths[i]))) {
+        changed = true;
+        break;
+      }
+    }
+
+    if (!changed) {
+      asset_source_hit_count_++;
+      return iter->second.source;
+    }
+
+    // The APKs will be loaded again, so the stale source is of no use anymore.
+    dropped_symbol_hit_count_ += iter->second.source->GetCacheHitCount();
+    dropped_symbol_miss_count_ += iter->second.source->GetCacheMissCount();
+    asset_sources_.erase(iter);
+  }
+  asset_source_miss_count_++;
+  return {};
+}
+
+void IncludeCache::AddAssetSource(const std::vector<std::string>& paths,
+                                  std::shared_ptr<AssetManagerSymbolSource> source) {
+  AssetSourceEntry entry;
+  for (const std::string& path : paths) {
+    entry.stamps.push_back(GetFileStamp(path));
+  }
+  entry.source = std::move(source);
+
+  auto iter = asset_sources_.find(paths);
+  if (iter != asset_sources_.end()) {
+    dropped_symbol_hit_count_ += iter->second.source->GetCacheHitCount();
+    dropped_symbol_miss_count_ += iter->second.source->GetCacheMissCount();
+    iter->second = std::move(entry);
+  } else {
+    asset_sources_.emplace(paths, std::move(entry));
+  }
+}
+
+static std::string FormatHitRate(size_t hits, size_t misses) {
+  const size_t total = hits + misses;
+  return std::to_string(hits) + "/" + std::to_string(total) +
+         StringPrintf(" hits (%.1f%%)",
+                      total == 0u ? 0.0 : 100.0 * static_cast<double>(hits) / total);
+}
+
+void IncludeCache::PrintStats(std::ostream* out) const {
+  size_t symbol_hit_count = dropped_symbol_hit_count_;
+  size_t symbol_miss_count = dropped_symbol_miss_count_;
+  for (const auto& entry : asset_sources_) {
+    symbol_hit_count += entry.second.source->GetCacheHitCount();
+    symbol_miss_count += entry.second.source->GetCacheMissCount();
+  }
+
+  *out << "include paths: " << FormatHitRate(include_hit_count_, include_miss_count_) << "\n";
+  *out << "include asset managers: "
+       << FormatHitRate(asset_source_hit_count_, asset_source_miss_count_) << "\n";
+  *out << "include symbols: " << FormatHitRate(symbol_hit_count, symbol_miss_count) << "\n";
+}
+
+}  // namespace aapt
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_LINK_INCLUDECACHE_H
+#define AAPT_LINK_INCLUDECACHE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "android-base/macros.h"
+
+#include "LoadedApk.h"
+#include "process/SymbolTable.h"
+
+namespace aapt {
+
+// Keeps the APKs included with -I loaded between the links of a long-running process, such as
+// `aapt2 daemon`. Loading the framework's resources table and looking up its symbols dominates the
+// cost of linking a small app, and is the same for every link against the same android.jar.
+//
+// Every cached value is keyed by the paths it was loaded from, and is dropped as soon as the size
+// or modification time of one of them changes. Not thread-safe.
+class IncludeCache {
+ public:
+  IncludeCache() = default;
+
+  // What was loaded from an include path.
+  struct Include {
+    // Set if the path is a static library, otherwise the path is a regular APK.
+    std::shared_ptr<LoadedApk> static_library;
+  };
+
+  // Returns the include loaded from `path`, if the file hasn't changed since it was added.
+  const Include* FindInclude(const std::string& path);
+
+  void AddInclude(const std::string& path, Include include);
+
+  // Returns the symbol source holding the APKs in `paths`, added in that order, if none of them
+  // changed since it was added.
+  std::shared_ptr<AssetManagerSymbolSource> FindAssetSource(const std::vector<std::string>& paths);
+
+  void AddAssetSource(const std::vector<std::string>& paths,
+                      std::shared_ptr<AssetManagerSymbolSource> source);
+
+  // Prints the hit rate of each cache.
+  void PrintStats(std::ostream* out) const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(IncludeCache);
+
+  // Identifies the version of a file.
+  struct FileStamp {
+    int64_t size = -1;
+    int64_t mtime = -1;
+
+    bool operator==(const FileStamp& rhs) const {
+      return size == rhs.size && mtime == rhs.mtime;
+    }
+  };
+
+  static FileStamp GetFileStamp(const std::string& path);
+
+  struct IncludeEntry {
+    FileStamp stamp;
+    Include include;
+  };
+
+  struct AssetSourceEntry {
+    std::vector<FileStamp> stamps;
+    std::shared_ptr<AssetManagerSymbolSource> source;
+  };
+
+  std::map<std::string, IncludeEntry> includes_;
+  std::map<std::vector<std::string>, AssetSourceEntry> asset_sources_;
+
+  size_t include_hit_count_ = 0u;
+  size_t include_miss_count_ = 0u;
+  size_t asset_source_hit_count_ = 0u;
+  size_t asset_source_miss_count_ = 0u;
+
+  // Symbol lookups of asset sources that were dropped.
+  size_t dropped_symbol_hit_count_ = 0u;
+  size_t dropped_symbol_miss_count_ = 0u;
+};
+
+}  // namespace aapt
+
+#endif /* AAPT_LINK_INCLUDECACHE_H */
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "link/IncludeCache.h"
+
+#include <sstream>
+
+#include "android-base/file.h"
+#include "android-base/test_utils.h"
+
+#include "test/Test.h"
+
+using ::testing::Eq;
+using ::testing::HasSubstr;
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+namespace aapt {
+
+TEST(IncludeCacheTest, FindIncludeMissesChangedFiles) {
+  TemporaryFile file;
+  ASSERT_TRUE(android::base::WriteStringToFile("apk", file.path));
+
+  IncludeCache cache;
+  EXPECT_THAT(cache.FindInclude(file.path), IsNull());
+
+  cache.AddInclude(file.path, IncludeCache::Include{});
+  const IncludeCache::Include* include = cache.FindInclude(file.path);
+  ASSERT_THAT(include, NotNull());
+  EXPECT_THAT(include->static_library, IsNull());
+
+  ASSERT_TRUE(android::base::WriteStringToFile("changed apk", file.path));
+  EXPECT_THAT(cache.FindInclude(file.path), IsNull());
+}
+
+TEST(IncludeCacheTest, FindAssetSourceMatchesPathsInOrder) {
+  TemporaryFile file_a;
+  TemporaryFile file_b;
+  const std::vector<std::string> paths = {file_a.path, file_b.path};
+
+  IncludeCache cache;
+  auto source = std::make_shared<AssetManagerSymbolSource>();
+  cache.AddAssetSource(paths, source);
+
+  EXPECT_THAT(cache.FindAssetSource(paths), Eq(source));
+  EXPECT_THAT(cache.FindAssetSource({file_b.path, file_a.path}), IsNull());
+  EXPECT_THAT(cache.FindAssetSource({file_a.path}), IsNull());
+
+  std::ostringstream stats;
+  cache.PrintStats(&stats);
+  EXPECT_THAT(stats.str(), HasSubstr("include asset managers: 1/3 hits"));
+}
+
+}  // namespace aapt
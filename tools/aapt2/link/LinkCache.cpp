@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "link/LinkCache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "android-base/file.h"
+#include "android-base/logging.h"
+#include "android-base/stringprintf.h"
+#include "android-base/unique_fd.h"
+#include "android-base/utf8.h"
+
+#include "ResourceValues.h"
+#include "io/StringStream.h"
+#include "util/Files.h"
+#include "util/Util.h"
+
+using ::android::StringPiece;
+using ::android::base::StringPrintf;
+using ::android::base::unique_fd;
+
+namespace aapt {
+
+// 'AXLC', followed by the version of the entry format.
+constexpr static uint32_t kEntryMagic = 0x434c5841u;
+constexpr static uint32_t kEntryVersion = 2u;
+
+constexpr static const char* kEntryExtension = ".xmlc";
+
+LinkCache::KeyBuilder::KeyBuilder()
+    : hash_a_(0xcbf29ce484222325ull), hash_b_(0x84222325cbf29ce4ull) {
+}
+
+LinkCache::KeyBuilder& LinkCache::KeyBuilder::Append(const void* data, size_t len) {
+  // Two different 64-bit hashes: FNV-1a, and a multiplicative hash with a rotation, so that a
+  // collision would have to happen in both.
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < len; i++) {
+    hash_a_ = (hash_a_ ^ bytes[i]) * 0x100000001b3ull;
+    hash_b_ = (((hash_b_ << 5) | (hash_b_ >> 59)) ^ bytes[i]) * 0x9e3779b97f4a7c15ull;
+  }
+  return *this;
+}
+
+LinkCache::KeyBuilder& LinkCache::KeyBuilder::Append(const StringPiece& str) {
+  // The length goes first, so that consecutive strings can't run into each other.
+  Append(static_cast<uint64_t>(str.size()));
+  return Append(str.data(), str.size());
+}
+
+LinkCache::KeyBuilder& LinkCache::KeyBuilder::Append(uint64_t value) {
+  uint8_t bytes[sizeof(value)];
+  for (size_t i = 0; i < sizeof(value); i++) {
+    bytes[i] = static_cast<uint8_t>(value >> (i * 8));
+  }
+  return Append(bytes, sizeof(bytes));
+}
+
+// Creates a file next to `path` that no other writer uses, like mkstemp(). Its name doesn't end
+// with kEntryExtension, so Prune() never deletes it. Returns an invalid fd, with errno set, if no
+// file can be created.
+static unique_fd CreateTempFile(const std::string& path, std::string* out_tmp_path) {
+  std::random_device random_device;
+  for (int attempt = 0; attempt < 100; attempt++) {
+    *out_tmp_path = StringPrintf("%s.%08x.tmp", path.c_str(), random_device());
+    unique_fd fd(TEMP_FAILURE_RETRY(::android::base::utf8::open(
+        out_tmp_path->c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC | O_BINARY, 0666)));
+    if (fd != -1 || errno != EEXIST) {
+      return fd;
+    }
+  }
+  return {};
+}
+
+// Appends what linking sees of a symbol, or a marker if it wasn't found.
+static void AppendSymbol(const SymbolTable::Symbol* symbol, LinkCache::KeyBuilder* key) {
+  if (symbol == nullptr) {
+    key->Append(0u);
+    return;
+  }
+
+  key->Append(symbol->id ? symbol->id.value().id + 1u : 1u);
+  key->Append(static_cast<uint64_t>(symbol->is_public))
+      .Append(static_cast<uint64_t>(symbol->is_dynamic));
+  const Attribute* attr = symbol->attribute.get();
+  if (attr == nullptr) {
+    key->Append(0u);
+    return;
+  }
+
+  key->Append(1u);
+  key->Append(attr->type_mask);
+  key->Append(static_cast<uint64_t>(static_cast<int64_t>(attr->min_int)));
+  key->Append(static_cast<uint64_t>(static_cast<int64_t>(attr->max_int)));
+  key->Append(attr->symbols.size());
+  for (const Attribute::Symbol& attr_symbol : attr->symbols) {
+    key->Append(attr_symbol.symbol.name ? attr_symbol.symbol.name.value().to_string()
+                                        : std::string());
+    key->Append(attr_symbol.symbol.id ? attr_symbol.symbol.id.value().id : 0u);
+    key->Append(attr_symbol.value);
+  }
+}
+
+LinkCache::KeyBuilder& LinkCache::KeyBuilder::AppendSymbols(const SymbolTable::Lookups& lookups,
+                                                            SymbolTable* symbols) {
+  Append(lookups.names.size());
+  for (const ResourceName& name : lookups.names) {
+    Append(name.to_string());
+    AppendSymbol(symbols->FindByName(name), this);
+  }
+
+  Append(lookups.ids.size());
+  for (const ResourceId& id : lookups.ids) {
+    Append(id.id);
+    AppendSymbol(symbols->FindById(id), this);
+  }
+  return *this;
+}
+
+LinkCache::KeyBuilder& LinkCache::KeyBuilder::AppendFileStat(const std::string& path) {
+  Append(path);
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0) {
+    Append(static_cast<uint64_t>(st.st_size));
+    Append(static_cast<uint64_t>(st.st_mtime));
+  }
+  return *this;
+}
+
+std::string LinkCache::KeyBuilder::ToString() const {
+  return StringPrintf("%016llx%016llx", static_cast<unsigned long long>(hash_a_),
+                      static_cast<unsigned long long>(hash_b_));
+}
+
+std::unique_ptr<LinkCache> LinkCache::Open(const std::string& dir, IDiagnostics* diag) {
+  if (file::GetFileType(dir) != file::FileType::kDirectory && !file::mkdirs(dir)) {
+    diag->Error(DiagMessage(dir) << "failed to create directory: " << strerror(errno));
+    return {};
+  }
+  return std::unique_ptr<LinkCache>(new LinkCache(dir, diag));
+}
+
+std::string LinkCache::GetPath(const std::string& key) const {
+  std::string path = dir_;
+  file::AppendPath(&path, key + kEntryExtension);
+  return path;
+}
+
+static void AppendUint32(uint32_t value, std::string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void AppendString(const StringPiece& str, std::string* out) {
+  AppendUint32(static_cast<uint32_t>(str.size()), out);
+  out->append(str.data(), str.size());
+}
+
+namespace {
+
+// Reads the fields of a cache entry, in host byte order.
+class EntryReader {
+ public:
+  explicit EntryReader(const std::string& data) : data_(data) {
+  }
+
+  bool ReadUint32(uint32_t* out) {
+    if (data_.size() - offset_ < sizeof(*out)) {
+      return false;
+    }
+    memcpy(out, data_.data() + offset_, sizeof(*out));
+    offset_ += sizeof(*out);
+    return true;
+  }
+
+  bool ReadString(std::string* out) {
+    uint32_t len;
+    if (!ReadUint32(&len) || data_.size() - offset_ < len) {
+      return false;
+    }
+    out->assign(data_, offset_, len);
+    offset_ += len;
+    return true;
+  }
+
+  bool AtEnd() const {
+    return offset_ == data_.size();
+  }
+
+ private:
+  const std::string& data_;
+  size_t offset_ = 0u;
+};
+
+}  // namespace
+
+bool LinkCache::Find(const std::string& key, SymbolTable* symbols,
+                     std::vector<Document>* out_docs) {
+  std::string contents;
+  if (!android::base::ReadFileToString(GetPath(key), &contents)) {
+    miss_count_++;
+    return false;
+  }
+
+  EntryReader reader(contents);
+  uint32_t magic;
+  uint32_t version;
+  if (!reader.ReadUint32(&magic) || magic != kEntryMagic || !reader.ReadUint32(&version) ||
+      version != kEntryVersion) {
+    miss_count_++;
+    return false;
+  }
+
+  // The documents are only valid if the symbols looked up to produce them are unchanged.
+  SymbolTable::Lookups lookups;
+  uint32_t name_count;
+  if (!reader.ReadUint32(&name_count)) {
+    miss_count_++;
+    return false;
+  }
+  for (uint32_t i = 0; i < name_count; i++) {
+    ResourceName name;
+    uint32_t type;
+    if (!reader.ReadString(&name.package) || !reader.ReadUint32(&type) ||
+        type > static_cast<uint32_t>(ResourceType::kXml) || !reader.ReadString(&name.entry)) {
+      miss_count_++;
+      return false;
+    }
+    name.type = static_cast<ResourceType>(type);
+    lookups.names.insert(std::move(name));
+  }
+
+  uint32_t id_count;
+  if (!reader.ReadUint32(&id_count)) {
+    miss_count_++;
+    return false;
+  }
+  for (uint32_t i = 0; i < id_count; i++) {
+    uint32_t id;
+    if (!reader.ReadUint32(&id)) {
+      miss_count_++;
+      return false;
+    }
+    lookups.ids.insert(ResourceId(id));
+  }
+
+  std::string symbols_key;
+  uint32_t count;
+  if (!reader.ReadString(&symbols_key) ||
+      symbols_key != KeyBuilder().AppendSymbols(lookups, symbols).ToString() ||
+      !reader.ReadUint32(&count)) {
+    miss_count_++;
+    return false;
+  }
+
+  std::vector<Document> docs;
+  for (uint32_t i = 0; i < count; i++) {
+    Document doc;
+    std::string config_data;
+    uint32_t written_as_file;
+    if (!reader.ReadString(&config_data) ||
+        config_data.size() != sizeof(android::ResTable_config) ||
+        !reader.ReadString(&doc.path) || !reader.ReadUint32(&doc.flags) ||
+        !reader.ReadUint32(&written_as_file) || !reader.ReadString(&doc.data)) {
+      miss_count_++;
+      return false;
+    }
+    memcpy(static_cast<android::ResTable_config*>(&doc.config), config_data.data(),
+           config_data.size());
+    doc.written_as_file = written_as_file != 0u;
+    docs.push_back(std::move(doc));
+  }
+
+  if (!reader.AtEnd()) {
+    miss_count_++;
+    return false;
+  }
+
+  used_keys_.insert(key);
+  hit_count_++;
+  *out_docs = std::move(docs);
+  return true;
+}
+
+void LinkCache::Put(const std::string& key, const SymbolTable::Lookups& lookups,
+                    SymbolTable* symbols, const BufferedArchiveWriter& writer,
+                    const std::vector<ConfigDescription>& configs) {
+  const std::vector<BufferedArchiveWriter::Entry>& entries = writer.GetEntries();
+  CHECK(entries.size() == configs.size()) << "every entry needs a configuration";
+
+  std::string contents;
+  AppendUint32(kEntryMagic, &contents);
+  AppendUint32(kEntryVersion, &contents);
+  AppendUint32(static_cast<uint32_t>(lookups.names.size()), &contents);
+  for (const ResourceName& name : lookups.names) {
+    AppendString(name.package, &contents);
+    AppendUint32(static_cast<uint32_t>(name.type), &contents);
+    AppendString(name.entry, &contents);
+  }
+  AppendUint32(static_cast<uint32_t>(lookups.ids.size()), &contents);
+  for (const ResourceId& id : lookups.ids) {
+    AppendUint32(id.id, &contents);
+  }
+  AppendString(KeyBuilder().AppendSymbols(lookups, symbols).ToString(), &contents);
+  AppendUint32(static_cast<uint32_t>(entries.size()), &contents);
+  for (size_t i = 0; i < entries.size(); i++) {
+    const BufferedArchiveWriter::Entry& entry = entries[i];
+    const android::ResTable_config& config = configs[i];
+    AppendString(StringPiece(reinterpret_cast<const char*>(&config), sizeof(config)), &contents);
+    AppendString(entry.path, &contents);
+    AppendUint32(entry.flags, &contents);
+    AppendUint32(entry.written_as_file ? 1u : 0u, &contents);
+    AppendUint32(static_cast<uint32_t>(entry.data->size()), &contents);
+    for (const BigBuffer::Block& block : *entry.data) {
+      contents.append(reinterpret_cast<const char*>(block.buffer.get()), block.size);
+    }
+  }
+
+  // Write to a temporary file of our own first, so that a concurrent or interrupted link never
+  // sees a partial entry, and concurrent writers of the same entry don't write over each other.
+  const std::string path = GetPath(key);
+  std::string tmp_path;
+  unique_fd fd = CreateTempFile(path, &tmp_path);
+  if (fd == -1) {
+    diag_->Warn(DiagMessage(path) << "failed to write cache entry: " << strerror(errno));
+    return;
+  }
+
+  const bool written = android::base::WriteStringToFd(contents, fd);
+  fd.reset();
+  if (!written || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    diag_->Warn(DiagMessage(path) << "failed to write cache entry: " << strerror(errno));
+    remove(tmp_path.c_str());
+    return;
+  }
+  used_keys_.insert(key);
+}
+
+bool LinkCache::WriteDocument(const Document& doc, IArchiveWriter* writer) {
+  if (doc.written_as_file) {
+    io::StringInputStream in(doc.data);
+    return writer->WriteFile(doc.path, doc.flags, &in);
+  }
+
+  return writer->StartEntry(doc.path, doc.flags) &&
+         writer->Write(doc.data.data(), static_cast<int>(doc.data.size())) &&
+         writer->FinishEntry();
+}
+
+void LinkCache::Prune() {
+  Maybe<std::vector<std::string>> files = file::FindFiles(dir_, diag_);
+  if (!files) {
+    return;
+  }
+
+  for (const std::string& file : files.value()) {
+    StringPiece name = file;
+    if (!util::EndsWith(name, kEntryExtension) ||
+        used_keys_.count(name.substr(0, name.size() - strlen(kEntryExtension)).to_string()) != 0) {
+      continue;
+    }
+
+    std::string path = dir_;
+    file::AppendPath(&path, file);
+    if (remove(path.c_str()) != 0) {
+      diag_->Warn(DiagMessage(path) << "failed to delete stale cache entry: " << strerror(errno));
+    }
+  }
+}
+
+}  // namespace aapt
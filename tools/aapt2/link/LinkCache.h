@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_LINK_LINKCACHE_H
+#define AAPT_LINK_LINKCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "android-base/macros.h"
+#include "androidfw/StringPiece.h"
+
+#include "ConfigDescription.h"
+#include "Diagnostics.h"
+#include "format/Archive.h"
+#include "process/SymbolTable.h"
+
+namespace aapt {
+
+// A persistent, on-disk cache of linked and flattened XML files, used by `aapt2 link` when
+// --incremental-dir is set. Linking an XML file only depends on the compiled file itself and on
+// the symbols it looks up, so when neither changed since the last link, the file's output archive
+// entries (including any auto-versioned copies) can be reused as is.
+//
+// An entry is keyed on the file, and records the names and IDs of the symbols that were looked up
+// while linking it. The entry is only used while these still resolve to the same symbols, so that
+// changing a resource only invalidates the files that reference it.
+//
+// Every cache entry is a single file named after its key. Entries that were not used by a link are
+// deleted by Prune(), so the cache never grows past the size of one build's XML files.
+//
+// A cache directory is meant to be used by a single link at a time. Concurrent links sharing one
+// still only read complete entries, as each entry is written to its own temporary file and then
+// renamed. But each link's Prune() deletes the entries only the others used, so they miss.
+class LinkCache {
+ public:
+  // An archive entry produced by linking an XML file.
+  struct Document {
+    // The configuration of the resource this document was written for. It differs from the
+    // configuration of the original file when the document is an auto-versioned copy.
+    ConfigDescription config;
+
+    std::string path;
+    uint32_t flags = 0u;
+
+    // Whether the entry was written with IArchiveWriter::WriteFile().
+    bool written_as_file = false;
+
+    std::string data;
+  };
+
+  // Builds a 128-bit cache key out of everything a cached value depends on.
+  class KeyBuilder {
+   public:
+    KeyBuilder();
+
+    KeyBuilder& Append(const void* data, size_t len);
+    KeyBuilder& Append(const android::StringPiece& str);
+    KeyBuilder& Append(uint64_t value);
+
+    // Looks up every name and ID of `lookups` in `symbols`, and appends the ID, visibility and
+    // attribute definition of each symbol found. These are all that XmlReferenceLinker uses.
+    KeyBuilder& AppendSymbols(const SymbolTable::Lookups& lookups, SymbolTable* symbols);
+
+    // Appends the path, size and modification time of a file, or only its path if it doesn't
+    // exist.
+    KeyBuilder& AppendFileStat(const std::string& path);
+
+    // Returns the key as a hex string.
+    std::string ToString() const;
+
+   private:
+    uint64_t hash_a_;
+    uint64_t hash_b_;
+  };
+
+  // Opens the cache stored in `dir`, creating the directory if needed.
+  // Returns nullptr and logs an error if the directory can't be created.
+  static std::unique_ptr<LinkCache> Open(const std::string& dir, IDiagnostics* diag);
+
+  // Returns the documents stored for `key` in `out_docs`. Returns false if there are none, if the
+  // symbols recorded with them no longer resolve the same way in `symbols`, or if the cache entry
+  // is unreadable.
+  bool Find(const std::string& key, SymbolTable* symbols, std::vector<Document>* out_docs);
+
+  // Stores the finished entries of `writer` for `key`, along with the configuration of the resource
+  // each was written for, and the symbols that were looked up in `symbols` to produce them.
+  // Failures are only reported as warnings, since the cache is optional.
+  void Put(const std::string& key, const SymbolTable::Lookups& lookups, SymbolTable* symbols,
+           const BufferedArchiveWriter& writer, const std::vector<ConfigDescription>& configs);
+
+  // Writes `doc` to `writer` the same way it was originally written.
+  static bool WriteDocument(const Document& doc, IArchiveWriter* writer);
+
+  // Deletes every cache entry that was neither found nor stored since the cache was opened,
+  // including the ones another link sharing the directory still uses, see above.
+  void Prune();
+
+  size_t GetHitCount() const {
+    return hit_count_;
+  }
+
+  size_t GetMissCount() const {
+    return miss_count_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LinkCache);
+
+  LinkCache(const std::string& dir, IDiagnostics* diag) : dir_(dir), diag_(diag) {
+  }
+
+  std::string GetPath(const std::string& key) const;
+
+  std::string dir_;
+  IDiagnostics* diag_;
+  std::unordered_set<std::string> used_keys_;
+  size_t hit_count_ = 0u;
+  size_t miss_count_ = 0u;
+};
+
+}  // namespace aapt
+
+#endif /* AAPT_LINK_LINKCACHE_H */
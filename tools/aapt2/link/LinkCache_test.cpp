@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "link/LinkCache.h"
+
+#include <thread>
+
+#include "android-base/test_utils.h"
+
+#include "io/StringStream.h"
+#include "test/Test.h"
+
+using ::testing::IsEmpty;
+using ::testing::NotNull;
+using ::testing::SizeIs;
+using ::testing::StrEq;
+
+namespace aapt {
+
+// Returns a symbol table with a string and an attribute, whose string has the given visibility.
+static std::unique_ptr<SymbolTable> MakeSymbols(NameMangler* mangler, bool public_string) {
+  test::StaticSymbolSourceBuilder builder;
+  if (public_string) {
+    builder.AddPublicSymbol("com.app.test:string/foo", ResourceId(0x7f010000));
+  } else {
+    builder.AddSymbol("com.app.test:string/foo", ResourceId(0x7f010000));
+  }
+  builder.AddPublicSymbol(
+      "com.app.test:attr/bar", ResourceId(0x7f020000),
+      test::AttributeBuilder().SetTypeMask(android::ResTable_map::TYPE_ANY).Build());
+
+  std::unique_ptr<SymbolTable> symbols = util::make_unique<SymbolTable>(mangler);
+  symbols->AppendSource(builder.Build());
+  return symbols;
+}
+
+// Stores an entry for `key` with one document written as a stream and one written as a file, which
+// depends on `lookups`.
+static void PutTestEntry(LinkCache* cache, const std::string& key,
+                         const SymbolTable::Lookups& lookups, SymbolTable* symbols) {
+  BufferedArchiveWriter writer;
+  ASSERT_TRUE(writer.StartEntry("res/layout/main.xml", ArchiveEntry::kCompress));
+  ASSERT_TRUE(writer.Write("v1", 2));
+  ASSERT_TRUE(writer.FinishEntry());
+
+  io::StringInputStream in("v21");
+  ASSERT_TRUE(writer.WriteFile("res/layout-v21/main.xml", ArchiveEntry::kCompress, &in));
+
+  cache->Put(key, lookups, symbols, writer,
+             {ConfigDescription::DefaultConfig(), test::ParseConfigOrDie("v21")});
+}
+
+TEST(LinkCacheTest, FindReturnsStoredDocuments) {
+  TemporaryDir dir;
+  StdErrDiagnostics diag;
+
+  NameMangler mangler(NameManglerPolicy{"com.app.test"});
+  std::unique_ptr<SymbolTable> symbols = MakeSymbols(&mangler, true /*public_string*/);
+
+  std::unique_ptr<LinkCache> cache = LinkCache::Open(dir.path, &diag);
+  ASSERT_THAT(cache, NotNull());
+  PutTestEntry(cache.get(), "key", {}, symbols.get());
+
+  // Entries persist across instances.
+  cache = LinkCache::Open(dir.path, &diag);
+  ASSERT_THAT(cache, NotNull());
+
+  std::vector<LinkCache::Document> docs;
+  EXPECT_FALSE(cache->Find("other_key", symbols.get(), &docs));
+  EXPECT_THAT(docs, IsEmpty());
+
+  ASSERT_TRUE(cache->Find("key", symbols.get(), &docs));
+  ASSERT_THAT(docs, SizeIs(2u));
+  EXPECT_EQ(ConfigDescription::DefaultConfig(), docs[0].config);
+  EXPECT_THAT(docs[0].path, StrEq("res/layout/main.xml"));
+  EXPECT_EQ(ArchiveEntry::kCompress, docs[0].flags);
+  EXPECT_FALSE(docs[0].written_as_file);
+  EXPECT_THAT(docs[0].data, StrEq("v1"));
+
+  EXPECT_EQ(test::ParseConfigOrDie("v21"), docs[1].config);
+  EXPECT_THAT(docs[1].path, StrEq("res/layout-v21/main.xml"));
+  EXPECT_TRUE(docs[1].written_as_file);
+  EXPECT_THAT(docs[1].data, StrEq("v21"));
+
+  EXPECT_EQ(1u, cache->GetHitCount());
+  EXPECT_EQ(1u, cache->GetMissCount());
+}
+
+TEST(LinkCacheTest, PruneDeletesUnusedEntries) {
+  TemporaryDir dir;
+  StdErrDiagnostics diag;
+
+  NameMangler mangler(NameManglerPolicy{"com.app.test"});
+  std::unique_ptr<SymbolTable> symbols = MakeSymbols(&mangler, true /*public_string*/);
+
+  std::unique_ptr<LinkCache> cache = LinkCache::Open(dir.path, &diag);
+  ASSERT_THAT(cache, NotNull());
+  PutTestEntry(cache.get(), "used", {}, symbols.get());
+  PutTestEntry(cache.get(), "unused", {}, symbols.get());
+
+  cache = LinkCache::Open(dir.path, &diag);
+  ASSERT_THAT(cache, NotNull());
+  std::vector<LinkCache::Document> docs;
+  ASSERT_TRUE(cache->Find("used", symbols.get(), &docs));
+  cache->Prune();
+
+  cache = LinkCache::Open(dir.path, &diag);
+  ASSERT_THAT(cache, NotNull());
+  EXPECT_TRUE(cache->Find("used", symbols.get(), &docs));
+  EXPECT_FALSE(cache->Find("unused", symbols.get(), &docs));
+}
+
+TEST(LinkCacheTest, ConcurrentLinksStoreCompleteEntries) {
+  TemporaryDir dir;
+  StdErrDiagnostics diag;
+
+  NameMangler mangler(NameManglerPolicy{"com.app.test"});
+  std::unique_ptr<SymbolTable> symbols = MakeSymbols(&mangler, true /*public_string*/);
+
+  // Two links store the same entry over and over, each through its own temporary file.
+  std::vector<std::thread> links;
+  for (int i = 0; i < 2; i++) {
+    links.emplace_back([&]() {
+      std::unique_ptr<LinkCache> cache = LinkCache::Open(dir.path, &diag);
+      ASSERT_THAT(cache, NotNull());
+      for (int j = 0; j < 20; j++) {
+        PutTestEntry(cache.get(), "key", {}, symbols.get());
+      }
+    });
+  }
+  for (std::thread& link : links) {
+    link.join();
+  }
+
+  // Only the entry is left, and it is complete.
+  Maybe<std::vector<std::string>> files = file::FindFiles(dir.path, &diag);
+  ASSERT_TRUE(files);
+  EXPECT_THAT(files.value(), SizeIs(1u));
+
+  std::unique_ptr<LinkCache> cache = LinkCache::Open(dir.path, &diag);
+  ASSERT_THAT(cache, NotNull());
+  std::vector<LinkCache::Document> docs;
+  ASSERT_TRUE(cache->Find("key", symbols.get(), &docs));
+  EXPECT_THAT(docs, SizeIs(2u));
+}
+
+TEST(LinkCacheTest, KeysDependOnLookedUpSymbols) {
+  EXPECT_NE(LinkCache::KeyBuilder().Append("ab").Append("c").ToString(),
+            LinkCache::KeyBuilder().Append("a").Append("bc").ToString());
+
+  NameMangler mangler(NameManglerPolicy{"com.app.test"});
+  std::unique_ptr<SymbolTable> public_symbols = MakeSymbols(&mangler, true /*public_string*/);
+  std::unique_ptr<SymbolTable> private_symbols = MakeSymbols(&mangler, false /*public_string*/);
+  auto symbols_key = [](const SymbolTable::Lookups& lookups, SymbolTable* symbols) {
+    return LinkCache::KeyBuilder().AppendSymbols(lookups, symbols).ToString();
+  };
+
+  SymbolTable::Lookups string_lookups;
+  string_lookups.names.insert(test::ParseNameOrDie("com.app.test:string/foo"));
+  EXPECT_NE(symbols_key(string_lookups, public_symbols.get()),
+            symbols_key(string_lookups, private_symbols.get()));
+
+  // Only the symbols that were looked up matter.
+  SymbolTable::Lookups attr_lookups;
+  attr_lookups.names.insert(test::ParseNameOrDie("com.app.test:attr/bar"));
+  attr_lookups.ids.insert(ResourceId(0x7f020000));
+  EXPECT_EQ(symbols_key(attr_lookups, public_symbols.get()),
+            symbols_key(attr_lookups, private_symbols.get()));
+  EXPECT_NE(symbols_key(string_lookups, public_symbols.get()),
+            symbols_key(attr_lookups, public_symbols.get()));
+}
+
+TEST(LinkCacheTest, FindMissesWhenLookedUpSymbolsChange) {
+  TemporaryDir dir;
+  StdErrDiagnostics diag;
+  NameMangler mangler(NameManglerPolicy{"com.app.test"});
+  std::unique_ptr<SymbolTable> public_symbols = MakeSymbols(&mangler, true /*public_string*/);
+  std::unique_ptr<SymbolTable> private_symbols = MakeSymbols(&mangler, false /*public_string*/);
+
+  SymbolTable::Lookups string_lookups;
+  string_lookups.names.insert(test::ParseNameOrDie("com.app.test:string/foo"));
+  SymbolTable::Lookups attr_lookups;
+  attr_lookups.names.insert(test::ParseNameOrDie("com.app.test:attr/bar"));
+
+  std::unique_ptr<LinkCache> cache = LinkCache::Open(dir.path, &diag);
+  ASSERT_THAT(cache, NotNull());
+  PutTestEntry(cache.get(), "string", string_lookups, public_symbols.get());
+  PutTestEntry(cache.get(), "attr", attr_lookups, public_symbols.get());
+
+  std::vector<LinkCache::Document> docs;
+  EXPECT_TRUE(cache->Find("string", public_symbols.get(), &docs));
+  EXPECT_TRUE(cache->Find("attr", public_symbols.get(), &docs));
+
+  // Changing the string only invalidates the entry that looked it up.
+  EXPECT_FALSE(cache->Find("string", private_symbols.get(), &docs));
+  EXPECT_TRUE(cache->Find("attr", private_symbols.get(), &docs));
+}
+
+}  // namespace aapt
@@ -17,6 +17,7 @@
 #include "MultiApkGenerator.h"
 
 #include <algorithm>
+#include <atomic>
 #include <regex>
 #include <string>
 
@@ -34,6 +35,7 @@
 #include "process/IResourceTableConsumer.h"
 #include "split/TableSplitter.h"
 #include "util/Files.h"
+#include "util/JobServer.h"
 #include "xml/XmlDom.h"
 #include "xml/XmlUtil.h"
 
@@ -51,7 +53,8 @@ using ::android::StringPiece;
 class ContextWrapper : public IAaptContext {
  public:
   explicit ContextWrapper(IAaptContext* context)
-      : context_(context), min_sdk_(context_->GetMinSdkVersion()) {
+      : context_(context), diag_(context->GetDiagnostics()),
+        min_sdk_(context_->GetMinSdkVersion()) {
   }
 
   PackageType GetPackageType() override {
@@ -66,7 +69,7 @@ class ContextWrapper : public IAaptContext {
     if (source_diag_) {
       return source_diag_.get();
     }
-    return context_->GetDiagnostics();
+    return diag_;
   }
 
   const std::string& GetCompilationPackage() override {
@@ -93,18 +96,29 @@ class ContextWrapper : public IAaptContext {
     min_sdk_ = min_sdk;
   }
 
+  // Sends diagnostics to `diag` instead of the wrapped context. Must be called before SetSource().
+  void SetDiagnostics(IDiagnostics* diag) {
+    diag_ = diag;
+  }
+
   void SetSource(const std::string& source) {
-    source_diag_ =
-        util::make_unique<SourcePathDiagnostics>(Source{source}, context_->GetDiagnostics());
+    source_diag_ = util::make_unique<SourcePathDiagnostics>(Source{source}, diag_);
   }
 
  private:
   IAaptContext* context_;
+  IDiagnostics* diag_;
   std::unique_ptr<SourcePathDiagnostics> source_diag_;
 
   int min_sdk_ = -1;
 };
 
+// The result of generating one artifact on a worker thread, held until it can be reported in order.
+struct ArtifactResult {
+  BufferedDiagnostics diagnostics;
+  bool success = false;
+};
+
 class SignatureFilter : public IPathFilter {
   bool Keep(const std::string& path) override {
     static std::regex signature_regex(R"regex(^META-INF/.*\.(RSA|DSA|EC|SF)$)regex");
@@ -124,13 +138,8 @@ bool MultiApkGenerator::FromBaseApk(const MultiApkGeneratorOptions& options) {
   std::unordered_set<std::string> filtered_artifacts;
   std::unordered_set<std::string> kept_artifacts;
 
-  // For now, just write out the stripped APK since ABI splitting doesn't modify anything else.
+  std::vector<const OutputArtifact*> artifacts;
   for (const OutputArtifact& artifact : options.apk_artifacts) {
-    FilterChain filters;
-
-    ContextWrapper wrapped_context{context_};
-    wrapped_context.SetSource(artifact.name);
-
     if (!options.kept_artifacts.empty()) {
       const auto& it = artifacts_to_keep.find(artifact.name);
       if (it == artifacts_to_keep.end()) {
@@ -144,42 +153,39 @@ bool MultiApkGenerator::FromBaseApk(const MultiApkGeneratorOptions& options) {
         kept_artifacts.insert(artifact.name);
       }
     }
+    artifacts.push_back(&artifact);
+  }
 
-    std::unique_ptr<ResourceTable> table =
-        FilterTable(context_, artifact, *apk_->GetResourceTable(), &filters);
-    if (!table) {
-      return false;
-    }
-
-    IDiagnostics* diag = wrapped_context.GetDiagnostics();
-
-    std::unique_ptr<XmlResource> manifest;
-    if (!UpdateManifest(artifact, &manifest, diag)) {
-      diag->Error(DiagMessage() << "could not update AndroidManifest.xml for output artifact");
-      return false;
-    }
-
-    std::string out = options.out_dir;
-    if (!file::mkdirs(out)) {
-      diag->Warn(DiagMessage() << "could not create out dir: " << out);
-    }
-    file::AppendPath(&out, artifact.name);
-
-    if (context_->IsVerbose()) {
-      diag->Note(DiagMessage() << "Generating split: " << out);
-    }
-
-    std::unique_ptr<IArchiveWriter> writer = CreateZipFileArchiveWriter(diag, out);
-
-    if (context_->IsVerbose()) {
-      diag->Note(DiagMessage() << "Writing output: " << out);
-    }
+  // Each artifact is written to its own APK, so they can be generated in parallel. Diagnostics are
+  // reported in the order of the artifacts, and nothing after the first failure is reported, so
+  // the output is the same as when generating them one at a time.
+  std::unique_ptr<JobServer> job_server = JobServer::FromEnvironment();
+  std::vector<std::unique_ptr<ArtifactResult>> results(artifacts.size());
+  std::atomic<bool> failed(false);
+  bool error = false;
+  ParallelForOrdered(
+      artifacts.size(), options.jobs, job_server.get(),
+      [&](size_t i) {
+        std::unique_ptr<ArtifactResult> result = util::make_unique<ArtifactResult>();
+        if (!failed) {
+          result->success = WriteArtifact(options, *artifacts[i], &result->diagnostics);
+          if (!result->success) {
+            failed = true;
+          }
+        }
+        results[i] = std::move(result);
+      },
+      [&](size_t i) {
+        std::unique_ptr<ArtifactResult> result = std::move(results[i]);
+        if (error) {
+          return;
+        }
+        result->diagnostics.FlushTo(context_->GetDiagnostics());
+        error = !result->success;
+      });
 
-    filters.AddFilter(util::make_unique<SignatureFilter>());
-    if (!apk_->WriteToArchive(&wrapped_context, table.get(), options.table_flattener_options,
-                              &filters, writer.get(), manifest.get())) {
-      return false;
-    }
+  if (error) {
+    return false;
   }
 
   // Make sure all of the requested artifacts were valid. If there are any kept artifacts left,
@@ -209,6 +215,68 @@ bool MultiApkGenerator::FromBaseApk(const MultiApkGeneratorOptions& options) {
   return true;
 }
 
+bool MultiApkGenerator::WriteArtifact(const MultiApkGeneratorOptions& options,
+                                      const OutputArtifact& artifact, IDiagnostics* job_diag) {
+  FilterChain filters;
+
+  ContextWrapper job_context{context_};
+  job_context.SetDiagnostics(job_diag);
+
+  ContextWrapper wrapped_context{context_};
+  wrapped_context.SetDiagnostics(job_diag);
+  wrapped_context.SetSource(artifact.name);
+
+  IDiagnostics* diag = wrapped_context.GetDiagnostics();
+
+  std::unique_ptr<ResourceTable> table;
+  std::unique_ptr<XmlResource> manifest;
+  {
+    // Copying the base APK's table and manifest reads their string pools, which can't be shared
+    // across threads.
+    std::lock_guard<std::mutex> lock(base_apk_mutex_);
+    table = FilterTable(&job_context, artifact, *apk_->GetResourceTable(), &filters);
+    if (!table) {
+      return false;
+    }
+
+    if (!UpdateManifest(artifact, &manifest, diag)) {
+      diag->Error(DiagMessage() << "could not update AndroidManifest.xml for output artifact");
+      return false;
+    }
+  }
+
+  std::string out = options.out_dir;
+  if (!file::mkdirs(out)) {
+    diag->Warn(DiagMessage() << "could not create out dir: " << out);
+  }
+  file::AppendPath(&out, artifact.name);
+
+  if (context_->IsVerbose()) {
+    diag->Note(DiagMessage() << "Generating split: " << out);
+  }
+
+  std::unique_ptr<IArchiveWriter> writer = CreateZipFileArchiveWriter(diag, out);
+  if (!writer) {
+    return false;
+  }
+
+  if (context_->IsVerbose()) {
+    diag->Note(DiagMessage() << "Writing output: " << out);
+  }
+
+  filters.AddFilter(util::make_unique<SignatureFilter>());
+  if (!apk_->WriteToArchive(&wrapped_context, table.get(), options.table_flattener_options,
+                            &filters, writer.get(), manifest.get())) {
+    return false;
+  }
+
+  if (!writer->Finish()) {
+    diag->Error(DiagMessage(out) << "failed to write archive: " << writer->GetError());
+    return false;
+  }
+  return true;
+}
+
 std::unique_ptr<ResourceTable> MultiApkGenerator::FilterTable(IAaptContext* context,
                                                               const OutputArtifact& artifact,
                                                               const ResourceTable& old_table,
@@ -18,6 +18,7 @@
 #define AAPT2_APKSPLITTER_H
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -33,6 +34,9 @@ struct MultiApkGeneratorOptions {
   std::vector<configuration::OutputArtifact> apk_artifacts;
   TableFlattenerOptions table_flattener_options;
   std::unordered_set<std::string> kept_artifacts;
+
+  // The maximum number of artifacts to generate in parallel.
+  size_t jobs = 1u;
 };
 
 /**
@@ -60,6 +64,11 @@ class MultiApkGenerator {
     return context_->GetDiagnostics();
   }
 
+  // Writes the APK of a single artifact, reporting diagnostics to `job_diag`. Safe to call from
+  // several threads at once.
+  bool WriteArtifact(const MultiApkGeneratorOptions& options,
+                     const configuration::OutputArtifact& artifact, IDiagnostics* job_diag);
+
   bool UpdateManifest(const configuration::OutputArtifact& artifact,
                       std::unique_ptr<xml::XmlResource>* updated_manifest, IDiagnostics* diag);
 
@@ -70,6 +79,9 @@ class MultiApkGenerator {
 
   LoadedApk* apk_;
   IAaptContext* context_;
+
+  // Guards reading the resource table and manifest of `apk_`.
+  std::mutex base_apk_mutex_;
 };
 
 }  // namespace aapt
@@ -77,6 +77,10 @@ const SymbolTable::Symbol* SymbolTable::FindByName(const ResourceName& name) {
     name_with_package = &name_with_package_impl.value();
   }
 
+  if (lookups_ != nullptr) {
+    lookups_->names.insert(*name_with_package);
+  }
+
   // We store the name unmangled in the cache, so look it up as-is.
   if (const std::shared_ptr<Symbol>& s = cache_.get(*name_with_package)) {
     return s.get();
@@ -115,6 +119,10 @@ const SymbolTable::Symbol* SymbolTable::FindByName(const ResourceName& name) {
 }
 
 const SymbolTable::Symbol* SymbolTable::FindById(const ResourceId& id) {
+  if (lookups_ != nullptr) {
+    lookups_->ids.insert(id);
+  }
+
   if (const std::shared_ptr<Symbol>& s = id_cache_.get(id)) {
     return s.get();
   }
@@ -212,6 +220,10 @@ std::unique_ptr<SymbolTable::Symbol> ResourceTableSymbolSource::FindByName(
 }
 
 bool AssetManagerSymbolSource::AddAssetPath(const StringPiece& path) {
+  // The new APK may define resources that weren't found before.
+  name_cache_.clear();
+  id_cache_.clear();
+
   int32_t cookie = 0;
   return assets_.addAssetPath(android::String8(path.data(), path.size()), &cookie);
 }
@@ -289,8 +301,39 @@ static std::unique_ptr<SymbolTable::Symbol> LookupAttributeInTable(
   return s;
 }
 
+// Returns a copy of a symbol kept by AssetManagerSymbolSource, or nullptr.
+static std::unique_ptr<SymbolTable::Symbol> CopySymbol(const SymbolTable::Symbol* symbol) {
+  if (symbol == nullptr) {
+    return {};
+  }
+  return util::make_unique<SymbolTable::Symbol>(*symbol);
+}
+
 std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::FindByName(
     const ResourceName& name) {
+  auto iter = name_cache_.find(name);
+  if (iter != name_cache_.end()) {
+    cache_hit_count_++;
+  } else {
+    cache_miss_count_++;
+    iter = name_cache_.emplace(name, LookupByName(name)).first;
+  }
+  return CopySymbol(iter->second.get());
+}
+
+std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::FindById(ResourceId id) {
+  auto iter = id_cache_.find(id);
+  if (iter != id_cache_.end()) {
+    cache_hit_count_++;
+  } else {
+    cache_miss_count_++;
+    iter = id_cache_.emplace(id, LookupById(id)).first;
+  }
+  return CopySymbol(iter->second.get());
+}
+
+std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::LookupByName(
+    const ResourceName& name) {
   const android::ResTable& table = assets_.getResources(false);
 
   const std::u16string package16 = util::Utf8ToUtf16(name.package);
@@ -353,7 +396,7 @@ static Maybe<ResourceName> GetResourceName(const android::ResTable& table,
   return ResourceUtils::ToResourceName(res_name);
 }
 
-std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::FindById(
+std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::LookupById(
     ResourceId id) {
   if (!id.is_valid()) {
     // Exit early and avoid the error logs from AssetManager.
@@ -19,6 +19,8 @@
 
 #include <algorithm>
 #include <memory>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
 #include "android-base/macros.h"
@@ -71,6 +73,12 @@ class SymbolTable {
     bool is_dynamic = false;
   };
 
+  // The names and IDs looked up through a SymbolTable, see SetLookupRecorder().
+  struct Lookups {
+    std::set<ResourceName> names;
+    std::set<ResourceId> ids;
+  };
+
   SymbolTable(NameMangler* mangler);
 
   // Overrides the default ISymbolTableDelegate, which allows a custom defined strategy for
@@ -85,6 +93,14 @@ class SymbolTable {
   // cause the existing cache to be cleared.
   void PrependSource(std::unique_ptr<ISymbolSource> source);
 
+  // While `lookups` is set, the name or ID of every FindByXXX call is added to it, whether or not
+  // the symbol is found, and whether or not it comes from the cache. Looking the same names and IDs
+  // up again tells whether something that depended on them would still see the same symbols.
+  // Pass nullptr to stop recording.
+  void SetLookupRecorder(Lookups* lookups) {
+    lookups_ = lookups;
+  }
+
   // NOTE: Never hold on to the result between calls to FindByXXX. The
   // results are stored in a cache which may evict entries on subsequent calls.
   const Symbol* FindByName(const ResourceName& name);
@@ -103,6 +119,7 @@ class SymbolTable {
   NameMangler* mangler_;
   std::unique_ptr<ISymbolTableDelegate> delegate_;
   std::vector<std::unique_ptr<ISymbolSource>> sources_;
+  Lookups* lookups_ = nullptr;
 
   // We use shared_ptr because unique_ptr is not supported and
   // we need automatic deletion.
@@ -187,6 +204,33 @@ class ResourceTableSymbolSource : public ISymbolSource {
   DISALLOW_COPY_AND_ASSIGN(ResourceTableSymbolSource);
 };
 
+// Forwards lookups to a symbol source that is owned elsewhere, so that the source can outlive the
+// SymbolTable and be shared by several of them.
+class SharedSymbolSource : public ISymbolSource {
+ public:
+  explicit SharedSymbolSource(std::shared_ptr<ISymbolSource> source) : source_(std::move(source)) {
+  }
+
+  std::unique_ptr<SymbolTable::Symbol> FindByName(const ResourceName& name) override {
+    return source_->FindByName(name);
+  }
+
+  std::unique_ptr<SymbolTable::Symbol> FindById(ResourceId id) override {
+    return source_->FindById(id);
+  }
+
+  std::unique_ptr<SymbolTable::Symbol> FindByReference(const Reference& ref) override {
+    return source_->FindByReference(ref);
+  }
+
+ private:
+  std::shared_ptr<ISymbolSource> source_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedSymbolSource);
+};
+
+// Exposes the resources of APKs loaded in an AssetManager. The result of every lookup is kept for
+// as long as the source lives, since the APKs never change once they are added.
 class AssetManagerSymbolSource : public ISymbolSource {
  public:
   AssetManagerSymbolSource() = default;
@@ -205,9 +249,27 @@ class AssetManagerSymbolSource : public ISymbolSource {
     return &assets_;
   }
 
+  // The number of lookups that were answered from, or had to be added to, the kept results.
+  size_t GetCacheHitCount() const {
+    return cache_hit_count_;
+  }
+
+  size_t GetCacheMissCount() const {
+    return cache_miss_count_;
+  }
+
  private:
+  std::unique_ptr<SymbolTable::Symbol> LookupByName(const ResourceName& name);
+  std::unique_ptr<SymbolTable::Symbol> LookupById(ResourceId id);
+
   android::AssetManager assets_;
 
+  // A null symbol means the resource doesn't exist.
+  std::unordered_map<ResourceName, std::unique_ptr<SymbolTable::Symbol>> name_cache_;
+  std::unordered_map<ResourceId, std::unique_ptr<SymbolTable::Symbol>> id_cache_;
+  size_t cache_hit_count_ = 0u;
+  size_t cache_miss_count_ = 0u;
+
   DISALLOW_COPY_AND_ASSIGN(AssetManagerSymbolSource);
 };
 
@@ -21,6 +21,7 @@
 #include "test/Test.h"
 #include "util/BigBuffer.h"
 
+using ::testing::ElementsAre;
 using ::testing::Eq;
 using ::testing::IsNull;
 using ::testing::Ne;
@@ -76,6 +77,30 @@ TEST(SymbolTableTest, FindByName) {
   EXPECT_THAT(symbol_table.FindByName(test::ParseNameOrDie("com.android.lib:id/foo")), NotNull());
 }
 
+TEST(SymbolTableTest, RecordLookups) {
+  std::unique_ptr<ResourceTable> table =
+      test::ResourceTableBuilder().AddSimple("com.android.app:id/foo").Build();
+
+  NameMangler mangler(NameManglerPolicy{"com.android.app"});
+  SymbolTable symbol_table(&mangler);
+  symbol_table.AppendSource(util::make_unique<ResourceTableSymbolSource>(table.get()));
+
+  // Warm the cache, cached lookups are recorded too.
+  EXPECT_THAT(symbol_table.FindByName(test::ParseNameOrDie("id/foo")), NotNull());
+
+  SymbolTable::Lookups lookups;
+  symbol_table.SetLookupRecorder(&lookups);
+  EXPECT_THAT(symbol_table.FindByName(test::ParseNameOrDie("id/foo")), NotNull());
+  EXPECT_THAT(symbol_table.FindByName(test::ParseNameOrDie("id/bar")), IsNull());
+  EXPECT_THAT(symbol_table.FindById(ResourceId(0x7f010000)), IsNull());
+  symbol_table.SetLookupRecorder(nullptr);
+  EXPECT_THAT(symbol_table.FindByName(test::ParseNameOrDie("id/baz")), IsNull());
+
+  EXPECT_THAT(lookups.names, ElementsAre(test::ParseNameOrDie("com.android.app:id/bar"),
+                                         test::ParseNameOrDie("com.android.app:id/foo")));
+  EXPECT_THAT(lookups.ids, ElementsAre(ResourceId(0x7f010000)));
+}
+
 TEST(SymbolTableTest, FindByNameWhenSymbolIsMangledInResTable) {
   using namespace android;
 
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/JobServer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "android-base/logging.h"
+
+#include "util/Util.h"
+
+using ::android::StringPiece;
+using ::android::base::unique_fd;
+
+namespace aapt {
+
+JobServer::JobServer(int read_fd, int write_fd, unique_fd owned_fd)
+    : read_fd_(read_fd), write_fd_(write_fd), owned_fd_(std::move(owned_fd)) {
+}
+
+#ifdef _WIN32
+
+std::unique_ptr<JobServer> JobServer::FromMakeFlags(const StringPiece& makeflags) {
+  // The jobserver protocol is implemented with a pipe, which isn't supported here.
+  return {};
+}
+
+bool JobServer::AcquireToken(const std::function<bool()>& cancelled, char* out_token) {
+  return false;
+}
+
+void JobServer::ReleaseToken(char token) {
+}
+
+#else
+
+// How long a thread waiting for a token sleeps before checking whether it is still needed.
+constexpr static int kTokenPollTimeoutMs = 100;
+
+static bool IsValidFd(int fd) {
+  return fd >= 0 && fcntl(fd, F_GETFD) != -1;
+}
+
+std::unique_ptr<JobServer> JobServer::FromMakeFlags(const StringPiece& makeflags) {
+  // The last occurrence of the option wins, as in make itself.
+  std::string auth;
+  for (const StringPiece& arg : util::Tokenize(makeflags, ' ')) {
+    for (const StringPiece& prefix : {StringPiece("--jobserver-auth="),
+                                      StringPiece("--jobserver-fds=")}) {
+      if (util::StartsWith(arg, prefix)) {
+        auth = arg.substr(prefix.size()).to_string();
+      }
+    }
+  }
+
+  if (auth.empty()) {
+    return {};
+  }
+
+  // Newer versions of make use a named pipe: --jobserver-auth=fifo:PATH
+  const StringPiece kFifoPrefix = "fifo:";
+  if (util::StartsWith(auth, kFifoPrefix)) {
+    const std::string path = auth.substr(kFifoPrefix.size());
+    unique_fd fd(open(path.c_str(), O_RDWR | O_CLOEXEC));
+    if (fd == -1) {
+      return {};
+    }
+    const int raw_fd = fd.get();
+    return std::unique_ptr<JobServer>(new JobServer(raw_fd, raw_fd, std::move(fd)));
+  }
+
+  // Otherwise the pipe is inherited: --jobserver-auth=R,W
+  const size_t comma = auth.find(',');
+  if (comma == std::string::npos) {
+    return {};
+  }
+
+  char* end = nullptr;
+  const long read_fd = strtol(auth.c_str(), &end, 10);
+  if (end != auth.c_str() + comma) {
+    return {};
+  }
+
+  const char* write_str = auth.c_str() + comma + 1;
+  const long write_fd = strtol(write_str, &end, 10);
+  if (end == write_str || *end != '\0') {
+    return {};
+  }
+
+  // make doesn't pass the pipe to commands it doesn't think are recursive makes, but still lists
+  // it in MAKEFLAGS, so make sure the file descriptors are really open.
+  if (!IsValidFd(static_cast<int>(read_fd)) || !IsValidFd(static_cast<int>(write_fd))) {
+    return {};
+  }
+  return std::unique_ptr<JobServer>(
+      new JobServer(static_cast<int>(read_fd), static_cast<int>(write_fd), unique_fd()));
+}
+
+bool JobServer::AcquireToken(const std::function<bool()>& cancelled, char* out_token) {
+  while (!cancelled()) {
+    struct pollfd pfd = {};
+    pfd.fd = read_fd_;
+    pfd.events = POLLIN;
+    const int result = poll(&pfd, 1, kTokenPollTimeoutMs);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    } else if (result == 0) {
+      continue;
+    }
+
+    if ((pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0 && (pfd.revents & POLLIN) == 0) {
+      return false;
+    }
+
+    // Another process may have taken the token between poll() and read(). The pipe may be
+    // non-blocking, in which case that shows up as EAGAIN.
+    const ssize_t n = read(read_fd_, out_token, 1);
+    if (n == 1) {
+      return true;
+    } else if (n == 0) {
+      return false;
+    } else if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+      return false;
+    }
+  }
+  return false;
+}
+
+void JobServer::ReleaseToken(char token) {
+  while (write(write_fd_, &token, 1) < 0) {
+    if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+      PLOG(ERROR) << "failed to return jobserver token";
+      return;
+    }
+  }
+}
+
+#endif  // _WIN32
+
+std::unique_ptr<JobServer> JobServer::FromEnvironment() {
+  const char* makeflags = getenv("MAKEFLAGS");
+  if (makeflags == nullptr) {
+    return {};
+  }
+  return FromMakeFlags(makeflags);
+}
+
+void ParallelForOrdered(size_t count, size_t max_jobs, JobServer* job_server,
+                        const std::function<void(size_t)>& work,
+                        const std::function<void(size_t)>& consume) {
+  if (max_jobs <= 1 || count <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      work(i);
+      consume(i);
+    }
+    return;
+  }
+
+  std::mutex lock;
+  std::condition_variable done_cv;
+  std::vector<bool> done(count, false);
+  size_t next = 0;
+
+  // Claims the next item, or returns false if there is none left.
+  auto claim = [&](size_t* out_index) -> bool {
+    std::lock_guard<std::mutex> guard(lock);
+    if (next >= count) {
+      return false;
+    }
+    *out_index = next++;
+    return true;
+  };
+
+  auto finish = [&](size_t index) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      done[index] = true;
+    }
+    done_cv.notify_all();
+  };
+
+  auto no_work_left = [&]() -> bool {
+    std::lock_guard<std::mutex> guard(lock);
+    return next >= count;
+  };
+
+  // The first worker runs on the token this process implicitly holds. The others must acquire a
+  // token for every item when there is a jobserver, so that they only run when the build has a
+  // free job slot.
+  auto worker = [&](bool needs_token) {
+    while (true) {
+      char token = 0;
+      if (needs_token && job_server != nullptr && !job_server->AcquireToken(no_work_left, &token)) {
+        return;
+      }
+
+      size_t index;
+      const bool claimed = claim(&index);
+      if (claimed) {
+        work(index);
+      }
+
+      if (needs_token && job_server != nullptr) {
+        job_server->ReleaseToken(token);
+      }
+
+      if (!claimed) {
+        return;
+      }
+      finish(index);
+    }
+  };
+
+  const size_t thread_count = std::min(max_jobs, count);
+  std::vector<std::thread> threads;
+  threads.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; i++) {
+    threads.emplace_back(worker, i != 0);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      done_cv.wait(guard, [&]() -> bool { return done[i]; });
+    }
+    consume(i);
+  }
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace aapt
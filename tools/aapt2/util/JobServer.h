@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_JOBSERVER_H
+#define AAPT_JOBSERVER_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#include "android-base/macros.h"
+#include "android-base/unique_fd.h"
+#include "androidfw/StringPiece.h"
+
+namespace aapt {
+
+// A client of the GNU make jobserver. Every process started by make implicitly holds one job
+// token. Any additional job it runs in parallel must first read a token from the jobserver, and
+// write it back when the job is done, so that the whole build never runs more jobs than make's
+// own -j limit.
+class JobServer {
+ public:
+  // Returns the jobserver described by the `--jobserver-auth=` (or the older `--jobserver-fds=`)
+  // option in `makeflags`, or nullptr if there is none or its file descriptors aren't usable.
+  static std::unique_ptr<JobServer> FromMakeFlags(const android::StringPiece& makeflags);
+
+  // Returns the jobserver described by the MAKEFLAGS environment variable, or nullptr.
+  static std::unique_ptr<JobServer> FromEnvironment();
+
+  // Blocks until a token is available, and stores it in `out_token`. Returns false without a
+  // token once `cancelled` returns true, or if the jobserver is gone.
+  bool AcquireToken(const std::function<bool()>& cancelled, char* out_token);
+
+  // Returns a token obtained from AcquireToken() to the jobserver.
+  void ReleaseToken(char token);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(JobServer);
+
+  JobServer(int read_fd, int write_fd, android::base::unique_fd owned_fd);
+
+  int read_fd_;
+  int write_fd_;
+
+  // Set when the jobserver is a named pipe that was opened by this process.
+  android::base::unique_fd owned_fd_;
+};
+
+// Calls `work(i)` for every i in [0, count) on up to `max_jobs` threads, and `consume(i)` on the
+// calling thread, in increasing order of i, as soon as `work(i)` and all work before it is done.
+// If `job_server` is set, every thread but one must hold a token from it while running work.
+// With `max_jobs` <= 1 everything runs on the calling thread.
+void ParallelForOrdered(size_t count, size_t max_jobs, JobServer* job_server,
+                        const std::function<void(size_t)>& work,
+                        const std::function<void(size_t)>& consume);
+
+}  // namespace aapt
+
+#endif /* AAPT_JOBSERVER_H */
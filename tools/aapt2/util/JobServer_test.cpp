@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/JobServer.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "test/Test.h"
+
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+namespace aapt {
+
+TEST(JobServerTest, ParallelForOrderedConsumesInOrder) {
+  std::vector<int> squares(64);
+  std::vector<int> consumed;
+  ParallelForOrdered(
+      squares.size(), 4u, nullptr /*job_server*/,
+      [&](size_t i) { squares[i] = static_cast<int>(i * i); },
+      [&](size_t i) {
+        // Work for an item is always done before it is consumed.
+        EXPECT_EQ(static_cast<int>(i * i), squares[i]);
+        consumed.push_back(static_cast<int>(i));
+      });
+
+  ASSERT_EQ(squares.size(), consumed.size());
+  for (size_t i = 0; i < consumed.size(); i++) {
+    EXPECT_EQ(static_cast<int>(i), consumed[i]);
+  }
+}
+
+TEST(JobServerTest, ParseMakeFlags) {
+  EXPECT_THAT(JobServer::FromMakeFlags(""), IsNull());
+  EXPECT_THAT(JobServer::FromMakeFlags("-j8"), IsNull());
+  EXPECT_THAT(JobServer::FromMakeFlags("--jobserver-auth=bogus"), IsNull());
+
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  const std::string fds_str = std::to_string(fds[0]) + "," + std::to_string(fds[1]);
+  EXPECT_THAT(JobServer::FromMakeFlags("-j --jobserver-auth=" + fds_str), NotNull());
+  EXPECT_THAT(JobServer::FromMakeFlags("-j --jobserver-fds=" + fds_str), NotNull());
+  close(fds[0]);
+  close(fds[1]);
+
+  // The file descriptors are listed but were not inherited.
+  EXPECT_THAT(JobServer::FromMakeFlags("-j --jobserver-auth=" + fds_str), IsNull());
+}
+
+TEST(JobServerTest, ParallelWorkersShareJobServerTokens) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+
+  // Offer a single token, so at most two items (one on the implicit token) run at once.
+  ASSERT_EQ(1, write(fds[1], "+", 1));
+  std::unique_ptr<JobServer> job_server = JobServer::FromMakeFlags(
+      "--jobserver-auth=" + std::to_string(fds[0]) + "," + std::to_string(fds[1]));
+  ASSERT_THAT(job_server, NotNull());
+
+  std::atomic<int> running(0);
+  std::atomic<int> max_running(0);
+  ParallelForOrdered(
+      32u, 8u, job_server.get(),
+      [&](size_t i) {
+        const int now_running = ++running;
+        int expected = max_running.load();
+        while (now_running > expected && !max_running.compare_exchange_weak(expected, now_running)) {
+        }
+        usleep(1000);
+        --running;
+      },
+      [&](size_t i) {});
+  EXPECT_LE(max_running.load(), 2);
+
+  // The token was returned.
+  char token;
+  ASSERT_EQ(1, read(fds[0], &token, 1));
+  EXPECT_EQ('+', token);
+
+  job_server = {};
+  close(fds[0]);
+  close(fds[1]);
+}
+
+}  // namespace aapt